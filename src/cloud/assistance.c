@@ -0,0 +1,91 @@
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/util.h>
+
+#include "cloud/assistance.h"
+#include "codec.h"
+
+size_t assistance_agnss_request_encode(const struct nrf_modem_gnss_agnss_data_frame *request,
+				       uint8_t *buf)
+{
+	size_t len = 0;
+	uint8_t count = MIN(request->system_count,
+			    MIN(ARRAY_SIZE(request->system), ASSISTANCE_AGNSS_SYSTEMS_MAX));
+
+	buf[len++] = ASSISTANCE_VERSION;
+	sys_put_le32(request->data_flags, &buf[len]);
+	len += 4;
+	buf[len++] = count;
+
+	for (uint8_t i = 0; i < count; i++) {
+		buf[len++] = request->system[i].system_id;
+		sys_put_le64(request->system[i].sv_mask_ephe, &buf[len]);
+		len += 8;
+		sys_put_le64(request->system[i].sv_mask_alm, &buf[len]);
+		len += 8;
+	}
+
+	return len;
+}
+
+size_t assistance_cells_request_encode(const struct location_module_cells *cells, uint8_t *buf)
+{
+	const struct lte_lc_cell *cell = &cells->current_cell;
+	uint8_t count = MIN(cells->ncells_count, LOCATION_MODULE_NCELLS_MAX);
+	size_t len = 0;
+
+	buf[len++] = ASSISTANCE_VERSION;
+	sys_put_le16(cell->mcc, &buf[len]);
+	len += 2;
+	sys_put_le16(cell->mnc, &buf[len]);
+	len += 2;
+	sys_put_le32(cell->tac, &buf[len]);
+	len += 4;
+	sys_put_le32(cell->id, &buf[len]);
+	len += 4;
+	sys_put_le32(cell->earfcn, &buf[len]);
+	len += 4;
+	sys_put_le16(cell->phys_cell_id, &buf[len]);
+	len += 2;
+	sys_put_le16(cell->rsrp, &buf[len]);
+	len += 2;
+	sys_put_le16(cell->rsrq, &buf[len]);
+	len += 2;
+	sys_put_le16(cell->timing_advance, &buf[len]);
+	len += 2;
+	buf[len++] = count;
+
+	for (uint8_t i = 0; i < count; i++) {
+		const struct lte_lc_ncell *ncell = &cells->neighbor_cells[i];
+
+		sys_put_le32(ncell->earfcn, &buf[len]);
+		len += 4;
+		sys_put_le16(ncell->phys_cell_id, &buf[len]);
+		len += 2;
+		sys_put_le16(ncell->rsrp, &buf[len]);
+		len += 2;
+		sys_put_le16(ncell->rsrq, &buf[len]);
+		len += 2;
+		sys_put_le32(ncell->time_diff, &buf[len]);
+		len += 4;
+	}
+
+	return len;
+}
+
+int assistance_cell_location_decode(const uint8_t *buf, size_t len,
+				    struct location_data *location)
+{
+	if (len < 13 || buf[0] != ASSISTANCE_VERSION) {
+		return -EBADMSG;
+	}
+
+	memset(location, 0, sizeof(*location));
+	location->latitude = (double)(int32_t)sys_get_le32(&buf[1]) / CODEC_SCALE_DEGREES;
+	location->longitude = (double)(int32_t)sys_get_le32(&buf[5]) / CODEC_SCALE_DEGREES;
+	location->accuracy = (float)sys_get_le32(&buf[9]);
+
+	return 0;
+}
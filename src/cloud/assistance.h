@@ -0,0 +1,83 @@
+#ifndef _ASSISTANCE_H_
+#define _ASSISTANCE_H_
+
+/**
+ * @brief Location assistance codec
+ * @defgroup assistance Binary requests and responses of the A-GNSS and
+ *			cellular positioning resources
+ * @{
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <modem/location.h>
+
+#include "events/location_module_event.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Version byte that starts every request and response. */
+#define ASSISTANCE_VERSION 1
+
+/** Maximum number of GNSS systems in an A-GNSS request. */
+#define ASSISTANCE_AGNSS_SYSTEMS_MAX 4
+
+/** Maximum length of an A-GNSS request. */
+#define ASSISTANCE_AGNSS_REQUEST_MAX_LEN (6 + ASSISTANCE_AGNSS_SYSTEMS_MAX * 17)
+
+/** Maximum length of a cellular positioning request. */
+#define ASSISTANCE_CELLS_REQUEST_MAX_LEN (26 + LOCATION_MODULE_NCELLS_MAX * 14)
+
+/** @brief Encode the assistance data needed by GNSS. The request is the
+ *	   version, the data flags (uint32), the number of systems (uint8) and
+ *	   for each system its id (uint8) and the ephemeris and almanac masks
+ *	   of its satellites (uint64), all little endian. The response is the
+ *	   assistance data in the nRF Cloud A-GNSS binary format.
+ *
+ * @param request Assistance data needed.
+ * @param buf Buffer of ASSISTANCE_AGNSS_REQUEST_MAX_LEN bytes.
+ *
+ * @return Length of the request.
+ */
+size_t assistance_agnss_request_encode(const struct nrf_modem_gnss_agnss_data_frame *request,
+				       uint8_t *buf);
+
+/** @brief Encode the cells to locate. The request is the version, the
+ *	   serving cell as MCC, MNC (uint16), TAC, cell id, EARFCN (uint32),
+ *	   physical cell id, RSRP, RSRQ and timing advance (int16), the number
+ *	   of neighbor cells (uint8) and for each of them its EARFCN (uint32),
+ *	   physical cell id, RSRP, RSRQ (int16) and time difference (int32),
+ *	   all little endian. RSRP and RSRQ are the modem's indices.
+ *
+ * @param cells Cells to locate.
+ * @param buf Buffer of ASSISTANCE_CELLS_REQUEST_MAX_LEN bytes.
+ *
+ * @return Length of the request.
+ */
+size_t assistance_cells_request_encode(const struct location_module_cells *cells, uint8_t *buf);
+
+/** @brief Decode a cellular positioning response, the version, the latitude
+ *	   and longitude in 1e-7 degrees (int32) and the accuracy in meters
+ *	   (uint32), all little endian.
+ *
+ * @param buf Response payload.
+ * @param len Length of the payload.
+ * @param location The location is written here.
+ *
+ * @return 0 on success, or -EBADMSG if the response is malformed.
+ */
+int assistance_cell_location_decode(const uint8_t *buf, size_t len,
+				    struct location_data *location);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* _ASSISTANCE_H_ */
@@ -0,0 +1,108 @@
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/logging/log.h>
+
+#include "cloud/blockwise.h"
+
+LOG_MODULE_REGISTER(blockwise, LOG_LEVEL_DBG);
+
+uint32_t blockwise_option(uint32_t num, bool more, uint8_t szx)
+{
+	return (num << 4) | (more ? 0x08 : 0) | szx;
+}
+
+void blockwise_upload_start(struct blockwise_upload *upload, const uint8_t *payload, size_t len)
+{
+	upload->payload = payload;
+	upload->len = len;
+	upload->offset = 0;
+	upload->block_len = 0;
+	upload->szx = BLOCKWISE_SZX_PREFERRED;
+}
+
+void blockwise_upload_next(struct blockwise_upload *upload, struct blockwise_block *block)
+{
+	bool more;
+
+	upload->block_len = MIN(BLOCKWISE_BYTES(upload->szx), upload->len - upload->offset);
+	more = upload->offset + upload->block_len < upload->len;
+
+	block->data = upload->payload + upload->offset;
+	block->len = upload->block_len;
+	block->block1 = blockwise_option(upload->offset >> (upload->szx + 4), more, upload->szx);
+
+	/* The total size lets the server reject a too large upload at once. */
+	block->size1 = upload->offset == 0 ? upload->len : 0;
+}
+
+bool blockwise_upload_response(struct blockwise_upload *upload,
+			       const struct coap_packet *response)
+{
+	int block1;
+
+	if (response == NULL || coap_header_get_code(response) != COAP_RESPONSE_CODE_CONTINUE) {
+		upload->payload = NULL;
+		return false;
+	}
+
+	upload->offset += upload->block_len;
+	if (upload->offset >= upload->len) {
+		LOG_ERR("Continue after the last block");
+		upload->payload = NULL;
+		return false;
+	}
+
+	/* The server may ask for smaller blocks, the offset stays a multiple of them. */
+	block1 = coap_get_option_int(response, COAP_OPTION_BLOCK1);
+	if (block1 >= 0 && (block1 & 0x07) < upload->szx) {
+		upload->szx = block1 & 0x07;
+		LOG_INF("Server negotiated %u byte blocks", BLOCKWISE_BYTES(upload->szx));
+	}
+
+	return true;
+}
+
+int blockwise_download_append(const struct coap_packet *reply, uint8_t *buf, size_t size,
+			      size_t *len, uint32_t *next_block2)
+{
+	const uint8_t *payload;
+	uint16_t payload_len;
+	int block2 = coap_get_option_int(reply, COAP_OPTION_BLOCK2);
+	size_t offset = 0;
+	bool more = false;
+	uint8_t szx = 0;
+
+	payload = coap_packet_get_payload(reply, &payload_len);
+
+	if (block2 >= 0) {
+		szx = block2 & 0x07;
+		more = block2 & 0x08;
+		offset = (size_t)(block2 >> 4) << (szx + 4);
+	}
+
+	/* The first block starts a new document, for example a notification. */
+	if (offset == 0) {
+		*len = 0;
+	} else if (offset != *len) {
+		LOG_ERR("Unexpected block at offset %zu", offset);
+		return -EBADMSG;
+	}
+
+	if (offset + payload_len > size) {
+		LOG_ERR("Document larger than %zu bytes", size);
+		return -EMSGSIZE;
+	}
+
+	memcpy(&buf[offset], payload, payload_len);
+	*len = offset + payload_len;
+
+	if (more) {
+		/* Continue with the smaller of the two block sizes. */
+		szx = MIN(szx, BLOCKWISE_SZX_PREFERRED);
+		*next_block2 = blockwise_option(*len >> (szx + 4), false, szx);
+	}
+
+	return more ? 1 : 0;
+}
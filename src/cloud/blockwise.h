@@ -0,0 +1,103 @@
+#ifndef _BLOCKWISE_H_
+#define _BLOCKWISE_H_
+
+/**
+ * @brief Block-wise transfers
+ * @defgroup blockwise Block1 uploads and Block2 downloads (RFC 7959)
+ * @{
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <zephyr/net/coap.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Block size exponent of CONFIG_CLOUD_COAP_BLOCK_SIZE, the block size is
+ *  2^(SZX + 4) bytes.
+ */
+#define BLOCKWISE_SZX_PREFERRED (find_lsb_set(CONFIG_CLOUD_COAP_BLOCK_SIZE) - 5)
+
+/** Size in bytes of the blocks of a block size exponent. */
+#define BLOCKWISE_BYTES(szx) (1U << ((szx) + 4))
+
+/** @brief A request payload uploaded in Block1 blocks. */
+struct blockwise_upload {
+	/** Payload, NULL when no upload runs. */
+	const uint8_t *payload;
+	size_t len;
+	/** Bytes acknowledged by the server. */
+	size_t offset;
+	/** Size of the block being sent. */
+	size_t block_len;
+	/** Block size exponent, lowered if the server asks for smaller blocks. */
+	uint8_t szx;
+};
+
+/** @brief The next block of an upload to send. */
+struct blockwise_block {
+	const uint8_t *data;
+	size_t len;
+	/** Value of the Block1 option. */
+	uint32_t block1;
+	/** Value of the Size1 option, 0 except in the first block. */
+	uint32_t size1;
+};
+
+/** @brief Value of a Block1 or Block2 option. */
+uint32_t blockwise_option(uint32_t num, bool more, uint8_t szx);
+
+/** @brief Start an upload with blocks of CONFIG_CLOUD_COAP_BLOCK_SIZE bytes.
+ *
+ * @param upload Upload state.
+ * @param payload Payload, kept until the upload ends.
+ * @param len Length of the payload.
+ */
+void blockwise_upload_start(struct blockwise_upload *upload, const uint8_t *payload, size_t len);
+
+/** @brief Get the next block of an upload.
+ *
+ * @param upload Upload state.
+ * @param[out] block Block to send.
+ */
+void blockwise_upload_next(struct blockwise_upload *upload, struct blockwise_block *block);
+
+/** @brief Handle the response to the block sent last. The server may ask
+ *	   for smaller blocks in the Block1 option of a 2.31 Continue.
+ *
+ * @param upload Upload state.
+ * @param response Response, or NULL if the block got none.
+ *
+ * @return true if the next block is to be sent, false if the upload has
+ *	   ended and the response is the one of the whole request.
+ */
+bool blockwise_upload_response(struct blockwise_upload *upload,
+			       const struct coap_packet *response);
+
+/** @brief Add the payload of a Block2 response to a document.
+ *
+ * @param reply Response with a block of the document.
+ * @param buf Buffer the document is reassembled in.
+ * @param size Size of the buffer.
+ * @param[in,out] len Length of the document so far.
+ * @param[out] next_block2 Block2 option of the next block to request.
+ *
+ * @return 1 if more blocks follow, 0 if the document is complete, or a
+ *	   negative error code.
+ */
+int blockwise_download_append(const struct coap_packet *reply, uint8_t *buf, size_t size,
+			      size_t *len, uint32_t *next_block2);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* _BLOCKWISE_H_ */
@@ -0,0 +1,38 @@
+#include <zephyr/kernel.h>
+#include <zephyr/net/coap.h>
+
+#include "cloud/cloud_codec.h"
+
+int cloud_codec_encode(const struct cloud_location_data *fixes, size_t count,
+		       bool array, uint8_t *buf, size_t size, size_t *len,
+		       size_t *single_len)
+{
+#if defined(CONFIG_COAP_DATA_FORMAT_CBOR)
+	return cloud_codec_encode_cbor(fixes, count, array, buf, size, len, single_len);
+#elif defined(CONFIG_COAP_DATA_FORMAT_RECORD)
+	/* A single fix is a batch of one record. */
+	int encoded = codec_records_encode(fixes, array ? count : 1, buf, size, len);
+
+	if (encoded > 0 && single_len != NULL) {
+		*single_len = 0;
+		for (int i = 0; i < encoded; i++) {
+			*single_len += codec_record_single_len(&fixes[i]);
+		}
+	}
+
+	return encoded;
+#else
+	return cloud_codec_encode_json(fixes, count, array, buf, size, len, single_len);
+#endif
+}
+
+uint8_t cloud_codec_content_format(void)
+{
+#if defined(CONFIG_COAP_DATA_FORMAT_CBOR)
+	return COAP_CONTENT_FORMAT_APP_CBOR;
+#elif defined(CONFIG_COAP_DATA_FORMAT_RECORD)
+	return COAP_CONTENT_FORMAT_APP_OCTET_STREAM;
+#else
+	return COAP_CONTENT_FORMAT_APP_JSON;
+#endif
+}
@@ -0,0 +1,94 @@
+#ifndef _CLOUD_CODEC_H_
+#define _CLOUD_CODEC_H_
+
+/**
+ * @brief Cloud codec
+ * @defgroup cloud_codec Encoding of the location data sent to the cloud
+ * @{
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "codec.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief CBOR map keys of a fix record. */
+enum cloud_codec_cbor_key {
+	/** Fix time, UNIX seconds. */
+	CLOUD_CODEC_KEY_TIME,
+	/** Latitude in 1e-7 degrees. */
+	CLOUD_CODEC_KEY_LATITUDE,
+	/** Longitude in 1e-7 degrees. */
+	CLOUD_CODEC_KEY_LONGITUDE,
+	/** Altitude in decimeters. */
+	CLOUD_CODEC_KEY_ALTITUDE,
+	/** Accuracy in decimeters. */
+	CLOUD_CODEC_KEY_ACCURACY,
+};
+
+/** @brief Encode fixes in the format selected with CONFIG_COAP_DATA_FORMAT.
+ *	   The encoders write directly to the buffer and never allocate.
+ *
+ * @param fixes Fixes to encode.
+ * @param count Number of fixes.
+ * @param array Encode the fixes as an array. If false, only the first fix
+ *		is encoded on its own.
+ * @param buf Buffer the payload is written to.
+ * @param size Size of the buffer. Fixes that do not fit are left out.
+ * @param len Length of the encoded payload.
+ * @param single_len If not NULL, the total length of the payloads of the
+ *		     encoded fixes sent each on its own is written here. It
+ *		     is computed while encoding, the fixes are not encoded
+ *		     again.
+ *
+ * @return Number of fixes encoded, or a negative error code if not even
+ *	   one fix fits in the buffer.
+ */
+int cloud_codec_encode(const struct cloud_location_data *fixes, size_t count,
+		       bool array, uint8_t *buf, size_t size, size_t *len,
+		       size_t *single_len);
+
+/** @brief CoAP Content-Format of the payload made by cloud_codec_encode(). */
+uint8_t cloud_codec_content_format(void);
+
+/** @brief Encode fixes as JSON. Each fix is an object with a formatted UTC
+ *	   time. The parameters are the same as for cloud_codec_encode().
+ */
+int cloud_codec_encode_json(const struct cloud_location_data *fixes, size_t count,
+			    bool array, uint8_t *buf, size_t size, size_t *len,
+			    size_t *single_len);
+
+/** @brief Encode fixes as CBOR. Each fix is a map with integer keys and
+ *	   fixed-point integer values.
+ *
+ * @param fixes Fixes to encode.
+ * @param count Number of fixes.
+ * @param array Encode the fixes as an array of maps. If false, only the
+ *		first fix is encoded as a single map.
+ * @param buf Buffer the payload is written to.
+ * @param size Size of the buffer. Fixes that do not fit are left out.
+ * @param len Length of the encoded payload.
+ * @param single_len If not NULL, the total length of the encoded fixes
+ *		     encoded each as a single map.
+ *
+ * @return Number of fixes encoded, or a negative error code if not even
+ *	   one fix fits in the buffer.
+ */
+int cloud_codec_encode_cbor(const struct cloud_location_data *fixes, size_t count,
+			    bool array, uint8_t *buf, size_t size, size_t *len,
+			    size_t *single_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* _CLOUD_CODEC_H_ */
@@ -0,0 +1,130 @@
+#include <errno.h>
+#include <zephyr/kernel.h>
+#include <zcbor_encode.h>
+
+#include "cloud/cloud_codec.h"
+
+/**@brief Size of the head of a CBOR data item holding an integer. */
+static size_t cbor_int_len(int64_t value)
+{
+	uint64_t arg = value < 0 ? (uint64_t)(-1 - value) : (uint64_t)value;
+
+	if (arg < 24) {
+		return 1;
+	} else if (arg <= UINT8_MAX) {
+		return 2;
+	} else if (arg <= UINT16_MAX) {
+		return 3;
+	} else if (arg <= UINT32_MAX) {
+		return 5;
+	}
+
+	return 9;
+}
+
+/**@brief Encoded size of the head and end of an array or map. zcbor writes
+ *	  indefinite length containers, closed by a break byte, unless
+ *	  canonical encoding is enabled.
+ */
+static size_t container_overhead(size_t count)
+{
+#if defined(CONFIG_ZCBOR_CANONICAL)
+	return cbor_int_len(count);
+#else
+	return 2;
+#endif
+}
+
+/**@brief Encoded size of a fix map, with five one byte keys. */
+static size_t fix_map_len(const struct codec_fix_record *record)
+{
+	return container_overhead(5) + 5 + cbor_int_len(record->time) +
+	       cbor_int_len(record->latitude) + cbor_int_len(record->longitude) +
+	       cbor_int_len(record->altitude) + cbor_int_len(record->accuracy);
+}
+
+/* The values are the fixed-point integers of the record format. A
+ * coordinate in 1e-7 degrees, about 1 cm, takes the same 5 bytes as a
+ * float32, which resolves only about 2 m of longitude. A float64 would take
+ * 9 bytes for a precision far below the accuracy of a fix.
+ */
+static bool encode_fix_map(zcbor_state_t *state, const struct codec_fix_record *record)
+{
+	return zcbor_map_start_encode(state, 5) &&
+	       zcbor_uint32_put(state, CLOUD_CODEC_KEY_TIME) &&
+	       zcbor_uint64_put(state, record->time) &&
+	       zcbor_uint32_put(state, CLOUD_CODEC_KEY_LATITUDE) &&
+	       zcbor_int32_put(state, record->latitude) &&
+	       zcbor_uint32_put(state, CLOUD_CODEC_KEY_LONGITUDE) &&
+	       zcbor_int32_put(state, record->longitude) &&
+	       zcbor_uint32_put(state, CLOUD_CODEC_KEY_ALTITUDE) &&
+	       zcbor_int32_put(state, record->altitude) &&
+	       zcbor_uint32_put(state, CLOUD_CODEC_KEY_ACCURACY) &&
+	       zcbor_int32_put(state, record->accuracy) &&
+	       zcbor_map_end_encode(state, 5);
+}
+
+int cloud_codec_encode_cbor(const struct cloud_location_data *fixes, size_t count,
+			    bool array, uint8_t *buf, size_t size, size_t *len,
+			    size_t *single_len)
+{
+	struct codec_fix_record record;
+	size_t maps_len = 0;
+	size_t total;
+	size_t fit;
+
+	if (count == 0) {
+		return -EINVAL;
+	}
+
+	if (!array) {
+		count = 1;
+	}
+
+	/* The size of each fix is known before encoding, so the fixes that
+	 * do not fit are left out without encoding them twice.
+	 */
+	total = array ? container_overhead(count) : 0;
+	for (fit = 0; fit < count; fit++) {
+		codec_record_from_fix(&record, &fixes[fit]);
+
+		size_t fix_len = fix_map_len(&record);
+
+		if (total + fix_len > size) {
+			break;
+		}
+		total += fix_len;
+		maps_len += fix_len;
+	}
+
+	if (fit == 0) {
+		return -ENOMEM;
+	}
+
+	/* Canonical encoding takes a backup for the array and for the map. */
+	ZCBOR_STATE_E(state, 2, buf, size, 1);
+
+	if (array && !zcbor_list_start_encode(state, fit)) {
+		return -ENOMEM;
+	}
+
+	for (size_t i = 0; i < fit; i++) {
+		codec_record_from_fix(&record, &fixes[i]);
+		if (!encode_fix_map(state, &record)) {
+			return -ENOMEM;
+		}
+	}
+
+	if (array && !zcbor_list_end_encode(state, fit)) {
+		return -ENOMEM;
+	}
+
+	*len = state->payload - buf;
+
+	/* A single fix is its map on its own. */
+	if (single_len != NULL) {
+		*single_len = maps_len;
+	}
+
+	return fit;
+}
@@ -0,0 +1,128 @@
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <time.h>
+#include <zephyr/kernel.h>
+
+#include "cloud/cloud_codec.h"
+
+/* The JSON encoder writes directly to the caller's buffer and does not
+ * allocate. Floating point values are printed as scaled integers, because
+ * the libc float conversion may allocate from the heap.
+ */
+struct json_writer {
+	char *buf;
+	size_t size;
+	size_t len;
+};
+
+static bool append(struct json_writer *w, const char *fmt, ...)
+{
+	va_list args;
+	int ret;
+	size_t left = w->size - w->len;
+
+	if (w->len >= w->size) {
+		return false;
+	}
+
+	va_start(args, fmt);
+	ret = vsnprintf(w->buf + w->len, left, fmt, args);
+	va_end(args);
+
+	if (ret < 0 || ret >= left) {
+		return false;
+	}
+
+	w->len += ret;
+
+	return true;
+}
+
+/* Print value with the given number of decimals, scale is 10^decimals. */
+static bool append_fixed(struct json_writer *w, double value, uint32_t scale, int decimals)
+{
+	int64_t scaled = (int64_t)(value * scale + (value < 0 ? -0.5 : 0.5));
+	uint64_t abs = scaled < 0 ? -scaled : scaled;
+
+	return append(w, "%s%llu.%0*llu", scaled < 0 ? "-" : "",
+		      abs / scale, decimals, abs % scale);
+}
+
+static bool append_fix(struct json_writer *w, const struct cloud_location_data *fix,
+		       bool separator)
+{
+	time_t rawtime = (time_t)(fix->gnss_ts / MSEC_PER_SEC);
+	struct tm tm_info;
+
+	gmtime_r(&rawtime, &tm_info);
+
+	return append(w, "%s{\"time\":\"%04d-%02d-%02d %02d:%02d:%02d\"",
+		      separator ? "," : "",
+		      tm_info.tm_year + 1900, tm_info.tm_mon + 1, tm_info.tm_mday,
+		      tm_info.tm_hour, tm_info.tm_min, tm_info.tm_sec) &&
+	       append(w, ",\"latitude\":") &&
+	       append_fixed(w, fix->pvt.latitude, 10000000, 7) &&
+	       append(w, ",\"longitude\":") &&
+	       append_fixed(w, fix->pvt.longitude, 10000000, 7) &&
+	       append(w, ",\"altitude\":") &&
+	       append_fixed(w, fix->pvt.altitude, 10, 1) &&
+	       append(w, ",\"accuracy\":") &&
+	       append_fixed(w, fix->pvt.accuracy, 10, 1) &&
+	       append(w, "}");
+}
+
+int cloud_codec_encode_json(const struct cloud_location_data *fixes, size_t count,
+			    bool array, uint8_t *buf, size_t size, size_t *len,
+			    size_t *single_len)
+{
+	/* One byte is reserved for the closing bracket of the array. */
+	struct json_writer w = {
+		.buf = (char *)buf,
+		.size = size - 1,
+	};
+	int encoded = 0;
+	size_t objects_len = 0;
+
+	if (count == 0 || size < 2) {
+		return -EINVAL;
+	}
+
+	if (!array) {
+		count = 1;
+	}
+
+	if (array && !append(&w, "[")) {
+		return -ENOMEM;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		size_t mark = w.len;
+
+		/* Leave out the fixes that do not fit, the first one must fit. */
+		if (!append_fix(&w, &fixes[i], array && i > 0)) {
+			if (i == 0) {
+				return -ENOMEM;
+			}
+
+			w.len = mark;
+			break;
+		}
+
+		/* A single fix is the object on its own, without the separator. */
+		objects_len += w.len - mark - (array && i > 0 ? 1 : 0);
+		encoded++;
+	}
+
+	if (array) {
+		buf[w.len++] = ']';
+	}
+
+	*len = w.len;
+
+	if (single_len != NULL) {
+		*single_len = objects_len;
+	}
+
+	return encoded;
+}
@@ -0,0 +1,359 @@
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/random/rand32.h>
+#include <zephyr/logging/log.h>
+
+#include "cloud/coap_transaction.h"
+
+LOG_MODULE_REGISTER(coap_transaction, LOG_LEVEL_DBG);
+
+/* Transmission parameters of RFC 7252, the initial RTO is used until the
+ * first round trip time has been measured.
+ */
+#define RTO_INITIAL_MS 2000
+#define RTO_MAX_MS 60000
+
+/* The RTO is estimated as in CoCoA (draft-ietf-core-cocoa). Round trip times
+ * of requests acknowledged without retransmission feed the strong
+ * estimator. Those acknowledged after one or two retransmissions are
+ * measured from the first transmission and feed the weak estimator, as it is
+ * not known which transmission was acknowledged. Each estimator is the RFC
+ * 6298 algorithm, and the overall RTO is a weighted average of both.
+ */
+struct rtt_estimator {
+	uint32_t srtt;
+	uint32_t rttvar;
+	bool valid;
+};
+
+static struct rtt_estimator strong;
+static struct rtt_estimator weak;
+static uint32_t rto = RTO_INITIAL_MS;
+
+/* Uptime of the last RTO update, for the aging of the RTO. */
+static int64_t rto_updated_at;
+
+static struct coap_transaction transactions[CONFIG_CLOUD_COAP_MAX_TRANSACTIONS];
+
+/* Number of transactions in use, read by the receive thread. */
+static atomic_t in_use_count;
+
+static uint32_t next_token;
+static int sock = -1;
+
+static struct coap_transaction_stats stats;
+
+/**@brief Update an estimator with a new round trip time.
+ *
+ * @param k Weight of the variance in the returned RTO.
+ *
+ * @return RTO estimated from this estimator alone.
+ */
+static uint32_t rtt_estimator_update(struct rtt_estimator *estimator, uint32_t rtt, uint32_t k)
+{
+	if (!estimator->valid) {
+		estimator->srtt = rtt;
+		estimator->rttvar = rtt / 2;
+		estimator->valid = true;
+	} else {
+		uint32_t diff = estimator->srtt > rtt ? estimator->srtt - rtt : rtt - estimator->srtt;
+
+		/* RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R|, SRTT = 7/8 SRTT + 1/8 R */
+		estimator->rttvar = (3 * estimator->rttvar + diff) / 4;
+		estimator->srtt = (7 * estimator->srtt + rtt) / 8;
+	}
+
+	return estimator->srtt + MAX(1, k * estimator->rttvar);
+}
+
+static void rtt_sample(struct coap_transaction *transaction)
+{
+	uint32_t rtt = (uint32_t)(k_uptime_get() - transaction->sent_at);
+
+	if (transaction->retransmissions == 0) {
+		rto = (rtt_estimator_update(&strong, rtt, 4) + rto) / 2;
+	} else if (transaction->retransmissions <= 2) {
+		rto = (rtt_estimator_update(&weak, rtt, 1) + 3 * rto) / 4;
+	} else {
+		/* Too ambiguous to be measured. */
+		return;
+	}
+
+	rto = MIN(rto, RTO_MAX_MS);
+	rto_updated_at = k_uptime_get();
+
+	stats.rtt_last_ms = rtt;
+	stats.rtt_min_ms = stats.rtt_min_ms ? MIN(stats.rtt_min_ms, rtt) : rtt;
+	stats.rtt_max_ms = MAX(stats.rtt_max_ms, rtt);
+
+	LOG_DBG("RTT %u ms after %u retransmission(s), RTO %u ms",
+		rtt, transaction->retransmissions, rto);
+}
+
+/**@brief Age an RTO that has not been updated for a while. A short RTO
+ *	  that makes every request take more than two retransmissions is
+ *	  never measured again, so it is doubled after 16 RTOs without update.
+ *	  A long one is brought back towards 1 s after 4 RTOs without update.
+ */
+static void rto_age(void)
+{
+	int64_t age = k_uptime_get() - rto_updated_at;
+
+	if (rto < 1000 && age > 16 * (int64_t)rto) {
+		rto = 2 * rto;
+	} else if (rto > 3000 && age > 4 * (int64_t)rto) {
+		rto = 1000 + rto / 2;
+	} else {
+		return;
+	}
+
+	rto_updated_at = k_uptime_get();
+
+	LOG_DBG("RTO aged to %u ms", rto);
+}
+
+/**@brief Backoff factor of the retransmission timeout. Short RTOs back off
+ *	  faster and long RTOs slower than the doubling of RFC 7252.
+ */
+static uint32_t backoff(uint32_t timeout_ms)
+{
+	if (rto < 1000) {
+		return timeout_ms * 3;
+	} else if (rto > 3000) {
+		return timeout_ms + timeout_ms / 2;
+	}
+
+	return timeout_ms * 2;
+}
+
+static void transaction_release(struct coap_transaction *transaction)
+{
+	transaction->in_use = false;
+	atomic_dec(&in_use_count);
+}
+
+/**@brief Free a transaction and call its completion callback. */
+static void transaction_complete(struct coap_transaction *transaction,
+				 const struct coap_packet *response)
+{
+	coap_transaction_cb_t cb = transaction->cb;
+	void *user_data = transaction->user_data;
+
+	if (response != NULL) {
+		stats.completed++;
+		stats.timeouts_in_row = 0;
+	}
+
+	/* Released first, so the callback can start a new transaction. */
+	transaction_release(transaction);
+
+	if (cb != NULL) {
+		cb(response, user_data);
+	}
+}
+
+static int transaction_transmit(struct coap_transaction *transaction)
+{
+	int err = send(sock, transaction->buf, transaction->len, 0);
+
+	if (err < 0) {
+		LOG_ERR("Failed to send CoAP request, %d", errno);
+		return -errno;
+	}
+
+	return 0;
+}
+
+void coap_transaction_init(int new_sock)
+{
+	coap_transaction_cancel_all();
+
+	sock = new_sock;
+	next_token = sys_rand32_get();
+	stats.timeouts_in_row = 0;
+}
+
+struct coap_transaction *coap_transaction_new(bool confirmable, coap_transaction_cb_t cb,
+					      void *user_data)
+{
+	for (int i = 0; i < ARRAY_SIZE(transactions); i++) {
+		struct coap_transaction *transaction = &transactions[i];
+
+		if (transaction->in_use) {
+			continue;
+		}
+
+		transaction->len = 0;
+		transaction->token = ++next_token;
+		transaction->id = coap_next_id();
+		transaction->in_use = true;
+		transaction->confirmable = confirmable;
+		transaction->acked = false;
+		transaction->retransmissions = 0;
+		transaction->cb = cb;
+		transaction->user_data = user_data;
+		atomic_inc(&in_use_count);
+
+		return transaction;
+	}
+
+	LOG_WRN("%d CoAP requests outstanding, no free transaction",
+		CONFIG_CLOUD_COAP_MAX_TRANSACTIONS);
+
+	return NULL;
+}
+
+int coap_transaction_send(struct coap_transaction *transaction)
+{
+	int err = transaction_transmit(transaction);
+
+	if (err) {
+		transaction_release(transaction);
+		return err;
+	}
+
+	stats.sent++;
+
+	/* Non-confirmable requests are not retransmitted, nor answered here. */
+	if (!transaction->confirmable) {
+		transaction_release(transaction);
+		return 0;
+	}
+
+	rto_age();
+
+	/* The first timeout is randomized between RTO and 1.5 RTO
+	 * (ACK_RANDOM_FACTOR), so that devices do not retransmit in step.
+	 */
+	transaction->timeout_ms = rto + sys_rand32_get() % (rto / 2 + 1);
+	transaction->sent_at = k_uptime_get();
+	transaction->deadline = transaction->sent_at + transaction->timeout_ms;
+
+	return 0;
+}
+
+void coap_transaction_free(struct coap_transaction *transaction)
+{
+	if (transaction->in_use) {
+		transaction_release(transaction);
+	}
+}
+
+bool coap_transaction_handle(const struct coap_packet *received)
+{
+	uint8_t type = coap_header_get_type(received);
+	uint16_t id = coap_header_get_id(received);
+	uint8_t token[COAP_TOKEN_MAX_LEN];
+	uint8_t token_len = coap_header_get_token(received, token);
+
+	for (int i = 0; i < ARRAY_SIZE(transactions); i++) {
+		struct coap_transaction *transaction = &transactions[i];
+		bool id_match;
+		bool token_match;
+
+		if (!transaction->in_use) {
+			continue;
+		}
+
+		id_match = (type == COAP_TYPE_ACK || type == COAP_TYPE_RESET) &&
+			   id == transaction->id;
+		token_match = token_len == sizeof(transaction->token) &&
+			      memcmp(token, &transaction->token, token_len) == 0;
+
+		if (id_match && type == COAP_TYPE_RESET) {
+			LOG_WRN("CoAP request 0x%08x reset by the server", transaction->token);
+			transaction_complete(transaction, NULL);
+			return true;
+		}
+
+		if (id_match && !transaction->acked) {
+			rtt_sample(transaction);
+		}
+
+		if (id_match && coap_header_get_code(received) == COAP_CODE_EMPTY) {
+			/* The response is sent separately, stop retransmitting. */
+			transaction->acked = true;
+			transaction->deadline = k_uptime_get() + CONFIG_CLOUD_RESPONSE_TIMEOUT_MS;
+			return true;
+		}
+
+		/* A piggybacked response must match both, a separate one the token. */
+		if ((id_match || type == COAP_TYPE_CON || type == COAP_TYPE_NON) && token_match) {
+			transaction_complete(transaction, received);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+int64_t coap_transaction_deadline(void)
+{
+	int64_t deadline = 0;
+
+	for (int i = 0; i < ARRAY_SIZE(transactions); i++) {
+		if (transactions[i].in_use &&
+		    (deadline == 0 || transactions[i].deadline < deadline)) {
+			deadline = transactions[i].deadline;
+		}
+	}
+
+	return deadline;
+}
+
+void coap_transaction_process(void)
+{
+	int64_t now = k_uptime_get();
+
+	for (int i = 0; i < ARRAY_SIZE(transactions); i++) {
+		struct coap_transaction *transaction = &transactions[i];
+
+		if (!transaction->in_use || now < transaction->deadline) {
+			continue;
+		}
+
+		if (transaction->acked ||
+		    transaction->retransmissions >= CONFIG_CLOUD_COAP_MAX_RETRANSMIT) {
+			LOG_WRN("CoAP request 0x%08x timed out after %u retransmission(s)",
+				transaction->token, transaction->retransmissions);
+			stats.timeouts++;
+			stats.timeouts_in_row++;
+			transaction_complete(transaction, NULL);
+			continue;
+		}
+
+		transaction->retransmissions++;
+		transaction->timeout_ms = backoff(transaction->timeout_ms);
+		transaction->deadline = now + transaction->timeout_ms;
+		stats.retransmissions++;
+
+		LOG_DBG("Retransmitting CoAP request 0x%08x, next timeout %u ms",
+			transaction->token, transaction->timeout_ms);
+
+		/* A failed send is retried at the next timeout. */
+		(void)transaction_transmit(transaction);
+	}
+}
+
+size_t coap_transaction_count(void)
+{
+	return atomic_get(&in_use_count);
+}
+
+void coap_transaction_cancel_all(void)
+{
+	for (int i = 0; i < ARRAY_SIZE(transactions); i++) {
+		if (transactions[i].in_use) {
+			transaction_complete(&transactions[i], NULL);
+		}
+	}
+}
+
+void coap_transaction_stats_get(struct coap_transaction_stats *out)
+{
+	*out = stats;
+	out->srtt_ms = strong.srtt;
+	out->rto_ms = rto;
+}
@@ -0,0 +1,140 @@
+#ifndef _COAP_TRANSACTION_H_
+#define _COAP_TRANSACTION_H_
+
+/**
+ * @brief CoAP transactions
+ * @defgroup coap_transaction Outstanding CoAP requests, retransmissions and RTT estimation
+ * @{
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <zephyr/net/coap.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Called once when a transaction ends.
+ *
+ * @param response The response, or NULL if the request timed out, was reset
+ *		   by the server or was cancelled.
+ * @param user_data User data given when the transaction was created.
+ */
+typedef void (*coap_transaction_cb_t)(const struct coap_packet *response, void *user_data);
+
+/** @brief A CoAP request and the state of its exchange. */
+struct coap_transaction {
+	/** Message buffer, the request is built here and kept for retransmissions. */
+	uint8_t buf[CONFIG_CLOUD_COAP_MAX_MSG_LEN];
+	/** Length of the request in buf. */
+	size_t len;
+	/** Token to put in the request. */
+	uint32_t token;
+	/** Message ID to put in the request. */
+	uint16_t id;
+
+	bool in_use;
+	bool confirmable;
+	/** Set when an empty ACK was received, the response comes separately. */
+	bool acked;
+	uint8_t retransmissions;
+	/** Uptime in milliseconds of the first transmission. */
+	int64_t sent_at;
+	/** Uptime in milliseconds of the next retransmission or the timeout. */
+	int64_t deadline;
+	/** Current retransmission timeout in milliseconds. */
+	uint32_t timeout_ms;
+	coap_transaction_cb_t cb;
+	void *user_data;
+};
+
+/** @brief Transaction and round trip time counters. */
+struct coap_transaction_stats {
+	/** Number of requests sent, retransmissions excluded. */
+	uint32_t sent;
+	/** Number of requests that got a response. */
+	uint32_t completed;
+	/** Number of retransmissions. */
+	uint32_t retransmissions;
+	/** Number of requests that never got a response. */
+	uint32_t timeouts;
+	/** Number of requests in a row that never got a response, reset by a
+	 *  response and by coap_transaction_init().
+	 */
+	uint32_t timeouts_in_row;
+	/** Last measured round trip time in milliseconds. */
+	uint32_t rtt_last_ms;
+	uint32_t rtt_min_ms;
+	uint32_t rtt_max_ms;
+	/** Smoothed round trip time of the strong estimator in milliseconds. */
+	uint32_t srtt_ms;
+	/** Retransmission timeout in milliseconds. */
+	uint32_t rto_ms;
+};
+
+/** @brief Cancel the outstanding transactions and send the new ones to a socket.
+ *
+ * @param sock Connected socket.
+ */
+void coap_transaction_init(int sock);
+
+/** @brief Allocate a transaction. The caller builds the request in the
+ *	   transaction buffer with its token and message ID, sets the length
+ *	   and sends it with coap_transaction_send().
+ *
+ * @param confirmable Request is sent as confirmable. Non-confirmable
+ *		      requests are freed once sent.
+ * @param cb Completion callback, can be NULL.
+ * @param user_data Passed to the callback.
+ *
+ * @return The transaction, or NULL if too many requests are outstanding.
+ */
+struct coap_transaction *coap_transaction_new(bool confirmable, coap_transaction_cb_t cb,
+					      void *user_data);
+
+/** @brief Send the request of a transaction.
+ *
+ * @return 0 on success, or a negative error code. The transaction is freed
+ *	   on error.
+ */
+int coap_transaction_send(struct coap_transaction *transaction);
+
+/** @brief Free a transaction that was not sent. */
+void coap_transaction_free(struct coap_transaction *transaction);
+
+/** @brief Match a received message to an outstanding transaction. Completes
+ *	   the transaction if the message is its response.
+ *
+ * @return true if the message belongs to a transaction.
+ */
+bool coap_transaction_handle(const struct coap_packet *received);
+
+/** @brief Uptime in milliseconds of the next retransmission or timeout, 0 if
+ *	   no transaction is outstanding.
+ */
+int64_t coap_transaction_deadline(void);
+
+/** @brief Retransmit or time out the transactions whose deadline has passed. */
+void coap_transaction_process(void);
+
+/** @brief Number of outstanding transactions, safe to call from any thread. */
+size_t coap_transaction_count(void);
+
+/** @brief Cancel all outstanding transactions, their callbacks get no response. */
+void coap_transaction_cancel_all(void);
+
+/** @brief Get the transaction counters. */
+void coap_transaction_stats_get(struct coap_transaction_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* _COAP_TRANSACTION_H_ */
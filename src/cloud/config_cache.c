@@ -0,0 +1,74 @@
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include "cloud/config_cache.h"
+
+LOG_MODULE_REGISTER(config_cache, LOG_LEVEL_DBG);
+
+/* ETag of the last device config received, sent to validate the config. */
+static uint8_t etag[CONFIG_CACHE_ETAG_MAX_LEN];
+static uint8_t etag_len;
+
+/* Uptime in milliseconds until the last device config is fresh (Max-Age). */
+static int64_t fresh_until;
+
+static struct config_cache_stats stats;
+
+bool config_cache_fresh(void)
+{
+	if (k_uptime_get() >= fresh_until) {
+		return false;
+	}
+
+	stats.fetches_avoided++;
+	LOG_DBG("Device config fresh, %u config fetches avoided", stats.fetches_avoided);
+
+	return true;
+}
+
+uint8_t config_cache_etag_get(const uint8_t **value)
+{
+	*value = etag;
+
+	return etag_len;
+}
+
+bool config_cache_update(const struct coap_packet *reply)
+{
+	struct coap_option option;
+	int max_age = coap_get_option_int(reply, COAP_OPTION_MAX_AGE);
+	uint8_t code = coap_header_get_code(reply);
+
+	if ((code >> 5) != 2) {
+		return false;
+	}
+
+	if (max_age < 0) {
+		max_age = CONFIG_CACHE_DEFAULT_MAX_AGE;
+	}
+
+	fresh_until = k_uptime_get() + (int64_t)max_age * MSEC_PER_SEC;
+
+	if (code == COAP_RESPONSE_CODE_VALID) {
+		stats.validated++;
+		LOG_DBG("Device config valid, %u payloads avoided", stats.validated);
+		return true;
+	}
+
+	if (coap_find_options(reply, COAP_OPTION_ETAG, &option, 1) == 1 &&
+	    option.len <= sizeof(etag)) {
+		memcpy(etag, option.value, option.len);
+		etag_len = option.len;
+	} else {
+		etag_len = 0;
+	}
+
+	return false;
+}
+
+void config_cache_stats_get(struct config_cache_stats *out)
+{
+	*out = stats;
+}
@@ -0,0 +1,71 @@
+#ifndef _CONFIG_CACHE_H_
+#define _CONFIG_CACHE_H_
+
+/**
+ * @brief Device config cache
+ * @defgroup config_cache Validation of the device config with ETag and Max-Age
+ * @{
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <zephyr/net/coap.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Longest ETag kept, a longer one is not sent back. */
+#define CONFIG_CACHE_ETAG_MAX_LEN 8
+
+/** Max-Age of a response without the option, in seconds (RFC 7252 5.10.5). */
+#define CONFIG_CACHE_DEFAULT_MAX_AGE 60
+
+/** @brief Device config caching counters. */
+struct config_cache_stats {
+	/** Number of GETs skipped while the config was fresh. */
+	uint32_t fetches_avoided;
+	/** Number of 2.03 Valid responses, no payload was sent or parsed. */
+	uint32_t validated;
+};
+
+/** @brief Check whether the last device config is still fresh. The server
+ *	   has promised it does not change until its Max-Age has passed, so
+ *	   no GET is needed. A skipped GET is counted.
+ *
+ * @return true if the config is fresh.
+ */
+bool config_cache_fresh(void);
+
+/** @brief Get the ETag of the last device config, to send with the GET so
+ *	   that an unchanged config is answered with 2.03 Valid.
+ *
+ * @param etag Set to the ETag.
+ *
+ * @return Length of the ETag, 0 if there is none.
+ */
+uint8_t config_cache_etag_get(const uint8_t **etag);
+
+/** @brief Remember the ETag and Max-Age of a device config response. Only
+ *	   success responses are cached.
+ *
+ * @param reply Response or notification.
+ *
+ * @return true if the cached config was validated and there is no new
+ *	   config to parse.
+ */
+bool config_cache_update(const struct coap_packet *reply);
+
+/** @brief Get the caching counters. */
+void config_cache_stats_get(struct config_cache_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* _CONFIG_CACHE_H_ */
@@ -0,0 +1,84 @@
+#include <math.h>
+
+#include <zephyr/kernel.h>
+
+#include "cloud/deadband.h"
+
+/* Last fix reported because the device moved. Heartbeats do not move it, so
+ * that a slow drift still adds up to movement.
+ */
+static struct cloud_location_data anchor;
+static bool anchor_valid;
+/* Uptime of the last reported fix, moved or heartbeat. */
+static int64_t reported_at;
+
+static struct deadband_stats stats;
+
+#define EARTH_RADIUS_M 6371000.0
+#define DEG_TO_RAD (3.14159265358979323846 / 180.0)
+
+/**@brief Distance in meters between two fixes. Equirectangular, which is
+ *	  accurate enough at the distances of a dead-band.
+ */
+static double distance(const struct cloud_location_data *a,
+		       const struct cloud_location_data *b)
+{
+	double x = (b->pvt.longitude - a->pvt.longitude) * DEG_TO_RAD *
+		   cos((a->pvt.latitude + b->pvt.latitude) / 2.0 * DEG_TO_RAD);
+	double y = (b->pvt.latitude - a->pvt.latitude) * DEG_TO_RAD;
+
+	return sqrt(x * x + y * y) * EARTH_RADIUS_M;
+}
+
+static bool moved(const struct cloud_location_data *fix, const struct app_cfg *cfg)
+{
+	double radius = MAX((double)anchor.pvt.accuracy, (double)cfg->deadband_distance);
+
+	if (fix->pvt.accuracy > cfg->deadband_accuracy) {
+		radius += fix->pvt.accuracy;
+	}
+
+	return distance(&anchor, fix) > radius;
+}
+
+static void report(void)
+{
+	reported_at = k_uptime_get();
+	stats.still_here = 0;
+}
+
+bool deadband_check(const struct cloud_location_data *fix, const struct app_cfg *cfg)
+{
+	if (cfg->deadband_distance == 0) {
+		/* Dead-band disabled, every fix is reported. */
+		anchor_valid = false;
+		stats.moved++;
+		report();
+		return true;
+	}
+
+	if (!anchor_valid || moved(fix, cfg)) {
+		anchor = *fix;
+		anchor_valid = true;
+		stats.moved++;
+		report();
+		return true;
+	}
+
+	stats.still_here++;
+
+	if (k_uptime_get() - reported_at >= (int64_t)cfg->heartbeat_interval * MSEC_PER_SEC) {
+		stats.heartbeats++;
+		report();
+		return true;
+	}
+
+	stats.suppressed++;
+
+	return false;
+}
+
+void deadband_stats_get(struct deadband_stats *out)
+{
+	*out = stats;
+}
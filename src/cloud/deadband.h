@@ -0,0 +1,58 @@
+#ifndef _DEADBAND_H_
+#define _DEADBAND_H_
+
+/**
+ * @brief Movement dead-band
+ * @defgroup deadband Suppression of the fixes of a stationary device
+ * @{
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "codec.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Dead-band counters. */
+struct deadband_stats {
+	/** Number of fixes reported because the device moved. */
+	uint32_t moved;
+	/** Number of fixes suppressed since the last reported fix. */
+	uint32_t still_here;
+	/** Number of heartbeat fixes reported while stationary. */
+	uint32_t heartbeats;
+	/** Number of fixes suppressed in total. */
+	uint32_t suppressed;
+};
+
+/** @brief Decide whether a fix is reported. A fix is suppressed when it is
+ *	   inside the uncertainty circle of the last fix reported because of
+ *	   movement, that is within the larger of its accuracy and
+ *	   deadband_distance meters of it. A fix less accurate than
+ *	   deadband_accuracy meters must also be outside its own accuracy to
+ *	   count as movement. A suppressed fix is reported anyway as a heartbeat
+ *	   when the last reported fix is heartbeat_interval seconds old. A
+ *	   deadband_distance of 0 disables the dead-band.
+ *
+ * @param fix New fix.
+ * @param cfg Device config with the dead-band thresholds.
+ *
+ * @return true if the fix is reported, false if it is suppressed.
+ */
+bool deadband_check(const struct cloud_location_data *fix, const struct app_cfg *cfg);
+
+/** @brief Get the counters. */
+void deadband_stats_get(struct deadband_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* _DEADBAND_H_ */
@@ -0,0 +1,140 @@
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include "cloud/fix_queue.h"
+#include "util/storage.h"
+
+LOG_MODULE_REGISTER(fix_queue, LOG_LEVEL_DBG);
+
+/* The queue is a ring of CONFIG_FIX_QUEUE_CAPACITY storage slots. Head and
+ * tail are free running sequence numbers, the slot of a record is its
+ * sequence number modulo the capacity. A record is written before the head
+ * is advanced, and the tail is advanced only after the server has
+ * acknowledged the records, so a power failure never loses a queued fix.
+ */
+static uint32_t head;
+static uint32_t tail;
+
+static struct fix_queue_stats stats;
+
+static uint16_t slot_id(uint32_t seq)
+{
+	return STORAGE_ID_FIX_QUEUE_FIRST + (seq % CONFIG_FIX_QUEUE_CAPACITY);
+}
+
+int fix_queue_init(void)
+{
+	ssize_t len;
+
+	len = storage_read(STORAGE_ID_FIX_QUEUE_HEAD, &head, sizeof(head));
+	if (len != sizeof(head)) {
+		head = 0;
+	}
+
+	/* The tail is written on the first trim or drop, until then the
+	 * queue starts from the first record ever written.
+	 */
+	len = storage_read(STORAGE_ID_FIX_QUEUE_TAIL, &tail, sizeof(tail));
+	if (len != sizeof(tail)) {
+		tail = 0;
+	}
+
+	/* The capacity may have been lowered since the records were written. */
+	if (head - tail > CONFIG_FIX_QUEUE_CAPACITY) {
+		LOG_WRN("Queue larger than capacity, dropping %u oldest fixes",
+			head - tail - CONFIG_FIX_QUEUE_CAPACITY);
+		tail = head - CONFIG_FIX_QUEUE_CAPACITY;
+	}
+
+	LOG_INF("Fix queue restored, %u fixes waiting", head - tail);
+
+	return 0;
+}
+
+int fix_queue_push(const struct cloud_location_data *fix)
+{
+	int err;
+	uint32_t new_head = head + 1;
+
+	if (head - tail == CONFIG_FIX_QUEUE_CAPACITY) {
+		uint32_t new_tail = tail + 1;
+
+		err = storage_write(STORAGE_ID_FIX_QUEUE_TAIL, &new_tail, sizeof(new_tail));
+		if (err) {
+			LOG_ERR("Failed to drop the oldest fix, error: %d", err);
+			return err;
+		}
+
+		tail = new_tail;
+		stats.dropped++;
+		LOG_WRN("Fix queue full, oldest fix dropped");
+	}
+
+	err = storage_write(slot_id(head), fix, sizeof(*fix));
+	if (err) {
+		LOG_ERR("Failed to write fix, error: %d", err);
+		return err;
+	}
+
+	err = storage_write(STORAGE_ID_FIX_QUEUE_HEAD, &new_head, sizeof(new_head));
+	if (err) {
+		LOG_ERR("Failed to update queue head, error: %d", err);
+		return err;
+	}
+
+	head = new_head;
+	stats.queued++;
+
+	return 0;
+}
+
+int fix_queue_peek(struct cloud_location_data *fixes, size_t max, uint32_t *first_seq)
+{
+	size_t count = MIN(max, fix_queue_count());
+
+	*first_seq = tail;
+
+	for (size_t i = 0; i < count; i++) {
+		ssize_t len = storage_read(slot_id(tail + i), &fixes[i], sizeof(fixes[i]));
+
+		if (len != sizeof(fixes[i])) {
+			LOG_ERR("Failed to read fix %u, error: %d", tail + i, (int)len);
+			return len < 0 ? len : -EIO;
+		}
+	}
+
+	return count;
+}
+
+int fix_queue_trim(uint32_t end_seq)
+{
+	int err;
+	uint32_t new_tail = end_seq;
+	uint32_t count = end_seq - tail;
+
+	/* Fixes before the tail have already been trimmed or dropped. */
+	if (count == 0 || count > fix_queue_count()) {
+		return 0;
+	}
+
+	err = storage_write(STORAGE_ID_FIX_QUEUE_TAIL, &new_tail, sizeof(new_tail));
+	if (err) {
+		LOG_ERR("Failed to update queue tail, error: %d", err);
+		return err;
+	}
+
+	tail = new_tail;
+	stats.sent += count;
+
+	return 0;
+}
+
+size_t fix_queue_count(void)
+{
+	return head - tail;
+}
+
+void fix_queue_stats_get(struct fix_queue_stats *out)
+{
+	*out = stats;
+}
@@ -0,0 +1,75 @@
+#ifndef _FIX_QUEUE_H_
+#define _FIX_QUEUE_H_
+
+/**
+ * @brief Fix queue
+ * @defgroup fix_queue Persistent queue of location fixes waiting for uplink
+ * @{
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "codec.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Fix queue counters. */
+struct fix_queue_stats {
+	/** Number of fixes added to the queue. */
+	uint32_t queued;
+	/** Number of fixes acknowledged by the server and removed. */
+	uint32_t sent;
+	/** Number of fixes overwritten because the queue was full. */
+	uint32_t dropped;
+};
+
+/** @brief Restore the queue state from the flash.
+ *
+ * @return 0 on success, or a negative error code.
+ */
+int fix_queue_init(void);
+
+/** @brief Add a fix to the end of the queue. When the queue is full the
+ *	   oldest fix is dropped.
+ *
+ * @return 0 on success, or a negative error code.
+ */
+int fix_queue_push(const struct cloud_location_data *fix);
+
+/** @brief Read the oldest fixes without removing them from the queue.
+ *
+ * @param fixes Array the fixes are read to.
+ * @param max Size of the array.
+ * @param first_seq Sequence number of the first fix read.
+ *
+ * @return Number of fixes read, or a negative error code.
+ */
+int fix_queue_peek(struct cloud_location_data *fixes, size_t max, uint32_t *first_seq);
+
+/** @brief Remove the fixes acknowledged by the server from the queue.
+ *
+ * @param end_seq Sequence number following the last acknowledged fix. All
+ *		  fixes before it are removed.
+ *
+ * @return 0 on success, or a negative error code.
+ */
+int fix_queue_trim(uint32_t end_seq);
+
+/** @brief Number of fixes in the queue. */
+size_t fix_queue_count(void);
+
+/** @brief Get the queue counters. */
+void fix_queue_stats_get(struct fix_queue_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* _FIX_QUEUE_H_ */
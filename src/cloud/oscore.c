@@ -0,0 +1,816 @@
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/logging/log.h>
+#include <psa/crypto.h>
+
+#include "cloud/oscore.h"
+#include "util/storage.h"
+
+LOG_MODULE_REGISTER(oscore, LOG_LEVEL_DBG);
+
+/* Only the mandatory to implement algorithms are supported:
+ * AES-CCM-16-64-128 and HKDF SHA-256.
+ */
+#define ALG_AEAD_AES_CCM_16_64_128 10
+#define KEY_LEN 16
+#define NONCE_LEN 13
+#define TAG_LEN 8
+#define PSA_AEAD_ALG PSA_ALG_AEAD_WITH_SHORTENED_TAG(PSA_ALG_CCM, TAG_LEN)
+
+#define ID_MAX_LEN (NONCE_LEN - 6)
+#define PIV_MAX_LEN 5
+#define TOKEN_MAX_LEN 8
+#define MASTER_SECRET_MAX_LEN 32
+#define MASTER_SALT_MAX_LEN 16
+
+#define OPTION_URI_HOST 3
+#define OPTION_OBSERVE 6
+#define OPTION_URI_PORT 7
+#define OPTION_OSCORE 9
+#define OPTION_PROXY_URI 35
+#define OPTION_PROXY_SCHEME 39
+#define OPTION_PAYLOAD_MARKER 0xff
+
+#define CODE_POST 0x02
+#define CODE_FETCH 0x05
+
+#define FLAG_KID 0x08
+#define FLAG_KID_CONTEXT 0x10
+#define FLAG_PIV_LEN_MASK 0x07
+
+/* Security context, derived at boot from the provisioned inputs. */
+static struct {
+	uint8_t sender_id[ID_MAX_LEN];
+	size_t sender_id_len;
+	uint8_t recipient_id[ID_MAX_LEN];
+	size_t recipient_id_len;
+	uint8_t common_iv[NONCE_LEN];
+	psa_key_id_t sender_key;
+	psa_key_id_t recipient_key;
+	bool valid;
+} context;
+
+/* Next sender sequence number, and the limit up to which the numbers are
+ * reserved in the flash. After a reboot the device continues from the limit,
+ * so a sequence number is never used twice with the same key.
+ */
+static uint64_t ssn;
+static uint64_t ssn_limit;
+
+/* Partial IV of a sent request, needed to verify its response. */
+struct request_record {
+	uint8_t token[TOKEN_MAX_LEN];
+	uint8_t token_len;
+	uint8_t piv[PIV_MAX_LEN];
+	uint8_t piv_len;
+};
+
+/* Recent requests, and the observe registration that is answered by
+ * notifications for as long as the observation lasts.
+ */
+static struct request_record requests[CONFIG_CLOUD_COAP_MAX_TRANSACTIONS];
+static size_t requests_next;
+static struct request_record observe_request;
+
+/* Partial IV of the last notification, older ones are replays. */
+static uint64_t notification_piv;
+static bool notification_piv_valid;
+
+static uint8_t plaintext[CONFIG_CLOUD_COAP_MAX_MSG_LEN];
+
+static struct oscore_stats stats;
+
+/* Minimal CBOR encoding of the structures of RFC 8613 section 5. */
+static size_t cbor_head(uint8_t *buf, uint8_t major, uint32_t value)
+{
+	if (value < 24) {
+		buf[0] = (major << 5) | value;
+		return 1;
+	} else if (value < 0x100) {
+		buf[0] = (major << 5) | 24;
+		buf[1] = value;
+		return 2;
+	}
+
+	buf[0] = (major << 5) | 25;
+	buf[1] = value >> 8;
+	buf[2] = value;
+	return 3;
+}
+
+static size_t cbor_bytes(uint8_t *buf, uint8_t major, const void *data, size_t len)
+{
+	size_t head = cbor_head(buf, major, len);
+
+	memcpy(&buf[head], data, len);
+	return head + len;
+}
+
+#define CBOR_UINT 0
+#define CBOR_BSTR 2
+#define CBOR_TSTR 3
+#define CBOR_ARRAY 4
+#define CBOR_NULL 0xf6
+
+/**@brief Build the additional authenticated data, the Enc_structure with the
+ *	  external_aad of the request.
+ */
+static size_t aad_build(uint8_t *buf, const uint8_t *request_piv, size_t request_piv_len)
+{
+	uint8_t external_aad[32];
+	size_t len = 0;
+	size_t aad_len = 0;
+
+	/* [oscore_version, [alg_aead], request_kid, request_piv, options] */
+	len += cbor_head(&external_aad[len], CBOR_ARRAY, 5);
+	len += cbor_head(&external_aad[len], CBOR_UINT, 1);
+	len += cbor_head(&external_aad[len], CBOR_ARRAY, 1);
+	len += cbor_head(&external_aad[len], CBOR_UINT, ALG_AEAD_AES_CCM_16_64_128);
+	len += cbor_bytes(&external_aad[len], CBOR_BSTR, context.sender_id, context.sender_id_len);
+	len += cbor_bytes(&external_aad[len], CBOR_BSTR, request_piv, request_piv_len);
+	len += cbor_bytes(&external_aad[len], CBOR_BSTR, NULL, 0);
+
+	/* ["Encrypt0", h'', external_aad] */
+	aad_len += cbor_head(&buf[aad_len], CBOR_ARRAY, 3);
+	aad_len += cbor_bytes(&buf[aad_len], CBOR_TSTR, "Encrypt0", strlen("Encrypt0"));
+	aad_len += cbor_bytes(&buf[aad_len], CBOR_BSTR, NULL, 0);
+	aad_len += cbor_bytes(&buf[aad_len], CBOR_BSTR, external_aad, len);
+
+	return aad_len;
+}
+
+/**@brief Build the AEAD nonce from the ID of the endpoint that chose the
+ *	  Partial IV, the Partial IV and the Common IV.
+ */
+static void nonce_build(uint8_t *nonce, const uint8_t *id, size_t id_len,
+			const uint8_t *piv, size_t piv_len)
+{
+	memset(nonce, 0, NONCE_LEN);
+	nonce[0] = id_len;
+	memcpy(&nonce[1 + ID_MAX_LEN - id_len], id, id_len);
+	memcpy(&nonce[NONCE_LEN - piv_len], piv, piv_len);
+
+	for (int i = 0; i < NONCE_LEN; i++) {
+		nonce[i] ^= context.common_iv[i];
+	}
+}
+
+/**@brief Derive a key or the Common IV with HKDF. */
+static int hkdf_derive(const uint8_t *secret, size_t secret_len, const uint8_t *salt,
+		       size_t salt_len, const uint8_t *id, size_t id_len, const char *type,
+		       uint8_t *out, size_t out_len)
+{
+	psa_key_derivation_operation_t op = PSA_KEY_DERIVATION_OPERATION_INIT;
+	psa_status_t status;
+	uint8_t info[32];
+	size_t len = 0;
+
+	/* [id, id_context, alg_aead, type, L] */
+	len += cbor_head(&info[len], CBOR_ARRAY, 5);
+	len += cbor_bytes(&info[len], CBOR_BSTR, id, id_len);
+	info[len++] = CBOR_NULL;
+	len += cbor_head(&info[len], CBOR_UINT, ALG_AEAD_AES_CCM_16_64_128);
+	len += cbor_bytes(&info[len], CBOR_TSTR, type, strlen(type));
+	len += cbor_head(&info[len], CBOR_UINT, out_len);
+
+	status = psa_key_derivation_setup(&op, PSA_ALG_HKDF(PSA_ALG_SHA_256));
+	/* An empty Master Salt is the same as no salt. */
+	if (status == PSA_SUCCESS && salt_len > 0) {
+		status = psa_key_derivation_input_bytes(&op, PSA_KEY_DERIVATION_INPUT_SALT,
+							salt, salt_len);
+	}
+	if (status == PSA_SUCCESS) {
+		status = psa_key_derivation_input_bytes(&op, PSA_KEY_DERIVATION_INPUT_SECRET,
+							secret, secret_len);
+	}
+	if (status == PSA_SUCCESS) {
+		status = psa_key_derivation_input_bytes(&op, PSA_KEY_DERIVATION_INPUT_INFO,
+							info, len);
+	}
+	if (status == PSA_SUCCESS) {
+		status = psa_key_derivation_output_bytes(&op, out, out_len);
+	}
+
+	psa_key_derivation_abort(&op);
+
+	return status == PSA_SUCCESS ? 0 : -EIO;
+}
+
+static int key_import(const uint8_t *key, psa_key_id_t *key_id)
+{
+	psa_key_attributes_t attributes = PSA_KEY_ATTRIBUTES_INIT;
+
+	psa_set_key_usage_flags(&attributes, PSA_KEY_USAGE_ENCRYPT | PSA_KEY_USAGE_DECRYPT);
+	psa_set_key_algorithm(&attributes, PSA_AEAD_ALG);
+	psa_set_key_type(&attributes, PSA_KEY_TYPE_AES);
+	psa_set_key_bits(&attributes, KEY_LEN * 8);
+
+	return psa_import_key(&attributes, key, KEY_LEN, key_id) == PSA_SUCCESS ? 0 : -EIO;
+}
+
+/**@brief Next sender sequence number as a Partial IV, big endian without
+ *	  leading zeros.
+ */
+static int piv_next(uint8_t *piv, size_t *piv_len)
+{
+	int err;
+	uint64_t value;
+
+	if (ssn >= BIT64(8 * PIV_MAX_LEN) - 1) {
+		LOG_ERR("Sender sequence numbers exhausted, a new context is needed");
+		return -ENOSPC;
+	}
+
+	/* Reserve the next window before using a number from it. */
+	if (ssn >= ssn_limit) {
+		uint64_t limit = ssn + CONFIG_CLOUD_OSCORE_SSN_WINDOW;
+
+		err = storage_write(STORAGE_ID_OSCORE_SSN, &limit, sizeof(limit));
+		if (err) {
+			LOG_ERR("Failed to store the sequence number, error: %d", err);
+			return err;
+		}
+
+		ssn_limit = limit;
+	}
+
+	value = ssn++;
+	*piv_len = 1;
+	while (*piv_len < PIV_MAX_LEN && (value >> (8 * *piv_len)) != 0) {
+		(*piv_len)++;
+	}
+
+	for (size_t i = 0; i < *piv_len; i++) {
+		piv[i] = value >> (8 * (*piv_len - 1 - i));
+	}
+
+	return 0;
+}
+
+/* Iterator over the options of a serialized CoAP message. */
+struct option_iter {
+	const uint8_t *pos;
+	const uint8_t *end;
+	uint16_t number;
+};
+
+static int option_ext(struct option_iter *it, uint8_t nibble, uint16_t *value)
+{
+	if (nibble < 13) {
+		*value = nibble;
+	} else if (nibble == 13 && it->pos + 1 <= it->end) {
+		*value = *it->pos + 13;
+		it->pos += 1;
+	} else if (nibble == 14 && it->pos + 2 <= it->end) {
+		*value = sys_get_be16(it->pos) + 269;
+		it->pos += 2;
+	} else {
+		return -EBADMSG;
+	}
+
+	return 0;
+}
+
+/**@brief Read the next option.
+ *
+ * @return 1 if an option was read, 0 at the payload marker or the end of the
+ *	   message, or a negative error code.
+ */
+static int option_next(struct option_iter *it, uint16_t *number, const uint8_t **value,
+		       uint16_t *len)
+{
+	uint16_t delta;
+	uint8_t head;
+
+	if (it->pos >= it->end || *it->pos == OPTION_PAYLOAD_MARKER) {
+		return 0;
+	}
+
+	head = *it->pos++;
+
+	if (option_ext(it, head >> 4, &delta) || option_ext(it, head & 0x0f, len) ||
+	    it->pos + *len > it->end) {
+		return -EBADMSG;
+	}
+
+	it->number += delta;
+	*number = it->number;
+	*value = it->pos;
+	it->pos += *len;
+
+	return 1;
+}
+
+/**@brief Payload following the options, NULL if there is none. */
+static const uint8_t *option_iter_payload(const struct option_iter *it, size_t *len)
+{
+	if (it->pos + 1 >= it->end || *it->pos != OPTION_PAYLOAD_MARKER) {
+		*len = 0;
+		return NULL;
+	}
+
+	*len = it->end - it->pos - 1;
+	return it->pos + 1;
+}
+
+static uint8_t option_nibble(uint16_t value, uint8_t *ext, size_t *ext_len)
+{
+	if (value < 13) {
+		*ext_len = 0;
+		return value;
+	} else if (value < 269) {
+		ext[0] = value - 13;
+		*ext_len = 1;
+		return 13;
+	}
+
+	sys_put_be16(value - 269, ext);
+	*ext_len = 2;
+	return 14;
+}
+
+/**@brief Append an option, the options must be appended in ascending order. */
+static int option_put(uint8_t **pos, const uint8_t *end, uint16_t *prev, uint16_t number,
+		      const uint8_t *value, uint16_t len)
+{
+	uint8_t delta_ext[2];
+	uint8_t len_ext[2];
+	size_t delta_ext_len;
+	size_t len_ext_len;
+	uint8_t head;
+
+	head = option_nibble(number - *prev, delta_ext, &delta_ext_len) << 4;
+	head |= option_nibble(len, len_ext, &len_ext_len);
+
+	if (*pos + 1 + delta_ext_len + len_ext_len + len > end) {
+		return -ENOMEM;
+	}
+
+	*(*pos)++ = head;
+	memcpy(*pos, delta_ext, delta_ext_len);
+	*pos += delta_ext_len;
+	memcpy(*pos, len_ext, len_ext_len);
+	*pos += len_ext_len;
+	memcpy(*pos, value, len);
+	*pos += len;
+	*prev = number;
+
+	return 0;
+}
+
+/**@brief Options of class U of RFC 8613, used by proxies and only sent as
+ *	  outer options.
+ */
+static bool option_outer_only(uint16_t number)
+{
+	return number == OPTION_URI_HOST || number == OPTION_URI_PORT ||
+	       number == OPTION_PROXY_URI || number == OPTION_PROXY_SCHEME;
+}
+
+/**@brief Append the outer options of a request, with the OSCORE option. */
+static int outer_options_put(const uint8_t *msg, size_t len, uint8_t token_len,
+			     uint8_t **pos, const uint8_t *end, const uint8_t *option,
+			     size_t option_len)
+{
+	int err;
+	struct option_iter it = { .pos = &msg[4 + token_len], .end = &msg[len] };
+	uint16_t number;
+	const uint8_t *value;
+	uint16_t value_len;
+	uint16_t prev = 0;
+	bool oscore_put = false;
+
+	while ((err = option_next(&it, &number, &value, &value_len)) > 0) {
+		if (!option_outer_only(number) && number != OPTION_OBSERVE) {
+			continue;
+		}
+
+		if (!oscore_put && number > OPTION_OSCORE) {
+			err = option_put(pos, end, &prev, OPTION_OSCORE, option, option_len);
+			if (err) {
+				return err;
+			}
+			oscore_put = true;
+		}
+
+		err = option_put(pos, end, &prev, number, value, value_len);
+		if (err) {
+			return err;
+		}
+	}
+
+	if (err < 0 || oscore_put) {
+		return err;
+	}
+
+	return option_put(pos, end, &prev, OPTION_OSCORE, option, option_len);
+}
+
+static struct request_record *request_find(const uint8_t *token, size_t token_len)
+{
+	if (observe_request.token_len == token_len &&
+	    memcmp(observe_request.token, token, token_len) == 0) {
+		return &observe_request;
+	}
+
+	for (int i = 0; i < ARRAY_SIZE(requests); i++) {
+		if (requests[i].piv_len > 0 && requests[i].token_len == token_len &&
+		    memcmp(requests[i].token, token, token_len) == 0) {
+			return &requests[i];
+		}
+	}
+
+	return NULL;
+}
+
+int oscore_init(void)
+{
+	int err;
+	uint8_t secret[MASTER_SECRET_MAX_LEN];
+	uint8_t salt[MASTER_SALT_MAX_LEN];
+	uint8_t key[KEY_LEN];
+	size_t secret_len;
+	size_t salt_len;
+	ssize_t len;
+
+	if (psa_crypto_init() != PSA_SUCCESS) {
+		return -EIO;
+	}
+
+	if (context.valid) {
+		context.valid = false;
+		psa_destroy_key(context.sender_key);
+		psa_destroy_key(context.recipient_key);
+	}
+
+	secret_len = hex2bin(CONFIG_CLOUD_OSCORE_MASTER_SECRET,
+			     strlen(CONFIG_CLOUD_OSCORE_MASTER_SECRET), secret, sizeof(secret));
+	salt_len = hex2bin(CONFIG_CLOUD_OSCORE_MASTER_SALT,
+			   strlen(CONFIG_CLOUD_OSCORE_MASTER_SALT), salt, sizeof(salt));
+	context.sender_id_len = hex2bin(CONFIG_CLOUD_OSCORE_SENDER_ID,
+					strlen(CONFIG_CLOUD_OSCORE_SENDER_ID),
+					context.sender_id, sizeof(context.sender_id));
+	context.recipient_id_len = hex2bin(CONFIG_CLOUD_OSCORE_RECIPIENT_ID,
+					   strlen(CONFIG_CLOUD_OSCORE_RECIPIENT_ID),
+					   context.recipient_id, sizeof(context.recipient_id));
+
+	if (secret_len == 0) {
+		LOG_ERR("No OSCORE master secret provisioned");
+		return -EINVAL;
+	}
+
+	err = hkdf_derive(secret, secret_len, salt, salt_len, context.sender_id,
+			  context.sender_id_len, "Key", key, sizeof(key));
+	if (!err) {
+		err = key_import(key, &context.sender_key);
+	}
+	if (!err) {
+		err = hkdf_derive(secret, secret_len, salt, salt_len, context.recipient_id,
+				  context.recipient_id_len, "Key", key, sizeof(key));
+	}
+	if (!err) {
+		err = key_import(key, &context.recipient_key);
+	}
+	if (!err) {
+		err = hkdf_derive(secret, secret_len, salt, salt_len, NULL, 0, "IV",
+				  context.common_iv, sizeof(context.common_iv));
+	}
+
+	memset(secret, 0, sizeof(secret));
+	memset(key, 0, sizeof(key));
+
+	if (err) {
+		LOG_ERR("Failed to derive the security context, error: %d", err);
+		return err;
+	}
+
+	len = storage_read(STORAGE_ID_OSCORE_SSN, &ssn_limit, sizeof(ssn_limit));
+	if (len != sizeof(ssn_limit)) {
+		ssn_limit = 0;
+	}
+
+	/* The numbers below the stored limit may have been used before the reboot. */
+	ssn = ssn_limit;
+
+	/* Responses to requests protected before are not accepted. */
+	memset(requests, 0, sizeof(requests));
+	memset(&observe_request, 0, sizeof(observe_request));
+	notification_piv_valid = false;
+	context.valid = true;
+
+	LOG_INF("OSCORE context ready, sender sequence number %llu", ssn);
+
+	return 0;
+}
+
+int oscore_protect(const uint8_t *msg, size_t len, uint8_t *out, size_t size, size_t *out_len)
+{
+	int err;
+	struct option_iter it;
+	uint16_t number;
+	const uint8_t *value;
+	uint16_t value_len;
+	const uint8_t *observe = NULL;
+	const uint8_t *payload;
+	size_t payload_len;
+	uint8_t token_len;
+	uint8_t piv[PIV_MAX_LEN];
+	size_t piv_len;
+	uint8_t nonce[NONCE_LEN];
+	uint8_t aad[64];
+	size_t aad_len;
+	uint8_t option[1 + PIV_MAX_LEN + ID_MAX_LEN];
+	size_t option_len;
+	uint8_t *pos;
+	uint8_t *pt_pos;
+	uint16_t prev = 0;
+	size_t cipher_len;
+
+	if (!context.valid) {
+		return -EACCES;
+	}
+
+	if (len < 4 || (token_len = msg[0] & 0x0f) > TOKEN_MAX_LEN || len < 4 + token_len) {
+		return -EBADMSG;
+	}
+
+	/* The plaintext is the code, the inner options and the payload. */
+	it = (struct option_iter){ .pos = &msg[4 + token_len], .end = &msg[len] };
+	pt_pos = plaintext;
+	*pt_pos++ = msg[1];
+
+	while ((err = option_next(&it, &number, &value, &value_len)) > 0) {
+		/* Observe is both an inner and an outer option. */
+		if (number == OPTION_OBSERVE) {
+			observe = value;
+		} else if (option_outer_only(number)) {
+			continue;
+		}
+
+		err = option_put(&pt_pos, &plaintext[sizeof(plaintext)], &prev, number,
+				 value, value_len);
+		if (err) {
+			return err;
+		}
+	}
+
+	if (err < 0) {
+		return err;
+	}
+
+	payload = option_iter_payload(&it, &payload_len);
+	if (payload != NULL) {
+		if (pt_pos + 1 + payload_len > &plaintext[sizeof(plaintext)]) {
+			return -ENOMEM;
+		}
+		*pt_pos++ = OPTION_PAYLOAD_MARKER;
+		memcpy(pt_pos, payload, payload_len);
+		pt_pos += payload_len;
+	}
+
+	err = piv_next(piv, &piv_len);
+	if (err) {
+		return err;
+	}
+
+	/* OSCORE option: flags, Partial IV and the sender ID as kid. */
+	option[0] = piv_len | FLAG_KID;
+	memcpy(&option[1], piv, piv_len);
+	memcpy(&option[1 + piv_len], context.sender_id, context.sender_id_len);
+	option_len = 1 + piv_len + context.sender_id_len;
+
+	/* Outer message: header and token, FETCH for observe registrations
+	 * and POST otherwise, the outer options and the ciphertext.
+	 */
+	if (size < 4 + token_len) {
+		return -ENOMEM;
+	}
+
+	memcpy(out, msg, 4 + token_len);
+	out[1] = observe != NULL ? CODE_FETCH : CODE_POST;
+	pos = &out[4 + token_len];
+
+	err = outer_options_put(msg, len, token_len, &pos, &out[size], option, option_len);
+	if (err) {
+		return err;
+	}
+
+	if (pos + 1 + (pt_pos - plaintext) + TAG_LEN > &out[size]) {
+		return -ENOMEM;
+	}
+
+	*pos++ = OPTION_PAYLOAD_MARKER;
+
+	nonce_build(nonce, context.sender_id, context.sender_id_len, piv, piv_len);
+	aad_len = aad_build(aad, piv, piv_len);
+
+	if (psa_aead_encrypt(context.sender_key, PSA_AEAD_ALG, nonce, sizeof(nonce),
+			     aad, aad_len, plaintext, pt_pos - plaintext,
+			     pos, &out[size] - pos, &cipher_len) != PSA_SUCCESS) {
+		return -EIO;
+	}
+
+	*out_len = (pos - out) + cipher_len;
+
+	/* Remember the Partial IV to verify the response. */
+	struct request_record *record = observe != NULL ? &observe_request :
+					&requests[requests_next++ % ARRAY_SIZE(requests)];
+
+	memcpy(record->token, &msg[4], token_len);
+	record->token_len = token_len;
+	memcpy(record->piv, piv, piv_len);
+	record->piv_len = piv_len;
+
+	if (observe != NULL) {
+		notification_piv_valid = false;
+	}
+
+	stats.protected++;
+	stats.overhead_bytes += *out_len - len;
+
+	return 0;
+}
+
+int oscore_unprotect(const uint8_t *msg, size_t len, uint8_t *out, size_t size, size_t *out_len)
+{
+	int err;
+	struct option_iter it;
+	uint16_t number;
+	const uint8_t *value;
+	uint16_t value_len;
+	const uint8_t *option = NULL;
+	uint16_t option_len = 0;
+	const uint8_t *observe = NULL;
+	uint16_t observe_len = 0;
+	const uint8_t *ciphertext;
+	size_t cipher_len;
+	const uint8_t *payload;
+	size_t payload_len;
+	size_t pt_len;
+	uint64_t notification = 0;
+	uint8_t token_len;
+	struct request_record *request;
+	const uint8_t *piv = NULL;
+	size_t piv_len = 0;
+	uint8_t nonce[NONCE_LEN];
+	uint8_t aad[64];
+	size_t aad_len;
+	uint8_t *pos;
+	uint16_t prev = 0;
+
+	if (!context.valid) {
+		return -EACCES;
+	}
+
+	if (len < 4 || (token_len = msg[0] & 0x0f) > TOKEN_MAX_LEN || len < 4 + token_len) {
+		return -EBADMSG;
+	}
+
+	it = (struct option_iter){ .pos = &msg[4 + token_len], .end = &msg[len] };
+
+	/* Only the outer Observe is kept, other outer options are for proxies. */
+	while ((err = option_next(&it, &number, &value, &value_len)) > 0) {
+		if (number == OPTION_OSCORE) {
+			option = value;
+			option_len = value_len;
+		} else if (number == OPTION_OBSERVE) {
+			observe = value;
+			observe_len = value_len;
+		}
+	}
+
+	if (err < 0) {
+		return err;
+	}
+
+	if (option == NULL) {
+		return -ENOENT;
+	}
+
+	request = request_find(&msg[4], token_len);
+	if (request == NULL) {
+		stats.rejected++;
+		return -EBADMSG;
+	}
+
+	/* A response has no Partial IV, and uses the nonce of the request. A
+	 * notification has its own, chosen by the server.
+	 */
+	if (option_len > 0) {
+		piv_len = option[0] & FLAG_PIV_LEN_MASK;
+		if ((option[0] & FLAG_KID_CONTEXT) || piv_len > PIV_MAX_LEN ||
+		    1 + piv_len > option_len) {
+			stats.rejected++;
+			return -EBADMSG;
+		}
+		piv = piv_len > 0 ? &option[1] : NULL;
+	}
+
+	if (piv != NULL) {
+		for (size_t i = 0; i < piv_len; i++) {
+			notification = (notification << 8) | piv[i];
+		}
+
+		if (request == &observe_request && notification_piv_valid &&
+		    notification <= notification_piv) {
+			LOG_WRN("Replayed notification rejected");
+			stats.rejected++;
+			return -EBADMSG;
+		}
+
+		nonce_build(nonce, context.recipient_id, context.recipient_id_len, piv, piv_len);
+	} else {
+		nonce_build(nonce, context.sender_id, context.sender_id_len,
+			    request->piv, request->piv_len);
+	}
+
+	aad_len = aad_build(aad, request->piv, request->piv_len);
+
+	ciphertext = option_iter_payload(&it, &cipher_len);
+	if (ciphertext == NULL ||
+	    psa_aead_decrypt(context.recipient_key, PSA_AEAD_ALG, nonce, sizeof(nonce),
+			     aad, aad_len, ciphertext, cipher_len,
+			     plaintext, sizeof(plaintext), &pt_len) != PSA_SUCCESS ||
+	    pt_len < 1) {
+		LOG_WRN("OSCORE verification failed");
+		stats.rejected++;
+		return -EBADMSG;
+	}
+
+	if (request == &observe_request) {
+		if (piv != NULL) {
+			notification_piv = notification;
+			notification_piv_valid = true;
+		}
+	} else {
+		/* A request has one response, a replay of it is rejected. */
+		request->piv_len = 0;
+	}
+
+	/* Rebuild the message from the outer header, the inner code and the
+	 * inner options, with the outer Observe merged in.
+	 */
+	if (size < 4 + token_len) {
+		return -ENOMEM;
+	}
+
+	memcpy(out, msg, 4 + token_len);
+	out[1] = plaintext[0];
+	pos = &out[4 + token_len];
+
+	it = (struct option_iter){ .pos = &plaintext[1], .end = &plaintext[pt_len] };
+
+	while ((err = option_next(&it, &number, &value, &value_len)) > 0) {
+		if (number == OPTION_OBSERVE) {
+			continue;
+		}
+
+		if (observe != NULL && number > OPTION_OBSERVE) {
+			err = option_put(&pos, &out[size], &prev, OPTION_OBSERVE,
+					 observe, observe_len);
+			if (err) {
+				return err;
+			}
+			observe = NULL;
+		}
+
+		err = option_put(&pos, &out[size], &prev, number, value, value_len);
+		if (err) {
+			return err;
+		}
+	}
+
+	if (err < 0) {
+		return err;
+	}
+
+	if (observe != NULL) {
+		err = option_put(&pos, &out[size], &prev, OPTION_OBSERVE, observe, observe_len);
+		if (err) {
+			return err;
+		}
+	}
+
+	payload = option_iter_payload(&it, &payload_len);
+	if (payload != NULL) {
+		if (pos + 1 + payload_len > &out[size]) {
+			return -ENOMEM;
+		}
+		*pos++ = OPTION_PAYLOAD_MARKER;
+		memcpy(pos, payload, payload_len);
+		pos += payload_len;
+	}
+
+	*out_len = pos - out;
+	stats.unprotected++;
+
+	return 0;
+}
+
+void oscore_stats_get(struct oscore_stats *out)
+{
+	*out = stats;
+}
@@ -0,0 +1,75 @@
+#ifndef _OSCORE_H_
+#define _OSCORE_H_
+
+/**
+ * @brief OSCORE
+ * @defgroup oscore Object security of the CoAP messages (RFC 8613)
+ * @{
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief OSCORE counters. */
+struct oscore_stats {
+	/** Number of requests protected. */
+	uint32_t protected;
+	/** Number of responses and notifications verified and decrypted. */
+	uint32_t unprotected;
+	/** Messages that failed verification or were replayed. */
+	uint32_t rejected;
+	/** Bytes added to the protected requests, compared to plain CoAP. */
+	uint32_t overhead_bytes;
+};
+
+/** @brief Derive the security context from the provisioned master secret,
+ *	   and restore the sender sequence number from the flash.
+ *
+ * @return 0 on success, or a negative error code.
+ */
+int oscore_init(void);
+
+/** @brief Protect a CoAP request. The request must not be an empty message.
+ *
+ * @param msg Serialized CoAP request.
+ * @param len Length of the request.
+ * @param out Buffer for the protected request.
+ * @param size Size of the buffer.
+ * @param out_len Length of the protected request.
+ *
+ * @return 0 on success, or a negative error code.
+ */
+int oscore_protect(const uint8_t *msg, size_t len, uint8_t *out, size_t size, size_t *out_len);
+
+/** @brief Verify and decrypt a response or a notification to a protected
+ *	   request.
+ *
+ * @param msg Serialized protected CoAP message.
+ * @param len Length of the message.
+ * @param out Buffer for the decrypted message.
+ * @param size Size of the buffer.
+ * @param out_len Length of the decrypted message.
+ *
+ * @retval 0 on success.
+ * @retval -ENOENT if the message has no OSCORE option.
+ * @retval -EBADMSG if the message is not a valid response to a request
+ *	   protected with this context, or was replayed.
+ */
+int oscore_unprotect(const uint8_t *msg, size_t len, uint8_t *out, size_t size, size_t *out_len);
+
+/** @brief Get the OSCORE counters. */
+void oscore_stats_get(struct oscore_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* _OSCORE_H_ */
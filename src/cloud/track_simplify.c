@@ -0,0 +1,168 @@
+#include <math.h>
+
+#include <zephyr/kernel.h>
+
+#include "cloud/track_simplify.h"
+#include "util/storage.h"
+
+/* Opening window simplification. The anchor is the last kept fix, and the
+ * window holds the fixes after it that have not been kept. A new fix extends
+ * the window for as long as every fix in the window lies within the
+ * tolerance of the line from the anchor to the new fix. Otherwise the newest
+ * fix of the window is kept and becomes the new anchor. The window has a
+ * fixed capacity, which bounds both the memory and the work per fix.
+ */
+static struct cloud_location_data anchor;
+static bool anchor_valid;
+static struct cloud_location_data window[CONFIG_TRACK_SIMPLIFY_WINDOW];
+static size_t window_len;
+
+static struct track_simplify_stats stats;
+
+#define EARTH_RADIUS_M 6371000.0
+#define DEG_TO_RAD (3.14159265358979323846 / 180.0)
+
+static bool is_stopped(const struct cloud_location_data *fix)
+{
+	return fix->pvt.speed * 100.0f < CONFIG_TRACK_SIMPLIFY_STOP_SPEED;
+}
+
+/**@brief Position of a fix in meters, on a plane tangent at the anchor. */
+static void project(const struct cloud_location_data *fix, double *x, double *y)
+{
+	*x = (fix->pvt.longitude - anchor.pvt.longitude) * DEG_TO_RAD *
+	     EARTH_RADIUS_M * cos(anchor.pvt.latitude * DEG_TO_RAD);
+	*y = (fix->pvt.latitude - anchor.pvt.latitude) * DEG_TO_RAD * EARTH_RADIUS_M;
+}
+
+/**@brief True if all fixes in the window are within the tolerance of the line
+ *	  from the anchor to the end fix.
+ */
+static bool window_fits(const struct cloud_location_data *end)
+{
+	double ex, ey;
+	double length;
+
+	project(end, &ex, &ey);
+	length = sqrt(ex * ex + ey * ey);
+
+	for (size_t i = 0; i < window_len; i++) {
+		double px, py;
+		double distance;
+
+		project(&window[i], &px, &py);
+
+		if (length < 1.0) {
+			/* The line is a point, use the distance to it. */
+			distance = sqrt(px * px + py * py);
+		} else {
+			distance = fabs(ex * py - ey * px) / length;
+		}
+
+		if (distance > CONFIG_TRACK_SIMPLIFY_TOLERANCE) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**@brief Store the newest fix of the window, so that the end of the track
+ *	  survives a reboot. It is the fix track_simplify_flush() would keep.
+ *	  Failures are not fatal, only the end of the track is lost on reboot.
+ */
+static void pending_store(void)
+{
+	if (window_len > 0) {
+		(void)storage_write(STORAGE_ID_TRACK_PENDING, &window[window_len - 1],
+				    sizeof(window[0]));
+	} else {
+		(void)storage_delete(STORAGE_ID_TRACK_PENDING);
+	}
+}
+
+/**@brief Keep a fix and make it the anchor of the next window. */
+static void keep(const struct cloud_location_data *fix, struct cloud_location_data *kept,
+		 int *count)
+{
+	anchor = *fix;
+	anchor_valid = true;
+	window_len = 0;
+	kept[(*count)++] = *fix;
+	stats.kept++;
+}
+
+int track_simplify_push(const struct cloud_location_data *fix,
+			struct cloud_location_data *kept)
+{
+	uint32_t start = k_cycle_get_32();
+	int count = 0;
+	const struct cloud_location_data *prev = window_len > 0 ? &window[window_len - 1] :
+						 &anchor;
+
+	stats.points++;
+
+	if (!anchor_valid) {
+		keep(fix, kept, &count);
+	} else if (is_stopped(fix) != is_stopped(prev)) {
+		/* Stops and departures are kept with the fix before them. */
+		if (window_len > 0) {
+			keep(&window[window_len - 1], kept, &count);
+		}
+		keep(fix, kept, &count);
+	} else {
+		if (window_len == ARRAY_SIZE(window)) {
+			keep(&window[window_len - 1], kept, &count);
+		}
+
+		if (!window_fits(fix)) {
+			keep(&window[window_len - 1], kept, &count);
+		}
+
+		window[window_len++] = *fix;
+	}
+
+	pending_store();
+
+	stats.cycles += k_cycle_get_32() - start;
+
+	return count;
+}
+
+int track_simplify_flush(struct cloud_location_data *kept)
+{
+	int count = 0;
+
+	if (window_len > 0) {
+		keep(&window[window_len - 1], kept, &count);
+		pending_store();
+	}
+
+	return count;
+}
+
+int track_simplify_restore(struct cloud_location_data *kept)
+{
+	struct cloud_location_data pending;
+	int count = 0;
+
+	window_len = 0;
+	anchor_valid = false;
+
+	if (storage_read(STORAGE_ID_TRACK_PENDING, &pending, sizeof(pending)) == sizeof(pending)) {
+		keep(&pending, kept, &count);
+		(void)storage_delete(STORAGE_ID_TRACK_PENDING);
+	}
+
+	return count;
+}
+
+size_t track_simplify_pending(void)
+{
+	return window_len;
+}
+
+void track_simplify_stats_get(struct track_simplify_stats *out)
+{
+	*out = stats;
+}
@@ -0,0 +1,80 @@
+#ifndef _TRACK_SIMPLIFY_H_
+#define _TRACK_SIMPLIFY_H_
+
+/**
+ * @brief Track simplification
+ * @defgroup track_simplify Streaming simplification of the track before uplink
+ * @{
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "codec.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Maximum number of fixes kept from one pushed fix. */
+#define TRACK_SIMPLIFY_MAX_OUT 2
+
+/** @brief Track simplification counters. */
+struct track_simplify_stats {
+	/** Number of fixes pushed. */
+	uint32_t points;
+	/** Number of fixes kept. */
+	uint32_t kept;
+	/** CPU cycles spent in track_simplify_push(). */
+	uint64_t cycles;
+};
+
+/** @brief Add the next fix of the track. Fixes that lie within
+ *	   CONFIG_TRACK_SIMPLIFY_TOLERANCE meters of the line between the kept
+ *	   fixes around them are dropped. The first fix, and the fixes where
+ *	   the device stops or starts moving, are always kept.
+ *
+ * @param fix New fix.
+ * @param kept Array of TRACK_SIMPLIFY_MAX_OUT fixes the kept fixes are
+ *	       written to, oldest first.
+ *
+ * @return Number of kept fixes written.
+ */
+int track_simplify_push(const struct cloud_location_data *fix,
+			struct cloud_location_data *kept);
+
+/** @brief Keep the last fix pushed, if it is not kept yet. Used before an
+ *	   uplink, so that the end of the track is sent.
+ *
+ * @param kept The last fix is written here.
+ *
+ * @return 1 if a fix was written, 0 if the last fix was already kept.
+ */
+int track_simplify_flush(struct cloud_location_data *kept);
+
+/** @brief Keep the newest fix held back before a reboot. Called once at
+ *	   boot, before the first fix is pushed. The fixes held back with it
+ *	   lie within the tolerance of the line to it, and are dropped as by
+ *	   track_simplify_flush().
+ *
+ * @param kept The restored fix is written here.
+ *
+ * @return 1 if a fix was written, 0 if no fix was held back.
+ */
+int track_simplify_restore(struct cloud_location_data *kept);
+
+/** @brief Number of pushed fixes whose fate is not decided yet. */
+size_t track_simplify_pending(void);
+
+/** @brief Get the counters. */
+void track_simplify_stats_get(struct track_simplify_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* _TRACK_SIMPLIFY_H_ */
@@ -0,0 +1,212 @@
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <zephyr/sys/util.h>
+
+#include "codec.h"
+
+/* Differences between record fields, and the absolute first record, are
+ * zigzag encoded so that small negative values also take few bytes, and then
+ * written as little endian base 128 varints.
+ */
+static uint64_t zigzag_encode(int64_t value)
+{
+	return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t zigzag_decode(uint64_t value)
+{
+	return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+static size_t varint_put(uint8_t *buf, int64_t value)
+{
+	uint64_t zigzag = zigzag_encode(value);
+	size_t len = 0;
+
+	while (zigzag >= 0x80) {
+		buf[len++] = (zigzag & 0x7f) | 0x80;
+		zigzag >>= 7;
+	}
+	buf[len++] = zigzag;
+
+	return len;
+}
+
+static size_t varint_len(int64_t value)
+{
+	uint64_t zigzag = zigzag_encode(value);
+	size_t len = 1;
+
+	while (zigzag >= 0x80) {
+		zigzag >>= 7;
+		len++;
+	}
+
+	return len;
+}
+
+static int varint_get(const uint8_t *buf, size_t len, size_t *pos, int64_t *value)
+{
+	uint64_t zigzag = 0;
+
+	for (int shift = 0; shift < 64; shift += 7) {
+		if (*pos >= len) {
+			return -EBADMSG;
+		}
+
+		uint8_t byte = buf[(*pos)++];
+
+		zigzag |= (uint64_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) {
+			*value = zigzag_decode(zigzag);
+			return 0;
+		}
+	}
+
+	return -EBADMSG;
+}
+
+/**@brief Scale a value to fixed-point. Values out of the range of the
+ *	  record fields are clamped, as the conversion would be undefined.
+ */
+static int32_t scale(double value, int32_t scale)
+{
+	double scaled = round(value * scale);
+
+	if (!(scaled >= INT32_MIN)) {
+		return INT32_MIN;
+	} else if (scaled > INT32_MAX) {
+		return INT32_MAX;
+	}
+
+	return (int32_t)scaled;
+}
+
+void codec_record_from_fix(struct codec_fix_record *record,
+			   const struct cloud_location_data *fix)
+{
+	record->time = fix->gnss_ts / 1000;
+	record->latitude = scale(fix->pvt.latitude, CODEC_SCALE_DEGREES);
+	record->longitude = scale(fix->pvt.longitude, CODEC_SCALE_DEGREES);
+	record->altitude = scale(fix->pvt.altitude, CODEC_SCALE_METERS);
+	record->accuracy = scale(fix->pvt.accuracy, CODEC_SCALE_METERS);
+	record->speed = scale(fix->pvt.speed, CODEC_SCALE_SPEED);
+	record->heading = scale(fix->pvt.heading, CODEC_SCALE_HEADING);
+}
+
+void codec_record_to_fix(struct cloud_location_data *fix,
+			 const struct codec_fix_record *record)
+{
+	fix->gnss_ts = record->time * 1000;
+	fix->pvt.latitude = (double)record->latitude / CODEC_SCALE_DEGREES;
+	fix->pvt.longitude = (double)record->longitude / CODEC_SCALE_DEGREES;
+	fix->pvt.altitude = (float)record->altitude / CODEC_SCALE_METERS;
+	fix->pvt.accuracy = (float)record->accuracy / CODEC_SCALE_METERS;
+	fix->pvt.speed = (float)record->speed / CODEC_SCALE_SPEED;
+	fix->pvt.heading = (float)record->heading / CODEC_SCALE_HEADING;
+}
+
+/**@brief Encode a record as the difference to the previous one. The first
+ *	  record is encoded against an all zero record, that is absolute.
+ */
+static size_t record_put(uint8_t *buf, const struct codec_fix_record *record,
+			 const struct codec_fix_record *prev)
+{
+	size_t len = 0;
+
+	len += varint_put(&buf[len], record->time - prev->time);
+	len += varint_put(&buf[len], (int64_t)record->latitude - prev->latitude);
+	len += varint_put(&buf[len], (int64_t)record->longitude - prev->longitude);
+	len += varint_put(&buf[len], (int64_t)record->altitude - prev->altitude);
+	len += varint_put(&buf[len], (int64_t)record->accuracy - prev->accuracy);
+	len += varint_put(&buf[len], (int64_t)record->speed - prev->speed);
+	len += varint_put(&buf[len], (int64_t)record->heading - prev->heading);
+
+	return len;
+}
+
+int codec_records_encode(const struct cloud_location_data *fixes, size_t count,
+			 uint8_t *buf, size_t size, size_t *len)
+{
+	struct codec_fix_record prev = {0};
+	struct codec_fix_record record;
+	uint8_t encoded[CODEC_RECORD_MAX_LEN];
+	size_t pos = 0;
+	size_t i;
+
+	if (size < 1) {
+		return -ENOMEM;
+	}
+
+	buf[pos++] = CODEC_RECORD_VERSION;
+
+	for (i = 0; i < count; i++) {
+		size_t record_len;
+
+		codec_record_from_fix(&record, &fixes[i]);
+		record_len = record_put(encoded, &record, &prev);
+
+		if (pos + record_len > size) {
+			break;
+		}
+
+		memcpy(&buf[pos], encoded, record_len);
+		pos += record_len;
+		prev = record;
+	}
+
+	if (i == 0) {
+		return -ENOMEM;
+	}
+
+	*len = pos;
+
+	return i;
+}
+
+size_t codec_record_single_len(const struct cloud_location_data *fix)
+{
+	struct codec_fix_record record;
+
+	codec_record_from_fix(&record, fix);
+
+	/* The version byte and a record encoded against an all zero record. */
+	return 1 + varint_len(record.time) + varint_len(record.latitude) +
+	       varint_len(record.longitude) + varint_len(record.altitude) +
+	       varint_len(record.accuracy) + varint_len(record.speed) +
+	       varint_len(record.heading);
+}
+
+int codec_records_decode(const uint8_t *buf, size_t len,
+			 struct cloud_location_data *fixes, size_t max)
+{
+	struct codec_fix_record record = {0};
+	int64_t delta[7];
+	size_t pos = 0;
+	size_t count = 0;
+
+	if (len < 1 || buf[pos++] != CODEC_RECORD_VERSION) {
+		return -EBADMSG;
+	}
+
+	while (pos < len && count < max) {
+		for (int i = 0; i < ARRAY_SIZE(delta); i++) {
+			if (varint_get(buf, len, &pos, &delta[i])) {
+				return -EBADMSG;
+			}
+		}
+
+		record.time += delta[0];
+		record.latitude += delta[1];
+		record.longitude += delta[2];
+		record.altitude += delta[3];
+		record.accuracy += delta[4];
+		record.speed += delta[5];
+		record.heading += delta[6];
+
+		codec_record_to_fix(&fixes[count++], &record);
+	}
+
+	return count;
+}
@@ -2,6 +2,8 @@
 #define CODEC_H__
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -18,8 +20,114 @@ struct app_cfg{
 	int active_wait_timeout;
 	/**Delay between location search in passive mode*/
 	int passive_wait_timeout;
+	/**Number of location fixes sent in one uplink*/
+	int batch_size;
+	/**Movement in meters below which a fix is not sent*/
+	int deadband_distance;
+	/**Fixes less accurate than this, in meters, must move further*/
+	int deadband_accuracy;
+	/**Delay between fixes sent while the device is not moving*/
+	int heartbeat_interval;
 };
 
+struct cloud_pvt {
+	/** Longitude in degrees. */
+	double longitude;
+
+	/** Latitude in degrees. */
+	double latitude;
+
+	/** Altitude above WGS-84 ellipsoid in meters. */
+	float altitude;
+
+	/** Position accuracy (2D 1-sigma) in meters. */
+	float accuracy;
+
+	/** Horizontal speed in m/s. */
+	float speed;
+
+	/** Heading of user movement in degrees. */
+	float heading;
+};
+
+struct cloud_location_data {
+	/** PVT data*/
+	struct cloud_pvt pvt;
+	/** GNSS data timestamp. UNIX milliseconds. */
+	int64_t gnss_ts;
+};
+
+/** Version byte at the start of an encoded record batch. */
+#define CODEC_RECORD_VERSION 1
+
+/** Scale of the fixed-point record fields. */
+#define CODEC_SCALE_DEGREES 10000000
+#define CODEC_SCALE_METERS 10
+#define CODEC_SCALE_SPEED 100
+#define CODEC_SCALE_HEADING 10
+
+/** Maximum encoded size of one record. */
+#define CODEC_RECORD_MAX_LEN (10 + 6 * 5)
+
+struct codec_fix_record {
+	/** Fix time. UNIX seconds. */
+	int64_t time;
+	/** Latitude in 1e-7 degrees. */
+	int32_t latitude;
+	/** Longitude in 1e-7 degrees. */
+	int32_t longitude;
+	/** Altitude in decimeters. */
+	int32_t altitude;
+	/** Accuracy in decimeters. */
+	int32_t accuracy;
+	/** Horizontal speed in cm/s. */
+	int32_t speed;
+	/** Heading in 0.1 degrees. */
+	int32_t heading;
+};
+
+/** @brief Convert a fix to fixed-point. */
+void codec_record_from_fix(struct codec_fix_record *record,
+			   const struct cloud_location_data *fix);
+
+/** @brief Convert a fixed-point record back to a fix. */
+void codec_record_to_fix(struct cloud_location_data *fix,
+			 const struct codec_fix_record *record);
+
+/** @brief Encode fixes as compact binary records. The payload is the
+ *	   version byte followed by the records. The first record is absolute
+ *	   and every later one holds the differences to the previous record.
+ *	   Each field is a zigzag varint.
+ *
+ * @param fixes Fixes to encode.
+ * @param count Number of fixes.
+ * @param buf Buffer the payload is written to.
+ * @param size Size of the buffer. Fixes that do not fit are left out.
+ * @param len Length of the encoded payload.
+ *
+ * @return Number of fixes encoded, or a negative error code if not even
+ *	   one fix fits in the buffer.
+ */
+int codec_records_encode(const struct cloud_location_data *fixes, size_t count,
+			 uint8_t *buf, size_t size, size_t *len);
+
+/** @brief Length of the payload of codec_records_encode() holding only the
+ *	   given fix, computed without encoding it.
+ */
+size_t codec_record_single_len(const struct cloud_location_data *fix);
+
+/** @brief Decode a payload made by codec_records_encode().
+ *
+ * @param buf Payload.
+ * @param len Length of the payload.
+ * @param fixes Array the fixes are decoded to.
+ * @param max Size of the array.
+ *
+ * @return Number of fixes decoded, or a negative error code.
+ */
+int codec_records_decode(const uint8_t *buf, size_t len,
+			 struct cloud_location_data *fixes, size_t max);
+
 #ifdef __cplusplus
 }
 #endif
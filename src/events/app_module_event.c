@@ -27,6 +27,14 @@ const char *get_app_module_event_type_str(enum app_module_event_type type)
 static void profile_app_module_event(struct log_event_buf *buf,
 				 const struct app_event_header *aeh)
 {
+	struct app_module_event *event = cast_app_module_event(aeh);
+
+	nrf_profiler_log_encode_uint8(buf, event->type);
+	nrf_profiler_log_encode_uint8(buf, event->app_cfg.active_mode);
+	nrf_profiler_log_encode_int32(buf, event->app_cfg.location_timeout);
+	nrf_profiler_log_encode_int32(buf, event->app_cfg.active_wait_timeout);
+	nrf_profiler_log_encode_int32(buf, event->app_cfg.passive_wait_timeout);
+	nrf_profiler_log_encode_int32(buf, event->app_cfg.batch_size);
 }
 
 static void log_app_module_event(const struct app_event_header *aeh)
@@ -37,8 +45,12 @@ static void log_app_module_event(const struct app_event_header *aeh)
 }
 
 APP_EVENT_INFO_DEFINE(app_module_event,
-                      ENCODE(),
-                      ENCODE(),
+                      ENCODE(NRF_PROFILER_ARG_U8, NRF_PROFILER_ARG_U8,
+                             NRF_PROFILER_ARG_S32, NRF_PROFILER_ARG_S32,
+                             NRF_PROFILER_ARG_S32, NRF_PROFILER_ARG_S32),
+                      ENCODE("type", "active_mode", "location_timeout",
+                             "active_wait_timeout", "passive_wait_timeout",
+                             "batch_size"),
                       profile_app_module_event);
 
 APP_EVENT_TYPE_DEFINE(app_module_event,
@@ -25,6 +25,11 @@ const char *get_cloud_module_event_type_str(enum cloud_module_event_type type)
 static void profile_cloud_module_event(struct log_event_buf *buf,
 				 const struct app_event_header *aeh)
 {
+	struct cloud_module_event *event = cast_cloud_module_event(aeh);
+
+	nrf_profiler_log_encode_uint8(buf, event->type);
+	nrf_profiler_log_encode_uint8(buf, event->cloud_cfg.active_mode);
+	nrf_profiler_log_encode_int32(buf, event->cloud_cfg.batch_size);
 }
 
 static void log_cloud_module_event(const struct app_event_header *aeh)
@@ -35,8 +40,8 @@ static void log_cloud_module_event(const struct app_event_header *aeh)
 }
 
 APP_EVENT_INFO_DEFINE(cloud_module_event,
-                      ENCODE(),
-                      ENCODE(),
+                      ENCODE(NRF_PROFILER_ARG_U8, NRF_PROFILER_ARG_U8, NRF_PROFILER_ARG_S32),
+                      ENCODE("type", "active_mode", "batch_size"),
                       profile_cloud_module_event);
 
 APP_EVENT_TYPE_DEFINE(cloud_module_event,
@@ -0,0 +1,170 @@
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/shell/shell.h>
+
+#include "events/event_latency.h"
+#include "events/event_pool.h"
+#include "events/app_module_event.h"
+#include "events/cloud_module_event.h"
+#include "events/modem_module_event.h"
+#include "events/location_module_event.h"
+
+/* Event types with their own histograms. Other events share the last one. */
+enum event_kind {
+	EVENT_KIND_APP,
+	EVENT_KIND_CLOUD,
+	EVENT_KIND_MODEM,
+	EVENT_KIND_LOCATION,
+	EVENT_KIND_OTHER,
+
+	EVENT_KIND_COUNT
+};
+
+struct histogram {
+	uint32_t buckets[EVENT_LATENCY_BUCKETS];
+	uint32_t count;
+	uint32_t max_us;
+	uint64_t sum_us;
+};
+
+static struct histogram histograms[EVENT_LATENCY_SUBSCRIBER_COUNT][EVENT_KIND_COUNT];
+static struct k_spinlock lock;
+
+static enum event_kind kind_of(const struct app_event_header *aeh)
+{
+	if (is_app_module_event(aeh)) {
+		return EVENT_KIND_APP;
+	} else if (is_cloud_module_event(aeh)) {
+		return EVENT_KIND_CLOUD;
+	} else if (is_modem_module_event(aeh)) {
+		return EVENT_KIND_MODEM;
+	} else if (is_location_module_event(aeh)) {
+		return EVENT_KIND_LOCATION;
+	}
+
+	return EVENT_KIND_OTHER;
+}
+
+static size_t bucket_of(uint32_t us)
+{
+	size_t bucket = 0;
+
+	while (us >= 4 && bucket < EVENT_LATENCY_BUCKETS - 1) {
+		us >>= 2;
+		bucket++;
+	}
+
+	return bucket;
+}
+
+void event_latency_record(enum event_latency_subscriber subscriber,
+			  const struct app_event_header *aeh)
+{
+	uint32_t us = k_cyc_to_us_floor32(event_pool_age_cycles(aeh));
+	struct histogram *histogram = &histograms[subscriber][kind_of(aeh)];
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	histogram->buckets[bucket_of(us)]++;
+	histogram->count++;
+	histogram->sum_us += us;
+	histogram->max_us = MAX(histogram->max_us, us);
+
+	k_spin_unlock(&lock, key);
+}
+
+void event_latency_get(enum event_latency_subscriber subscriber,
+		       struct event_latency_stats *stats)
+{
+	uint64_t sum_us = 0;
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	memset(stats, 0, sizeof(*stats));
+
+	for (size_t k = 0; k < EVENT_KIND_COUNT; k++) {
+		const struct histogram *histogram = &histograms[subscriber][k];
+
+		for (size_t b = 0; b < EVENT_LATENCY_BUCKETS; b++) {
+			stats->buckets[b] += histogram->buckets[b];
+		}
+		stats->count += histogram->count;
+		stats->max_us = MAX(stats->max_us, histogram->max_us);
+		sum_us += histogram->sum_us;
+	}
+
+	k_spin_unlock(&lock, key);
+
+	stats->mean_us = stats->count ? (uint32_t)(sum_us / stats->count) : 0;
+}
+
+void event_latency_reset(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	memset(histograms, 0, sizeof(histograms));
+	k_spin_unlock(&lock, key);
+}
+
+#if defined(CONFIG_SHELL)
+static const char *const kind_names[] = {
+	[EVENT_KIND_APP] = "app",
+	[EVENT_KIND_CLOUD] = "cloud",
+	[EVENT_KIND_MODEM] = "modem",
+	[EVENT_KIND_LOCATION] = "location",
+	[EVENT_KIND_OTHER] = "other",
+};
+
+static const char *const subscriber_names[] = {
+	[EVENT_LATENCY_MAIN] = "main",
+	[EVENT_LATENCY_CLOUD] = "cloud_module",
+	[EVENT_LATENCY_MODEM] = "modem_module",
+	[EVENT_LATENCY_LOCATION] = "location_module",
+	[EVENT_LATENCY_LED] = "led_module",
+};
+
+static int cmd_latency(const struct shell *sh, size_t argc, char **argv)
+{
+	shell_print(sh, "Submit to handle latency, buckets of 1, 4, 16 ... us");
+
+	for (size_t s = 0; s < EVENT_LATENCY_SUBSCRIBER_COUNT; s++) {
+		for (size_t k = 0; k < EVENT_KIND_COUNT; k++) {
+			struct histogram histogram;
+			k_spinlock_key_t key = k_spin_lock(&lock);
+
+			histogram = histograms[s][k];
+			k_spin_unlock(&lock, key);
+
+			if (histogram.count == 0) {
+				continue;
+			}
+
+			shell_fprintf(sh, SHELL_NORMAL, "%s <- %s: n %u, mean %u us, max %u us |",
+				      subscriber_names[s], kind_names[k], histogram.count,
+				      (uint32_t)(histogram.sum_us / histogram.count),
+				      histogram.max_us);
+			for (size_t b = 0; b < EVENT_LATENCY_BUCKETS; b++) {
+				shell_fprintf(sh, SHELL_NORMAL, " %u", histogram.buckets[b]);
+			}
+			shell_fprintf(sh, SHELL_NORMAL, "\n");
+		}
+	}
+
+	return 0;
+}
+
+static int cmd_reset(const struct shell *sh, size_t argc, char **argv)
+{
+	event_latency_reset();
+
+	shell_print(sh, "Event latency histograms cleared");
+
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_events,
+	SHELL_CMD(latency, NULL, "Print the event latency histograms", cmd_latency),
+	SHELL_CMD(reset, NULL, "Clear the event latency histograms", cmd_reset),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(events, &sub_events, "Event diagnostics", NULL);
+#endif /* CONFIG_SHELL */
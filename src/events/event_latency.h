@@ -0,0 +1,85 @@
+#ifndef _EVENT_LATENCY_H_
+#define _EVENT_LATENCY_H_
+
+/**
+ * @brief Event latency
+ * @defgroup event_latency Histograms of the time from submitting an event to
+ *	     handling it, per event type and subscriber
+ * @{
+ */
+
+#include <stdint.h>
+
+#include <app_event_manager.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Modules that handle events. */
+enum event_latency_subscriber {
+	EVENT_LATENCY_MAIN,
+	EVENT_LATENCY_CLOUD,
+	EVENT_LATENCY_MODEM,
+	EVENT_LATENCY_LOCATION,
+	EVENT_LATENCY_LED,
+
+	EVENT_LATENCY_SUBSCRIBER_COUNT
+};
+
+/** Number of histogram buckets. Bucket i counts the latencies from 4^i to
+ *  4^(i+1) microseconds, and the last bucket everything longer.
+ */
+#define EVENT_LATENCY_BUCKETS 12
+
+/** @brief Latency of the events handled by a subscriber. */
+struct event_latency_stats {
+	/** Number of events handled. */
+	uint32_t count;
+	uint32_t mean_us;
+	uint32_t max_us;
+	/** Histogram, see EVENT_LATENCY_BUCKETS. */
+	uint32_t buckets[EVENT_LATENCY_BUCKETS];
+};
+
+#if defined(CONFIG_EVENT_LATENCY)
+
+/** @brief Record the latency of an event when a subscriber starts to handle
+ *	   it. Called by the listener of a module that handles the events
+ *	   directly, and by the module thread of a module that queues them.
+ *
+ * @param subscriber Module handling the event.
+ * @param aeh Event.
+ */
+void event_latency_record(enum event_latency_subscriber subscriber,
+			  const struct app_event_header *aeh);
+
+/** @brief Get the latency of all the events a subscriber has handled.
+ *
+ * @param subscriber Module handling the events.
+ * @param[out] stats Latency of the events of every type together.
+ */
+void event_latency_get(enum event_latency_subscriber subscriber,
+		       struct event_latency_stats *stats);
+
+/** @brief Clear the histograms. */
+void event_latency_reset(void);
+
+#else
+
+static inline void event_latency_record(enum event_latency_subscriber subscriber,
+					const struct app_event_header *aeh)
+{
+}
+
+#endif /* CONFIG_EVENT_LATENCY */
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* _EVENT_LATENCY_H_ */
@@ -0,0 +1,121 @@
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/logging/log.h>
+
+#include "events/event_pool.h"
+#include "events/app_module_event.h"
+#include "events/cloud_module_event.h"
+#include "events/modem_module_event.h"
+#include "events/location_module_event.h"
+
+LOG_MODULE_REGISTER(event_pool, LOG_LEVEL_INF);
+
+/* Every event is preceded by its reference count. The Application Event
+ * Manager holds the first reference until all listeners have returned, and
+ * each module queue that holds the event holds another one.
+ */
+struct event_block {
+	atomic_t refs;
+	/* Cycle counter when the event was allocated, just before it is
+	 * submitted.
+	 */
+	uint32_t allocated_at;
+	bool from_heap;
+} __aligned(8);
+
+#define EVENT_MAX_SIZE MAX(MAX(sizeof(struct app_module_event),			\
+			       sizeof(struct cloud_module_event)),			\
+			   MAX(sizeof(struct modem_module_event),			\
+			       sizeof(struct location_module_event)))
+
+#define EVENT_BLOCK_SIZE ROUND_UP(sizeof(struct event_block) + EVENT_MAX_SIZE, 8)
+
+K_MEM_SLAB_DEFINE_STATIC(event_slab, EVENT_BLOCK_SIZE, CONFIG_EVENT_POOL_BLOCKS, 8);
+
+static atomic_t allocated;
+static atomic_t heap;
+static atomic_t in_use;
+static atomic_t peak;
+
+static struct event_block *block_of(const struct app_event_header *aeh)
+{
+	return (struct event_block *)aeh - 1;
+}
+
+/* Overrides the heap allocation of the Application Event Manager. Called
+ * from the new_*() function of every event type, also from interrupts.
+ */
+void *app_event_manager_alloc(size_t size)
+{
+	struct event_block *block = NULL;
+	atomic_val_t now;
+
+	if (size <= EVENT_MAX_SIZE &&
+	    k_mem_slab_alloc(&event_slab, (void **)&block, K_NO_WAIT) == 0) {
+		block->from_heap = false;
+	} else {
+		block = k_malloc(sizeof(*block) + size);
+		if (block == NULL) {
+			LOG_ERR("Out of memory for a %zu byte event", size);
+			__ASSERT_NO_MSG(false);
+			return NULL;
+		}
+		block->from_heap = true;
+		atomic_inc(&heap);
+	}
+
+	atomic_set(&block->refs, 1);
+	block->allocated_at = k_cycle_get_32();
+	atomic_inc(&allocated);
+
+	now = atomic_inc(&in_use) + 1;
+	for (atomic_val_t max = atomic_get(&peak); now > max; max = atomic_get(&peak)) {
+		if (atomic_cas(&peak, max, now)) {
+			break;
+		}
+	}
+
+	return block + 1;
+}
+
+/* Called by the Application Event Manager when all listeners have returned. */
+void app_event_manager_free(void *addr)
+{
+	event_pool_unref(addr);
+}
+
+void event_pool_ref(const struct app_event_header *aeh)
+{
+	atomic_inc(&block_of(aeh)->refs);
+}
+
+void event_pool_unref(const struct app_event_header *aeh)
+{
+	struct event_block *block = block_of(aeh);
+
+	if (atomic_dec(&block->refs) != 1) {
+		return;
+	}
+
+	atomic_dec(&in_use);
+
+	if (block->from_heap) {
+		k_free(block);
+	} else {
+		k_mem_slab_free(&event_slab, (void **)&block);
+	}
+}
+
+uint32_t event_pool_age_cycles(const struct app_event_header *aeh)
+{
+	return k_cycle_get_32() - block_of(aeh)->allocated_at;
+}
+
+void event_pool_stats_get(struct event_pool_stats *stats)
+{
+	stats->allocated = atomic_get(&allocated);
+	stats->heap = atomic_get(&heap);
+	stats->in_use = atomic_get(&in_use);
+	stats->peak = atomic_get(&peak);
+	stats->block_size = EVENT_BLOCK_SIZE;
+}
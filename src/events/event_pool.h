@@ -0,0 +1,65 @@
+#ifndef _EVENT_POOL_H_
+#define _EVENT_POOL_H_
+
+/**
+ * @brief Event pool
+ * @defgroup event_pool Reference counted allocation of application events
+ * @{
+ */
+
+#include <stdint.h>
+
+#include <app_event_manager.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Event pool counters. */
+struct event_pool_stats {
+	/** Number of events allocated. */
+	uint32_t allocated;
+	/** Number of events allocated from the heap instead of the pool. */
+	uint32_t heap;
+	/** Number of events allocated now. */
+	uint32_t in_use;
+	/** Maximum number of events allocated at the same time. */
+	uint32_t peak;
+	/** Size of one pool block, including the reference count. */
+	uint32_t block_size;
+};
+
+/** @brief Take a reference to an event, so that it is not freed when the
+ *	   Application Event Manager has delivered it. Used by the modules that
+ *	   queue the event to their own thread.
+ *
+ * @param aeh Event header.
+ */
+void event_pool_ref(const struct app_event_header *aeh);
+
+/** @brief Release a reference to an event. The event is freed when the last
+ *	   reference is released.
+ *
+ * @param aeh Event header.
+ */
+void event_pool_unref(const struct app_event_header *aeh);
+
+/** @brief Time since an event was allocated, which is when it was
+ *	   submitted, in cycles.
+ *
+ * @param aeh Event header.
+ */
+uint32_t event_pool_age_cycles(const struct app_event_header *aeh);
+
+/** @brief Get the counters. */
+void event_pool_stats_get(struct event_pool_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* _EVENT_POOL_H_ */
@@ -13,6 +13,10 @@ const char *get_location_module_event_type_str(enum location_module_event_type t
             return "LOCATION_EVENT_ACTIVE";
         case LOCATION_EVENT_INACTIVE:
             return "LOCATION_EVENT_INACTIVE";
+        case LOCATION_EVENT_AGNSS_REQUEST:
+            return "LOCATION_EVENT_AGNSS_REQUEST";
+        case LOCATION_EVENT_CELLULAR_REQUEST:
+            return "LOCATION_EVENT_CELLULAR_REQUEST";
         default:
             return "UNKNOWN_EVENT_TYPE";
     }
@@ -21,6 +25,14 @@ const char *get_location_module_event_type_str(enum location_module_event_type t
 static void profile_location_module_event(struct log_event_buf *buf,
                                           const struct app_event_header *aeh)
 {
+    struct location_module_event *event = cast_location_module_event(aeh);
+
+    nrf_profiler_log_encode_uint8(buf, event->type);
+    nrf_profiler_log_encode_uint8(buf, event->location.method);
+    nrf_profiler_log_encode_uint8(buf, event->location.satellites_tracked);
+    nrf_profiler_log_encode_uint32(buf, event->location.search_time);
+    /* The profiler has no floats, the accuracy is sent in decimeters. */
+    nrf_profiler_log_encode_uint32(buf, (uint32_t)(event->location.pvt.accuracy * 10.0f));
 }
 
 static void log_location_module_event(const struct app_event_header *aeh)
@@ -31,8 +43,11 @@ static void log_location_module_event(const struct app_event_header *aeh)
 }
 
 APP_EVENT_INFO_DEFINE(location_module_event,
-                      ENCODE(),
-                      ENCODE(),
+                      ENCODE(NRF_PROFILER_ARG_U8, NRF_PROFILER_ARG_U8,
+                             NRF_PROFILER_ARG_U8, NRF_PROFILER_ARG_U32,
+                             NRF_PROFILER_ARG_U32),
+                      ENCODE("type", "method", "satellites", "search_time",
+                             "accuracy_dm"),
                       profile_location_module_event);
 
 APP_EVENT_TYPE_DEFINE(location_module_event,
@@ -10,6 +10,11 @@
 #include <app_event_manager.h>
 #include <app_event_manager_profiler_tracer.h>
 
+#if defined(CONFIG_CLOUD_AGNSS)
+#include <modem/lte_lc.h>
+#include <nrf_modem_gnss.h>
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -20,7 +25,9 @@ enum location_module_event_type {
     LOCATION_EVENT_TIMEOUT,
     LOCATION_EVENT_ERROR,
     LOCATION_EVENT_ACTIVE,
-    LOCATION_EVENT_INACTIVE
+    LOCATION_EVENT_INACTIVE,
+    LOCATION_EVENT_AGNSS_REQUEST,
+    LOCATION_EVENT_CELLULAR_REQUEST
 };
 
 /** @brief Position, velocity and time (PVT) data. */
@@ -95,14 +102,37 @@ struct location_module_data{
 	struct location_module_datetime datetime;
 };
 
+#if defined(CONFIG_CLOUD_AGNSS)
+/** Maximum number of neighbor cells in a cellular positioning request. */
+#define LOCATION_MODULE_NCELLS_MAX 4
+
+/** @brief Cells measured for cellular positioning. */
+struct location_module_cells {
+	/** Serving cell. */
+	struct lte_lc_cell current_cell;
+	/** Number of neighbor cells. */
+	uint8_t ncells_count;
+	/** Neighbor cells. */
+	struct lte_lc_ncell neighbor_cells[LOCATION_MODULE_NCELLS_MAX];
+};
+#endif
+
 /** @brief Location module event. */
 struct location_module_event {
     /** Location module application event header. */
     struct app_event_header header;
     /** Location module event type. */
     enum location_module_event_type type;
-    /** Location data. */
-    struct location_module_data location;
+    union {
+	/** Location data. */
+	struct location_module_data location;
+#if defined(CONFIG_CLOUD_AGNSS)
+	/** Assistance data needed by GNSS, with LOCATION_EVENT_AGNSS_REQUEST. */
+	struct nrf_modem_gnss_agnss_data_frame agnss_request;
+	/** Cells to locate, with LOCATION_EVENT_CELLULAR_REQUEST. */
+	struct location_module_cells cells;
+#endif
+    };
 };
 
 APP_EVENT_TYPE_DECLARE(location_module_event);
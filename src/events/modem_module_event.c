@@ -19,6 +19,9 @@ const char *get_modem_module_event_type_str(enum modem_module_event_type type)
 static void profile_modem_module_event(struct log_event_buf *buf,
 				 const struct app_event_header *aeh)
 {
+	struct modem_module_event *event = cast_modem_module_event(aeh);
+
+	nrf_profiler_log_encode_uint8(buf, event->type);
 }
 
 static void log_modem_module_event(const struct app_event_header *aeh)
@@ -29,8 +32,8 @@ static void log_modem_module_event(const struct app_event_header *aeh)
 }
 
 APP_EVENT_INFO_DEFINE(modem_module_event,
-                      ENCODE(),
-                      ENCODE(),
+                      ENCODE(NRF_PROFILER_ARG_U8),
+                      ENCODE("type"),
                       profile_modem_module_event);
 
 APP_EVENT_TYPE_DEFINE(modem_module_event,
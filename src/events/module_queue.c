@@ -0,0 +1,195 @@
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/init.h>
+#include <zephyr/sys/slist.h>
+
+#include "events/module_queue.h"
+#include "events/event_pool.h"
+
+static sys_slist_t queues = SYS_SLIST_STATIC_INIT(&queues);
+static K_MUTEX_DEFINE(queues_lock);
+
+static void queue_register(struct module_queue *queue)
+{
+	if (!atomic_cas(&queue->registered, 0, 1)) {
+		return;
+	}
+
+	k_mutex_lock(&queues_lock, K_FOREVER);
+	sys_slist_append(&queues, &queue->node);
+	k_mutex_unlock(&queues_lock);
+}
+
+static void high_water_update(struct module_queue *queue)
+{
+	uint32_t used = k_msgq_num_used_get(queue->msgq) + queue->spill_len;
+
+	queue->stats.high_water = MAX(queue->stats.high_water, used);
+}
+
+/**@brief Keep an event that does not fit in the queue. Called with the
+ *	  queue locked.
+ *
+ * @return true if the event was kept.
+ */
+static bool spill(struct module_queue *queue, const struct module_queue_item *item)
+{
+	if (item->policy == MODULE_QUEUE_COALESCE) {
+		for (size_t i = 0; i < queue->spill_len; i++) {
+			struct module_queue_item *old = &queue->spill[i];
+
+			if (old->policy == MODULE_QUEUE_COALESCE &&
+			    old->aeh->type_id == item->aeh->type_id) {
+				/* Keep the place of the older event, which
+				 * is still the newest of its type.
+				 */
+				event_pool_unref(old->aeh);
+				old->aeh = item->aeh;
+				queue->stats.coalesced++;
+				return true;
+			}
+		}
+	}
+
+	if (queue->spill_len == ARRAY_SIZE(queue->spill)) {
+		return false;
+	}
+
+	queue->spill[queue->spill_len++] = *item;
+	queue->stats.spilled++;
+
+	return true;
+}
+
+int module_queue_put(struct module_queue *queue, const struct app_event_header *aeh)
+{
+	struct module_queue_item item = {
+		.aeh = aeh,
+		.queued_at = k_uptime_get_32(),
+		.policy = queue->policy ? queue->policy(aeh) : MODULE_QUEUE_DROP,
+	};
+	int err = 0;
+
+	queue_register(queue);
+
+	/* The queue holds a reference to the event, not a copy of it. */
+	event_pool_ref(aeh);
+
+	k_mutex_lock(&queue->lock, K_FOREVER);
+
+	/* While events are spilled, the events that would be spilled too
+	 * wait behind them, so that they are handled in order.
+	 */
+	if ((item.policy == MODULE_QUEUE_DROP || queue->spill_len == 0) &&
+	    k_msgq_put(queue->msgq, &item, K_NO_WAIT) == 0) {
+		/* Queued. */
+	} else if (item.policy == MODULE_QUEUE_DROP || !spill(queue, &item)) {
+		queue->stats.drops++;
+		event_pool_unref(aeh);
+		err = -ENOMSG;
+	}
+
+	high_water_update(queue);
+
+	k_mutex_unlock(&queue->lock);
+
+#if defined(CONFIG_MODULE_WORK_QUEUE)
+	/* Does not move the first run of the module forward. */
+	if (err == 0 && queue->running) {
+		k_work_schedule_for_queue(&module_work_q, &queue->work, K_NO_WAIT);
+	}
+#endif
+
+	return err;
+}
+
+int module_queue_get(struct module_queue *queue, const struct app_event_header **aeh,
+		     k_timeout_t timeout)
+{
+	struct module_queue_item item;
+	uint32_t residency;
+	bool spilled;
+	int err;
+
+	queue_register(queue);
+
+	k_mutex_lock(&queue->lock, K_FOREVER);
+	spilled = queue->spill_len > 0;
+	k_mutex_unlock(&queue->lock);
+
+	/* Not waiting with the queue locked. An event spilled meanwhile was
+	 * spilled because the message queue is full, so the wait ends at once.
+	 */
+	err = k_msgq_get(queue->msgq, &item, spilled ? K_NO_WAIT : timeout);
+
+	k_mutex_lock(&queue->lock, K_FOREVER);
+
+	if (err && queue->spill_len > 0) {
+		item = queue->spill[0];
+		queue->spill_len--;
+		memmove(&queue->spill[0], &queue->spill[1],
+			queue->spill_len * sizeof(queue->spill[0]));
+		err = 0;
+	}
+
+	if (err == 0) {
+		residency = k_uptime_get_32() - item.queued_at;
+		queue->stats.max_residency_ms = MAX(queue->stats.max_residency_ms, residency);
+		*aeh = item.aeh;
+	}
+
+	k_mutex_unlock(&queue->lock);
+
+	return err;
+}
+
+#if defined(CONFIG_MODULE_WORK_QUEUE)
+K_THREAD_STACK_DEFINE(module_work_stack, CONFIG_MODULE_WORK_QUEUE_STACK_SIZE);
+
+struct k_work_q module_work_q;
+
+void module_queue_run(struct module_queue *queue, k_work_handler_t handler,
+		      k_timeout_t delay)
+{
+	k_work_init_delayable(&queue->work, handler);
+	queue->running = true;
+
+	/* Also handles the events put before the module runs. */
+	k_work_schedule_for_queue(&module_work_q, &queue->work, delay);
+}
+
+static int module_work_q_init(void)
+{
+	struct k_work_queue_config config = {
+		.name = "module_workq",
+	};
+
+	k_work_queue_start(&module_work_q, module_work_stack,
+			   K_THREAD_STACK_SIZEOF(module_work_stack),
+			   K_LOWEST_APPLICATION_THREAD_PRIO, &config);
+
+	return 0;
+}
+
+/* Started before the modules, which run from APPLICATION level init. */
+SYS_INIT(module_work_q_init, APPLICATION, 0);
+#endif /* CONFIG_MODULE_WORK_QUEUE */
+
+void module_queue_stats_get(struct module_queue *queue, struct module_queue_stats *stats)
+{
+	k_mutex_lock(&queue->lock, K_FOREVER);
+	*stats = queue->stats;
+	k_mutex_unlock(&queue->lock);
+}
+
+void module_queue_foreach(void (*cb)(struct module_queue *queue, void *user_data),
+			  void *user_data)
+{
+	struct module_queue *queue;
+
+	k_mutex_lock(&queues_lock, K_FOREVER);
+	SYS_SLIST_FOR_EACH_CONTAINER(&queues, queue, node) {
+		cb(queue, user_data);
+	}
+	k_mutex_unlock(&queues_lock);
+}
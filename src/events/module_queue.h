@@ -0,0 +1,159 @@
+#ifndef _MODULE_QUEUE_H_
+#define _MODULE_QUEUE_H_
+
+/**
+ * @brief Module queue
+ * @defgroup module_queue Event queue of a module thread, with telemetry and
+ *	     an overflow policy
+ * @{
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/slist.h>
+#include <app_event_manager.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief What to do with an event when the queue is full. */
+enum module_queue_policy {
+	/** Drop the event. */
+	MODULE_QUEUE_DROP,
+	/** Keep the event in the spill buffer. */
+	MODULE_QUEUE_SPILL,
+	/** Replace an older spilled event of the same type, or spill. */
+	MODULE_QUEUE_COALESCE,
+};
+
+/** @brief Queue counters. */
+struct module_queue_stats {
+	/** Maximum number of events waiting at the same time, spilled
+	 *  events included.
+	 */
+	uint32_t high_water;
+	/** Number of events dropped. */
+	uint32_t drops;
+	/** Number of events kept in the spill buffer. */
+	uint32_t spilled;
+	/** Number of spilled events replaced by a newer one. */
+	uint32_t coalesced;
+	/** Longest time an event has waited in the queue, in milliseconds. */
+	uint32_t max_residency_ms;
+};
+
+/** @private */
+struct module_queue_item {
+	const struct app_event_header *aeh;
+	uint32_t queued_at;
+	enum module_queue_policy policy;
+};
+
+/** @brief Event queue of a module thread. Define with MODULE_QUEUE_DEFINE. */
+struct module_queue {
+	/** Name used in the diagnostics. */
+	const char *name;
+	/** Queue of the events. */
+	struct k_msgq *msgq;
+	/** Number of events the queue holds. */
+	uint32_t size;
+	/** Overflow policy of an event. */
+	enum module_queue_policy (*policy)(const struct app_event_header *aeh);
+	/** @private */
+	struct module_queue_item spill[CONFIG_MODULE_QUEUE_SPILL_SIZE];
+	/** @private */
+	size_t spill_len;
+	/** @private */
+	struct k_mutex lock;
+	/** @private */
+	struct module_queue_stats stats;
+	/** @private */
+	sys_snode_t node;
+	/** @private */
+	atomic_t registered;
+#if defined(CONFIG_MODULE_WORK_QUEUE)
+	/** @private */
+	struct k_work_delayable work;
+	/** @private */
+	bool running;
+#endif
+};
+
+#if defined(CONFIG_MODULE_WORK_QUEUE)
+/** @brief Work queue that runs the modules. */
+extern struct k_work_q module_work_q;
+
+/** @brief Run a module on the module work queue instead of its own thread.
+ *	   The handler is submitted to the work queue whenever an event is
+ *	   put in the queue, and gets the events with module_queue_get()
+ *	   without waiting.
+ *
+ * @param queue Queue of the module.
+ * @param handler Work handler of the module.
+ * @param delay Delay before the handler runs for the first time.
+ */
+void module_queue_run(struct module_queue *queue, k_work_handler_t handler,
+		      k_timeout_t delay);
+#endif
+
+/** @brief Define a module queue.
+ *
+ * @param _name Name of the queue.
+ * @param _size Number of events the queue holds, not counting the spill
+ *		buffer.
+ * @param _policy Function that returns the overflow policy of an event, or
+ *		  NULL to drop every event that does not fit.
+ */
+#define MODULE_QUEUE_DEFINE(_name, _size, _policy)					\
+	K_MSGQ_DEFINE(_name ## _msgq, sizeof(struct module_queue_item), _size, 4);	\
+	static struct module_queue _name = {						\
+		.name = #_name,								\
+		.msgq = &_name ## _msgq,						\
+		.size = _size,								\
+		.policy = _policy,							\
+		.lock = Z_MUTEX_INITIALIZER(_name.lock),				\
+	}
+
+/** @brief Queue a reference to an event. The event is not copied. The caller
+ *	   releases the reference with event_pool_unref() once the event
+ *	   returned by module_queue_get() is handled.
+ *
+ * @param queue Queue.
+ * @param aeh Event.
+ *
+ * @retval 0 if the event was queued or spilled.
+ * @retval -ENOMSG if the event was dropped.
+ */
+int module_queue_put(struct module_queue *queue, const struct app_event_header *aeh);
+
+/** @brief Get the oldest event. Spilled events are returned after the events
+ *	   in the queue.
+ *
+ * @param queue Queue.
+ * @param aeh The event is written here.
+ * @param timeout Time to wait for an event.
+ *
+ * @return 0 on success, or the error of k_msgq_get().
+ */
+int module_queue_get(struct module_queue *queue, const struct app_event_header **aeh,
+		     k_timeout_t timeout);
+
+/** @brief Get the counters of a queue. */
+void module_queue_stats_get(struct module_queue *queue, struct module_queue_stats *stats);
+
+/** @brief Call a function for every queue that has been used. */
+void module_queue_foreach(void (*cb)(struct module_queue *queue, void *user_data),
+			  void *user_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* _MODULE_QUEUE_H_ */
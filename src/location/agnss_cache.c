@@ -0,0 +1,603 @@
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/crc.h>
+#include <zephyr/sys/util.h>
+#include <modem/location.h>
+#include <date_time.h>
+#if defined(CONFIG_SHELL)
+#include <zephyr/shell/shell.h>
+#endif
+
+#include "location/agnss_cache.h"
+#include "util/storage.h"
+
+LOG_MODULE_REGISTER(agnss_cache, LOG_LEVEL_DBG);
+
+/* Element types of the nRF Cloud A-GNSS binary format, schema version 1. The
+ * data is the schema version followed by elements, each one the type
+ * (uint8), the number of items (uint16) and the items.
+ */
+enum element_type {
+	TYPE_UTC = 1,
+	TYPE_EPHEMERIDES,
+	TYPE_ALMANAC,
+	TYPE_KLOBUCHAR,
+	TYPE_NEQUICK,
+	TYPE_TOWS,
+	TYPE_CLOCK,
+	TYPE_LOCATION,
+	TYPE_INTEGRITY,
+	TYPE_QZSS_EPHEMERIDES,
+	TYPE_QZSS_ALMANAC,
+	TYPE_COUNT
+};
+
+#define SCHEMA_VERSION 1
+#define ELEMENT_HEADER_LEN 3
+
+#define UTC_LEN 14
+#define EPHEMERIS_LEN 62
+#define ALMANAC_LEN 31
+#define KLOBUCHAR_LEN 8
+#define NEQUICK_LEN 8
+
+static const uint8_t item_lens[TYPE_COUNT] = {
+	[TYPE_UTC] = UTC_LEN,
+	[TYPE_EPHEMERIDES] = EPHEMERIS_LEN,
+	[TYPE_ALMANAC] = ALMANAC_LEN,
+	[TYPE_KLOBUCHAR] = KLOBUCHAR_LEN,
+	[TYPE_NEQUICK] = NEQUICK_LEN,
+	[TYPE_TOWS] = 3,
+	[TYPE_CLOCK] = 12,
+	[TYPE_LOCATION] = 15,
+	[TYPE_INTEGRITY] = 4,
+	[TYPE_QZSS_EPHEMERIDES] = EPHEMERIS_LEN,
+	[TYPE_QZSS_ALMANAC] = ALMANAC_LEN,
+};
+
+/* Types that are cached, in the order they are injected. The ephemerides
+ * and almanacs are kept per satellite, the first byte of an item is its
+ * satellite id.
+ */
+static const uint8_t cached_types[] = {
+	TYPE_UTC,
+	TYPE_KLOBUCHAR,
+	TYPE_NEQUICK,
+	TYPE_ALMANAC,
+	TYPE_EPHEMERIDES,
+};
+
+#define GPS_SV_MAX 32
+#define CACHE_ITEMS (2 * GPS_SV_MAX + 3)
+#define ENCODED_MAX_LEN (1 + ARRAY_SIZE(cached_types) * ELEMENT_HEADER_LEN +		\
+			 GPS_SV_MAX * (EPHEMERIS_LEN + ALMANAC_LEN) +			\
+			 UTC_LEN + KLOBUCHAR_LEN + NEQUICK_LEN)
+
+struct cache_item {
+	/* Element type, 0 for a free slot. */
+	uint8_t type;
+	/* UNIX time of the download in seconds. */
+	uint32_t stored_at;
+	uint8_t data[EPHEMERIS_LEN];
+} __packed;
+
+struct cache_header {
+	uint8_t version;
+	uint8_t items;
+	uint16_t item_len;
+	uint32_t crc;
+} __packed;
+
+#define CACHE_VERSION 1
+
+/* The items are saved in chunks that fit in a flash sector, and the header
+ * with the CRC of the items last. A cache that was not saved completely
+ * does not match its CRC and is dropped.
+ */
+#define CHUNK_LEN 1024
+#define CHUNKS DIV_ROUND_UP(sizeof(items), CHUNK_LEN)
+
+static struct cache_item items[CACHE_ITEMS];
+static uint8_t encoded[ENCODED_MAX_LEN];
+
+static struct agnss_cache_ttff ttff_stats[2];
+
+static K_MUTEX_DEFINE(lock);
+
+BUILD_ASSERT(DIV_ROUND_UP(CACHE_ITEMS * sizeof(struct cache_item), CHUNK_LEN) <=
+	     STORAGE_ID_AGNSS_CACHE_LAST - STORAGE_ID_AGNSS_CACHE_FIRST + 1,
+	     "Not enough storage ids for the A-GNSS cache");
+
+static bool keyed(uint8_t type)
+{
+	return type == TYPE_EPHEMERIDES || type == TYPE_ALMANAC;
+}
+
+static uint32_t validity(uint8_t type)
+{
+	return type == TYPE_EPHEMERIDES ? CONFIG_AGNSS_CACHE_EPHEMERIS_VALIDITY :
+					  CONFIG_AGNSS_CACHE_ALMANAC_VALIDITY;
+}
+
+/**@brief Seconds the item is still valid, 0 if it has expired. A clock
+ *	  that went backwards expires the item too.
+ */
+static uint32_t remaining(const struct cache_item *item, uint32_t now)
+{
+	uint32_t age = now - item->stored_at;
+
+	return age < validity(item->type) ? validity(item->type) - age : 0;
+}
+
+static int now_get(uint32_t *now)
+{
+	int64_t unix_time_ms;
+
+	if (date_time_now(&unix_time_ms)) {
+		return -EAGAIN;
+	}
+
+	*now = (uint32_t)(unix_time_ms / MSEC_PER_SEC);
+
+	return 0;
+}
+
+/**@brief Check that the data is a sequence of known elements. */
+static int data_check(const uint8_t *data, size_t len)
+{
+	size_t pos = 1;
+
+	if (len < 1 || data[0] != SCHEMA_VERSION) {
+		return -EBADMSG;
+	}
+
+	while (pos < len) {
+		uint8_t type;
+		size_t items_len;
+
+		if (len - pos < ELEMENT_HEADER_LEN) {
+			return -EBADMSG;
+		}
+
+		type = data[pos];
+		if (type == 0 || type >= TYPE_COUNT) {
+			return -EBADMSG;
+		}
+
+		items_len = sys_get_le16(&data[pos + 1]) * item_lens[type];
+		pos += ELEMENT_HEADER_LEN;
+		if (len - pos < items_len) {
+			return -EBADMSG;
+		}
+
+		pos += items_len;
+	}
+
+	return 0;
+}
+
+/**@brief Slot of the item, the cached item of the same satellite or a free
+ *	  slot.
+ */
+static struct cache_item *slot_find(uint8_t type, const uint8_t *data)
+{
+	struct cache_item *free = NULL;
+
+	for (size_t i = 0; i < ARRAY_SIZE(items); i++) {
+		if (items[i].type == type && (!keyed(type) || items[i].data[0] == data[0])) {
+			return &items[i];
+		}
+
+		if (items[i].type == 0 && free == NULL) {
+			free = &items[i];
+		}
+	}
+
+	return free;
+}
+
+static bool type_cached(uint8_t type)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(cached_types); i++) {
+		if (cached_types[i] == type) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static int cache_save(void)
+{
+	int err;
+	struct cache_header header = {
+		.version = CACHE_VERSION,
+		.items = CACHE_ITEMS,
+		.item_len = sizeof(struct cache_item),
+		.crc = crc32_ieee((const uint8_t *)items, sizeof(items)),
+	};
+
+	for (size_t i = 0; i < CHUNKS; i++) {
+		err = storage_write(STORAGE_ID_AGNSS_CACHE_FIRST + i, (uint8_t *)items + i * CHUNK_LEN,
+				    MIN(CHUNK_LEN, sizeof(items) - i * CHUNK_LEN));
+		if (err) {
+			return err;
+		}
+	}
+
+	return storage_write(STORAGE_ID_AGNSS_CACHE, &header, sizeof(header));
+}
+
+int agnss_cache_init(void)
+{
+	ssize_t len;
+	struct cache_header header;
+	size_t count = 0;
+
+	memset(items, 0, sizeof(items));
+
+	len = storage_read(STORAGE_ID_AGNSS_TTFF, ttff_stats, sizeof(ttff_stats));
+	if (len != sizeof(ttff_stats)) {
+		memset(ttff_stats, 0, sizeof(ttff_stats));
+	}
+
+	len = storage_read(STORAGE_ID_AGNSS_CACHE, &header, sizeof(header));
+	if (len != sizeof(header) || header.version != CACHE_VERSION ||
+	    header.items != CACHE_ITEMS || header.item_len != sizeof(struct cache_item)) {
+		LOG_INF("No A-GNSS cache");
+		return 0;
+	}
+
+	for (size_t i = 0; i < CHUNKS && len >= 0; i++) {
+		size_t chunk_len = MIN(CHUNK_LEN, sizeof(items) - i * CHUNK_LEN);
+
+		len = storage_read(STORAGE_ID_AGNSS_CACHE_FIRST + i,
+				   (uint8_t *)items + i * CHUNK_LEN, chunk_len);
+		if (len >= 0 && (size_t)len != chunk_len) {
+			len = -EBADMSG;
+		}
+	}
+
+	if (len < 0 || crc32_ieee((const uint8_t *)items, sizeof(items)) != header.crc) {
+		LOG_WRN("A-GNSS cache is corrupted, dropped");
+		memset(items, 0, sizeof(items));
+		return 0;
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(items); i++) {
+		count += items[i].type != 0;
+	}
+
+	LOG_INF("A-GNSS cache restored, %zu items", count);
+
+	return 0;
+}
+
+int agnss_cache_store(const uint8_t *data, size_t len)
+{
+	int err;
+	uint32_t now;
+	size_t pos = 1;
+	int stored = 0;
+
+	err = data_check(data, len);
+	if (err) {
+		LOG_WRN("Unknown A-GNSS data layout, not cached");
+		return err;
+	}
+
+	err = now_get(&now);
+	if (err) {
+		return err;
+	}
+
+	k_mutex_lock(&lock, K_FOREVER);
+
+	for (size_t i = 0; i < ARRAY_SIZE(items); i++) {
+		if (items[i].type != 0 && remaining(&items[i], now) == 0) {
+			items[i].type = 0;
+		}
+	}
+
+	while (pos < len) {
+		uint8_t type = data[pos];
+		uint16_t count = sys_get_le16(&data[pos + 1]);
+
+		pos += ELEMENT_HEADER_LEN;
+
+		for (uint16_t i = 0; i < count; i++, pos += item_lens[type]) {
+			struct cache_item *item;
+
+			if (!type_cached(type) ||
+			    (keyed(type) && (data[pos] == 0 || data[pos] > GPS_SV_MAX))) {
+				continue;
+			}
+
+			item = slot_find(type, &data[pos]);
+			if (item == NULL) {
+				continue;
+			}
+
+			item->type = type;
+			item->stored_at = now;
+			memset(item->data, 0, sizeof(item->data));
+			memcpy(item->data, &data[pos], item_lens[type]);
+			stored++;
+		}
+	}
+
+	err = stored > 0 ? cache_save() : 0;
+
+	k_mutex_unlock(&lock);
+
+	if (err) {
+		LOG_ERR("Failed to save the A-GNSS cache, error: %d", err);
+		return err;
+	}
+
+	LOG_INF("%d A-GNSS items cached", stored);
+
+	return stored;
+}
+
+/**@brief Encode the valid items in the nRF Cloud A-GNSS binary format. */
+static size_t cache_encode(uint32_t now, int *count)
+{
+	size_t len = 0;
+
+	*count = 0;
+	encoded[len++] = SCHEMA_VERSION;
+
+	for (size_t t = 0; t < ARRAY_SIZE(cached_types); t++) {
+		uint8_t type = cached_types[t];
+		size_t header = len;
+		uint16_t type_count = 0;
+
+		len += ELEMENT_HEADER_LEN;
+
+		for (size_t i = 0; i < ARRAY_SIZE(items); i++) {
+			if (items[i].type != type || remaining(&items[i], now) == 0) {
+				continue;
+			}
+
+			memcpy(&encoded[len], items[i].data, item_lens[type]);
+			len += item_lens[type];
+			type_count++;
+		}
+
+		if (type_count == 0) {
+			len = header;
+			continue;
+		}
+
+		encoded[header] = type;
+		sys_put_le16(type_count, &encoded[header + 1]);
+		*count += type_count;
+	}
+
+	return len;
+}
+
+int agnss_cache_inject(void)
+{
+	int err;
+	uint32_t now;
+	size_t len;
+	int count;
+
+	err = now_get(&now);
+	if (err) {
+		return err;
+	}
+
+	k_mutex_lock(&lock, K_FOREVER);
+
+	len = cache_encode(now, &count);
+	if (count == 0) {
+		err = -ENODATA;
+	} else {
+		err = location_agnss_data_process((const char *)encoded, len);
+	}
+
+	k_mutex_unlock(&lock);
+
+	if (err) {
+		return err;
+	}
+
+	LOG_INF("%d cached A-GNSS items injected", count);
+
+	return count;
+}
+
+static uint32_t request_flag(uint8_t type)
+{
+	switch (type) {
+	case TYPE_UTC:
+		return NRF_MODEM_GNSS_AGNSS_GPS_UTC_REQUEST;
+	case TYPE_KLOBUCHAR:
+		return NRF_MODEM_GNSS_AGNSS_KLOBUCHAR_REQUEST;
+	case TYPE_NEQUICK:
+		return NRF_MODEM_GNSS_AGNSS_NEQUICK_REQUEST;
+	default:
+		return 0;
+	}
+}
+
+bool agnss_cache_trim(struct nrf_modem_gnss_agnss_data_frame *request)
+{
+	uint32_t now;
+	uint32_t flags = 0;
+	uint64_t ephe = 0;
+	uint64_t alm = 0;
+	bool covered = false;
+
+	if (now_get(&now)) {
+		return false;
+	}
+
+	/* An item close to its expiry is downloaded again, which refreshes
+	 * the cache.
+	 */
+	k_mutex_lock(&lock, K_FOREVER);
+
+	for (size_t i = 0; i < ARRAY_SIZE(items); i++) {
+		if (items[i].type == 0 ||
+		    remaining(&items[i], now) <= CONFIG_AGNSS_CACHE_REFRESH_MARGIN) {
+			continue;
+		}
+
+		if (items[i].type == TYPE_EPHEMERIDES) {
+			ephe |= BIT64(items[i].data[0] - 1);
+		} else if (items[i].type == TYPE_ALMANAC) {
+			alm |= BIT64(items[i].data[0] - 1);
+		} else {
+			flags |= request_flag(items[i].type);
+		}
+	}
+
+	k_mutex_unlock(&lock);
+
+	if (request->data_flags & flags) {
+		request->data_flags &= ~flags;
+		covered = true;
+	}
+
+	for (size_t i = 0; i < MIN(request->system_count, ARRAY_SIZE(request->system)); i++) {
+		if (request->system[i].system_id != NRF_MODEM_GNSS_SYSTEM_GPS) {
+			continue;
+		}
+
+		if ((request->system[i].sv_mask_ephe & ephe) ||
+		    (request->system[i].sv_mask_alm & alm)) {
+			request->system[i].sv_mask_ephe &= ~ephe;
+			request->system[i].sv_mask_alm &= ~alm;
+			covered = true;
+		}
+	}
+
+	return covered;
+}
+
+void agnss_cache_ttff_record(bool cached, uint32_t ttff)
+{
+	int err;
+	struct agnss_cache_ttff *stats = &ttff_stats[cached];
+
+	k_mutex_lock(&lock, K_FOREVER);
+
+	stats->count++;
+	stats->total += ttff;
+	stats->last = ttff;
+	err = storage_write(STORAGE_ID_AGNSS_TTFF, ttff_stats, sizeof(ttff_stats));
+
+	k_mutex_unlock(&lock);
+
+	if (err) {
+		LOG_WRN("Failed to save the time to first fix, error: %d", err);
+	}
+
+	LOG_INF("Time to first fix %u ms %s the A-GNSS cache, average %u ms over %u boots",
+		ttff, cached ? "with" : "without", stats->total / stats->count, stats->count);
+}
+
+void agnss_cache_ttff_get(bool cached, struct agnss_cache_ttff *ttff)
+{
+	k_mutex_lock(&lock, K_FOREVER);
+	*ttff = ttff_stats[cached];
+	k_mutex_unlock(&lock);
+}
+
+#if defined(CONFIG_SHELL)
+static const char *const type_names[TYPE_COUNT] = {
+	[TYPE_UTC] = "UTC",
+	[TYPE_EPHEMERIDES] = "ephemerides",
+	[TYPE_ALMANAC] = "almanacs",
+	[TYPE_KLOBUCHAR] = "Klobuchar",
+	[TYPE_NEQUICK] = "NeQuick",
+};
+
+static int cmd_status(const struct shell *sh, size_t argc, char **argv)
+{
+	uint32_t now;
+	bool time_known = now_get(&now) == 0;
+
+	shell_print(sh, "type: items, valid, oldest s");
+
+	k_mutex_lock(&lock, K_FOREVER);
+
+	for (size_t t = 0; t < ARRAY_SIZE(cached_types); t++) {
+		uint8_t type = cached_types[t];
+		uint32_t count = 0;
+		uint32_t valid = 0;
+		uint32_t oldest = 0;
+
+		for (size_t i = 0; i < ARRAY_SIZE(items); i++) {
+			if (items[i].type != type) {
+				continue;
+			}
+
+			count++;
+			if (time_known) {
+				valid += remaining(&items[i], now) > 0;
+				oldest = MAX(oldest, now - items[i].stored_at);
+			}
+		}
+
+		shell_print(sh, "%s: %u, %u, %u", type_names[type], count, valid, oldest);
+	}
+
+	for (int cached = 1; cached >= 0; cached--) {
+		const struct agnss_cache_ttff *stats = &ttff_stats[cached];
+
+		shell_print(sh, "TTFF %s the cache: %u boots, average %u ms, last %u ms",
+			    cached ? "with" : "without", stats->count,
+			    stats->count ? stats->total / stats->count : 0, stats->last);
+	}
+
+	k_mutex_unlock(&lock);
+
+	if (!time_known) {
+		shell_print(sh, "Time not known, validity not checked");
+	}
+
+	return 0;
+}
+
+static int cmd_clear(const struct shell *sh, size_t argc, char **argv)
+{
+	k_mutex_lock(&lock, K_FOREVER);
+	memset(items, 0, sizeof(items));
+	(void)storage_delete(STORAGE_ID_AGNSS_CACHE);
+	k_mutex_unlock(&lock);
+
+	shell_print(sh, "A-GNSS cache cleared");
+
+	return 0;
+}
+
+static int cmd_reset(const struct shell *sh, size_t argc, char **argv)
+{
+	k_mutex_lock(&lock, K_FOREVER);
+	memset(ttff_stats, 0, sizeof(ttff_stats));
+	(void)storage_delete(STORAGE_ID_AGNSS_TTFF);
+	k_mutex_unlock(&lock);
+
+	shell_print(sh, "Time to first fix statistics cleared");
+
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_agnss_cache,
+	SHELL_CMD(status, NULL, "Print the cached items and the time to first fix", cmd_status),
+	SHELL_CMD(clear, NULL, "Clear the cache", cmd_clear),
+	SHELL_CMD(reset, NULL, "Clear the time to first fix statistics", cmd_reset),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(agnss_cache, &sub_agnss_cache, "A-GNSS cache", NULL);
+#endif /* CONFIG_SHELL */
@@ -0,0 +1,88 @@
+#ifndef _AGNSS_CACHE_H_
+#define _AGNSS_CACHE_H_
+
+/**
+ * @brief A-GNSS cache
+ * @defgroup agnss_cache Assistance data kept in flash for warm starts
+ *			 after a reboot
+ * @{
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <nrf_modem_gnss.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Time to first fix after a boot, with or without the cache. */
+struct agnss_cache_ttff {
+	/** Number of first fixes. */
+	uint32_t count;
+	/** Sum of the times to first fix in milliseconds. */
+	uint32_t total;
+	/** Last time to first fix in milliseconds. */
+	uint32_t last;
+};
+
+/** @brief Restore the cache and the time to first fix statistics from the
+ *	   flash.
+ *
+ * @return 0 on success, or a negative error code.
+ */
+int agnss_cache_init(void);
+
+/** @brief Add the ephemerides, almanacs, UTC parameters and ionospheric
+ *	   corrections of downloaded A-GNSS data to the cache, replacing the
+ *	   cached items of the same satellites. Time, integrity and position
+ *	   are only valid at download and are not cached.
+ *
+ * @param data A-GNSS data in the nRF Cloud A-GNSS binary format.
+ * @param len Length of the data.
+ *
+ * @return Number of items cached, or a negative error code.
+ */
+int agnss_cache_store(const uint8_t *data, size_t len);
+
+/** @brief Give the valid cached data to GNSS.
+ *
+ * @return Number of items injected, -ENODATA if no cached item is valid,
+ *	   -EAGAIN if the time is not known yet, or a negative error code.
+ */
+int agnss_cache_inject(void);
+
+/** @brief Remove from an assistance request of GNSS what the cache holds
+ *	   and is not close to its expiry. The rest has to be downloaded.
+ *
+ * @param request Assistance data needed by GNSS.
+ *
+ * @return true if the cache covers a part of the request.
+ */
+bool agnss_cache_trim(struct nrf_modem_gnss_agnss_data_frame *request);
+
+/** @brief Record the time to the first GNSS fix after a boot.
+ *
+ * @param cached True if the cached data was injected before the search.
+ * @param ttff Time to first fix in milliseconds.
+ */
+void agnss_cache_ttff_record(bool cached, uint32_t ttff);
+
+/** @brief Get the time to first fix statistics.
+ *
+ * @param cached True for the first fixes with the cache.
+ * @param ttff The statistics are written here.
+ */
+void agnss_cache_ttff_get(bool cached, struct agnss_cache_ttff *ttff);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* _AGNSS_CACHE_H_ */
@@ -0,0 +1,321 @@
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/util.h>
+#include <date_time.h>
+#if defined(CONFIG_SHELL)
+#include <zephyr/shell/shell.h>
+#endif
+
+#include "location/gnss_assist.h"
+#include "util/storage.h"
+
+LOG_MODULE_REGISTER(gnss_assist, LOG_LEVEL_DBG);
+
+/* UNIX time of the GPS epoch, 1980-01-06, and the leap seconds GPS time is
+ * ahead of UTC since 2017.
+ */
+#define GPS_EPOCH_UNIX_S 315964800LL
+#define GPS_UTC_LEAP_S 18
+#define SEC_PER_DAY 86400
+
+/* The uncertainties are coded as in 3GPP TS 23.032, r = C((1 + x)^K - 1). */
+#define UNC_C 10.0f
+#define UNC_X 0.1f
+#define UNC_ALTITUDE_C 45.0f
+#define UNC_ALTITUDE_X 0.025f
+#define UNC_K_MAX 127
+#define UNC_MISSING 255
+
+/* The accuracy of a fix is the radius of 68 % confidence. */
+#define CONFIDENCE 68
+
+#define LATITUDE_SCALE ((float)(1 << 23) / 90.0f)
+#define LONGITUDE_SCALE ((float)(1 << 24) / 360.0f)
+#define COORDINATE_MIN (-(1 << 23))
+#define COORDINATE_MAX ((1 << 23) - 1)
+
+/* Last known position, and the last one saved in the flash. The flash is
+ * written at most every CONFIG_GNSS_ASSIST_SAVE_INTERVAL seconds, unless
+ * the accuracy improves a lot.
+ */
+static struct gnss_assist_fix last;
+static struct gnss_assist_fix saved;
+
+/* Uptime of the last GNSS fix of this boot, or -1. GNSS keeps its own
+ * position and time after a fix.
+ */
+static int64_t gnss_fix_at = -1;
+static int64_t last_at = -1;
+
+static struct gnss_assist_ttff ttff_stats[(GNSS_ASSIST_POSITION | GNSS_ASSIST_TIME) + 1];
+
+static K_MUTEX_DEFINE(lock);
+
+static uint8_t uncertainty_encode(float meters, float c, float x)
+{
+	float k = ceilf(logf(meters / c + 1.0f) / logf(1.0f + x));
+
+	return (uint8_t)CLAMP(k, 0.0f, (float)UNC_K_MAX);
+}
+
+static int32_t coordinate_encode(double degrees, float scale)
+{
+	return (int32_t)CLAMP(lround(degrees * scale), COORDINATE_MIN, COORDINATE_MAX);
+}
+
+/**@brief Uncertainty of the position at the given time, in meters. */
+static float uncertainty(const struct gnss_assist_fix *fix, int64_t now)
+{
+	float age = (float)MAX(now - fix->time, 0) / MSEC_PER_SEC;
+
+	return fix->accuracy + age * CONFIG_GNSS_ASSIST_SPEED;
+}
+
+bool gnss_assist_location_encode(const struct gnss_assist_fix *fix, int64_t now,
+				 struct nrf_modem_gnss_agnss_data_location *location)
+{
+	float unc = uncertainty(fix, now);
+
+	memset(location, 0, sizeof(*location));
+	location->latitude = coordinate_encode(fix->latitude, LATITUDE_SCALE);
+	location->longitude = coordinate_encode(fix->longitude, LONGITUDE_SCALE);
+	location->unc_semimajor = uncertainty_encode(unc, UNC_C, UNC_X);
+	location->unc_semiminor = location->unc_semimajor;
+	location->confidence = CONFIDENCE;
+
+	/* The altitude changes little, a moving device mostly moves along the
+	 * ground.
+	 */
+	if (fix->altitude_accuracy > 0.0f) {
+		location->altitude = (int16_t)CLAMP(lroundf(fix->altitude), INT16_MIN, INT16_MAX);
+		location->unc_altitude = uncertainty_encode(fix->altitude_accuracy,
+							    UNC_ALTITUDE_C, UNC_ALTITUDE_X);
+	} else {
+		location->unc_altitude = UNC_MISSING;
+	}
+
+	return unc <= CONFIG_GNSS_ASSIST_MAX_UNCERTAINTY;
+}
+
+void gnss_assist_time_encode(int64_t now,
+			     struct nrf_modem_gnss_agnss_gps_data_system_time_and_sv_tow *time)
+{
+	int64_t gps_s = now / MSEC_PER_SEC - GPS_EPOCH_UNIX_S + GPS_UTC_LEAP_S;
+
+	memset(time, 0, sizeof(*time));
+	time->date_day = (uint16_t)(gps_s / SEC_PER_DAY);
+	time->time_full_s = (uint32_t)(gps_s % SEC_PER_DAY);
+	time->time_frac_ms = (uint16_t)(now % MSEC_PER_SEC);
+}
+
+int gnss_assist_init(void)
+{
+	ssize_t len;
+
+	k_mutex_lock(&lock, K_FOREVER);
+
+	memset(&last, 0, sizeof(last));
+	last_at = -1;
+	gnss_fix_at = -1;
+
+	len = storage_read(STORAGE_ID_LAST_FIX, &saved, sizeof(saved));
+	if (len != sizeof(saved)) {
+		memset(&saved, 0, sizeof(saved));
+		k_mutex_unlock(&lock);
+		LOG_INF("No last known position");
+		return 0;
+	}
+
+	last = saved;
+	last_at = k_uptime_get();
+
+	k_mutex_unlock(&lock);
+
+	LOG_INF("Last known position restored, accuracy %d m", (int)saved.accuracy);
+
+	return 0;
+}
+
+void gnss_assist_fix_update(const struct gnss_assist_fix *fix, bool gnss)
+{
+	int err = 0;
+	int64_t uptime = k_uptime_get();
+
+	k_mutex_lock(&lock, K_FOREVER);
+
+	if (gnss) {
+		gnss_fix_at = uptime;
+	}
+
+	if (last.time != 0 && fix->accuracy > uncertainty(&last, fix->time)) {
+		k_mutex_unlock(&lock);
+		return;
+	}
+
+	last = *fix;
+	last_at = uptime;
+
+	if (saved.time == 0 || fix->accuracy < saved.accuracy / 2.0f ||
+	    fix->time - saved.time >= CONFIG_GNSS_ASSIST_SAVE_INTERVAL * MSEC_PER_SEC) {
+		err = storage_write(STORAGE_ID_LAST_FIX, fix, sizeof(*fix));
+		if (!err) {
+			saved = *fix;
+		}
+	}
+
+	k_mutex_unlock(&lock);
+
+	if (err) {
+		LOG_WRN("Failed to save the last known position, error: %d", err);
+	}
+}
+
+int gnss_assist_inject(void)
+{
+	int err;
+	int64_t now;
+	int assisted = 0;
+	struct nrf_modem_gnss_agnss_data_location location;
+	struct nrf_modem_gnss_agnss_gps_data_system_time_and_sv_tow time;
+	bool position_known;
+	bool time_known;
+	float unc;
+
+	/* Without the time the age of the position is not known either. */
+	if (date_time_now(&now)) {
+		return -EAGAIN;
+	}
+
+	k_mutex_lock(&lock, K_FOREVER);
+	position_known = last.time != 0 && (gnss_fix_at < 0 || last_at > gnss_fix_at) &&
+			 gnss_assist_location_encode(&last, now, &location);
+	time_known = gnss_fix_at >= 0;
+	unc = uncertainty(&last, now);
+	k_mutex_unlock(&lock);
+
+	if (position_known) {
+		err = nrf_modem_gnss_agnss_write(&location, sizeof(location),
+						 NRF_MODEM_GNSS_AGNSS_LOCATION);
+		if (err) {
+			LOG_WRN("Failed to give the position to GNSS, error: %d", err);
+		} else {
+			assisted |= GNSS_ASSIST_POSITION;
+		}
+	}
+
+	if (!time_known) {
+		gnss_assist_time_encode(now, &time);
+		err = nrf_modem_gnss_agnss_write(&time, sizeof(time),
+						 NRF_MODEM_GNSS_AGNSS_GPS_SYSTEM_CLOCK_AND_TOWS);
+		if (err) {
+			LOG_WRN("Failed to give the time to GNSS, error: %d", err);
+		} else {
+			assisted |= GNSS_ASSIST_TIME;
+		}
+	}
+
+	if (assisted & GNSS_ASSIST_POSITION) {
+		LOG_INF("Position given to GNSS, uncertainty %d m", (int)unc);
+	}
+
+	return assisted;
+}
+
+void gnss_assist_ttff_record(int assisted, uint32_t ttff)
+{
+	struct gnss_assist_ttff *stats = &ttff_stats[assisted & (ARRAY_SIZE(ttff_stats) - 1)];
+
+	k_mutex_lock(&lock, K_FOREVER);
+	stats->min = stats->count == 0 ? ttff : MIN(stats->min, ttff);
+	stats->max = MAX(stats->max, ttff);
+	stats->count++;
+	stats->total += ttff;
+	k_mutex_unlock(&lock);
+
+	LOG_INF("Time to fix %u ms, position %s, time %s, average %u ms over %u searches",
+		ttff, assisted & GNSS_ASSIST_POSITION ? "given" : "not given",
+		assisted & GNSS_ASSIST_TIME ? "given" : "not given",
+		stats->total / stats->count, stats->count);
+}
+
+void gnss_assist_ttff_get(int assisted, struct gnss_assist_ttff *ttff)
+{
+	k_mutex_lock(&lock, K_FOREVER);
+	*ttff = ttff_stats[assisted & (ARRAY_SIZE(ttff_stats) - 1)];
+	k_mutex_unlock(&lock);
+}
+
+#if defined(CONFIG_SHELL)
+static const char *const assisted_names[] = {
+	"none",
+	"position",
+	"time",
+	"position and time",
+};
+
+static int cmd_report(const struct shell *sh, size_t argc, char **argv)
+{
+	int64_t now;
+
+	shell_print(sh, "assistance: searches, average, min, max ms");
+
+	for (size_t i = 0; i < ARRAY_SIZE(ttff_stats); i++) {
+		struct gnss_assist_ttff stats;
+
+		gnss_assist_ttff_get(i, &stats);
+		shell_print(sh, "%s: %u, %u, %u, %u", assisted_names[i], stats.count,
+			    stats.count ? stats.total / stats.count : 0, stats.min, stats.max);
+	}
+
+	k_mutex_lock(&lock, K_FOREVER);
+
+	if (last.time == 0) {
+		shell_print(sh, "No last known position");
+	} else if (date_time_now(&now) == 0) {
+		shell_print(sh, "Last known position %.06f, %.06f, %lld s old, uncertainty %d m",
+			    last.latitude, last.longitude, (now - last.time) / MSEC_PER_SEC,
+			    (int)uncertainty(&last, now));
+	}
+
+	k_mutex_unlock(&lock);
+
+	return 0;
+}
+
+static int cmd_forget(const struct shell *sh, size_t argc, char **argv)
+{
+	k_mutex_lock(&lock, K_FOREVER);
+	memset(&last, 0, sizeof(last));
+	memset(&saved, 0, sizeof(saved));
+	(void)storage_delete(STORAGE_ID_LAST_FIX);
+	k_mutex_unlock(&lock);
+
+	shell_print(sh, "Last known position forgotten");
+
+	return 0;
+}
+
+static int cmd_reset(const struct shell *sh, size_t argc, char **argv)
+{
+	k_mutex_lock(&lock, K_FOREVER);
+	memset(ttff_stats, 0, sizeof(ttff_stats));
+	k_mutex_unlock(&lock);
+
+	shell_print(sh, "Time to fix statistics cleared");
+
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_gnss_assist,
+	SHELL_CMD(report, NULL, "Print the time to fix per assistance", cmd_report),
+	SHELL_CMD(forget, NULL, "Forget the last known position", cmd_forget),
+	SHELL_CMD(reset, NULL, "Clear the time to fix statistics", cmd_reset),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(gnss_assist, &sub_gnss_assist, "GNSS self-assistance", NULL);
+#endif /* CONFIG_SHELL */
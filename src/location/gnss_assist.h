@@ -0,0 +1,121 @@
+#ifndef _GNSS_ASSIST_H_
+#define _GNSS_ASSIST_H_
+
+/**
+ * @brief GNSS self-assistance
+ * @defgroup gnss_assist Last known position and time given to GNSS
+ * @{
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <nrf_modem_gnss.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** The position was given to GNSS. */
+#define GNSS_ASSIST_POSITION 0x01
+/** The time was given to GNSS. */
+#define GNSS_ASSIST_TIME 0x02
+
+/** @brief A fix of any location method. */
+struct gnss_assist_fix {
+	/** Latitude in degrees. */
+	double latitude;
+	/** Longitude in degrees. */
+	double longitude;
+	/** Horizontal accuracy in meters. */
+	float accuracy;
+	/** Altitude in meters. */
+	float altitude;
+	/** Vertical accuracy in meters, 0 if the altitude is not known. */
+	float altitude_accuracy;
+	/** UNIX time of the fix in milliseconds. */
+	int64_t time;
+};
+
+/** @brief Time to fix of the GNSS searches with the same assistance. */
+struct gnss_assist_ttff {
+	/** Number of fixes. */
+	uint32_t count;
+	/** Sum of the times to fix in milliseconds. */
+	uint32_t total;
+	/** Shortest time to fix in milliseconds. */
+	uint32_t min;
+	/** Longest time to fix in milliseconds. */
+	uint32_t max;
+};
+
+/** @brief Restore the last known position from the flash.
+ *
+ * @return 0 on success, or a negative error code.
+ */
+int gnss_assist_init(void);
+
+/** @brief Keep a fix as the last known position if it is more accurate
+ *	   than the one kept, after the uncertainty of that one has grown
+ *	   with its age. Cell based fixes are kept too, they are the coarse
+ *	   position before the first GNSS fix.
+ *
+ * @param fix Fix.
+ * @param gnss True if the fix is from GNSS.
+ */
+void gnss_assist_fix_update(const struct gnss_assist_fix *fix, bool gnss);
+
+/** @brief Give the last known position and the time to GNSS before a
+ *	   search. Nothing is given that GNSS knows better from a fix of its
+ *	   own since the boot.
+ *
+ * @return GNSS_ASSIST_POSITION and GNSS_ASSIST_TIME for what was given, or
+ *	   a negative error code.
+ */
+int gnss_assist_inject(void);
+
+/** @brief Record the time to fix of a GNSS search.
+ *
+ * @param assisted What was given to GNSS before the search.
+ * @param ttff Time to fix in milliseconds.
+ */
+void gnss_assist_ttff_record(int assisted, uint32_t ttff);
+
+/** @brief Get the time to fix statistics.
+ *
+ * @param assisted What was given to GNSS before the searches.
+ * @param ttff The statistics are written here.
+ */
+void gnss_assist_ttff_get(int assisted, struct gnss_assist_ttff *ttff);
+
+/** @brief Encode a position as A-GNSS location assistance. The uncertainty
+ *	   is the accuracy of the fix grown with its age at
+ *	   CONFIG_GNSS_ASSIST_SPEED.
+ *
+ * @param fix Position.
+ * @param now UNIX time in milliseconds.
+ * @param location The assistance data is written here.
+ *
+ * @return true if the uncertainty is within CONFIG_GNSS_ASSIST_MAX_UNCERTAINTY.
+ */
+bool gnss_assist_location_encode(const struct gnss_assist_fix *fix, int64_t now,
+				 struct nrf_modem_gnss_agnss_data_location *location);
+
+/** @brief Encode a UTC time as A-GNSS GPS system time, without the time of
+ *	   week of the satellites.
+ *
+ * @param now UNIX time in milliseconds.
+ * @param time The assistance data is written here.
+ */
+void gnss_assist_time_encode(int64_t now,
+			     struct nrf_modem_gnss_agnss_gps_data_system_time_and_sv_tow *time);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* _GNSS_ASSIST_H_ */
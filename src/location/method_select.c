@@ -0,0 +1,307 @@
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#if defined(CONFIG_SHELL)
+#include <zephyr/shell/shell.h>
+#endif
+
+#include "location/method_select.h"
+
+/* The statistics are kept per signal strength and per age of the last GNSS
+ * fix. Below a few hours the ephemeris are still valid and GNSS gets a fix
+ * quickly, after a day it starts from the almanac or from nothing.
+ */
+enum rsrp_bucket {
+	RSRP_UNKNOWN,
+	RSRP_GOOD,
+	RSRP_FAIR,
+	RSRP_POOR,
+	RSRP_BUCKETS
+};
+
+enum age_bucket {
+	AGE_HOT,
+	AGE_WARM,
+	AGE_COLD,
+	AGE_BUCKETS
+};
+
+#define RSRP_GOOD_MIN -95
+#define RSRP_FAIR_MIN -110
+#define AGE_HOT_MAX (4 * 3600)
+#define AGE_WARM_MAX (24 * 3600)
+
+static const enum location_method methods[METHOD_SELECT_METHODS] = {
+	LOCATION_METHOD_GNSS,
+	LOCATION_METHOD_CELLULAR,
+};
+
+static struct method_select_stats stats[RSRP_BUCKETS][AGE_BUCKETS][METHOD_SELECT_METHODS];
+static struct k_spinlock lock;
+static uint32_t decisions;
+
+static enum rsrp_bucket rsrp_bucket_of(int16_t rsrp)
+{
+	if (rsrp == INT16_MIN) {
+		return RSRP_UNKNOWN;
+	} else if (rsrp >= RSRP_GOOD_MIN) {
+		return RSRP_GOOD;
+	} else if (rsrp >= RSRP_FAIR_MIN) {
+		return RSRP_FAIR;
+	}
+
+	return RSRP_POOR;
+}
+
+static enum age_bucket age_bucket_of(int32_t age)
+{
+	if (age < 0 || age >= AGE_WARM_MAX) {
+		return AGE_COLD;
+	} else if (age >= AGE_HOT_MAX) {
+		return AGE_WARM;
+	}
+
+	return AGE_HOT;
+}
+
+static struct method_select_stats *stats_of(const struct method_select_context *ctx,
+					    enum location_method method)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(methods); i++) {
+		if (methods[i] == method) {
+			return &stats[rsrp_bucket_of(ctx->rsrp)][age_bucket_of(ctx->gnss_age)][i];
+		}
+	}
+
+	return NULL;
+}
+
+/**@brief Move an average towards a new value. The first value sets it. */
+static void average(float *avg, float value, bool first)
+{
+	if (first) {
+		*avg = value;
+	} else {
+		*avg += (value - *avg) / CONFIG_LOCATION_METHOD_SELECT_WINDOW;
+	}
+}
+
+/**@brief Expected charge of one attempt, in mAs. */
+static float attempt_charge(const struct method_select_stats *method, float current,
+			    float fail_time)
+{
+	return current * (method->success * method->fix_time +
+			  (1.0f - method->success) * fail_time);
+}
+
+/**@brief Expected charge per accurate fix of trying first, and second if the
+ *	  first gives no fix. The Location library stops at the first fix,
+ *	  accurate or not.
+ */
+static float order_cost(const struct method_select_stats *first, float first_charge,
+			const struct method_select_stats *second, float second_charge,
+			float *charge)
+{
+	float accurate = first->success * first->accurate +
+			 (1.0f - first->success) * second->success * second->accurate;
+
+	*charge = first_charge + (1.0f - first->success) * second_charge;
+
+	return accurate > 0.01f ? *charge / accurate : FLT_MAX;
+}
+
+void method_select_choose(const struct method_select_context *ctx, int gnss_budget,
+			  struct method_select_decision *decision)
+{
+	struct method_select_stats gnss;
+	struct method_select_stats cellular;
+	float gnss_charge, cellular_charge;
+	float gnss_first, cellular_first;
+	float gnss_first_charge, cellular_first_charge;
+	float timeout;
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	gnss = *stats_of(ctx, LOCATION_METHOD_GNSS);
+	cellular = *stats_of(ctx, LOCATION_METHOD_CELLULAR);
+	decisions++;
+	k_spin_unlock(&lock, key);
+
+	decision->order[0] = LOCATION_METHOD_GNSS;
+	decision->order[1] = LOCATION_METHOD_CELLULAR;
+	decision->gnss_timeout = gnss_budget;
+	decision->charge = 0.0f;
+	decision->explore = false;
+
+	if (gnss.attempts < CONFIG_LOCATION_METHOD_SELECT_MIN_ATTEMPTS ||
+	    cellular.attempts < CONFIG_LOCATION_METHOD_SELECT_MIN_ATTEMPTS) {
+		return;
+	}
+
+	/* Long enough for nearly all the fixes seen in this context, a longer
+	 * search is unlikely to end with a fix.
+	 */
+	if (gnss.fixes > 0) {
+		timeout = (gnss.fix_time + 4.0f * gnss.fix_time_dev) * MSEC_PER_SEC;
+		timeout = CLAMP(timeout, CONFIG_LOCATION_METHOD_SELECT_GNSS_TIMEOUT_MIN *
+				MSEC_PER_SEC, (float)gnss_budget);
+		decision->gnss_timeout = MIN((int)timeout, gnss_budget);
+	}
+
+	gnss_charge = attempt_charge(&gnss, CONFIG_LOCATION_METHOD_SELECT_GNSS_CURRENT,
+				     (float)decision->gnss_timeout / MSEC_PER_SEC);
+	cellular_charge = attempt_charge(&cellular,
+					 CONFIG_LOCATION_METHOD_SELECT_CELLULAR_CURRENT,
+					 cellular.fail_time);
+
+	gnss_first = order_cost(&gnss, gnss_charge, &cellular, cellular_charge,
+				&gnss_first_charge);
+	cellular_first = order_cost(&cellular, cellular_charge, &gnss, gnss_charge,
+				    &cellular_first_charge);
+
+	if (gnss_first == FLT_MAX && cellular_first == FLT_MAX) {
+		return;
+	}
+
+	if (cellular_first < gnss_first) {
+		decision->order[0] = LOCATION_METHOD_CELLULAR;
+		decision->order[1] = LOCATION_METHOD_GNSS;
+		decision->charge = cellular_first_charge;
+	} else {
+		decision->charge = gnss_first_charge;
+	}
+
+	/* Now and then the other order, so that the statistics of the method
+	 * that is tried second do not go stale.
+	 */
+	if (CONFIG_LOCATION_METHOD_SELECT_EXPLORE > 0 &&
+	    decisions % CONFIG_LOCATION_METHOD_SELECT_EXPLORE == 0) {
+		enum location_method first = decision->order[0];
+
+		decision->order[0] = decision->order[1];
+		decision->order[1] = first;
+		decision->charge = first == LOCATION_METHOD_GNSS ? cellular_first_charge :
+								     gnss_first_charge;
+		decision->explore = true;
+	}
+}
+
+void method_select_record(const struct method_select_context *ctx,
+			  enum location_method method, bool fix, int64_t time,
+			  float accuracy)
+{
+	struct method_select_stats *method_stats = stats_of(ctx, method);
+	float seconds = (float)time / MSEC_PER_SEC;
+	k_spinlock_key_t key;
+
+	if (method_stats == NULL) {
+		return;
+	}
+
+	key = k_spin_lock(&lock);
+
+	average(&method_stats->success, fix ? 1.0f : 0.0f, method_stats->attempts == 0);
+
+	if (fix) {
+		bool first = method_stats->fixes == 0;
+
+		average(&method_stats->fix_time_dev,
+			first ? 0.0f : fabsf(seconds - method_stats->fix_time), first);
+		average(&method_stats->fix_time, seconds, first);
+		average(&method_stats->accuracy, accuracy, first);
+		average(&method_stats->accurate,
+			accuracy <= CONFIG_LOCATION_METHOD_SELECT_ACCURACY ? 1.0f : 0.0f, first);
+		method_stats->fixes++;
+	} else {
+		average(&method_stats->fail_time, seconds,
+			method_stats->attempts == method_stats->fixes);
+	}
+
+	method_stats->attempts++;
+
+	k_spin_unlock(&lock, key);
+}
+
+void method_select_stats_get(const struct method_select_context *ctx,
+			     enum location_method method,
+			     struct method_select_stats *out)
+{
+	struct method_select_stats *method_stats = stats_of(ctx, method);
+	k_spinlock_key_t key;
+
+	if (method_stats == NULL) {
+		memset(out, 0, sizeof(*out));
+		return;
+	}
+
+	key = k_spin_lock(&lock);
+	*out = *method_stats;
+	k_spin_unlock(&lock, key);
+}
+
+#if defined(CONFIG_SHELL)
+static const char *const rsrp_names[] = {
+	[RSRP_UNKNOWN] = "unknown",
+	[RSRP_GOOD] = "good",
+	[RSRP_FAIR] = "fair",
+	[RSRP_POOR] = "poor",
+};
+
+static const char *const age_names[] = {
+	[AGE_HOT] = "hot",
+	[AGE_WARM] = "warm",
+	[AGE_COLD] = "cold",
+};
+
+static int cmd_stats(const struct shell *sh, size_t argc, char **argv)
+{
+	shell_print(sh, "rsrp/age method: attempts fixes, success %%, accurate %%, "
+		    "fix time s (dev), fail time s, accuracy m");
+
+	for (size_t r = 0; r < RSRP_BUCKETS; r++) {
+		for (size_t a = 0; a < AGE_BUCKETS; a++) {
+			for (size_t m = 0; m < ARRAY_SIZE(methods); m++) {
+				struct method_select_stats s;
+				k_spinlock_key_t key = k_spin_lock(&lock);
+
+				s = stats[r][a][m];
+				k_spin_unlock(&lock, key);
+
+				if (s.attempts == 0) {
+					continue;
+				}
+
+				shell_print(sh, "%s/%s %s: %u %u, %d, %d, %.1f (%.1f), %.1f, %.0f",
+					    rsrp_names[r], age_names[a],
+					    location_method_str(methods[m]), s.attempts, s.fixes,
+					    (int)(s.success * 100.0f), (int)(s.accurate * 100.0f),
+					    (double)s.fix_time, (double)s.fix_time_dev,
+					    (double)s.fail_time, (double)s.accuracy);
+			}
+		}
+	}
+
+	return 0;
+}
+
+static int cmd_reset(const struct shell *sh, size_t argc, char **argv)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	memset(stats, 0, sizeof(stats));
+	k_spin_unlock(&lock, key);
+
+	shell_print(sh, "Location method statistics cleared");
+
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_methods,
+	SHELL_CMD(stats, NULL, "Print the location method statistics", cmd_stats),
+	SHELL_CMD(reset, NULL, "Clear the location method statistics", cmd_reset),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(methods, &sub_methods, "Location method selection", NULL);
+#endif /* CONFIG_SHELL */
@@ -0,0 +1,109 @@
+#ifndef _METHOD_SELECT_H_
+#define _METHOD_SELECT_H_
+
+/**
+ * @brief Location method selection
+ * @defgroup method_select Choice of the location method order from the
+ *			   outcome of earlier requests
+ * @{
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <modem/location.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Methods the order is chosen between. */
+#define METHOD_SELECT_METHODS 2
+
+/** @brief Conditions of a location request. The statistics are kept
+ *	   separately for each combination of the signal strength and the
+ *	   age of the last GNSS fix, which decide the ephemeris that are
+ *	   still valid.
+ */
+struct method_select_context {
+	/** RSRP of the serving cell in dBm, or INT16_MIN if not known. */
+	int16_t rsrp;
+	/** Seconds since the last GNSS fix, or -1 if there was none. */
+	int32_t gnss_age;
+};
+
+/** @brief Statistics of one method in one context. */
+struct method_select_stats {
+	/** Number of attempts. */
+	uint32_t attempts;
+	/** Number of attempts that gave a fix. */
+	uint32_t fixes;
+	/** Moving average of the attempts that gave a fix, 0 to 1. */
+	float success;
+	/** Moving average of the fixes within the accuracy target, 0 to 1. */
+	float accurate;
+	/** Moving average of the time to fix in seconds. */
+	float fix_time;
+	/** Moving average of the deviation of the time to fix in seconds. */
+	float fix_time_dev;
+	/** Moving average of the time spent on failed attempts in seconds. */
+	float fail_time;
+	/** Moving average of the accuracy of the fixes in meters. */
+	float accuracy;
+};
+
+/** @brief Method order and GNSS timeout of a request. */
+struct method_select_decision {
+	/** Methods in the order they are tried. */
+	enum location_method order[METHOD_SELECT_METHODS];
+	/** GNSS timeout in milliseconds. */
+	int gnss_timeout;
+	/** Expected charge of the request in mAs, 0 if not known. */
+	float charge;
+	/** True if the order is an exploration of the worse order. */
+	bool explore;
+};
+
+/** @brief Choose the method order and the GNSS timeout that give an
+ *	   accurate fix for the least expected charge. Without enough
+ *	   statistics for the context, GNSS is tried first with the whole
+ *	   GNSS budget.
+ *
+ * @param ctx Conditions of the request.
+ * @param gnss_budget Longest GNSS timeout allowed, in milliseconds.
+ * @param decision The decision is written here.
+ */
+void method_select_choose(const struct method_select_context *ctx, int gnss_budget,
+			  struct method_select_decision *decision);
+
+/** @brief Record the outcome of an attempt of one method.
+ *
+ * @param ctx Conditions of the request, as given to method_select_choose().
+ * @param method Method attempted.
+ * @param fix True if the method gave a fix.
+ * @param time Time the attempt took, in milliseconds.
+ * @param accuracy Accuracy of the fix in meters, ignored without a fix.
+ */
+void method_select_record(const struct method_select_context *ctx,
+			  enum location_method method, bool fix, int64_t time,
+			  float accuracy);
+
+/** @brief Get the statistics of a method in a context.
+ *
+ * @param ctx Conditions of the requests.
+ * @param method Method.
+ * @param stats The statistics are written here.
+ */
+void method_select_stats_get(const struct method_select_context *ctx,
+			     enum location_method method,
+			     struct method_select_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* _METHOD_SELECT_H_ */
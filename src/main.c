@@ -25,6 +25,9 @@
 #include "events/cloud_module_event.h"
 #include "events/modem_module_event.h"
 #include "events/location_module_event.h"
+#include "events/event_latency.h"
+#include "events/event_pool.h"
+#include "events/module_queue.h"
 
 /* Application module super states. */
 static enum state_type {
@@ -53,23 +56,67 @@ static struct app_cfg current_cfg = {
 	.active_mode = true,
 	.location_timeout = 300,
 	.active_wait_timeout = 120,
-	.passive_wait_timeout = 3600
+	.passive_wait_timeout = 3600,
+	.batch_size = CONFIG_CLOUD_BATCH_SIZE,
+	.deadband_distance = CONFIG_CLOUD_DEADBAND_DISTANCE,
+	.deadband_accuracy = CONFIG_CLOUD_DEADBAND_ACCURACY,
+	.heartbeat_interval = CONFIG_CLOUD_HEARTBEAT_INTERVAL
 };
 
 struct app_msg_data {
 	union {
-		struct app_module_event app;
-		struct cloud_module_event cloud;
-		struct modem_module_event modem;
-		struct location_module_event location;
+		const struct app_event_header *header;
+		const struct app_module_event *app;
+		const struct cloud_module_event *cloud;
+		const struct modem_module_event *modem;
+		const struct location_module_event *location;
 	} module;
 };
 
+/* Events handled by this module, by state, see modules_common.h. */
+#define MODULE_SOURCES(X) X(app) X(cloud)
+
+#define STATE_INIT_HANDLERS(X)								\
+	X(app, APP_EVENT_START, on_init_start)
+
+#define STATE_RUNNING_HANDLERS(X)							\
+	X(cloud, CLOUD_EVENT_SERVER_CONNECTED, on_running_server_connected)
+
+#define SUB_STATE_ACTIVE_HANDLERS(X)							\
+	X(app, APP_EVENT_CONFIG_UPDATE, on_active_config_update)
+
+#define SUB_STATE_PASSIVE_HANDLERS(X)							\
+	X(app, APP_EVENT_CONFIG_UPDATE, on_passive_config_update)
+
+#define ALL_STATES_HANDLERS(X)								\
+	X(cloud, CLOUD_EVENT_CLOUD_CONFIG_RECEIVED, on_config_received)
+
+#define MODULE_HANDLERS(X)								\
+	STATE_INIT_HANDLERS(X) STATE_RUNNING_HANDLERS(X) SUB_STATE_ACTIVE_HANDLERS(X)	\
+	SUB_STATE_PASSIVE_HANDLERS(X) ALL_STATES_HANDLERS(X)
+
+MODULE_DISPATCH_DEFINE(struct app_msg_data, MODULE_SOURCES)
+MODULE_EVENT_FILTER_DEFINE(MODULE_HANDLERS)
+
 static void data_sample_timer_handler(struct k_timer *timer_id);
 
+/* Config changes are coalesced, only the newest one matters. */
+static enum module_queue_policy queue_policy(const struct app_event_header *aeh)
+{
+	struct app_msg_data data = { .module.header = aeh };
+	struct app_msg_data *msg = &data;
+
+	if (IS_EVENT(msg, app, APP_EVENT_CONFIG_UPDATE) ||
+	    IS_EVENT(msg, cloud, CLOUD_EVENT_CLOUD_CONFIG_RECEIVED)) {
+		return MODULE_QUEUE_COALESCE;
+	}
+
+	return MODULE_QUEUE_SPILL;
+}
+
 #define MSG_Q_SIZE 20
 
-K_MSGQ_DEFINE(msgq_app, sizeof(struct app_msg_data), MSG_Q_SIZE, 4);
+MODULE_QUEUE_DEFINE(msgq_app, MSG_Q_SIZE, queue_policy);
 
 LOG_MODULE_REGISTER(MODULE, LOG_LEVEL_DBG);
 
@@ -141,42 +188,11 @@ static void set_active_mode_timer(void)
 }
 
 static bool app_event_handler(const struct app_event_header *aeh){
-	bool consume = false, enqueue_msg = false;
-	struct app_msg_data msg = {0};
-	if (is_app_module_event(aeh)){
-		struct app_module_event *event = cast_app_module_event(aeh);
-		msg.module.app = *event;
-		enqueue_msg = true;
-	}
-	
-	if (is_cloud_module_event(aeh)){
-		struct cloud_module_event *event = cast_cloud_module_event(aeh);
-		msg.module.cloud = *event;
-		enqueue_msg = true;
-	}
-	
-	if (is_modem_module_event(aeh)){
-		struct modem_module_event *event = cast_modem_module_event(aeh);
-		msg.module.modem = *event;
-		enqueue_msg = true;
-	}
-	
-	if (is_location_module_event(aeh)){
-		struct location_module_event *event = cast_location_module_event(aeh);
-		msg.module.location = *event;
-		enqueue_msg = true;
-	}
-
-	if (enqueue_msg){
-		 /* Add the event to the message queue */
-        int err = k_msgq_put(&msgq_app, &msg, K_NO_WAIT);
-        if (err) {
-            LOG_ERR("Failed to add event to message queue: %d", err);
-            /* Handle the error */
-        }
+	if (module_event_accept(aeh) && module_queue_put(&msgq_app, aeh)) {
+		LOG_ERR("Event queue full, event dropped");
 	}
 
-	return consume;
+	return false;
 }
 
 static void data_sample_timer_handler(struct k_timer *timer_id)
@@ -192,6 +208,10 @@ static void data_sample_timer_handler(struct k_timer *timer_id)
 	}
 }
 
+/**@brief Apply a config received from the cloud. Fields missing from the
+ *	  received config hold their current value, so only the fields the
+ *	  cloud sent can be out of range.
+ */
 static void handle_new_config(struct app_cfg *new_cfg){
 	bool config_change = false;
 	if (current_cfg.active_mode != new_cfg->active_mode){
@@ -234,6 +254,51 @@ static void handle_new_config(struct app_cfg *new_cfg){
 		LOG_WRN("New passive wait timeout out of range: %d", new_cfg->passive_wait_timeout);
 	}
 
+	if ((new_cfg->batch_size > 0) && (new_cfg->batch_size <= CONFIG_FIX_QUEUE_DRAIN_BATCH)){
+		if (current_cfg.batch_size != new_cfg->batch_size){
+			current_cfg.batch_size = new_cfg->batch_size;
+			LOG_DBG("New batch size: %d", current_cfg.batch_size);
+			config_change = true;
+		}
+	} else {
+		LOG_WRN("New batch size out of range: %d", new_cfg->batch_size);
+	}
+
+	/* A dead-band distance of 0 disables the dead-band. */
+	if (new_cfg->deadband_distance >= 0){
+		if (current_cfg.deadband_distance != new_cfg->deadband_distance){
+			current_cfg.deadband_distance = new_cfg->deadband_distance;
+			if (current_cfg.deadband_distance == 0){
+				LOG_DBG("Dead-band disabled");
+			} else {
+				LOG_DBG("New dead-band distance: %d", current_cfg.deadband_distance);
+			}
+			config_change = true;
+		}
+	} else {
+		LOG_WRN("New dead-band distance out of range: %d", new_cfg->deadband_distance);
+	}
+
+	if (new_cfg->deadband_accuracy > 0){
+		if (current_cfg.deadband_accuracy != new_cfg->deadband_accuracy){
+			current_cfg.deadband_accuracy = new_cfg->deadband_accuracy;
+			LOG_DBG("New dead-band accuracy: %d", current_cfg.deadband_accuracy);
+			config_change = true;
+		}
+	} else {
+		LOG_WRN("New dead-band accuracy out of range: %d", new_cfg->deadband_accuracy);
+	}
+
+	if (new_cfg->heartbeat_interval > 0){
+		if (current_cfg.heartbeat_interval != new_cfg->heartbeat_interval){
+			current_cfg.heartbeat_interval = new_cfg->heartbeat_interval;
+			LOG_DBG("New heartbeat interval: %d", current_cfg.heartbeat_interval);
+			config_change = true;
+		}
+	} else {
+		LOG_WRN("New heartbeat interval out of range: %d", new_cfg->heartbeat_interval);
+	}
+
 	if (config_change){
 		//TODO Save config to flash
 
@@ -246,7 +311,7 @@ static void handle_new_config(struct app_cfg *new_cfg){
 	}
 }
 
-static void on_state_init(struct app_msg_data *msg)
+static void on_init_start(struct app_msg_data *msg)
 {
 	set_state(STATE_RUNNING);
 	if (current_cfg.active_mode) {
@@ -258,12 +323,12 @@ static void on_state_init(struct app_msg_data *msg)
 	}
 }
 
-static void on_state_running(struct app_msg_data *msg)
-{	
+static void on_running_server_connected(struct app_msg_data *msg)
+{
 	// flag used to trigger data request, when connected to the cloud for the first time
 	static bool initial_data_request;
 
-	if (IS_EVENT(msg, cloud, CLOUD_EVENT_SERVER_CONNECTED) && !initial_data_request){
+	if (!initial_data_request){
 		struct app_module_event *app_module_event = new_app_module_event();
 		app_module_event->type = APP_EVENT_LOCATION_GET;
 		APP_EVENT_SUBMIT(app_module_event);
@@ -272,43 +337,86 @@ static void on_state_running(struct app_msg_data *msg)
 	}
 }
 
-static void on_sub_state_active(struct app_msg_data *msg)
+static void on_active_config_update(struct app_msg_data *msg)
 {
-	if (IS_EVENT(msg, app, APP_EVENT_CONFIG_UPDATE)){
-		if (current_cfg.active_mode){
-			set_active_mode_timer();
-			return;
-		}
-		set_passive_mode_timer();
-		set_sub_state(SUB_STATE_PASSIVE_MODE);
+	if (current_cfg.active_mode){
+		set_active_mode_timer();
+		return;
 	}
+	set_passive_mode_timer();
+	set_sub_state(SUB_STATE_PASSIVE_MODE);
 }
 
-static void on_sub_state_passive(struct app_msg_data *msg)
+static void on_passive_config_update(struct app_msg_data *msg)
 {
-	if (IS_EVENT(msg, app, APP_EVENT_CONFIG_UPDATE)){
-		if (current_cfg.active_mode){
-			set_active_mode_timer();
-			set_sub_state(SUB_STATE_ACTIVE_MODE);
-			return;
+	if (current_cfg.active_mode){
+		set_active_mode_timer();
+		set_sub_state(SUB_STATE_ACTIVE_MODE);
+		return;
+	}
+	set_passive_mode_timer();
+}
+
+static void on_config_received(struct app_msg_data *msg)
+{
+	struct app_cfg new_cfg = msg->module.cloud->cloud_cfg;
+
+	handle_new_config(&new_cfg);
+}
+
+MODULE_HANDLERS_DEFINE(state_init_handlers, STATE_INIT_HANDLERS);
+MODULE_HANDLERS_DEFINE(state_running_handlers, STATE_RUNNING_HANDLERS);
+MODULE_HANDLERS_DEFINE(sub_state_active_handlers, SUB_STATE_ACTIVE_HANDLERS);
+MODULE_HANDLERS_DEFINE(sub_state_passive_handlers, SUB_STATE_PASSIVE_HANDLERS);
+MODULE_HANDLERS_DEFINE(all_states_handlers, ALL_STATES_HANDLERS);
+
+static void message_handler(struct app_msg_data *msg)
+{
+	event_latency_record(EVENT_LATENCY_MAIN, msg->module.header);
+
+	switch (state)
+	{
+	case STATE_INIT:
+		MODULE_DISPATCH(state_init_handlers, msg);
+		break;
+	case STATE_RUNNING:
+		switch (sub_state)
+		{
+		case SUB_STATE_ACTIVE_MODE:
+			MODULE_DISPATCH(sub_state_active_handlers, msg);
+			break;
+		case SUB_STATE_PASSIVE_MODE:
+			MODULE_DISPATCH(sub_state_passive_handlers, msg);
+			break;
+		default:
+			break;
 		}
-		set_passive_mode_timer();
+		MODULE_DISPATCH(state_running_handlers, msg);
+		break;
+	case STATE_SHUTDOWN:
+		break;
+
+	default:
+		LOG_ERR("Unknown state");
+		break;
 	}
+	MODULE_DISPATCH(all_states_handlers, msg);
+	event_pool_unref(msg->module.header);
 }
 
-static void on_all_states(struct app_msg_data *msg)
+#if defined(CONFIG_MODULE_WORK_QUEUE)
+static void main_work_fn(struct k_work *work)
 {
-	if (IS_EVENT(msg, cloud, CLOUD_EVENT_CLOUD_CONFIG_RECEIVED)){
-		struct app_cfg new_cfg = msg->module.cloud.cloud_cfg;
-		handle_new_config(&new_cfg);
+	struct app_msg_data msg = {0};
+
+	while (module_queue_get(&msgq_app, &msg.module.header, K_NO_WAIT) == 0) {
+		message_handler(&msg);
 	}
 }
+#endif
 
 int main(void)
 {	
-	int err;
-	struct app_msg_data msg = {0};
-
 	k_sleep(K_SECONDS(3));
 
 	LOG_INF("Application started");
@@ -326,49 +434,27 @@ int main(void)
 		APP_EVENT_SUBMIT(app_module_event);
 	}
 
+#if defined(CONFIG_MODULE_WORK_QUEUE)
+	/* The main thread is done, main runs on the module work queue. */
+	module_queue_run(&msgq_app, main_work_fn, K_NO_WAIT);
+#else
+	int err;
+	struct app_msg_data msg = {0};
+
 	while (1)
 	{	
-        err = k_msgq_get(&msgq_app, &msg, K_FOREVER);
+        err = module_queue_get(&msgq_app, &msg.module.header, K_FOREVER);
 		if (err) {
             LOG_ERR("Failed to get event from message queue: %d", err);
             /* Handle the error */
         } else {
-
-			switch (state)
-			{
-			case STATE_INIT:
-				on_state_init(&msg);
-				break;
-			case STATE_RUNNING:
-				switch (sub_state)
-				{
-				case SUB_STATE_ACTIVE_MODE:
-					on_sub_state_active(&msg);
-					break;
-				case SUB_STATE_PASSIVE_MODE:
-					on_sub_state_passive(&msg);
-					break;
-				default:
-					break;
-				}
-				on_state_running(&msg);
-				break;
-			case STATE_SHUTDOWN:
-				break;
-			
-			default:
-				LOG_ERR("Unknown state");
-				break;
-			}
-			on_all_states(&msg);
+			message_handler(&msg);
 		}
 	}
+#endif
 
 	return 0;
 }
 
 APP_EVENT_LISTENER(MODULE, app_event_handler);
-APP_EVENT_SUBSCRIBE(MODULE, app_module_event);
-APP_EVENT_SUBSCRIBE(MODULE, modem_module_event);
-APP_EVENT_SUBSCRIBE(MODULE, cloud_module_event);
-APP_EVENT_SUBSCRIBE(MODULE, location_module_event);
\ No newline at end of file
+MODULE_SOURCES(MODULE_EVENT_SUBSCRIBE)
@@ -1,9 +1,14 @@
+#include <stdarg.h>
 #include <stdio.h>
 #include <time.h>
+#if defined(CONFIG_NEWLIB_LIBC)
+#include <malloc.h>
+#endif
 
 #include <zephyr/kernel.h>
+#include <zephyr/init.h>
 #include <zephyr/net/socket.h>
-#include <zephyr/random/rand32.h>
+#include <zephyr/net/tls_credentials.h>
 #include <app_event_manager.h>
 
 #include <zephyr/logging/log.h>
@@ -16,6 +21,21 @@
 #include <zephyr/net/coap.h>
 
 #include "codec.h"
+#include "cloud/fix_queue.h"
+#include "cloud/cloud_codec.h"
+#include "cloud/coap_transaction.h"
+#include "cloud/blockwise.h"
+#include "cloud/config_cache.h"
+#include "cloud/oscore.h"
+#include "cloud/track_simplify.h"
+#include "cloud/deadband.h"
+#if defined(CONFIG_CLOUD_AGNSS)
+#include <modem/location.h>
+#include "cloud/assistance.h"
+#endif
+#if defined(CONFIG_AGNSS_CACHE)
+#include "location/agnss_cache.h"
+#endif
 
 #include <cJSON.h>
 #include <date_time.h>
@@ -25,6 +45,9 @@
 #include "events/cloud_module_event.h"
 #include "events/modem_module_event.h"
 #include "events/location_module_event.h"
+#include "events/event_latency.h"
+#include "events/event_pool.h"
+#include "events/module_queue.h"
 
 #define MODULE cloud_module
 
@@ -44,60 +67,199 @@ static enum sub_state_type {
 
 struct cloud_msg_data {
 	union {
-		struct app_module_event app;
-		struct cloud_module_event cloud;
-		struct modem_module_event modem;
-		struct location_module_event location;
+		const struct app_event_header *header;
+		const struct app_module_event *app;
+		const struct cloud_module_event *cloud;
+		const struct modem_module_event *modem;
+		const struct location_module_event *location;
 	} module;
 };
 
-struct cloud_pvt {
-	/** Longitude in degrees. */
-	double longitude;
-
-	/** Latitude in degrees. */
-	double latitude;
-
-	/** Altitude above WGS-84 ellipsoid in meters. */
-	float altitude;
-
-	/** Position accuracy (2D 1-sigma) in meters. */
-	float accuracy;
+/* Events handled by this module, by state, see modules_common.h. */
+#define MODULE_SOURCES(X) X(app) X(modem) X(cloud) X(location)
+
+#define STATE_LTE_INIT_HANDLERS(X)							\
+	X(app, APP_EVENT_START, on_lte_init_start)
+
+#define STATE_LTE_DISCONNECTED_HANDLERS(X)						\
+	X(modem, MODEM_EVENT_LTE_CONNECTED, on_lte_disconnected_lte_connected)
+
+#define STATE_LTE_CONNECTED_HANDLERS(X)							\
+	X(modem, MODEM_EVENT_LTE_DISCONNECTED, on_lte_connected_lte_disconnected)
+
+#define SUB_STATE_SERVER_DISCONNECTED_HANDLERS(X)					\
+	X(cloud, CLOUD_EVENT_SERVER_CONNECTED, on_server_disconnected_connected)
+
+#define SUB_STATE_SERVER_CONNECTED_HANDLERS(X)						\
+	X(cloud, CLOUD_EVENT_SERVER_DISCONNECTED, on_server_connected_disconnected)	\
+	X(cloud, CLOUD_EVENT_BUTTON_PRESSED, on_server_connected_button_pressed)
+
+#if defined(CONFIG_CLOUD_AGNSS)
+#define ASSISTANCE_HANDLERS(X)								\
+	X(location, LOCATION_EVENT_AGNSS_REQUEST, on_agnss_request)			\
+	X(location, LOCATION_EVENT_CELLULAR_REQUEST, on_cellular_request)
+#else
+#define ASSISTANCE_HANDLERS(X)
+#endif
+
+/* Fixes are queued in every state, so they are not lost while the server is
+ * not connected.
+ */
+#define ALL_STATES_HANDLERS(X)								\
+	X(app, APP_EVENT_START, on_config_update)					\
+	X(app, APP_EVENT_CONFIG_UPDATE, on_config_update)				\
+	X(location, LOCATION_EVENT_GNSS_DATA_READY, on_gnss_data_ready)			\
+	ASSISTANCE_HANDLERS(X)
+
+#define MODULE_HANDLERS(X)								\
+	STATE_LTE_INIT_HANDLERS(X) STATE_LTE_DISCONNECTED_HANDLERS(X)			\
+	STATE_LTE_CONNECTED_HANDLERS(X) SUB_STATE_SERVER_DISCONNECTED_HANDLERS(X)	\
+	SUB_STATE_SERVER_CONNECTED_HANDLERS(X) ALL_STATES_HANDLERS(X)
+
+MODULE_DISPATCH_DEFINE(struct cloud_msg_data, MODULE_SOURCES)
+MODULE_EVENT_FILTER_DEFINE(MODULE_HANDLERS)
+
+/* Fixes and connection changes must not be lost. Config changes are
+ * coalesced, only the newest one matters.
+ */
+static enum module_queue_policy queue_policy(const struct app_event_header *aeh)
+{
+	struct cloud_msg_data data = { .module.header = aeh };
+	struct cloud_msg_data *msg = &data;
 
-	/** Horizontal speed in m/s. */
-	float speed;
+	if (IS_EVENT(msg, app, APP_EVENT_CONFIG_UPDATE)) {
+		return MODULE_QUEUE_COALESCE;
+	}
 
-	/** Heading of user movement in degrees. */
-	float heading;
-};
+	if (IS_EVENT(msg, cloud, CLOUD_EVENT_BUTTON_PRESSED)) {
+		return MODULE_QUEUE_DROP;
+	}
 
-struct cloud_location_data {
-	/** PVT data*/
-	struct cloud_pvt pvt;
-	/** GNSS data timestamp. UNIX milliseconds. */
-	int64_t gnss_ts;
-};
+	return MODULE_QUEUE_SPILL;
+}
 
 #define MSG_Q_SIZE 20
 
-K_MSGQ_DEFINE(msgq_cloud, sizeof(struct cloud_msg_data), MSG_Q_SIZE, 4);
+MODULE_QUEUE_DEFINE(msgq_cloud, MSG_Q_SIZE, queue_policy);
 
 /* Local copy of the device configuration. */
 static struct app_cfg copy_cfg;
 
 /* Define the macros for the CoAP version and message length */
 #define APP_COAP_VERSION 1
-#define APP_COAP_MAX_MSG_LEN 1280
-
-/* Declare the buffer coap_buf to receive the response. */
-static uint8_t coap_buf[APP_COAP_MAX_MSG_LEN];
-
-/* Define the CoAP message token next_token */
-static uint16_t next_token;
-
-static int sock;
+#define APP_COAP_MAX_MSG_LEN CONFIG_CLOUD_COAP_MAX_MSG_LEN
+
+/* Buffer the receive thread copies received datagrams into. */
+static uint8_t rx_buf[APP_COAP_MAX_MSG_LEN];
+static int rx_len;
+
+#if defined(CONFIG_CLOUD_OSCORE)
+/* Protected request, before it is copied to its transaction. */
+static uint8_t oscore_tx_buf[APP_COAP_MAX_MSG_LEN];
+/* Received message after verification and decryption. */
+static uint8_t oscore_rx_buf[APP_COAP_MAX_MSG_LEN];
+#endif
+
+static int sock = -1;
+
+/* Held while the socket is opened or closed, and by the receive thread
+ * while it reads from the socket, so it never reads a closed or reused fd.
+ */
+static K_MUTEX_DEFINE(sock_lock);
+
+/* Given when a request becomes outstanding, starts the receive thread. */
+K_SEM_DEFINE(rx_armed, 0, 1);
+
+/* Given by the cloud thread once the datagram in rx_buf has been handled. */
+K_SEM_DEFINE(rx_consumed, 0, 1);
+
+/* Token of the device config observation. */
+static uint32_t observe_token;
+
+/* Set while the server pushes device config notifications. */
+static atomic_t observing;
+
+/* Cleared if the server does not support observing the device config. */
+static bool observe_supported = true;
+
+/* Uptime in milliseconds when the observation must be registered again.
+ * Written under sock_lock, the receive thread waits for it to pass.
+ */
+static int64_t observe_expiry;
+
+/* Number of device config GET round trips skipped thanks to the observation. */
+static uint32_t config_round_trips_saved;
+
+/* Set while a device config GET is outstanding. */
+static bool config_pending;
+
+/* Options of a request. */
+struct request_options {
+	/* ETag of the cached representation, validated by the server. */
+	const uint8_t *etag;
+	uint8_t etag_len;
+	/* Register an observation. */
+	bool observe;
+	/* Block2 option, to request a block of the response. */
+	bool has_block2;
+	uint32_t block2;
+	/* Block1 option and total payload size, for a block of the request. */
+	bool has_block1;
+	uint32_t block1;
+	uint32_t size1;
+};
 
-K_SEM_DEFINE(socket_sem, 1, 1);  // Initialize a semaphore with an initial count of 1 and a maximum count of 1
+BUILD_ASSERT(IS_POWER_OF_TWO(CONFIG_CLOUD_COAP_BLOCK_SIZE),
+	     "CoAP block size must be a power of two");
+BUILD_ASSERT(CONFIG_CLOUD_COAP_MAX_MSG_LEN >= CONFIG_CLOUD_COAP_BLOCK_SIZE + 64 +
+	     (IS_ENABLED(CONFIG_CLOUD_OSCORE) ? 32 : 0),
+	     "CoAP message buffer must fit a block and the header");
+
+/* Block-wise upload of a request payload that does not fit in one block. */
+static struct {
+	const char *resource_path;
+	uint8_t content_type;
+	uint8_t method;
+	struct blockwise_upload blocks;
+	coap_transaction_cb_t cb;
+	void *user_data;
+} upload;
+
+/* Device config document, reassembled from the Block2 blocks. */
+static char config_body[CONFIG_CLOUD_CONFIG_MAX_LEN + 1];
+static size_t config_body_len;
+
+/* Encoded location data payload. */
+static uint8_t payload_buf[CONFIG_CLOUD_BATCH_MAX_BYTES];
+
+/* Size of the last request sent, in bytes. */
+static size_t last_request_len;
+
+/* Queued fixes that are being sent to the server. */
+static struct cloud_location_data drain_batch[CONFIG_FIX_QUEUE_DRAIN_BATCH];
+/* Fix queue sequence number of drain_batch[0]. */
+static uint32_t drain_batch_seq;
+/* Number of fixes in the batch waiting for acknowledgement. */
+static int drain_batch_len;
+static bool draining;
+/* Send also the last partial batch, used after reconnecting. */
+static bool drain_flush;
+
+/* Uptime in milliseconds when the oldest unsent fix must be sent, 0 if none. */
+static int64_t batch_deadline;
+
+/* Uptime in milliseconds of the next connection attempt, 0 if none. */
+static int64_t reconnect_at;
+
+/* Batched uplink sizes, compared to sending each fix on its own. */
+static struct {
+	/* Number of fixes sent. */
+	uint32_t fixes;
+	/* Bytes sent in the batched requests. */
+	uint32_t bytes;
+	/* Bytes the fixes would have taken in single fix requests. */
+	uint32_t single_bytes;
+} batch_stats;
 
 static struct sockaddr_storage server;
 
@@ -158,44 +320,102 @@ static void set_sub_state(enum sub_state_type new_sub_state)
 }
 
 static bool app_event_handler(const struct app_event_header *aeh){
-	bool consume = false, enqueue_msg = false;
-	struct cloud_msg_data msg = {0};
-	if (is_app_module_event(aeh)){
-		struct app_module_event *event = cast_app_module_event(aeh);
-		msg.module.app = *event;
-		enqueue_msg = true;
+	if (module_event_accept(aeh) && module_queue_put(&msgq_cloud, aeh)) {
+		LOG_ERR("Event queue full, event dropped");
 	}
-	
-	if (is_cloud_module_event(aeh)){
-		struct cloud_module_event *event = cast_cloud_module_event(aeh);
-		msg.module.cloud = *event;
-		enqueue_msg = true;
+
+	return false;
+}
+
+static void report_idle_time(void)
+{
+#if defined(CONFIG_CLOUD_IDLE_REPORT)
+	static uint64_t last_idle_cycles;
+	static uint64_t last_execution_cycles;
+	k_thread_runtime_stats_t stats;
+
+	if (k_thread_runtime_stats_all_get(&stats)) {
+		return;
 	}
 
-	
-	if (is_modem_module_event(aeh)){
-		struct modem_module_event *event = cast_modem_module_event(aeh);
-		msg.module.modem = *event;
-		enqueue_msg = true;
+	uint64_t idle = stats.idle_cycles - last_idle_cycles;
+	uint64_t execution = stats.execution_cycles - last_execution_cycles;
+
+	last_idle_cycles = stats.idle_cycles;
+	last_execution_cycles = stats.execution_cycles;
+
+	if (execution == 0) {
+		return;
 	}
 
-	
-	if (is_location_module_event(aeh)){
-		struct location_module_event *event = cast_location_module_event(aeh);
-		msg.module.location = *event;
-		enqueue_msg = true;
+	LOG_INF("CPU idle %llu ms of %llu ms (%u%%) since last report",
+		k_cyc_to_ms_floor64(idle), k_cyc_to_ms_floor64(execution),
+		(unsigned int)((idle * 100) / execution));
+#endif
+}
+
+/**@brief Log the transaction counters and the CPU idle time once the last
+ *	  outstanding request has completed.
+ */
+static void requests_idle_check(void)
+{
+	static size_t last_count;
+	size_t count = coap_transaction_count();
+	struct coap_transaction_stats stats;
+
+	if (count == 0 && last_count > 0) {
+		coap_transaction_stats_get(&stats);
+		LOG_INF("No requests outstanding");
+		LOG_INF("CoAP: sent %u, completed %u, retransmitted %u, timed out %u",
+			stats.sent, stats.completed, stats.retransmissions, stats.timeouts);
+		LOG_INF("CoAP RTT: last %u ms, min %u ms, max %u ms, smoothed %u ms, RTO %u ms",
+			stats.rtt_last_ms, stats.rtt_min_ms, stats.rtt_max_ms,
+			stats.srtt_ms, stats.rto_ms);
+#if defined(CONFIG_CLOUD_OSCORE)
+		struct oscore_stats oscore;
+
+		oscore_stats_get(&oscore);
+		if (oscore.protected > 0) {
+			LOG_INF("OSCORE: %u bytes per request over plain CoAP, %u rejected",
+				oscore.overhead_bytes / oscore.protected, oscore.rejected);
+		}
+#endif
+		report_idle_time();
+	}
+
+	last_count = count;
+}
+
+/**@brief True when the server is connected and no batch is being sent. */
+static bool uplink_idle(void)
+{
+	return state == STATE_LTE_CONNECTED && sub_state == SUB_STATE_SERVER_CONNECTED &&
+	       !draining && upload.blocks.payload == NULL;
+}
+
+/**@brief Time left until the next retransmission or request timeout, or until
+ *	  the oldest unsent fix must be sent.
+ */
+static k_timeout_t event_timeout(void)
+{
+	int64_t deadline = coap_transaction_deadline();
+
+	if (uplink_idle() && batch_deadline != 0 &&
+	    (deadline == 0 || batch_deadline < deadline)) {
+		deadline = batch_deadline;
+	}
+
+	if (reconnect_at != 0 && (deadline == 0 || reconnect_at < deadline)) {
+		deadline = reconnect_at;
 	}
 
-	if (enqueue_msg){
-		 /* Add the event to the message queue */
-        int err = k_msgq_put(&msgq_cloud, &msg, K_NO_WAIT);
-        if (err) {
-            LOG_ERR("Failed to add event to message queue: %d", err);
-            /* Handle the error */
-        }
+	if (deadline == 0) {
+		return K_FOREVER;
 	}
 
-	return consume;
+	int64_t remaining = deadline - k_uptime_get();
+
+	return remaining > 0 ? K_MSEC(remaining) : K_NO_WAIT;
 }
 
 static int server_resolve(void)
@@ -214,54 +434,198 @@ static int server_resolve(void)
 	return 0;
 }
 
-/**@brief Initialize the CoAP client */
-static int client_init(void)
+#if defined(CONFIG_CLOUD_DTLS)
+/* DTLS handshake counters. */
+static struct {
+	/* Full handshakes. */
+	uint32_t handshakes;
+	/* Abbreviated handshakes resuming a cached session. */
+	uint32_t resumptions;
+} dtls_stats;
+
+/**@brief Set the DTLS options of the cloud socket, before the handshake. */
+static int dtls_setup(int fd)
 {
 	int err;
+	sec_tag_t sec_tag_list[] = { CONFIG_CLOUD_DTLS_SEC_TAG };
+	int verify = IS_ENABLED(CONFIG_CLOUD_DTLS_PEER_VERIFY) ?
+		     TLS_PEER_VERIFY_REQUIRED : TLS_PEER_VERIFY_NONE;
+
+	err = setsockopt(fd, SOL_TLS, TLS_SEC_TAG_LIST, sec_tag_list, sizeof(sec_tag_list));
+	if (err) {
+		LOG_ERR("Failed to set the security tag: %d", errno);
+		return -errno;
+	}
+
+	err = setsockopt(fd, SOL_TLS, TLS_PEER_VERIFY, &verify, sizeof(verify));
+	if (err) {
+		LOG_ERR("Failed to set peer verification: %d", errno);
+		return -errno;
+	}
+
+#if defined(CONFIG_CLOUD_DTLS_SESSION_CACHE)
+	int session_cache = TLS_SESSION_CACHE_ENABLED;
+
+	err = setsockopt(fd, SOL_TLS, TLS_SESSION_CACHE, &session_cache, sizeof(session_cache));
+	if (err) {
+		LOG_WRN("Failed to enable the session cache: %d", errno);
+	}
+#endif
+
+#if defined(CONFIG_CLOUD_DTLS_CID)
+	/* The device sends the ID chosen by the server, it does not need one itself. */
+	int cid = TLS_DTLS_CID_SUPPORTED;
+
+	err = setsockopt(fd, SOL_TLS, TLS_DTLS_CID, &cid, sizeof(cid));
+	if (err) {
+		LOG_WRN("Failed to enable the Connection ID: %d", errno);
+	}
+#endif
+
+	return 0;
+}
+
+/**@brief Count the handshake and log the Connection ID status after connecting. */
+static void dtls_connected(int fd)
+{
+	int value;
+	socklen_t len = sizeof(value);
 
-	k_sem_take(&socket_sem, K_FOREVER); // Take the semaphore
+#if defined(TLS_DTLS_HANDSHAKE_STATUS)
+	if (getsockopt(fd, SOL_TLS, TLS_DTLS_HANDSHAKE_STATUS, &value, &len) == 0 &&
+	    value == TLS_DTLS_HANDSHAKE_STATUS_CACHED) {
+		dtls_stats.resumptions++;
+	} else {
+		dtls_stats.handshakes++;
+	}
+#else
+	dtls_stats.handshakes++;
+#endif
+
+#if defined(CONFIG_CLOUD_DTLS_CID)
+	len = sizeof(value);
+	if (getsockopt(fd, SOL_TLS, TLS_DTLS_CID_STATUS, &value, &len) == 0) {
+		LOG_INF("DTLS Connection ID %s",
+			value == TLS_DTLS_CID_STATUS_DISABLED ? "not used by the server" : "in use");
+	}
+#endif
+
+	LOG_INF("DTLS: %u full handshakes, %u resumptions",
+		dtls_stats.handshakes, dtls_stats.resumptions);
+}
+#endif /* CONFIG_CLOUD_DTLS */
+
+/**@brief Initialize the CoAP client. The socket is kept open while the modem
+ *	  sleeps in PSM, only a lost LTE link opens a new one.
+ */
+static int client_init(void)
+{
+	int err = 0;
 
-	sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	k_mutex_lock(&sock_lock, K_FOREVER);
+
+	if (sock >= 0) {
+		(void)close(sock);
+		sock = -1;
+	}
+
+	sock = socket(AF_INET, SOCK_DGRAM,
+		      IS_ENABLED(CONFIG_CLOUD_DTLS) ? IPPROTO_DTLS_1_2 : IPPROTO_UDP);
 	if (sock < 0) {
 		LOG_ERR("Failed to create CoAP socket: %d.\n", errno);
-		return -errno;
+		err = -errno;
+		goto out;
 	}
 
+#if defined(CONFIG_CLOUD_DTLS)
+	err = dtls_setup(sock);
+	if (err) {
+		goto out;
+	}
+#endif
+
+	/* With DTLS the handshake is done here. */
 	err = connect(sock, (struct sockaddr *)&server,
 				  sizeof(struct sockaddr_in));
 	if (err < 0) {
 		LOG_ERR("Connect failed : %d\n", errno);
-		return -errno;
+		err = -errno;
+		goto out;
 	}
 
-	k_sem_give(&socket_sem); // Give the semaphore
+#if defined(CONFIG_CLOUD_DTLS)
+	dtls_connected(sock);
+#endif
 
 	LOG_INF("Successfully connected to server");
 
-	/* Generate a random token after the socket is connected */
-	next_token = sys_rand32_get();
+	/* Requests of a previous connection are never answered on this one. */
+	coap_transaction_init(sock);
+
+out:
+	k_mutex_unlock(&sock_lock);
+
+	return err;
+}
+
+/**@brief Send an empty ACK or RST to a received message. */
+static int client_send_empty(enum coap_msgtype type, const struct coap_packet *received)
+{
+	int err;
+	struct coap_packet reply;
+	uint8_t buf[4];
+
+	err = coap_packet_init(&reply, buf, sizeof(buf),
+			       APP_COAP_VERSION, type, 0, NULL,
+			       COAP_CODE_EMPTY, coap_header_get_id(received));
+	if (err < 0) {
+		LOG_ERR("Failed to create CoAP reply, %d\n", err);
+		return err;
+	}
+
+	err = send(sock, reply.data, reply.offset, 0);
+	if (err < 0) {
+		LOG_ERR("Failed to send CoAP reply, %d\n", errno);
+		return -errno;
+	}
 
 	return 0;
 }
 
-/**@biref Send CoAP request. */
-static int client_send_request(const char *resource_path, uint8_t content_type, const char *payload, uint8_t method, enum coap_msgtype type)
+/**@brief Build a CoAP request in the buffer of its transaction. */
+static int request_build(struct coap_transaction *transaction, const char *resource_path, uint8_t content_type, const uint8_t *payload, size_t payload_len, uint8_t method, enum coap_msgtype type, const struct request_options *options)
 {
 	int err;
 	struct coap_packet request;
 
-	next_token++;
-
 	/* Initialize the CoAP packet and append the resource path */
-	err = coap_packet_init(&request, coap_buf, sizeof(coap_buf),
+	err = coap_packet_init(&request, transaction->buf, sizeof(transaction->buf),
 				   APP_COAP_VERSION, type,
-				   sizeof(next_token), (uint8_t *)&next_token,
-				   method, coap_next_id());
+				   sizeof(transaction->token), (uint8_t *)&transaction->token,
+				   method, transaction->id);
 	if (err < 0) {
 		LOG_ERR("Failed to create CoAP request, %d\n", err);
 		return err;
 	}
 
+	/* Options are appended in ascending option number order */
+	if (options != NULL && options->etag_len > 0) {
+		err = coap_packet_append_option(&request, COAP_OPTION_ETAG,
+						options->etag, options->etag_len);
+		if (err < 0) {
+			LOG_ERR("Failed to encode CoAP option, %d\n", err);
+			return err;
+		}
+	}
+
+	if (options != NULL && options->observe) {
+		err = coap_append_option_int(&request, COAP_OPTION_OBSERVE, 0);
+		if (err < 0) {
+			LOG_ERR("Failed to encode CoAP option, %d\n", err);
+			return err;
+		}
+	}
+
 	err = coap_packet_append_option(&request, COAP_OPTION_URI_PATH,
 					(uint8_t *)resource_path,
 					strlen(resource_path));
@@ -279,6 +643,30 @@ static int client_send_request(const char *resource_path, uint8_t content_type,
 		return err;
 	}
 
+	if (options != NULL && options->has_block2) {
+		err = coap_append_option_int(&request, COAP_OPTION_BLOCK2, options->block2);
+		if (err < 0) {
+			LOG_ERR("Failed to encode CoAP option, %d\n", err);
+			return err;
+		}
+	}
+
+	if (options != NULL && options->has_block1) {
+		err = coap_append_option_int(&request, COAP_OPTION_BLOCK1, options->block1);
+		if (err < 0) {
+			LOG_ERR("Failed to encode CoAP option, %d\n", err);
+			return err;
+		}
+	}
+
+	if (options != NULL && options->size1 > 0) {
+		err = coap_append_option_int(&request, COAP_OPTION_SIZE1, options->size1);
+		if (err < 0) {
+			LOG_ERR("Failed to encode CoAP option, %d\n", err);
+			return err;
+		}
+	}
+
 	/* Add the payload to the message */
 	if (payload != NULL) {
 		err = coap_packet_append_payload_marker(&request);
@@ -287,416 +675,1569 @@ static int client_send_request(const char *resource_path, uint8_t content_type,
 			return err;
 		}
 
-		err = coap_packet_append_payload(&request, (uint8_t *)payload, strlen(payload));
+		err = coap_packet_append_payload(&request, payload, payload_len);
 		if (err < 0) {
 			LOG_ERR("Failed to append payload, %d\n", err);
 			return err;
 		}
 	}
 
-	k_sem_take(&socket_sem, K_FOREVER); // Take the semaphore
-
-	err = send(sock, request.data, request.offset, 0);
-	if (err < 0) {
-		LOG_ERR("Failed to send CoAP request, %d\n", errno);
-		return -errno;
-	}
+	transaction->len = request.offset;
 
-	k_sem_give(&socket_sem); // Give the semaphore
+#if defined(CONFIG_CLOUD_OSCORE)
+	size_t protected_len;
 
-	LOG_INF("CoAP request sent: Token 0x%04x\n", next_token);
+	err = oscore_protect(transaction->buf, transaction->len, oscore_tx_buf,
+			     sizeof(oscore_tx_buf), &protected_len);
+	if (err) {
+		LOG_ERR("Failed to protect CoAP request, %d\n", err);
+		return err;
+	}
 
-	struct cloud_module_event *cloud_module_event = new_cloud_module_event();
-	cloud_module_event->type = CLOUD_EVENT_DATA_SENT;
-	APP_EVENT_SUBMIT(cloud_module_event);
+	memcpy(transaction->buf, oscore_tx_buf, protected_len);
+	transaction->len = protected_len;
+#endif
 
 	return 0;
 }
 
-static int client_send_location_data(struct cloud_location_data *location_data)
-{	
+/**@biref Send CoAP request. The completion callback is called with the
+ *	  response, or with NULL if the request was not answered.
+ */
+static int client_send_request(const char *resource_path, uint8_t content_type, const uint8_t *payload, size_t payload_len, uint8_t method, enum coap_msgtype type, const struct request_options *options, coap_transaction_cb_t cb, void *user_data)
+{
 	int err;
-	err = date_time_uptime_to_unix_time_ms(&location_data->gnss_ts);
+	struct coap_transaction *transaction;
+
+	transaction = coap_transaction_new(type == COAP_TYPE_CON, cb, user_data);
+	if (transaction == NULL) {
+		return -EBUSY;
+	}
+
+	err = request_build(transaction, resource_path, content_type, payload, payload_len, method, type, options);
 	if (err) {
-		LOG_ERR("date_time_uptime_to_unix_time_ms, error: %d", err);
+		coap_transaction_free(transaction);
 		return err;
 	}
 
-	time_t rawtime = (time_t)(location_data->gnss_ts / 1000); // Convert milliseconds to seconds
-    struct tm *tm_info = localtime(&rawtime);
+	uint32_t token = transaction->token;
 
-    char time_str[20];
-    strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", tm_info);
+	last_request_len = transaction->len;
 
-	cJSON *root = cJSON_CreateObject();
-	if (root == NULL) {
-		printf("Error: cJSON_CreateObject failed\n");
-		return -1;
+	err = coap_transaction_send(transaction);
+	if (err) {
+		return err;
 	}
 
-	if (!cJSON_AddStringToObject(root, "time", time_str)) {
-		LOG_ERR("Error: cJSON_AddStringToObject failed for time\n");
-		cJSON_Delete(root);
-		return -1;
-	}
+	LOG_INF("CoAP request sent: Token 0x%08x\n", token);
 
-	if (!cJSON_AddNumberToObject(root, "latitude", location_data->pvt.latitude)) {
-		LOG_ERR("Error: cJSON_AddNumberToObject failed for latitude\n");
-		cJSON_Delete(root);
-		return -1;
+	/* Only confirmable requests are answered, listen for those. */
+	if (type == COAP_TYPE_CON) {
+		k_sem_give(&rx_armed);
 	}
 
-	if (!cJSON_AddNumberToObject(root, "longitude", location_data->pvt.longitude)) {
-		LOG_ERR("Error: cJSON_AddNumberToObject failed for longitude\n");
-		cJSON_Delete(root);
-		return -1;
-	}
+	struct cloud_module_event *cloud_module_event = new_cloud_module_event();
+	cloud_module_event->type = CLOUD_EVENT_DATA_SENT;
+	APP_EVENT_SUBMIT(cloud_module_event);
 
-	if (!cJSON_AddNumberToObject(root, "altitude", location_data->pvt.altitude)) {
-		LOG_ERR("Error: cJSON_AddNumberToObject failed for altitude\n");
-		cJSON_Delete(root);
-		return -1;
-	}
+	return 0;
+}
 
-	if (!cJSON_AddNumberToObject(root, "accuracy", location_data->pvt.accuracy)) {
-		LOG_ERR("Error: cJSON_AddNumberToObject failed for accuracy\n");
-		cJSON_Delete(root);
-		return -1;
-	}
-	char *payload = cJSON_Print(root);
-	if (payload == NULL) {
-		LOG_ERR("Error: cJSON_Print failed\n");
-		cJSON_Delete(root);
-		return -1;
-	}
+static int client_send_upload_block(void);
 
-	LOG_INF("Sending: %s", payload);
-	client_send_request(CONFIG_COAP_DATA_RESOURCE, COAP_CONTENT_FORMAT_APP_JSON, payload, COAP_METHOD_POST, COAP_TYPE_NON_CON);
+/**@brief Handle the response to a block of an upload. The next block is sent
+ *	  on 2.31 Continue, other responses complete the upload.
+ */
+static void upload_response_handler(const struct coap_packet *response, void *user_data)
+{
+	int err;
 
-	cJSON_Delete(root);
-	free(payload);
+	if (!blockwise_upload_response(&upload.blocks, response)) {
+		if (upload.cb != NULL) {
+			upload.cb(response, upload.user_data);
+		}
+		return;
+	}
 
-	return 0;
+	err = client_send_upload_block();
+	if (err) {
+		LOG_ERR("Failed to send block, error: %d", err);
+		upload.blocks.payload = NULL;
+		if (upload.cb != NULL) {
+			upload.cb(NULL, upload.user_data);
+		}
+	}
 }
 
-static int client_get_device_config()
+/**@brief Send the next block of the upload. */
+static int client_send_upload_block(void)
 {
-	client_send_request(CONFIG_COAP_DEVICE_CONFIG_RESOURCE, COAP_CONTENT_FORMAT_TEXT_PLAIN, NULL, COAP_METHOD_GET, COAP_TYPE_CON);
-
-	return 0;
+	struct blockwise_block block;
+	struct request_options options = {
+		.has_block1 = true,
+	};
+
+	blockwise_upload_next(&upload.blocks, &block);
+	options.block1 = block.block1;
+	options.size1 = block.size1;
+
+	LOG_DBG("Sending block %u, %zu bytes at offset %zu",
+		block.block1 >> 4, block.len, upload.blocks.offset);
+
+	return client_send_request(upload.resource_path, upload.content_type,
+				   block.data, block.len,
+				   upload.method, COAP_TYPE_CON, &options,
+				   upload_response_handler, NULL);
 }
 
-static int handle_device_config_responce(char *device_config) {
-    cJSON *root = cJSON_Parse(device_config);
-    if (root == NULL) {
-        printf("Error: cJSON_Parse failed\n");
-        return -1;
-    }
+/**@brief Send a confirmable request, splitting the payload in Block1 blocks
+ *	  if it does not fit in one. The completion callback gets the response
+ *	  to the last block.
+ */
+static int client_send_blockwise(const char *resource_path, uint8_t content_type, const uint8_t *payload, size_t payload_len, uint8_t method, coap_transaction_cb_t cb, void *user_data)
+{
+	if (payload_len <= CONFIG_CLOUD_COAP_BLOCK_SIZE) {
+		return client_send_request(resource_path, content_type, payload, payload_len,
+					   method, COAP_TYPE_CON, NULL, cb, user_data);
+	}
 
-    cJSON *device_id = cJSON_GetObjectItem(root, "device_id");
-    cJSON *active_mode = cJSON_GetObjectItem(root, "active_mode");
-    cJSON *location_timeout = cJSON_GetObjectItem(root, "location_timeout");
-    cJSON *active_wait_timeout = cJSON_GetObjectItem(root, "active_wait_timeout");
-    cJSON *passive_wait_timeout = cJSON_GetObjectItem(root, "passive_wait_timeout");
+	if (upload.blocks.payload != NULL) {
+		return -EBUSY;
+	}
 
-	struct app_cfg new_cfg;
+	upload.resource_path = resource_path;
+	upload.content_type = content_type;
+	upload.method = method;
+	upload.cb = cb;
+	upload.user_data = user_data;
+	blockwise_upload_start(&upload.blocks, payload, payload_len);
 
+	int err = client_send_upload_block();
 
-    if (device_id != NULL && cJSON_IsNumber(device_id)) {
-		new_cfg.device_id = device_id->valueint;
+	if (err) {
+		upload.blocks.payload = NULL;
 	}
 
-	if (active_mode != NULL && cJSON_IsNumber(active_mode)) {
-		new_cfg.active_mode = active_mode->valueint;
-	}
+	return err;
+}
 
-	if (location_timeout != NULL && cJSON_IsNumber(location_timeout)) {
-		new_cfg.location_timeout = location_timeout->valueint;
+static void data_response_handler(const struct coap_packet *response, void *user_data);
+static void config_response_handler(const struct coap_packet *response, void *user_data);
+static void config_observe_response_handler(const struct coap_packet *response, void *user_data);
+
+/**@brief Number of fixes sent in one uplink, from the device config. */
+static int batch_size(void)
+{
+	return CLAMP(copy_cfg.batch_size, 1, CONFIG_FIX_QUEUE_DRAIN_BATCH);
+}
+
+/**@brief Send the oldest queued fixes in one request.
+ *
+ * @return Number of fixes sent, or a negative error code.
+ */
+static int client_send_location_batch(void)
+{
+	int err;
+	int count;
+	size_t len;
+	size_t single_len;
+
+	drain_batch_len = fix_queue_peek(drain_batch, batch_size(), &drain_batch_seq);
+	if (drain_batch_len <= 0) {
+		return drain_batch_len;
 	}
 
-	if (active_wait_timeout != NULL && cJSON_IsNumber(active_wait_timeout)) {
-		new_cfg.active_wait_timeout = active_wait_timeout->valueint;
+#if defined(CONFIG_NEWLIB_LIBC)
+	size_t heap_used = mallinfo().uordblks;
+#endif
+
+	/* The encoder also gives the size of each fix sent on its own. */
+	count = cloud_codec_encode(drain_batch, drain_batch_len, batch_size() > 1,
+				   payload_buf, sizeof(payload_buf), &len, &single_len);
+	if (count < 0) {
+		LOG_ERR("Failed to encode location data, error: %d", count);
+		return count;
 	}
 
-	if (passive_wait_timeout != NULL && cJSON_IsNumber(passive_wait_timeout)) {
-		new_cfg.passive_wait_timeout = passive_wait_timeout->valueint;
+#if defined(CONFIG_NEWLIB_LIBC)
+	if (mallinfo().uordblks != heap_used) {
+		LOG_WRN("Uplink encoding allocated %d bytes from the heap",
+			(int)(mallinfo().uordblks - heap_used));
+	}
+#endif
+
+	LOG_INF("Sending %d fix(es), %zu bytes", count, len);
+	/* Sent as confirmable, the fixes are removed from the queue on acknowledgement. */
+	err = client_send_blockwise(CONFIG_COAP_DATA_RESOURCE, cloud_codec_content_format(), payload_buf, len, COAP_METHOD_POST, data_response_handler, NULL);
+	if (err == 0) {
+		/* Header bytes of the first request, repeated for every block. */
+		size_t overhead = last_request_len - MIN(len, CONFIG_CLOUD_COAP_BLOCK_SIZE);
+		size_t blocks = DIV_ROUND_UP(len, CONFIG_CLOUD_COAP_BLOCK_SIZE);
+
+		drain_batch_len = count;
+
+		batch_stats.fixes += count;
+		batch_stats.bytes += len + blocks * overhead;
+		batch_stats.single_bytes += single_len + count * overhead;
+		LOG_INF("Bytes per fix: %u batched, %u as single fix uplinks",
+			batch_stats.bytes / batch_stats.fixes,
+			batch_stats.single_bytes / batch_stats.fixes);
 	}
-	
-	struct cloud_module_event *cloud_module_event = new_cloud_module_event();
-	cloud_module_event->type = CLOUD_EVENT_CLOUD_CONFIG_RECEIVED;
-	cloud_module_event->cloud_cfg = new_cfg;
-	APP_EVENT_SUBMIT(cloud_module_event);
 
-    cJSON_Delete(root);
-	return 0;
+	return err ? err : count;
 }
 
-/**@brief Handles responses from the remote CoAP server. */
-static int client_handle_response(uint8_t *buf, int received)
+/**@brief Fetch the device config. While the config is observed the server
+ *	  pushes the changes, and the GET is only sent to register the
+ *	  observation again once it has expired.
+ */
+static int client_get_device_config()
 {
-	struct coap_packet reply;
-	uint8_t token[8];
-	uint16_t token_len;
-	const uint8_t *payload;
-	uint16_t payload_len;
-	uint8_t temp_buf[128];
-	/* Parse the received CoAP packet */
-	int err = coap_packet_parse(&reply, buf, received, NULL, 0);
-	if (err < 0) {
-		LOG_ERR("Malformed response received: %d\n", err);
-		return err;
+	int err;
+	struct request_options options = {
+		.observe = IS_ENABLED(CONFIG_CLOUD_CONFIG_OBSERVE) && observe_supported,
+		/* Ask for blocks that fit the receive buffer from the start. */
+		.has_block2 = true,
+		.block2 = blockwise_option(0, false, BLOCKWISE_SZX_PREFERRED),
+	};
+
+	if (options.observe && atomic_get(&observing) && k_uptime_get() < observe_expiry) {
+		config_round_trips_saved++;
+		LOG_DBG("Device config observed, %u GET round trips saved",
+			config_round_trips_saved);
+		return 0;
 	}
 
-	/* Confirm the token in the response matches the token sent */
-	token_len = coap_header_get_token(&reply, token);
-	if ((token_len != sizeof(next_token)) ||
-	    (memcmp(&next_token, token, sizeof(next_token)) != 0)) {
-		LOG_ERR("Invalid token received: 0x%02x%02x\n",
-		       token[1], token[0]);
+	if (config_pending) {
 		return 0;
 	}
 
-	/* Retrieve the payload and confirm it's nonzero */
-	payload = coap_packet_get_payload(&reply, &payload_len);
+	/* The server has promised the last config stays valid until Max-Age. */
+	if (config_cache_fresh()) {
+		return 0;
+	}
 
-	if (payload_len > 0) {
-		snprintf(temp_buf, MIN(payload_len + 1, sizeof(temp_buf)), "%s", payload);
+	options.etag_len = config_cache_etag_get(&options.etag);
 
-		err = handle_device_config_responce(temp_buf);
-		if (err < 0){
-			LOG_ERR("Failed to handle device config responce");
-			return err;
-		}
-	} else {
-		strcpy(temp_buf, "EMPTY");
+	/* Notifications of an expired observation are answered with a reset. */
+	atomic_set(&observing, 0);
+
+	err = client_send_request(CONFIG_COAP_DEVICE_CONFIG_RESOURCE, COAP_CONTENT_FORMAT_TEXT_PLAIN, NULL, 0, COAP_METHOD_GET, COAP_TYPE_CON, &options,
+				  options.observe ? config_observe_response_handler : config_response_handler, NULL);
+	if (err == 0) {
+		config_pending = true;
 	}
 
-	/* Log the header code, token and payload of the response */
-	LOG_INF("CoAP response: Code 0x%x, Token 0x%02x%02x, Payload: %s\n",
-	       coap_header_get_code(&reply), token[1], token[0], (char *)temp_buf);
+	return err;
+}
 
-	return 0;
+/**@brief Request the next block of the device config. The ETag and Observe
+ *	  options are only sent with the first block.
+ */
+static int client_get_device_config_block(uint32_t num, uint8_t szx)
+{
+	int err;
+	struct request_options options = {
+		.has_block2 = true,
+		.block2 = blockwise_option(num, false, szx),
+	};
+
+	err = client_send_request(CONFIG_COAP_DEVICE_CONFIG_RESOURCE, COAP_CONTENT_FORMAT_TEXT_PLAIN, NULL, 0, COAP_METHOD_GET, COAP_TYPE_CON, &options,
+				  config_response_handler, NULL);
+	if (err == 0) {
+		config_pending = true;
+	}
+
+	return err;
 }
 
-static void button_handler(uint32_t button_state, uint32_t has_changed)
+/**@brief Extend the observation lifetime after the server has been heard. */
+static void observe_refresh(const struct coap_packet *reply)
 {
-	/*Send a GET request or PUT request upon button triggers */
-	if (has_changed & DK_BTN1_MSK && button_state & DK_BTN1_MSK) {
-		struct cloud_module_event *cloud_module_event = new_cloud_module_event();
-		cloud_module_event->type = CLOUD_EVENT_BUTTON_PRESSED;
-		APP_EVENT_SUBMIT(cloud_module_event);
+	int lifetime = CONFIG_CLOUD_OBSERVE_LIFETIME;
+	int max_age = coap_get_option_int(reply, COAP_OPTION_MAX_AGE);
+
+	if (max_age >= 0) {
+		lifetime = MIN(lifetime, max_age);
 	}
+
+	k_mutex_lock(&sock_lock, K_FOREVER);
+	observe_expiry = k_uptime_get() + (int64_t)lifetime * MSEC_PER_SEC;
+	k_mutex_unlock(&sock_lock);
 }
 
-static void connect_cloud() {
-	if (server_resolve() != 0) {
-		LOG_INF("Failed to resolve server name");
+/**@brief Handle the response to an observe registration. */
+static void observe_registered(const struct coap_packet *reply)
+{
+	uint8_t token[COAP_TOKEN_MAX_LEN];
+
+	if (coap_get_option_int(reply, COAP_OPTION_OBSERVE) < 0) {
+		LOG_WRN("Server does not support observe, polling the device config");
+		observe_supported = false;
+		return;
 	}
 
-	if (client_init() != 0) {
-		LOG_INF("Failed to initialize client");
+	/* Notifications carry the token of the registration. */
+	if (coap_header_get_token(reply, token) != sizeof(observe_token)) {
+		return;
 	}
 
-	struct cloud_module_event *cloud_module_event = new_cloud_module_event();
-	cloud_module_event->type = CLOUD_EVENT_SERVER_CONNECTED;
-	APP_EVENT_SUBMIT(cloud_module_event);
+	memcpy(&observe_token, token, sizeof(observe_token));
+
+	LOG_INF("Device config observed");
+	observe_refresh(reply);
+	atomic_set(&observing, 1);
+
+	/* Keep listening for notifications. */
+	k_sem_give(&rx_armed);
 }
 
-static void on_state_lte_init(struct cloud_msg_data *msg)
+static void observe_stop(void)
 {
-	if (IS_EVENT(msg, app, APP_EVENT_START)){
-		set_state(STATE_LTE_DISCONNECTED);
-		set_sub_state(SUB_STATE_SERVER_DISCONNECTED);
-	}
+	atomic_set(&observing, 0);
+	observe_supported = true;
 }
 
-static void on_state_lte_disconnected(struct cloud_msg_data *msg)
+static void log_fix_queue_stats(void)
 {
-	if (IS_EVENT(msg, modem, MODEM_EVENT_LTE_CONNECTED)){
-		set_state(STATE_LTE_CONNECTED);
-		struct cloud_module_event *cloud_module_event = new_cloud_module_event();
-		cloud_module_event->type = CLOUD_EVENT_SERVER_CONNECTING;
-		APP_EVENT_SUBMIT(cloud_module_event);
-		connect_cloud();
-	}
+	struct fix_queue_stats stats;
+
+	fix_queue_stats_get(&stats);
+	LOG_INF("Fix queue: %d waiting, queued %u, sent %u, dropped %u",
+		fix_queue_count(), stats.queued, stats.sent, stats.dropped);
 }
 
-static void on_state_lte_connected(struct cloud_msg_data *msg)
+/**@brief Number of fixes not sent yet, also those held back by the track
+ *	  simplification.
+ */
+static size_t fixes_waiting(void)
 {
-	if (IS_EVENT(msg, modem, MODEM_EVENT_LTE_DISCONNECTED)){
-		set_state(STATE_LTE_DISCONNECTED);
-		set_sub_state(SUB_STATE_SERVER_DISCONNECTED);
-	}
+#if defined(CONFIG_TRACK_SIMPLIFY)
+	return fix_queue_count() + track_simplify_pending();
+#else
+	return fix_queue_count();
+#endif
 }
 
-static void on_sub_state_server_disconnected(struct cloud_msg_data *msg)
+/**@brief Start the batch age timer when the first fix waits in the queue. */
+static void update_batch_deadline(void)
 {
-	if (IS_EVENT(msg, cloud, CLOUD_EVENT_SERVER_CONNECTED)){
-		set_sub_state(SUB_STATE_SERVER_CONNECTED);
-		client_get_device_config();
+	if (fixes_waiting() == 0) {
+		batch_deadline = 0;
+	} else if (batch_deadline == 0) {
+		batch_deadline = k_uptime_get() + CONFIG_CLOUD_BATCH_MAX_AGE * MSEC_PER_SEC;
 	}
 }
 
-static void on_sub_state_server_connected(struct cloud_msg_data *msg)
+/**@brief A batch is sent when it is full or its oldest fix is too old. */
+static bool batch_ready(void)
 {
-	if (IS_EVENT(msg, cloud, CLOUD_EVENT_SERVER_DISCONNECTED)){
-		set_sub_state(SUB_STATE_SERVER_DISCONNECTED);
+	if (fixes_waiting() == 0) {
+		return false;
 	}
 
-	if (IS_EVENT(msg, cloud, CLOUD_EVENT_BUTTON_PRESSED)){
-		struct app_module_event *app_module_event = new_app_module_event();
-		app_module_event->type = APP_EVENT_LOCATION_GET;
-		APP_EVENT_SUBMIT(app_module_event);
-	}
+	return fix_queue_count() >= batch_size() ||
+	       (batch_deadline != 0 && k_uptime_get() >= batch_deadline);
+}
 
-	if (IS_EVENT(msg, location, LOCATION_EVENT_GNSS_DATA_READY)){
-		struct cloud_location_data new_location_data = {
-			.gnss_ts = msg->module.location.location.timestamp
-		};
+static void fix_queue_store(const struct cloud_location_data *location_data)
+{
+	int err = fix_queue_push(location_data);
+
+	if (err) {
+		LOG_ERR("Failed to queue location data, error: %d", err);
+	}
+}
+
+/**@brief Store a new fix to the flash queue. With the track simplification,
+ *	  only the fixes that add to the shape of the track are stored.
+ */
+static void fix_queue_add(struct cloud_location_data *location_data)
+{
+	int err;
+
+	/* Uptime is meaningless after a reboot, store the fix with UNIX time. */
+	err = date_time_uptime_to_unix_time_ms(&location_data->gnss_ts);
+	if (err) {
+		LOG_WRN("date_time_uptime_to_unix_time_ms, error: %d", err);
+		location_data->gnss_ts = 0;
+	}
+
+#if defined(CONFIG_TRACK_SIMPLIFY)
+	struct cloud_location_data kept[TRACK_SIMPLIFY_MAX_OUT];
+	struct track_simplify_stats stats;
+	int count = track_simplify_push(location_data, kept);
+
+	for (int i = 0; i < count; i++) {
+		fix_queue_store(&kept[i]);
+	}
+
+	track_simplify_stats_get(&stats);
+	LOG_INF("Track: kept %u of %u fixes, %u us per fix",
+		stats.kept, stats.points,
+		(uint32_t)(k_cyc_to_us_floor64(stats.cycles) / stats.points));
+#else
+	fix_queue_store(location_data);
+#endif
+
+	update_batch_deadline();
+	log_fix_queue_stats();
+}
+
+/**@brief Check the movement dead-band. A stationary device only counts the
+ *	  fixes, and sends one as a heartbeat every heartbeat_interval.
+ *
+ * @return true if the fix is sent.
+ */
+static bool deadband_report(const struct cloud_location_data *location_data)
+{
+	struct deadband_stats stats;
+
+	deadband_stats_get(&stats);
+
+	if (deadband_check(location_data, &copy_cfg)) {
+		if (stats.still_here > 0) {
+			LOG_INF("Fix sent after %u fixes in the dead-band", stats.still_here);
+		}
+		return true;
+	}
+
+	LOG_INF("Fix inside the dead-band, still here %u times, %u suppressed in total",
+		stats.still_here + 1, stats.suppressed + 1);
+
+	return false;
+}
+
+#if CONFIG_CLOUD_DIAG_INTERVAL > 0
+static void fix_queue_drain(bool flush);
+
+/* Uptime when the next diagnostics uplink is due. */
+static int64_t diag_due;
+
+/* Diagnostics uplink, sent block-wise if it does not fit in one block. The
+ * buffer is in use until the response to the last block.
+ */
+static char diag_buf[CONFIG_CLOUD_DIAG_BUF_SIZE];
+static bool diag_sending;
+
+struct diag_writer {
+	size_t len;
+	size_t queues;
+	bool truncated;
+};
+
+static void diag_append(struct diag_writer *writer, const char *fmt, ...)
+{
+	va_list args;
+	int len;
+
+	if (writer->truncated) {
+		return;
+	}
+
+	va_start(args, fmt);
+	len = vsnprintf(&diag_buf[writer->len], sizeof(diag_buf) - writer->len, fmt, args);
+	va_end(args);
+
+	if (len < 0 || writer->len + len >= sizeof(diag_buf)) {
+		writer->truncated = true;
+		return;
+	}
+
+	writer->len += len;
+}
+
+static void diag_append_queue(struct module_queue *queue, void *user_data)
+{
+	struct diag_writer *writer = user_data;
+	struct module_queue_stats stats;
+
+	module_queue_stats_get(queue, &stats);
+
+	diag_append(writer, "%s{\"name\":\"%s\",\"size\":%u,\"high_water\":%u,"
+		    "\"drops\":%u,\"spilled\":%u,\"coalesced\":%u,\"residency_ms\":%u}",
+		    writer->queues++ > 0 ? "," : "",
+		    queue->name, queue->size, stats.high_water, stats.drops,
+		    stats.spilled, stats.coalesced, stats.max_residency_ms);
+
+	LOG_INF("Queue %s: high water %u of %u, %u dropped, %u spilled, %u coalesced, "
+		"max residency %u ms", queue->name, stats.high_water, queue->size,
+		stats.drops, stats.spilled, stats.coalesced, stats.max_residency_ms);
+}
+
+static void diag_response_handler(const struct coap_packet *response, void *user_data)
+{
+	diag_sending = false;
+
+	if (response == NULL) {
+		LOG_WRN("Diagnostics not acknowledged, sent again next time");
+		return;
+	}
+
+	diag_due = k_uptime_get() + (int64_t)CONFIG_CLOUD_DIAG_INTERVAL * MSEC_PER_SEC;
+
+	/* Fixes are not sent while the diagnostics upload runs. */
+	if (uplink_idle() && batch_ready()) {
+		fix_queue_drain(false);
+	}
+}
+
+/**@brief Send the queue and event pool counters, at most once every
+ *	  CONFIG_CLOUD_DIAG_INTERVAL seconds. Sent after an uplink, so the
+ *	  radio is not woken up only for the diagnostics.
+ */
+static void diag_send_if_due(void)
+{
+	struct diag_writer writer = { 0 };
+	struct event_pool_stats pool;
+	int err;
+
+	if (diag_sending || k_uptime_get() < diag_due) {
+		return;
+	}
+
+	event_pool_stats_get(&pool);
+
+	diag_append(&writer, "{\"queues\":[");
+	module_queue_foreach(diag_append_queue, &writer);
+	diag_append(&writer, "],\"events\":{\"allocated\":%u,\"heap\":%u,\"peak\":%u}}",
+		    pool.allocated, pool.heap, pool.peak);
+
+	if (writer.truncated) {
+		LOG_ERR("Diagnostics do not fit in %zu bytes, increase "
+			"CONFIG_CLOUD_DIAG_BUF_SIZE", sizeof(diag_buf));
+		diag_due = k_uptime_get() + (int64_t)CONFIG_CLOUD_DIAG_INTERVAL * MSEC_PER_SEC;
+		return;
+	}
+
+	/* Confirmable, so that a payload larger than a block goes out in Block1
+	 * blocks. Diagnostics not acknowledged are sent again next time.
+	 */
+	err = client_send_blockwise(CONFIG_COAP_DIAG_RESOURCE, COAP_CONTENT_FORMAT_APP_JSON,
+				    (const uint8_t *)diag_buf, writer.len, COAP_METHOD_POST,
+				    diag_response_handler, NULL);
+	if (err) {
+		LOG_WRN("Failed to send diagnostics, error: %d", err);
+		return;
+	}
+
+	diag_sending = true;
+}
+#else
+static void diag_send_if_due(void)
+{
+}
+#endif /* CONFIG_CLOUD_DIAG_INTERVAL > 0 */
+
+/**@brief Queue the end of the track held back by the track simplification. */
+static void track_flush(void)
+{
+#if defined(CONFIG_TRACK_SIMPLIFY)
+	struct cloud_location_data kept;
+
+	if (track_simplify_flush(&kept) > 0) {
+		fix_queue_store(&kept);
+	}
+#endif
+}
+
+/**@brief Queue the end of the track held back by the track simplification
+ *	  before a reboot.
+ */
+static void track_restore(void)
+{
+#if defined(CONFIG_TRACK_SIMPLIFY)
+	struct cloud_location_data kept;
+
+	if (track_simplify_restore(&kept) > 0) {
+		LOG_INF("End of the track restored after a reboot");
+		fix_queue_store(&kept);
+	}
+#endif
+}
+
+/**@brief Stop draining the queue. The unacknowledged fixes stay in the queue. */
+static void fix_queue_drain_abort(void)
+{
+	draining = false;
+	drain_flush = false;
+	drain_batch_len = 0;
+}
+
+/**@brief Send the next batch of queued fixes to the server. The device
+ *	  config is fetched once there is no batch left to send.
+ *
+ * @param flush Send also the last partial batch.
+ */
+static void fix_queue_drain(bool flush)
+{
+	int err;
+
+	drain_flush |= flush;
+
+	if (flush) {
+		track_flush();
+	}
+
+	if (fix_queue_count() == 0 || (!drain_flush && !batch_ready())) {
+		fix_queue_drain_abort();
+		diag_send_if_due();
+		client_get_device_config();
+		return;
+	}
+
+	draining = true;
+
+	err = client_send_location_batch();
+	if (err <= 0) {
+		LOG_ERR("Failed to send location data, error: %d", err);
+		fix_queue_drain_abort();
+	}
+}
+
+/**@brief Handle the server acknowledgement of the batch being sent. */
+static void fix_queue_drain_ack(uint8_t code)
+{
+	int err;
+
+	if (!draining) {
+		return;
+	}
+
+	if ((code >> 5) != 2) {
+		LOG_ERR("Server rejected location data, code 0x%x", code);
+		fix_queue_drain_abort();
+		return;
+	}
+
+	err = fix_queue_trim(drain_batch_seq + drain_batch_len);
+	if (err) {
+		LOG_ERR("Failed to trim the fix queue, error: %d", err);
+	}
+
+	/* The remaining fixes start a new batch. */
+	batch_deadline = 0;
+	update_batch_deadline();
+	log_fix_queue_stats();
+
+	fix_queue_drain(false);
+}
+
+/**@brief Completion of a location data request. */
+static void data_response_handler(const struct coap_packet *response, void *user_data)
+{
+	if (response == NULL) {
+		LOG_WRN("Location data not acknowledged, retrying later");
+		fix_queue_drain_abort();
+		return;
+	}
+
+	fix_queue_drain_ack(coap_header_get_code(response));
+}
+
+static int handle_device_config_responce(char *device_config) {
+    cJSON *root = cJSON_Parse(device_config);
+    if (root == NULL) {
+        printf("Error: cJSON_Parse failed\n");
+        return -1;
+    }
+
+    cJSON *device_id = cJSON_GetObjectItem(root, "device_id");
+    cJSON *active_mode = cJSON_GetObjectItem(root, "active_mode");
+    cJSON *location_timeout = cJSON_GetObjectItem(root, "location_timeout");
+    cJSON *active_wait_timeout = cJSON_GetObjectItem(root, "active_wait_timeout");
+    cJSON *passive_wait_timeout = cJSON_GetObjectItem(root, "passive_wait_timeout");
+    cJSON *batch_size = cJSON_GetObjectItem(root, "batch_size");
+    cJSON *deadband_distance = cJSON_GetObjectItem(root, "deadband_distance");
+    cJSON *deadband_accuracy = cJSON_GetObjectItem(root, "deadband_accuracy");
+    cJSON *heartbeat_interval = cJSON_GetObjectItem(root, "heartbeat_interval");
+
+	/* Fields missing from the config keep their current value. */
+	struct app_cfg new_cfg = copy_cfg;
+
+
+    if (device_id != NULL && cJSON_IsNumber(device_id)) {
+		new_cfg.device_id = device_id->valueint;
+	}
+
+	if (active_mode != NULL && cJSON_IsBool(active_mode)) {
+		new_cfg.active_mode = cJSON_IsTrue(active_mode);
+	} else if (active_mode != NULL && cJSON_IsNumber(active_mode)) {
+		new_cfg.active_mode = active_mode->valueint;
+	}
+
+	if (location_timeout != NULL && cJSON_IsNumber(location_timeout)) {
+		new_cfg.location_timeout = location_timeout->valueint;
+	}
+
+	if (active_wait_timeout != NULL && cJSON_IsNumber(active_wait_timeout)) {
+		new_cfg.active_wait_timeout = active_wait_timeout->valueint;
+	}
+
+	if (passive_wait_timeout != NULL && cJSON_IsNumber(passive_wait_timeout)) {
+		new_cfg.passive_wait_timeout = passive_wait_timeout->valueint;
+	}
+
+	if (batch_size != NULL && cJSON_IsNumber(batch_size)) {
+		new_cfg.batch_size = batch_size->valueint;
+	}
+
+	if (deadband_distance != NULL && cJSON_IsNumber(deadband_distance)) {
+		new_cfg.deadband_distance = deadband_distance->valueint;
+	}
+
+	if (deadband_accuracy != NULL && cJSON_IsNumber(deadband_accuracy)) {
+		new_cfg.deadband_accuracy = deadband_accuracy->valueint;
+	}
+
+	if (heartbeat_interval != NULL && cJSON_IsNumber(heartbeat_interval)) {
+		new_cfg.heartbeat_interval = heartbeat_interval->valueint;
+	}
+	
+	struct cloud_module_event *cloud_module_event = new_cloud_module_event();
+	cloud_module_event->type = CLOUD_EVENT_CLOUD_CONFIG_RECEIVED;
+	cloud_module_event->cloud_cfg = new_cfg;
+	APP_EVENT_SUBMIT(cloud_module_event);
+
+    cJSON_Delete(root);
+	return 0;
+}
+
+/**@brief Add the payload of a response to the device config document.
+ *
+ * @param[out] next_block2 Block2 option of the next block to request.
+ *
+ * @return 1 if more blocks follow, 0 if the document is complete, or a
+ *	   negative error code.
+ */
+static int config_body_append(const struct coap_packet *reply, uint32_t *next_block2)
+{
+	int err = blockwise_download_append(reply, (uint8_t *)config_body,
+					    CONFIG_CLOUD_CONFIG_MAX_LEN, &config_body_len,
+					    next_block2);
+
+	config_body[config_body_len] = '\0';
+
+	return err;
+}
+
+/**@brief Handle a device config response or notification. */
+static int device_config_handle(const struct coap_packet *reply)
+{
+	int err;
+	uint32_t next_block2;
+
+	if (config_cache_update(reply)) {
+		LOG_INF("CoAP response: Code 0x%x, device config valid\n",
+			coap_header_get_code(reply));
+		return 0;
+	}
+
+	err = config_body_append(reply, &next_block2);
+	if (err < 0) {
+		return err;
+	} else if (err > 0) {
+		return client_get_device_config_block(next_block2 >> 4, next_block2 & 0x07);
+	}
+
+	/* Log the header code and payload of the response */
+	LOG_INF("CoAP response: Code 0x%x, Payload: %s\n",
+	       coap_header_get_code(reply), config_body_len > 0 ? config_body : "EMPTY");
+
+	if (config_body_len == 0) {
+		return 0;
+	}
+
+	err = handle_device_config_responce(config_body);
+	if (err < 0){
+		LOG_ERR("Failed to handle device config responce");
+		return err;
+	}
+
+	return 0;
+}
+
+/**@brief Completion of a device config GET. */
+static void config_response_handler(const struct coap_packet *response, void *user_data)
+{
+	config_pending = false;
+
+	if (response == NULL) {
+		LOG_WRN("No device config received");
+		return;
+	}
+
+	(void)device_config_handle(response);
+}
+
+/**@brief Completion of a device config GET that registers an observation. */
+static void config_observe_response_handler(const struct coap_packet *response, void *user_data)
+{
+	if (response != NULL) {
+		observe_registered(response);
+	}
+
+	config_response_handler(response, user_data);
+}
+
+#if defined(CONFIG_CLOUD_AGNSS)
+/* A-GNSS download. The request is sent again with each Block2 request, and
+ * the blocks are reassembled in agnss_buf before they are given to GNSS.
+ */
+static struct {
+	/* Request being downloaded. */
+	uint8_t request[ASSISTANCE_AGNSS_REQUEST_MAX_LEN];
+	size_t request_len;
+	/* Request waiting for the server connection or the running download. */
+	uint8_t pending[ASSISTANCE_AGNSS_REQUEST_MAX_LEN];
+	size_t pending_len;
+	/* A download is running. */
+	bool active;
+	size_t len;
+	uint32_t blocks;
+} agnss;
+
+static uint8_t agnss_buf[CONFIG_CLOUD_AGNSS_MAX_LEN];
+
+static void agnss_response_handler(const struct coap_packet *response, void *user_data);
+
+static int client_get_agnss_block(uint32_t block2)
+{
+	int err;
+	struct request_options options = {
+		.has_block2 = true,
+		.block2 = block2,
+	};
+
+	err = client_send_request(CONFIG_COAP_AGNSS_RESOURCE, COAP_CONTENT_FORMAT_APP_OCTET_STREAM,
+				  agnss.request, agnss.request_len, COAP_METHOD_FETCH,
+				  COAP_TYPE_CON, &options, agnss_response_handler, NULL);
+	agnss.active = err == 0;
+
+	return err;
+}
+
+/**@brief Start the download of the pending A-GNSS request. */
+static void agnss_fetch(void)
+{
+	int err;
+
+	if (agnss.pending_len == 0 || agnss.active ||
+	    sub_state != SUB_STATE_SERVER_CONNECTED) {
+		return;
+	}
+
+	memcpy(agnss.request, agnss.pending, agnss.pending_len);
+	agnss.request_len = agnss.pending_len;
+	agnss.pending_len = 0;
+	agnss.blocks = 0;
+
+	err = client_get_agnss_block(blockwise_option(0, false, BLOCKWISE_SZX_PREFERRED));
+	if (err) {
+		LOG_ERR("Failed to request A-GNSS data, error: %d", err);
+	}
+}
+
+/**@brief Handle a block of the A-GNSS data, and inject the data once all
+ *	  blocks are received.
+ */
+static void agnss_block_handle(const struct coap_packet *response)
+{
+	int err;
+	uint32_t next_block2;
+
+	if (response == NULL) {
+		LOG_WRN("No A-GNSS data received");
+		return;
+	}
+
+	if (coap_header_get_code(response) != COAP_RESPONSE_CODE_CONTENT) {
+		LOG_WRN("A-GNSS request failed, code 0x%x", coap_header_get_code(response));
+		return;
+	}
+
+	agnss.blocks++;
+
+	err = blockwise_download_append(response, agnss_buf, sizeof(agnss_buf), &agnss.len,
+					&next_block2);
+	if (err < 0) {
+		return;
+	} else if (err > 0) {
+		err = client_get_agnss_block(next_block2);
+		if (err) {
+			LOG_ERR("Failed to request A-GNSS block, error: %d", err);
+		}
+		return;
+	}
+
+	err = location_agnss_data_process((const char *)agnss_buf, agnss.len);
+	if (err) {
+		LOG_ERR("Failed to inject A-GNSS data, error: %d", err);
+		return;
+	}
+
+	LOG_INF("A-GNSS data injected, %zu bytes in %u blocks", agnss.len, agnss.blocks);
+
+#if defined(CONFIG_AGNSS_CACHE)
+	(void)agnss_cache_store(agnss_buf, agnss.len);
+#endif
+}
+
+static void agnss_response_handler(const struct coap_packet *response, void *user_data)
+{
+	agnss.active = false;
+	agnss_block_handle(response);
+
+	/* A request that came during the download. */
+	agnss_fetch();
+}
+
+/**@brief Queue the assistance data needed by GNSS, a newer request
+ *	  replaces a pending one.
+ */
+static void agnss_request(const struct nrf_modem_gnss_agnss_data_frame *request)
+{
+	bool needed = request->data_flags != 0;
+
+	for (size_t i = 0; i < MIN(request->system_count, ARRAY_SIZE(request->system)); i++) {
+		needed |= request->system[i].sv_mask_ephe || request->system[i].sv_mask_alm;
+	}
+
+	/* Answered from the A-GNSS cache. */
+	if (!needed) {
+		return;
+	}
+
+	agnss.pending_len = assistance_agnss_request_encode(request, agnss.pending);
+	agnss_fetch();
+}
+
+static void cell_location_response_handler(const struct coap_packet *response, void *user_data)
+{
+	struct location_data location;
+	const uint8_t *payload;
+	uint16_t payload_len;
+
+	if (response == NULL || coap_header_get_code(response) != COAP_RESPONSE_CODE_CONTENT) {
+		LOG_WRN("No cell location received");
+		location_cellular_ext_result_set(LOCATION_EXT_RESULT_ERROR, NULL);
+		return;
+	}
+
+	payload = coap_packet_get_payload(response, &payload_len);
+	if (assistance_cell_location_decode(payload, payload_len, &location)) {
+		LOG_ERR("Malformed cell location");
+		location_cellular_ext_result_set(LOCATION_EXT_RESULT_ERROR, NULL);
+		return;
+	}
+
+	location_cellular_ext_result_set(LOCATION_EXT_RESULT_SUCCESS, &location);
+}
+
+/**@brief Locate the cells with the server. The Location library waits for
+ *	  the result, so it is given also when the request cannot be sent.
+ */
+static void cell_location_request(const struct location_module_cells *cells)
+{
+	int err = -ENOTCONN;
+	uint8_t request[ASSISTANCE_CELLS_REQUEST_MAX_LEN];
+	size_t len = assistance_cells_request_encode(cells, request);
+
+	if (sub_state == SUB_STATE_SERVER_CONNECTED) {
+		err = client_send_request(CONFIG_COAP_CELLPOS_RESOURCE,
+					  COAP_CONTENT_FORMAT_APP_OCTET_STREAM, request, len,
+					  COAP_METHOD_FETCH, COAP_TYPE_CON, NULL,
+					  cell_location_response_handler, NULL);
+	}
 
-		new_location_data.pvt.longitude = msg->module.location.location.pvt.longitude;
-		new_location_data.pvt.latitude = msg->module.location.location.pvt.latitude;
-		new_location_data.pvt.altitude = msg->module.location.location.pvt.altitude;
-		new_location_data.pvt.accuracy = msg->module.location.location.pvt.accuracy;
-		new_location_data.pvt.speed = msg->module.location.location.pvt.speed;
-		new_location_data.pvt.heading = msg->module.location.location.pvt.heading;
-		
-		LOG_DBG("New_location_data:");
-		LOG_DBG("  latitude: %.06f", new_location_data.pvt.latitude);
-		LOG_DBG("  longitude: %.06f", new_location_data.pvt.longitude);
-		LOG_DBG("  accuracy: %.01f m", new_location_data.pvt.accuracy);
-		LOG_DBG("  altitude: %.01f m", new_location_data.pvt.altitude);
-		LOG_DBG("  speed: %.01f m", new_location_data.pvt.speed);
-		LOG_DBG("  heading: %.01f deg", new_location_data.pvt.heading);
-		
-		client_send_location_data(&new_location_data);
-		client_get_device_config();
+	if (err) {
+		LOG_WRN("Failed to request cell location, error: %d", err);
+		location_cellular_ext_result_set(LOCATION_EXT_RESULT_ERROR, NULL);
 	}
-	
 }
+#endif /* CONFIG_CLOUD_AGNSS */
+
+/**@brief Handles messages from the remote CoAP server. Responses complete
+ *	  their transaction, notifications update the device config.
+ */
+static int client_handle_response(uint8_t *buf, int received)
+{
+	struct coap_packet reply;
+	uint8_t token[COAP_TOKEN_MAX_LEN] = {0};
+	uint16_t token_len;
+	bool is_notification;
+	/* Parse the received CoAP packet */
+	int err = coap_packet_parse(&reply, buf, received, NULL, 0);
+	if (err < 0) {
+		LOG_ERR("Malformed response received: %d\n", err);
+		return err;
+	}
+
+#if defined(CONFIG_CLOUD_OSCORE)
+	/* Empty ACKs and resets are not protected, everything else must be. */
+	if (coap_header_get_code(&reply) != COAP_CODE_EMPTY) {
+		size_t len;
+
+		err = oscore_unprotect(buf, received, oscore_rx_buf, sizeof(oscore_rx_buf), &len);
+		if (err) {
+			LOG_ERR("Unprotected or invalid message dropped: %d", err);
+			if (coap_header_get_type(&reply) == COAP_TYPE_CON) {
+				client_send_empty(COAP_TYPE_RESET, &reply);
+			}
+			return err;
+		}
+
+		err = coap_packet_parse(&reply, oscore_rx_buf, len, NULL, 0);
+		if (err < 0) {
+			LOG_ERR("Malformed protected message received: %d\n", err);
+			return err;
+		}
+	}
+#endif
+
+	if (coap_transaction_handle(&reply)) {
+		/* Separate responses are confirmable. */
+		if (coap_header_get_type(&reply) == COAP_TYPE_CON) {
+			client_send_empty(COAP_TYPE_ACK, &reply);
+		}
+		return 0;
+	}
+
+	/* Not a response, confirm the token is the one of the device config
+	 * observation.
+	 */
+	token_len = coap_header_get_token(&reply, token);
+	is_notification = atomic_get(&observing) &&
+			  (token_len == sizeof(observe_token)) &&
+			  (memcmp(&observe_token, token, sizeof(observe_token)) == 0);
+
+	if (!is_notification) {
+		LOG_ERR("Invalid token received: 0x%02x%02x%02x%02x\n",
+		       token[3], token[2], token[1], token[0]);
+		/* Cancels observations the device no longer follows. */
+		if (coap_header_get_type(&reply) != COAP_TYPE_ACK &&
+		    coap_header_get_type(&reply) != COAP_TYPE_RESET) {
+			client_send_empty(COAP_TYPE_RESET, &reply);
+		}
+		return 0;
+	}
 
-static void on_all_states(struct cloud_msg_data *msg){
-	if ((IS_EVENT(msg, app, APP_EVENT_START)) || 
-		(IS_EVENT(msg, app, APP_EVENT_CONFIG_UPDATE))){
-		copy_cfg = msg->module.app.app_cfg;
+	if (coap_header_get_type(&reply) == COAP_TYPE_CON) {
+		client_send_empty(COAP_TYPE_ACK, &reply);
 	}
+
+	LOG_INF("Device config notification received");
+	observe_refresh(&reply);
+
+	return device_config_handle(&reply);
 }
 
+static void button_handler(uint32_t button_state, uint32_t has_changed)
+{
+	/*Send a GET request or PUT request upon button triggers */
+	if (has_changed & DK_BTN1_MSK && button_state & DK_BTN1_MSK) {
+		struct cloud_module_event *cloud_module_event = new_cloud_module_event();
+		cloud_module_event->type = CLOUD_EVENT_BUTTON_PRESSED;
+		APP_EVENT_SUBMIT(cloud_module_event);
+	}
+}
 
-int cloud_thread_fn(void)
+/**@brief Connect to the server. A failed attempt is retried after
+ *	  CONFIG_CLOUD_RECONNECT_DELAY seconds, as long as LTE is connected.
+ */
+static void connect_cloud(void)
 {
-	int err;
-    struct cloud_msg_data msg = {0};
+	struct cloud_module_event *cloud_module_event = new_cloud_module_event();
 
-	LOG_INF("started!");
+	cloud_module_event->type = CLOUD_EVENT_SERVER_CONNECTING;
+	APP_EVENT_SUBMIT(cloud_module_event);
 
-	k_sleep(K_SECONDS(3));
+	reconnect_at = 0;
+
+	if (server_resolve() != 0) {
+		LOG_INF("Failed to resolve server name");
+	} else if (client_init() != 0) {
+		LOG_INF("Failed to initialize client");
+	} else {
+		cloud_module_event = new_cloud_module_event();
+		cloud_module_event->type = CLOUD_EVENT_SERVER_CONNECTED;
+		APP_EVENT_SUBMIT(cloud_module_event);
+		return;
+	}
+
+	LOG_WRN("Connecting again in %d s", CONFIG_CLOUD_RECONNECT_DELAY);
+	reconnect_at = k_uptime_get() + (int64_t)CONFIG_CLOUD_RECONNECT_DELAY * MSEC_PER_SEC;
+}
+
+/**@brief Connect again once the server has not answered
+ *	  CONFIG_CLOUD_RECONNECT_TIMEOUTS requests in a row, or when a failed
+ *	  connection is due to be retried.
+ */
+static void reconnect_check(void)
+{
+	struct coap_transaction_stats stats;
+	struct cloud_module_event *cloud_module_event;
+
+	if (state != STATE_LTE_CONNECTED) {
+		return;
+	}
+
+	if (sub_state == SUB_STATE_SERVER_DISCONNECTED) {
+		if (reconnect_at != 0 && k_uptime_get() >= reconnect_at) {
+			connect_cloud();
+		}
+		return;
+	}
+
+	coap_transaction_stats_get(&stats);
+	if (stats.timeouts_in_row < CONFIG_CLOUD_RECONNECT_TIMEOUTS) {
+		return;
+	}
+
+	/* A second event submitted before the first is handled finds the
+	 * server disconnected and is ignored.
+	 */
+	LOG_WRN("%u CoAP requests in a row timed out, server lost", stats.timeouts_in_row);
+	cloud_module_event = new_cloud_module_event();
+	cloud_module_event->type = CLOUD_EVENT_SERVER_DISCONNECTED;
+	APP_EVENT_SUBMIT(cloud_module_event);
+}
+
+static void on_lte_init_start(struct cloud_msg_data *msg)
+{
+	set_state(STATE_LTE_DISCONNECTED);
+	set_sub_state(SUB_STATE_SERVER_DISCONNECTED);
+}
+
+static void on_lte_disconnected_lte_connected(struct cloud_msg_data *msg)
+{
+	set_state(STATE_LTE_CONNECTED);
+	connect_cloud();
+}
+
+static void on_lte_connected_lte_disconnected(struct cloud_msg_data *msg)
+{
+	set_state(STATE_LTE_DISCONNECTED);
+	set_sub_state(SUB_STATE_SERVER_DISCONNECTED);
+	reconnect_at = 0;
+	fix_queue_drain_abort();
+	observe_stop();
+	coap_transaction_cancel_all();
+}
+
+static void on_server_disconnected_connected(struct cloud_msg_data *msg)
+{
+	set_sub_state(SUB_STATE_SERVER_CONNECTED);
+	/* Send the fixes queued while disconnected, then fetch the device config. */
+	fix_queue_drain(true);
+#if defined(CONFIG_CLOUD_AGNSS)
+	agnss_fetch();
+#endif
+}
+
+static void on_server_connected_disconnected(struct cloud_msg_data *msg)
+{
+	set_sub_state(SUB_STATE_SERVER_DISCONNECTED);
+	fix_queue_drain_abort();
+	observe_stop();
+	coap_transaction_cancel_all();
+	/* The unsent fixes stay queued and are sent once connected again. */
+	connect_cloud();
+}
+
+static void on_server_connected_button_pressed(struct cloud_msg_data *msg)
+{
+	struct app_module_event *app_module_event = new_app_module_event();
+	app_module_event->type = APP_EVENT_LOCATION_GET;
+	APP_EVENT_SUBMIT(app_module_event);
+}
+
+static void on_config_update(struct cloud_msg_data *msg)
+{
+	copy_cfg = msg->module.app->app_cfg;
+}
+
+#if defined(CONFIG_CLOUD_AGNSS)
+static void on_agnss_request(struct cloud_msg_data *msg)
+{
+	agnss_request(&msg->module.location->agnss_request);
+}
+
+static void on_cellular_request(struct cloud_msg_data *msg)
+{
+	cell_location_request(&msg->module.location->cells);
+}
+#endif
+
+static void on_gnss_data_ready(struct cloud_msg_data *msg)
+{
+	struct cloud_location_data new_location_data = {
+		.gnss_ts = msg->module.location->location.timestamp
+	};
+
+	new_location_data.pvt.longitude = msg->module.location->location.pvt.longitude;
+	new_location_data.pvt.latitude = msg->module.location->location.pvt.latitude;
+	new_location_data.pvt.altitude = msg->module.location->location.pvt.altitude;
+	new_location_data.pvt.accuracy = msg->module.location->location.pvt.accuracy;
+	new_location_data.pvt.speed = msg->module.location->location.pvt.speed;
+	new_location_data.pvt.heading = msg->module.location->location.pvt.heading;
+	
+	LOG_DBG("New_location_data:");
+	LOG_DBG("  latitude: %.06f", new_location_data.pvt.latitude);
+	LOG_DBG("  longitude: %.06f", new_location_data.pvt.longitude);
+	LOG_DBG("  accuracy: %.01f m", new_location_data.pvt.accuracy);
+	LOG_DBG("  altitude: %.01f m", new_location_data.pvt.altitude);
+	LOG_DBG("  speed: %.01f m", new_location_data.pvt.speed);
+	LOG_DBG("  heading: %.01f deg", new_location_data.pvt.heading);
+
+	if (!deadband_report(&new_location_data)) {
+		return;
+	}
+
+	fix_queue_add(&new_location_data);
+
+	/* A batch that fills up while a batch is sent is sent after it. */
+	if (uplink_idle() && batch_ready()) {
+		fix_queue_drain(false);
+	}
+}
+
+MODULE_HANDLERS_DEFINE(state_lte_init_handlers, STATE_LTE_INIT_HANDLERS);
+MODULE_HANDLERS_DEFINE(state_lte_disconnected_handlers, STATE_LTE_DISCONNECTED_HANDLERS);
+MODULE_HANDLERS_DEFINE(state_lte_connected_handlers, STATE_LTE_CONNECTED_HANDLERS);
+MODULE_HANDLERS_DEFINE(sub_state_server_disconnected_handlers,
+		       SUB_STATE_SERVER_DISCONNECTED_HANDLERS);
+MODULE_HANDLERS_DEFINE(sub_state_server_connected_handlers, SUB_STATE_SERVER_CONNECTED_HANDLERS);
+MODULE_HANDLERS_DEFINE(all_states_handlers, ALL_STATES_HANDLERS);
+
+static void message_handler(struct cloud_msg_data *msg)
+{
+	switch (state)
+	{
+	case STATE_LTE_INIT:
+		MODULE_DISPATCH(state_lte_init_handlers, msg);
+		break;
+	case STATE_LTE_DISCONNECTED:
+		MODULE_DISPATCH(state_lte_disconnected_handlers, msg);
+		break;
+	case STATE_LTE_CONNECTED:
+		switch (sub_state)
+		{
+		case SUB_STATE_SERVER_DISCONNECTED:
+			MODULE_DISPATCH(sub_state_server_disconnected_handlers, msg);
+			break;
+		case SUB_STATE_SERVER_CONNECTED:
+			MODULE_DISPATCH(sub_state_server_connected_handlers, msg);
+			break;
+		default:
+			break;
+		}
+		MODULE_DISPATCH(state_lte_connected_handlers, msg);
+		break;
+	case STATE_SHUTDOWN:
+		break;
+
+	default:
+		LOG_ERR("Unknown state");
+		break;
+	}
+	MODULE_DISPATCH(all_states_handlers, msg);
+}
+
+/**@brief One-time initialization, after the boot delay. */
+static void cloud_init(void)
+{
+	int err;
 
 	LOG_INF("Cloud module started");
 
+	err = fix_queue_init();
+	if (err) {
+		LOG_ERR("Failed to initialize the fix queue, error: %d", err);
+	}
+
+	track_restore();
+
+#if defined(CONFIG_CLOUD_OSCORE)
+	err = oscore_init();
+	if (err) {
+		LOG_ERR("Failed to initialize OSCORE, error: %d", err);
+	}
+#endif
+
 	if (dk_buttons_init(button_handler) != 0) {
 		LOG_ERR("Failed to initialize the buttons library");
 	}
+}
+
+/**@brief Retransmit, time out requests and send batches that are old enough. */
+static void cloud_on_timeout(void)
+{
+	coap_transaction_process();
+	reconnect_check();
+	if (uplink_idle() && batch_ready()) {
+		/* Maximum batch age reached. */
+		fix_queue_drain(true);
+	}
+	requests_idle_check();
+}
+
+/**@brief Handle the datagram received by the receive thread. */
+static void cloud_on_rx(void)
+{
+	/* Parse the received CoAP packet */
+	int err = client_handle_response(rx_buf, rx_len);
+
+	if (err < 0) {
+		LOG_ERR("Handle response error: %d", err);
+	}
+	k_sem_give(&rx_consumed);
+	requests_idle_check();
+}
+
+static void cloud_on_events(void)
+{
+	struct cloud_msg_data msg = {0};
+
+	while (module_queue_get(&msgq_cloud, &msg.module.header, K_NO_WAIT) == 0) {
+		event_latency_record(EVENT_LATENCY_CLOUD, msg.module.header);
+		message_handler(&msg);
+		event_pool_unref(msg.module.header);
+	}
+}
+
+#if defined(CONFIG_MODULE_WORK_QUEUE)
+static void timeout_work_fn(struct k_work *work);
+static void rx_work_fn(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(timeout_work, timeout_work_fn);
+static K_WORK_DEFINE(rx_work, rx_work_fn);
+
+/**@brief Schedule the next retransmission, request timeout or batch age check. */
+static void timeout_reschedule(void)
+{
+	k_timeout_t timeout = event_timeout();
+
+	if (K_TIMEOUT_EQ(timeout, K_FOREVER)) {
+		k_work_cancel_delayable(&timeout_work);
+	} else {
+		k_work_reschedule_for_queue(&module_work_q, &timeout_work, timeout);
+	}
+}
+
+static void timeout_work_fn(struct k_work *work)
+{
+	cloud_on_timeout();
+	timeout_reschedule();
+}
+
+static void rx_work_fn(struct k_work *work)
+{
+	cloud_on_rx();
+	timeout_reschedule();
+}
+
+static void module_work_fn(struct k_work *work)
+{
+	cloud_on_events();
+	timeout_reschedule();
+}
+
+static void start_work_fn(struct k_work *work)
+{
+	cloud_init();
+	module_queue_run(&msgq_cloud, module_work_fn, K_NO_WAIT);
+}
+
+static K_WORK_DELAYABLE_DEFINE(start_work, start_work_fn);
+
+static int cloud_module_init(void)
+{
+	LOG_INF("started!");
+
+	k_work_schedule_for_queue(&module_work_q, &start_work, K_SECONDS(3));
+
+	return 0;
+}
+
+SYS_INIT(cloud_module_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+static void rx_notify(void)
+{
+	k_work_submit_to_queue(&module_work_q, &rx_work);
+}
+#else
+/* Raised by the receive thread when rx_buf holds a new datagram. */
+static struct k_poll_signal rx_signal = K_POLL_SIGNAL_INITIALIZER(rx_signal);
+
+static void rx_notify(void)
+{
+	k_poll_signal_raise(&rx_signal, 0);
+}
+
+/* The cloud module event loop. Blocks on both the message queue and the
+ * receive signal, and only wakes up when there is an event to handle, a
+ * response was received or an outstanding request must be retransmitted.
+ */
+int cloud_thread_fn(void)
+{
+	int err;
+	struct k_poll_event events[] = {
+		K_POLL_EVENT_INITIALIZER(K_POLL_TYPE_MSGQ_DATA_AVAILABLE,
+					 K_POLL_MODE_NOTIFY_ONLY, msgq_cloud.msgq),
+		K_POLL_EVENT_INITIALIZER(K_POLL_TYPE_SIGNAL,
+					 K_POLL_MODE_NOTIFY_ONLY, &rx_signal),
+	};
+
+	LOG_INF("started!");
+
+	k_sleep(K_SECONDS(3));
+
+	cloud_init();
 
 	while (1) {
-        err = k_msgq_get(&msgq_cloud, &msg, K_FOREVER);
-		if (err) {
-            LOG_ERR("Failed to get event from message queue: %d", err);
-            /* Handle the error */
-        } else {
-			switch (state)
-			{
-			case STATE_LTE_INIT:
-				on_state_lte_init(&msg);
-				break;
-			case STATE_LTE_DISCONNECTED:
-				on_state_lte_disconnected(&msg);
-				break;
-			case STATE_LTE_CONNECTED:
-				switch (sub_state)
-				{
-				case SUB_STATE_SERVER_DISCONNECTED:
-					on_sub_state_server_disconnected(&msg);
-					break;
-				case SUB_STATE_SERVER_CONNECTED:
-					on_sub_state_server_connected(&msg);
-					break;
-				default:
-					break;
-				}
-				on_state_lte_connected(&msg);
-				break;
-			case STATE_SHUTDOWN:
-				break;
-			
-			default:
-				LOG_ERR("Unknown state");
-				break;
-			}
-			on_all_states(&msg);
+		err = k_poll(events, ARRAY_SIZE(events), event_timeout());
+		if (err == -EAGAIN) {
+			cloud_on_timeout();
+			continue;
+		} else if (err) {
+			LOG_ERR("Failed to poll cloud module events: %d", err);
+			continue;
 		}
-	}
 
-	k_sem_take(&socket_sem, K_FOREVER); // Take the semaphore
+		if (events[1].state == K_POLL_STATE_SIGNALED) {
+			events[1].state = K_POLL_STATE_NOT_READY;
+			k_poll_signal_reset(&rx_signal);
+			cloud_on_rx();
+		}
 
-	(void)close(sock);
+		if (events[0].state == K_POLL_STATE_MSGQ_DATA_AVAILABLE) {
+			events[0].state = K_POLL_STATE_NOT_READY;
+			cloud_on_events();
+		}
+	}
 
-	k_sem_give(&socket_sem); // Give the semaphore
+	(void)close(sock);
 
 	return 0;
 }
 
-void coap_response_thread_fs(void *arg1, void *arg2, void *arg3){
+K_THREAD_DEFINE(cloud_module_thread, CONFIG_CLOUD_THREAD_STACK_SIZE,
+		cloud_thread_fn, NULL, NULL, NULL,
+		K_LOWEST_APPLICATION_THREAD_PRIO, 0, 0);
+#endif /* CONFIG_MODULE_WORK_QUEUE */
+
+/**@brief Time in milliseconds to wait for a datagram. Responses are waited
+ *	  for with the separate response timeout, notifications until the
+ *	  observation expires.
+ *
+ * @return Timeout of the poll, 0 once nothing is expected anymore.
+ */
+static int rx_poll_timeout(int64_t expiry)
+{
+	int64_t remaining;
+
+	if (coap_transaction_count() > 0) {
+		return CONFIG_CLOUD_RESPONSE_TIMEOUT_MS;
+	}
+
+	if (!atomic_get(&observing)) {
+		return 0;
+	}
+
+	remaining = expiry - k_uptime_get();
+	if (remaining <= 0) {
+		/* The server no longer owes notifications, the next device
+		 * config GET registers the observation again.
+		 */
+		LOG_DBG("Device config observation expired");
+		atomic_set(&observing, 0);
+		return 0;
+	}
+
+	/* At most CONFIG_CLOUD_OBSERVE_LIFETIME seconds ahead. */
+	return (int)remaining;
+}
 
-	int received;
+/* Listens to the socket only while requests are outstanding or the device
+ * config is observed. The thread blocks in poll() so the CPU can idle until
+ * a datagram arrives. While only the observation is pending, the poll waits
+ * until the observation expires instead of waking up periodically. Closing
+ * the socket in client_init() ends the poll.
+ */
+void coap_rx_thread_fn(void *arg1, void *arg2, void *arg3)
+{
+	struct pollfd fds = {
+		.events = POLLIN
+	};
+	int64_t expiry;
+	int timeout;
 	int err;
 
-    while (1) 
-	{
-		if (state == STATE_LTE_CONNECTED && sub_state == SUB_STATE_SERVER_CONNECTED) {
-
-			k_sem_take(&socket_sem, K_FOREVER); // Take the semaphore
-			
-			received = recv(sock, coap_buf, sizeof(coap_buf), ZSOCK_MSG_DONTWAIT);
-
-			k_sem_give(&socket_sem); // Give the semaphore
-
-			if (received < 0) {
-				if (errno == EAGAIN || errno == EWOULDBLOCK) {
-					/* No data available, yield the thread to allow other threads to run */
-					k_yield();
-					continue;
-				} else {
-					LOG_ERR("Socket error: %d, exit\n", errno);
-					break;
+	while (1) {
+		k_sem_take(&rx_armed, K_FOREVER);
+
+		while (1) {
+			k_mutex_lock(&sock_lock, K_FOREVER);
+			fds.fd = sock;
+			expiry = observe_expiry;
+			k_mutex_unlock(&sock_lock);
+
+			timeout = rx_poll_timeout(expiry);
+			if (timeout == 0) {
+				break;
+			}
+
+			if (fds.fd < 0) {
+				k_sleep(K_MSEC(CONFIG_CLOUD_RESPONSE_TIMEOUT_MS));
+				continue;
+			}
+
+			err = poll(&fds, 1, timeout);
+			if (err == 0) {
+				/* Timed out, check if a datagram is still expected. */
+				continue;
+			}
+
+			k_mutex_lock(&sock_lock, K_FOREVER);
+
+			/* The socket was closed or opened again while polling. */
+			if (fds.fd != sock) {
+				k_mutex_unlock(&sock_lock);
+				continue;
+			}
+
+			if (err < 0 || (fds.revents & (POLLERR | POLLNVAL))) {
+				k_mutex_unlock(&sock_lock);
+				LOG_ERR("Socket poll error: %d", err < 0 ? errno : fds.revents);
+				/* Until the socket is opened again, or nothing is expected. */
+				k_sleep(K_MSEC(CONFIG_CLOUD_RESPONSE_TIMEOUT_MS));
+				continue;
+			}
+
+			rx_len = recv(sock, rx_buf, sizeof(rx_buf), MSG_DONTWAIT);
+			k_mutex_unlock(&sock_lock);
+
+			if (rx_len < 0) {
+				if (errno != EAGAIN) {
+					LOG_ERR("Socket error: %d", errno);
+					k_sleep(K_MSEC(CONFIG_CLOUD_RESPONSE_TIMEOUT_MS));
 				}
-			} else if (received == 0) {
+				continue;
+			} else if (rx_len == 0) {
 				LOG_INF("Empty datagram\n");
 				continue;
 			}
 
-			/* Parse the received CoAP packet */
-			err = client_handle_response(coap_buf, received);
-			if (err < 0) {
-				LOG_ERR("Handle response error: %d, exit\n", errno);
-			}
+			rx_notify();
+			k_sem_take(&rx_consumed, K_FOREVER);
 		}
-		else {
-			k_yield();
-		}
-    }
+	}
 }
 
-K_THREAD_DEFINE(coap_thread_id, 2048,
-		coap_response_thread_fs, NULL, NULL, NULL, 
+K_THREAD_DEFINE(coap_thread_id, CONFIG_CLOUD_RX_THREAD_STACK_SIZE,
+		coap_rx_thread_fn, NULL, NULL, NULL,
 		K_LOWEST_APPLICATION_THREAD_PRIO, 0, 0);
 
-K_THREAD_DEFINE(cloud_module_thread, 2048,
-		cloud_thread_fn, NULL, NULL, NULL,
-		K_LOWEST_APPLICATION_THREAD_PRIO, 0, 0);
-	
 APP_EVENT_LISTENER(MODULE, app_event_handler);
-APP_EVENT_SUBSCRIBE(MODULE, app_module_event);
-APP_EVENT_SUBSCRIBE(MODULE, modem_module_event);
-APP_EVENT_SUBSCRIBE(MODULE, cloud_module_event);
-APP_EVENT_SUBSCRIBE(MODULE, location_module_event);
\ No newline at end of file
+MODULE_SOURCES(MODULE_EVENT_SUBSCRIBE)
@@ -13,6 +13,7 @@
 #include "events/cloud_module_event.h"
 #include "events/modem_module_event.h"
 #include "events/location_module_event.h"
+#include "events/event_latency.h"
 
 /* Application module super states. */
 static enum state_type {
@@ -37,13 +38,35 @@ static enum sub_sub_state_type {
 
 struct led_msg_data {
 	union {
-		struct app_module_event app;
-		struct cloud_module_event cloud;
-		struct modem_module_event modem;
-		struct location_module_event location;
+		const struct app_event_header *header;
+		const struct app_module_event *app;
+		const struct cloud_module_event *cloud;
+		const struct modem_module_event *modem;
+		const struct location_module_event *location;
 	} module;
 };
 
+/* Events handled by this module, by state, see modules_common.h. */
+#define MODULE_SOURCES(X) X(app) X(cloud) X(location)
+
+#define STATE_CLOUD_CONNECTING_HANDLERS(X)						\
+	X(cloud, CLOUD_EVENT_SERVER_CONNECTED, on_cloud_connecting_connected)
+
+#define SUB_SUB_STATE_LOCATION_SEARCHING_HANDLERS(X)					\
+	X(location, LOCATION_EVENT_INACTIVE, on_searching_location_inactive)
+
+#define ALL_STATES_HANDLERS(X)								\
+	X(location, LOCATION_EVENT_ACTIVE, on_location_active)				\
+	X(cloud, CLOUD_EVENT_SERVER_CONNECTING, on_server_connecting)			\
+	X(app, APP_EVENT_CONFIG_UPDATE, on_config_update)
+
+#define MODULE_HANDLERS(X)								\
+	STATE_CLOUD_CONNECTING_HANDLERS(X) SUB_SUB_STATE_LOCATION_SEARCHING_HANDLERS(X)	\
+	ALL_STATES_HANDLERS(X)
+
+MODULE_DISPATCH_DEFINE(struct led_msg_data, MODULE_SOURCES)
+MODULE_EVENT_FILTER_DEFINE(MODULE_HANDLERS)
+
 #define MODULE led_module
 
 LOG_MODULE_REGISTER(MODULE, LOG_LEVEL_DBG);
@@ -146,154 +169,85 @@ static void send_led_event(enum led_id led_id, const struct led_effect *led_effe
 
 
 static bool app_event_handler(const struct app_event_header *aeh){
-	bool consume = false;
-	struct led_msg_data msg = {0};
-
-	if (is_app_module_event(aeh)){
-		struct app_module_event *event = cast_app_module_event(aeh);
-		msg.module.app = *event;
-        message_handler(&msg);
-	}
-	
-	if (is_cloud_module_event(aeh)){
-		struct cloud_module_event *event = cast_cloud_module_event(aeh);
-		msg.module.cloud = *event;
-        message_handler(&msg);
-    }
-
-	
-	if (is_modem_module_event(aeh)){
-		struct modem_module_event *event = cast_modem_module_event(aeh);
-		msg.module.modem = *event;
-        message_handler(&msg);
-	}
+	struct led_msg_data msg = {
+		.module.header = aeh
+	};
 
-	
-	if (is_location_module_event(aeh)){
-		struct location_module_event *event = cast_location_module_event(aeh);
-		msg.module.location = *event;
-        message_handler(&msg);
+	if (module_event_accept(aeh)) {
+		event_latency_record(EVENT_LATENCY_LED, aeh);
+		message_handler(&msg);
 	}
 
-	return consume;
-}
-
-static void on_state_init(struct led_msg_data *msg){
-
-}
-
-static void on_state_running(struct led_msg_data *msg){
-    
+	return false;
 }
 
-static void on_sub_state_active_mode(struct led_msg_data *msg){
-    
+static void on_searching_location_inactive(struct led_msg_data *msg){
+    set_sub_sub_state(SUB_SUB_STATE_LOCATION_NOT_SEARCHING);
+    if (sub_state == SUB_STATE_ACTIVE_MODE){
+    	LOG_DBG("Setting led state to LED_STATE_ACTIVE_MODE");
+        send_led_event(LED_ID_1, &led_effect[LED_STATE_ACTIVE_MODE]);
+    } else {
+    	LOG_DBG("Setting led state to LED_STATE_PASSIVE_MODE");
+        send_led_event(LED_ID_1, &led_effect[LED_STATE_PASSIVE_MODE]);
+    }
 }
 
-static void on_sub_state_passive_mode(struct led_msg_data *msg){
-    
+static void on_cloud_connecting_connected(struct led_msg_data *msg){
+    if (sub_state == SUB_STATE_ACTIVE_MODE){
+    	LOG_DBG("Setting led state to LED_STATE_ACTIVE_MODE");
+        send_led_event(LED_ID_1, &led_effect[LED_STATE_ACTIVE_MODE]);
+    } else {
+    	LOG_DBG("Setting led state to LED_STATE_PASSIVE_MODE");
+        send_led_event(LED_ID_1, &led_effect[LED_STATE_PASSIVE_MODE]);
+    }
+    set_state(STATE_RUNNING);
 }
 
-static void on_sub_sub_state_location_searching(struct led_msg_data *msg){
-    if (IS_EVENT(msg, location, LOCATION_EVENT_INACTIVE)){
-        set_sub_sub_state(SUB_SUB_STATE_LOCATION_NOT_SEARCHING);
-        if (sub_state == SUB_STATE_ACTIVE_MODE){
-        	LOG_DBG("Setting led state to LED_STATE_ACTIVE_MODE");
-            send_led_event(LED_ID_1, &led_effect[LED_STATE_ACTIVE_MODE]);
-        } else {
-        	LOG_DBG("Setting led state to LED_STATE_PASSIVE_MODE");
-            send_led_event(LED_ID_1, &led_effect[LED_STATE_PASSIVE_MODE]);
-        }
-	}
+static void on_location_active(struct led_msg_data *msg){
+    LOG_DBG("Setting led state to LED_STATE_LOCATION_SEARCHING");
+    send_led_event(LED_ID_1, &led_effect[LED_STATE_LOCATION_SEARCHING]);
+    set_sub_sub_state(SUB_SUB_STATE_LOCATION_SEARCHING);
 }
 
-static void on_sub_sub_state_location_not_searching(struct led_msg_data *msg){
-    
+static void on_server_connecting(struct led_msg_data *msg){
+    LOG_DBG("Setting led state to LED_STATE_CLOUD_CONNECTING");
+    send_led_event(LED_ID_1, &led_effect[LED_STATE_CLOUD_CONNECTING]);
+    set_state(STATE_CLOUD_CONNECTING);
 }
 
-static void on_state_cloud_connecting(struct led_msg_data *msg){
-    if (IS_EVENT(msg, cloud, CLOUD_EVENT_SERVER_CONNECTED)){
-        if (sub_state == SUB_STATE_ACTIVE_MODE){
-        	LOG_DBG("Setting led state to LED_STATE_ACTIVE_MODE");
-            send_led_event(LED_ID_1, &led_effect[LED_STATE_ACTIVE_MODE]);
-        } else {
-        	LOG_DBG("Setting led state to LED_STATE_PASSIVE_MODE");
-            send_led_event(LED_ID_1, &led_effect[LED_STATE_PASSIVE_MODE]);
-        }
-        set_state(STATE_RUNNING);
-	}
+static void on_config_update(struct led_msg_data *msg){
+	// TODO: add led blinking for short time
+    if (msg->module.app->app_cfg.active_mode){
+        set_sub_state(SUB_STATE_ACTIVE_MODE);
+    } else {
+        set_sub_state(SUB_STATE_PASSIVE_MODE);
+    }
 }
 
-static void on_all_states(struct led_msg_data *msg){
-    if (IS_EVENT(msg, location, LOCATION_EVENT_ACTIVE)){
-        LOG_DBG("Setting led state to LED_STATE_LOCATION_SEARCHING");
-        send_led_event(LED_ID_1, &led_effect[LED_STATE_LOCATION_SEARCHING]);
-        set_sub_sub_state(SUB_SUB_STATE_LOCATION_SEARCHING);
-	}
-    // if (IS_EVENT(msg, cloud, CLOUD_EVENT_DATA_SENT)){
-    //     LOG_DBG("Setting led state to LED_STATE_CLOUD_SENDING_DATA");
-    //     send_led_event(LED_ID_1, &led_effect[LED_STATE_CLOUD_SENDING_DATA]);
-	// }
-    if (IS_EVENT(msg, cloud, CLOUD_EVENT_SERVER_CONNECTING)){
-        LOG_DBG("Setting led state to LED_STATE_CLOUD_CONNECTING");
-        send_led_event(LED_ID_1, &led_effect[LED_STATE_CLOUD_CONNECTING]);
-        set_state(STATE_CLOUD_CONNECTING);
-	}
-    if (IS_EVENT(msg, app, APP_EVENT_CONFIG_UPDATE)){
-		// TODO: add led blinking for short time
-        if (msg->module.app.app_cfg.active_mode){
-            set_sub_state(SUB_STATE_ACTIVE_MODE);
-        } else {
-            set_sub_state(SUB_STATE_PASSIVE_MODE);
-        }
-	}
-}
+MODULE_HANDLERS_DEFINE(state_cloud_connecting_handlers, STATE_CLOUD_CONNECTING_HANDLERS);
+MODULE_HANDLERS_DEFINE(sub_sub_state_location_searching_handlers,
+		       SUB_SUB_STATE_LOCATION_SEARCHING_HANDLERS);
+MODULE_HANDLERS_DEFINE(all_states_handlers, ALL_STATES_HANDLERS);
 
 static void message_handler(struct led_msg_data *msg){
 
     switch (state) {
-    case STATE_INIT:
-        on_state_init(msg);
-        break;
     case STATE_RUNNING:
-        switch (sub_state) {
-        case SUB_STATE_ACTIVE_MODE:
-            switch (sub_sub_state) {
-            case SUB_SUB_STATE_LOCATION_SEARCHING:
-                on_sub_sub_state_location_searching(msg);
-                break;
-            case SUB_SUB_STATE_LOCATION_NOT_SEARCHING:
-                on_sub_sub_state_location_not_searching(msg);
-                break;
-            }
-            on_sub_state_active_mode(msg);
-            break;
-        case SUB_STATE_PASSIVE_MODE:
-            switch (sub_sub_state) {
-            case SUB_SUB_STATE_LOCATION_SEARCHING:
-                on_sub_sub_state_location_searching(msg);
-                break;
-            case SUB_SUB_STATE_LOCATION_NOT_SEARCHING:
-                on_sub_sub_state_location_not_searching(msg);
-                break;
-            }
-            on_sub_state_passive_mode(msg);
-            break;
+        /* Both sub states handle the location search the same way. */
+        if (sub_sub_state == SUB_SUB_STATE_LOCATION_SEARCHING) {
+            MODULE_DISPATCH(sub_sub_state_location_searching_handlers, msg);
         }
-        on_state_running(msg);
         break;
     case STATE_CLOUD_CONNECTING:
-        on_state_cloud_connecting(msg);
+        MODULE_DISPATCH(state_cloud_connecting_handlers, msg);
         break;
+    case STATE_INIT:
     case STATE_SHUTDOWN:
         // Do nothing
         break;
     }
-	on_all_states(msg);
+	MODULE_DISPATCH(all_states_handlers, msg);
 }
 
 APP_EVENT_LISTENER(MODULE, app_event_handler);
-APP_EVENT_SUBSCRIBE(MODULE, app_module_event);
-APP_EVENT_SUBSCRIBE(MODULE, modem_module_event);
-APP_EVENT_SUBSCRIBE(MODULE, cloud_module_event);
-APP_EVENT_SUBSCRIBE(MODULE, location_module_event);
\ No newline at end of file
+MODULE_SOURCES(MODULE_EVENT_SUBSCRIBE)
@@ -6,18 +6,31 @@
 
 #include <string.h>
 #include <zephyr/kernel.h>
+#include <zephyr/init.h>
 #include <nrf_modem_at.h>
 #include <modem/lte_lc.h>
 #include <modem/location.h>
+#include <modem/modem_info.h>
 #include <modem/nrf_modem_lib.h>
 #include <date_time.h>
 #include <nrf_modem_gnss.h>
+#include <zephyr/sys/timeutil.h>
 
 #include "modules/modules_common.h"
 #include "events/app_module_event.h"
 #include "events/cloud_module_event.h"
 #include "events/modem_module_event.h"
 #include "events/location_module_event.h"
+#include "events/event_latency.h"
+#include "events/event_pool.h"
+#include "events/module_queue.h"
+#include "location/method_select.h"
+#if defined(CONFIG_AGNSS_CACHE)
+#include "location/agnss_cache.h"
+#endif
+#if defined(CONFIG_GNSS_ASSIST)
+#include "location/gnss_assist.h"
+#endif
 
 static K_SEM_DEFINE(time_update_finished, 0, 1);
 
@@ -27,13 +40,62 @@ LOG_MODULE_REGISTER(MODULE, LOG_LEVEL_DBG);
 
 struct location_msg_data {
 	union {
-		struct app_module_event app;
-		struct cloud_module_event cloud;
-		struct modem_module_event modem;
-		struct location_module_event location;
+		const struct app_event_header *header;
+		const struct app_module_event *app;
+		const struct cloud_module_event *cloud;
+		const struct modem_module_event *modem;
+		const struct location_module_event *location;
 	} module;
 };
 
+/* Events handled by this module, by state, see modules_common.h. */
+#define MODULE_SOURCES(X) X(app) X(modem) X(location)
+
+#define STATE_INIT_HANDLERS(X)								\
+	X(modem, MODEM_EVENT_LTE_CONNECTED, on_init_lte_connected)
+
+#define SUB_STATE_IDLE_HANDLERS(X)							\
+	X(location, LOCATION_EVENT_ACTIVE, on_idle_location_active)			\
+	X(app, APP_EVENT_LOCATION_GET, on_idle_location_get)
+
+#define SUB_STATE_SEARCHING_HANDLERS(X)							\
+	X(location, LOCATION_EVENT_INACTIVE, on_searching_location_inactive)		\
+	X(app, APP_EVENT_LOCATION_GET, on_searching_location_get)
+
+#define ALL_STATES_HANDLERS(X)								\
+	X(app, APP_EVENT_START, on_config_update)					\
+	X(app, APP_EVENT_CONFIG_UPDATE, on_config_update)
+
+#define MODULE_HANDLERS(X)								\
+	STATE_INIT_HANDLERS(X) SUB_STATE_IDLE_HANDLERS(X) SUB_STATE_SEARCHING_HANDLERS(X)	\
+	ALL_STATES_HANDLERS(X)
+
+MODULE_DISPATCH_DEFINE(struct location_msg_data, MODULE_SOURCES)
+MODULE_EVENT_FILTER_DEFINE(MODULE_HANDLERS)
+
+/* A location request while the queue is full is dropped, the search it
+ * would start is either running already or repeated by the sample timer.
+ */
+static enum module_queue_policy queue_policy(const struct app_event_header *aeh)
+{
+	struct location_msg_data data = { .module.header = aeh };
+	struct location_msg_data *msg = &data;
+
+	if (IS_EVENT(msg, app, APP_EVENT_CONFIG_UPDATE)) {
+		return MODULE_QUEUE_COALESCE;
+	}
+
+	if (IS_EVENT(msg, app, APP_EVENT_LOCATION_GET)) {
+		return MODULE_QUEUE_DROP;
+	}
+
+	return MODULE_QUEUE_SPILL;
+}
+
+#define MSG_Q_SIZE 20
+
+MODULE_QUEUE_DEFINE(msgq_location, MSG_Q_SIZE, queue_policy);
+
 static enum state_type {
     STATE_INIT,
     STATE_RUNNING,
@@ -47,10 +109,49 @@ static enum sub_state_type {
 
 static struct app_cfg copy_cfg;
 
-static struct nrf_modem_gnss_pvt_data_frame pvt_data;
+/* GNSS and cellular positioning. */
+#define METHOD_COUNT 2
+
+/* Config of the location requests, built from copy_cfg. */
+static struct location_config config;
+
+/* Timeouts of a request in milliseconds, from the location timeout of
+ * copy_cfg or the library defaults.
+ */
+static int timeout_total;
+static int gnss_budget;
+static int cellular_budget;
+
+/* Uptime at the start of the running request. */
+static int64_t request_start;
+
+#if defined(CONFIG_LOCATION_METHOD_SELECT)
+#define RSRP_UNKNOWN 255
+#define RSRP_OFFSET 140
+
+/* Conditions of the running request. */
+static struct method_select_context request_ctx;
+
+/* Uptime of the last GNSS fix, or -1. */
+static int64_t gnss_fix_at = -1;
+#endif
+
+#if defined(CONFIG_AGNSS_CACHE)
+/* The cache is given to GNSS once, before the first request after the boot. */
+static bool cache_injected;
+/* The first search after the boot started with cached data. */
+static bool cache_used;
+static bool first_fix_recorded;
+/* An assistance request of the running search was answered from the cache. */
+static bool cache_answered;
+#endif
+
+#if defined(CONFIG_GNSS_ASSIST)
+/* Assistance given to GNSS before the running search. */
+static int assisted;
+#endif
 
-/* Forward declarations*/
-static void message_handler(struct location_msg_data *msg);
+static struct nrf_modem_gnss_pvt_data_frame pvt_data;
 
 static char *state_to_string(enum state_type state)
 {
@@ -104,36 +205,15 @@ static void set_sub_state(enum sub_state_type new_sub_state)
     sub_state = new_sub_state;
 }
 
+/* The location library is called from the module thread, so that the
+ * event manager never waits for the modem or GNSS.
+ */
 static bool app_event_handler(const struct app_event_header *aeh){
-	bool consume = false;
-	struct location_msg_data msg = {0};
-	if (is_app_module_event(aeh)){
-		struct app_module_event *event = cast_app_module_event(aeh);
-		msg.module.app = *event;
-        message_handler(&msg);
-	}
-	
-	if (is_cloud_module_event(aeh)){
-		struct cloud_module_event *event = cast_cloud_module_event(aeh);
-		msg.module.cloud = *event;
-        message_handler(&msg);
-    }
-
-	
-	if (is_modem_module_event(aeh)){
-		struct modem_module_event *event = cast_modem_module_event(aeh);
-		msg.module.modem = *event;
-        message_handler(&msg);
+	if (module_event_accept(aeh) && module_queue_put(&msgq_location, aeh)) {
+		LOG_ERR("Event queue full, event dropped");
 	}
 
-	
-	if (is_location_module_event(aeh)){
-		struct location_module_event *event = cast_location_module_event(aeh);
-		msg.module.location = *event;
-        message_handler(&msg);
-	}
-
-	return consume;
+	return false;
 }
 
 static void date_time_evt_handler(const struct date_time_evt *evt)
@@ -177,11 +257,194 @@ static void send_pvt_data(){
         APP_EVENT_SUBMIT(location_module_event);
 }
 
-static void location_event_handler(const struct location_event_data *event_data)
+#if defined(CONFIG_LOCATION_METHOD_SELECT)
+static void request_context_get(struct method_select_context *ctx)
+{
+	uint16_t rsrp;
+
+	ctx->rsrp = INT16_MIN;
+	if (modem_info_short_get(MODEM_INFO_RSRP, &rsrp) > 0 && rsrp != RSRP_UNKNOWN) {
+		ctx->rsrp = (int16_t)rsrp - RSRP_OFFSET;
+	}
+
+	ctx->gnss_age = gnss_fix_at < 0 ? -1 :
+			(int32_t)((k_uptime_get() - gnss_fix_at) / MSEC_PER_SEC);
+}
+
+static int method_timeout(size_t i)
 {
+	if (config.methods[i].method == LOCATION_METHOD_GNSS) {
+		return config.methods[i].gnss.timeout;
+	}
+
+	return config.methods[i].cellular.timeout;
+}
+
+/**@brief Record the outcome of the request for the method selection. The
+ *	  Location library only reports the method that gave the fix. A method
+ *	  tried before it is counted as failed after its timeout, which
+ *	  overestimates a method that fails early, such as cellular positioning
+ *	  without a network.
+ */
+static void method_outcome_record(const struct location_event_data *event_data)
+{
+	int64_t elapsed = k_uptime_get() - request_start;
+
+	for (size_t i = 0; i < config.methods_count && elapsed > 0; i++) {
+		enum location_method method = config.methods[i].method;
+		int timeout = method_timeout(i);
+		int64_t time = timeout < 0 ? elapsed : MIN(elapsed, timeout);
+
+		if (event_data->id == LOCATION_EVT_LOCATION && event_data->method == method) {
+			method_select_record(&request_ctx, method, true, elapsed,
+					     event_data->location.accuracy);
+			return;
+		}
+
+		method_select_record(&request_ctx, method, false, time, 0.0f);
+		elapsed -= time;
+	}
+}
+#endif /* CONFIG_LOCATION_METHOD_SELECT */
+
+#if defined(CONFIG_AGNSS_CACHE)
+/**@brief Give the cached assistance data to GNSS before the first search,
+ *	  so that it does not wait for the download. Without the time the
+ *	  validity is not known, and it is tried again at the next search.
+ */
+static void agnss_cache_boot_inject(void)
+{
+	int err;
+
+	if (cache_injected) {
+		return;
+	}
+
+	err = agnss_cache_inject();
+	if (err == -EAGAIN) {
+		LOG_WRN("Time not known, A-GNSS cache not injected");
+		return;
+	} else if (err < 0 && err != -ENODATA) {
+		LOG_ERR("Failed to inject the A-GNSS cache, error: %d", err);
+	}
+
+	cache_injected = true;
+	cache_used = !first_fix_recorded && err > 0;
+}
+
+/**@brief Answer from the cache the part of an assistance request that it
+ *	  holds, the rest is downloaded. Only the first request of a search
+ *	  is answered, if GNSS asks again it did not accept the cached data.
+ */
+static void agnss_cache_answer(struct nrf_modem_gnss_agnss_data_frame *request)
+{
+	int err;
+	struct nrf_modem_gnss_agnss_data_frame full = *request;
+
+	if (cache_answered) {
+		return;
+	}
+
+	cache_answered = true;
+
+	if (!agnss_cache_trim(request)) {
+		return;
+	}
+
+	err = agnss_cache_inject();
+	if (err < 0) {
+		LOG_WRN("Failed to inject the A-GNSS cache, error: %d", err);
+		*request = full;
+	}
+}
+
+static void first_fix_record(const struct location_event_data *event_data)
+{
+	if (first_fix_recorded || event_data->id != LOCATION_EVT_LOCATION ||
+	    event_data->method != LOCATION_METHOD_GNSS) {
+		return;
+	}
+
+	first_fix_recorded = true;
+	agnss_cache_ttff_record(cache_used, event_data->location.details.gnss.elapsed_time_gnss);
+}
+#endif /* CONFIG_AGNSS_CACHE */
+
+#if defined(CONFIG_GNSS_ASSIST)
+/**@brief Keep the fix as the last known position for later searches, and
+ *	  record the time to fix of GNSS.
+ */
+static void assist_fix_update(const struct location_event_data *event_data)
+{
+	const struct location_datetime *datetime = &event_data->location.datetime;
+	bool gnss = event_data->method == LOCATION_METHOD_GNSS;
+	struct gnss_assist_fix fix = {
+		.latitude = event_data->location.latitude,
+		.longitude = event_data->location.longitude,
+		.accuracy = event_data->location.accuracy,
+	};
+
+	if (gnss) {
+		fix.altitude = event_data->location.details.gnss.pvt_data.altitude;
+		fix.altitude_accuracy = event_data->location.details.gnss.pvt_data.altitude_accuracy;
+		gnss_assist_ttff_record(assisted, event_data->location.details.gnss.elapsed_time_gnss);
+	}
 
+	if (datetime->valid) {
+		struct tm tm = {
+			.tm_year = datetime->year - 1900,
+			.tm_mon = datetime->month - 1,
+			.tm_mday = datetime->day,
+			.tm_hour = datetime->hour,
+			.tm_min = datetime->minute,
+			.tm_sec = datetime->second,
+		};
+
+		fix.time = timeutil_timegm64(&tm) * MSEC_PER_SEC + datetime->ms;
+	} else if (date_time_now(&fix.time)) {
+		/* Without the time the age of the fix is not known. */
+		return;
+	}
+
+	gnss_assist_fix_update(&fix, gnss);
+}
+#endif /* CONFIG_GNSS_ASSIST */
+
+/**@brief Submit an event that carries no data. */
+static void location_event_submit(enum location_module_event_type type)
+{
 	struct location_module_event *location_module_event = new_location_module_event();
 
+	location_module_event->type = type;
+	APP_EVENT_SUBMIT(location_module_event);
+}
+
+static void location_event_handler(const struct location_event_data *event_data)
+{
+#if defined(CONFIG_LOCATION_METHOD_SELECT)
+	if (event_data->id == LOCATION_EVT_LOCATION ||
+	    event_data->id == LOCATION_EVT_TIMEOUT ||
+	    event_data->id == LOCATION_EVT_ERROR) {
+		method_outcome_record(event_data);
+	}
+
+	if (event_data->id == LOCATION_EVT_LOCATION &&
+	    event_data->method == LOCATION_METHOD_GNSS) {
+		gnss_fix_at = k_uptime_get();
+	}
+#endif
+#if defined(CONFIG_AGNSS_CACHE)
+	first_fix_record(event_data);
+#endif
+#if defined(CONFIG_GNSS_ASSIST)
+	if (event_data->id == LOCATION_EVT_LOCATION) {
+		assist_fix_update(event_data);
+	}
+#endif
+
+	/* Allocated only by the cases that submit an event. */
+	struct location_module_event *location_module_event;
+
 	switch (event_data->id) {
 	case LOCATION_EVT_LOCATION:
 		LOG_DBG("Got location:");
@@ -217,7 +480,7 @@ static void location_event_handler(const struct location_event_data *event_data)
 			
 			send_pvt_data();
 		} else if (event_data->method == LOCATION_METHOD_CELLULAR) {
-			struct location_module_event *location_module_event = new_location_module_event();
+			location_module_event = new_location_module_event();
 
 			location_module_event->type = LOCATION_EVENT_GNSS_DATA_READY;
 			location_module_event->location.method = LOCATION_DATA_METHOD_CELLULAR;
@@ -265,33 +528,54 @@ static void location_event_handler(const struct location_event_data *event_data)
 
 			APP_EVENT_SUBMIT(location_module_event);
 		}
-        location_module_event->type = LOCATION_EVENT_INACTIVE;
-        APP_EVENT_SUBMIT(location_module_event);
+		location_event_submit(LOCATION_EVENT_INACTIVE);
 		break;
 
 	case LOCATION_EVT_TIMEOUT:
 		LOG_INF("Getting location timed out\n\n");
-		
-        location_module_event->type = LOCATION_EVENT_TIMEOUT;
-        APP_EVENT_SUBMIT(location_module_event);
-
-        location_module_event->type = LOCATION_EVENT_INACTIVE;
-        APP_EVENT_SUBMIT(location_module_event);
+		location_event_submit(LOCATION_EVENT_TIMEOUT);
+		location_event_submit(LOCATION_EVENT_INACTIVE);
 		break;
 
 	case LOCATION_EVT_ERROR:
 		LOG_ERR("Getting location failed\n\n");
-		
-        location_module_event->type = LOCATION_EVENT_ERROR;
-        APP_EVENT_SUBMIT(location_module_event);
+		location_event_submit(LOCATION_EVENT_ERROR);
+		location_event_submit(LOCATION_EVENT_INACTIVE);
+		break;
 
-        location_module_event->type = LOCATION_EVENT_INACTIVE;
-        APP_EVENT_SUBMIT(location_module_event);
+#if defined(CONFIG_CLOUD_AGNSS)
+	case LOCATION_EVT_GNSS_ASSISTANCE_REQUEST:
+		LOG_INF("Getting location assistance requested (A-GNSS)");
+
+		location_module_event = new_location_module_event();
+		location_module_event->type = LOCATION_EVENT_AGNSS_REQUEST;
+		location_module_event->agnss_request = event_data->agnss_request;
+#if defined(CONFIG_AGNSS_CACHE)
+		agnss_cache_answer(&location_module_event->agnss_request);
+#endif
+		APP_EVENT_SUBMIT(location_module_event);
 		break;
 
+	case LOCATION_EVT_CELLULAR_EXT_REQUEST:
+		LOG_INF("Cellular positioning requested, %d neighbor cells",
+			event_data->cellular_request.ncells_count);
+
+		location_module_event = new_location_module_event();
+		location_module_event->type = LOCATION_EVENT_CELLULAR_REQUEST;
+		location_module_event->cells.current_cell = event_data->cellular_request.current_cell;
+		location_module_event->cells.ncells_count =
+			MIN(event_data->cellular_request.ncells_count, LOCATION_MODULE_NCELLS_MAX);
+		memcpy(location_module_event->cells.neighbor_cells,
+		       event_data->cellular_request.neighbor_cells,
+		       location_module_event->cells.ncells_count *
+		       sizeof(struct lte_lc_ncell));
+		APP_EVENT_SUBMIT(location_module_event);
+		break;
+#else
 	case LOCATION_EVT_GNSS_ASSISTANCE_REQUEST:
 		LOG_INF("Getting location assistance requested (A-GNSS). Not doing anything.\n\n");
 		break;
+#endif
 
 	case LOCATION_EVT_GNSS_PREDICTION_REQUEST:
 		LOG_INF("Getting location assistance requested (P-GPS). Not doing anything.\n\n");
@@ -303,20 +587,91 @@ static void location_event_handler(const struct location_event_data *event_data)
 	}
 }
 
-/**
- * @brief Retrieve location with default configuration.
- *
- * @details This is achieved by not passing configuration at all to location_request().
+/**@brief Split the location timeout of the app config between GNSS and the
+ *	  cellular fallback. Applies to the next location request, a running
+ *	  one keeps its timeouts.
  */
+static void location_config_update(const struct app_cfg *cfg)
+{
+	enum location_method methods[] = {LOCATION_METHOD_GNSS, LOCATION_METHOD_CELLULAR};
+
+	location_config_defaults_set(&config, ARRAY_SIZE(methods), methods);
+
+	if (cfg->location_timeout <= 0) {
+		timeout_total = config.timeout;
+		gnss_budget = config.methods[0].gnss.timeout;
+		cellular_budget = config.methods[1].cellular.timeout;
+		return;
+	}
+
+	/* The overall timeout alone does not shorten a search, the GNSS
+	 * method has a timeout of its own.
+	 */
+	timeout_total = MIN(cfg->location_timeout, INT32_MAX / MSEC_PER_SEC) * MSEC_PER_SEC;
+	gnss_budget = (int64_t)timeout_total * CONFIG_LOCATION_MODULE_GNSS_SHARE / 100;
+	cellular_budget = timeout_total - gnss_budget;
+
+	LOG_INF("Location timeout %d s: GNSS %d ms, cellular %d ms",
+		cfg->location_timeout, gnss_budget, cellular_budget);
+}
+
+/**@brief Build the config of a request with the methods in the given order. */
+static void location_config_build(enum location_method *order, int gnss_timeout)
+{
+	location_config_defaults_set(&config, METHOD_COUNT, order);
+	config.timeout = timeout_total;
+
+	for (size_t i = 0; i < METHOD_COUNT; i++) {
+		if (order[i] == LOCATION_METHOD_GNSS) {
+			config.methods[i].gnss.timeout = gnss_timeout;
+		} else if (order[i] == LOCATION_METHOD_CELLULAR) {
+			config.methods[i].cellular.timeout = cellular_budget;
+		}
+	}
+}
+
 static void start_location_search(void)
 {
 	int err;
+	enum location_method order[METHOD_COUNT] = {
+		LOCATION_METHOD_GNSS, LOCATION_METHOD_CELLULAR
+	};
+	int gnss_timeout = gnss_budget;
 
-	printk("Requesting location with the default configuration...\n");
+#if defined(CONFIG_LOCATION_METHOD_SELECT)
+	struct method_select_decision decision;
 
-	err = location_request(NULL);
+	request_context_get(&request_ctx);
+	method_select_choose(&request_ctx, gnss_budget, &decision);
+	memcpy(order, decision.order, sizeof(order));
+	gnss_timeout = decision.gnss_timeout;
+
+	LOG_INF("Methods %s, %s%s, GNSS timeout %d ms, expected charge %d mAs",
+		location_method_str(order[0]), location_method_str(order[1]),
+		decision.explore ? " (explore)" : "", gnss_timeout, (int)decision.charge);
+#endif
+
+	location_config_build(order, gnss_timeout);
+
+#if defined(CONFIG_AGNSS_CACHE)
+	agnss_cache_boot_inject();
+	cache_answered = false;
+#endif
+
+#if defined(CONFIG_GNSS_ASSIST)
+	assisted = gnss_assist_inject();
+	if (assisted < 0) {
+		LOG_WRN("Time not known, GNSS not assisted");
+		assisted = 0;
+	}
+#endif
+
+	LOG_INF("Requesting location");
+
+	request_start = k_uptime_get();
+	err = location_request(&config);
 	if (err) {
-		printk("Requesting location failed, error: %d\n", err);
+		LOG_ERR("Requesting location failed, error: %d", err);
 		return;
 	}
 
@@ -325,121 +680,163 @@ static void start_location_search(void)
 	APP_EVENT_SUBMIT(location_module_event);
 }
 
-// This is a attempt to take the location search timeout from device config. Doesn't work.
-// /**
-//  * @brief Retrieve location with default configuration.
-//  *
-//  * @details This is achieved by not passing configuration at all to location_request().
-//  */
-// static void start_location_search(void)
-// {
-// 	int err;
-// 	struct location_config config;
-// 	enum location_method methods[] = {LOCATION_METHOD_GNSS, LOCATION_METHOD_CELLULAR};
-// 	/**/
-
-// 	location_config_defaults_set(&config, ARRAY_SIZE(methods), methods);
-	
-// 	config.timeout = copy_cfg.location_timeout * MSEC_PER_SEC;
-
-// 	LOG_INF("Requesting location. Timeout %ds\n", config.timeout);
-
-// 	err = location_request(&config);
-// 	if (err) {
-// 		LOG_ERR("Requesting location failed, error: %d\n", err);
-// 		return;
-// 	}
-
-// 	struct location_module_event *location_module_event = new_location_module_event();
-// 	location_module_event->type = LOCATION_EVENT_ACTIVE;
-// 	APP_EVENT_SUBMIT(location_module_event);
-// }
-
-static void on_state_init(struct location_msg_data *msg){
+static void on_init_lte_connected(struct location_msg_data *msg){
     int err;
-	if (IS_EVENT(msg, modem, MODEM_EVENT_LTE_CONNECTED)){
-		LOG_DBG("MODEM_EVENT_LTE_CONNECTED");
-        err = location_init(location_event_handler);
-        if (err) {
-            LOG_ERR("Initializing the Location library failed, error: %d\n", err);
-        }
-        if (IS_ENABLED(CONFIG_DATE_TIME)) {
-            /* Registering early for date_time event handler to avoid missing
-            * the first event after LTE is connected.
-            */
-            date_time_register_handler(date_time_evt_handler);
-        }
-        set_state(STATE_RUNNING);
-        set_sub_state(SUB_STATE_IDLE);
+
+    err = location_init(location_event_handler);
+    if (err) {
+        LOG_ERR("Initializing the Location library failed, error: %d\n", err);
+    }
+    location_config_update(&copy_cfg);
+#if defined(CONFIG_GNSS_ASSIST)
+    err = gnss_assist_init();
+    if (err) {
+        LOG_ERR("Initializing the GNSS assistance failed, error: %d", err);
+    }
+#endif
+#if defined(CONFIG_AGNSS_CACHE)
+    err = agnss_cache_init();
+    if (err) {
+        LOG_ERR("Initializing the A-GNSS cache failed, error: %d", err);
+    }
+#endif
+#if defined(CONFIG_LOCATION_METHOD_SELECT)
+    err = modem_info_init();
+    if (err) {
+        LOG_ERR("Initializing the modem info failed, error: %d", err);
     }
+#endif
+    if (IS_ENABLED(CONFIG_DATE_TIME)) {
+        /* Registering early for date_time event handler to avoid missing
+        * the first event after LTE is connected.
+        */
+        date_time_register_handler(date_time_evt_handler);
+    }
+    set_state(STATE_RUNNING);
+    set_sub_state(SUB_STATE_IDLE);
+}
+
+static void on_idle_location_active(struct location_msg_data *msg){
+	set_sub_state(SUB_STATE_SEARCHING);
 }
 
-static void on_state_running(struct location_msg_data *msg){
+#if defined(CONFIG_MODULE_STACK_REPORT)
+static void log_event_pool_stats(void)
+{
+	struct event_pool_stats stats;
 
+	event_pool_stats_get(&stats);
+	LOG_DBG("Event pool: %u allocated, %u from heap, %u in use, peak %u of %d blocks of %u bytes",
+		stats.allocated, stats.heap, stats.in_use, stats.peak,
+		CONFIG_EVENT_POOL_BLOCKS, stats.block_size);
 }
 
-static void on_sub_state_idle(struct location_msg_data *msg){
-	if (IS_EVENT(msg, location, LOCATION_EVENT_ACTIVE)){
-		LOG_DBG("LOCATION_EVENT_ACTIVE");
-		set_sub_state(SUB_STATE_SEARCHING);
+static void log_thread_stack(const struct k_thread *thread, void *user_data)
+{
+	size_t unused;
+	const char *name = k_thread_name_get((k_tid_t)thread);
+
+	if (k_thread_stack_space_get(thread, &unused)) {
+		return;
 	}
 
-	if (IS_EVENT(msg, app, APP_EVENT_LOCATION_GET)){
-		LOG_DBG("APP_EVENT_LOCATION_GET");
-        start_location_search();
-        set_sub_state(SUB_STATE_SEARCHING);
-    }
+	LOG_DBG("Stack %s: %zu of %zu bytes used", name ? name : "?",
+		thread->stack_info.size - unused, thread->stack_info.size);
+}
+#endif /* CONFIG_MODULE_STACK_REPORT */
+
+static void on_idle_location_get(struct location_msg_data *msg){
+#if defined(CONFIG_MODULE_STACK_REPORT)
+	log_event_pool_stats();
+	k_thread_foreach(log_thread_stack, NULL);
+#endif
+	start_location_search();
+	set_sub_state(SUB_STATE_SEARCHING);
 }
 
-static void on_sub_state_searching(struct location_msg_data *msg){
-	if (IS_EVENT(msg, location, LOCATION_EVENT_INACTIVE)){
-		LOG_DBG("LOCATION_EVENT_INACTIVE");
-		set_sub_state(SUB_STATE_IDLE);
-	}
-	if (IS_EVENT(msg, app, APP_EVENT_LOCATION_GET)){
-		LOG_DBG("APP_EVENT_LOCATION_GET");
-		LOG_INF("Location request is already active and will not be restarted");
-	}
+static void on_searching_location_inactive(struct location_msg_data *msg){
+	set_sub_state(SUB_STATE_IDLE);
 }
 
-static void on_all_states(struct location_msg_data *msg){
-	if ((IS_EVENT(msg, app, APP_EVENT_START)) || 
-		(IS_EVENT(msg, app, APP_EVENT_CONFIG_UPDATE))){
-		LOG_DBG("APP_EVENT_START || APP_EVENT_CONFIG_UPDATE");
-		copy_cfg = msg->module.app.app_cfg;
-	}
+static void on_searching_location_get(struct location_msg_data *msg){
+	LOG_INF("Location request is already active and will not be restarted");
+}
+
+static void on_config_update(struct location_msg_data *msg){
+	copy_cfg = msg->module.app->app_cfg;
+	location_config_update(&copy_cfg);
 }
 
+MODULE_HANDLERS_DEFINE(state_init_handlers, STATE_INIT_HANDLERS);
+MODULE_HANDLERS_DEFINE(sub_state_idle_handlers, SUB_STATE_IDLE_HANDLERS);
+MODULE_HANDLERS_DEFINE(sub_state_searching_handlers, SUB_STATE_SEARCHING_HANDLERS);
+MODULE_HANDLERS_DEFINE(all_states_handlers, ALL_STATES_HANDLERS);
 
 static void message_handler(struct location_msg_data *msg){
+	event_latency_record(EVENT_LATENCY_LOCATION, msg->module.header);
 
     switch (state) {
 	case STATE_INIT:
-		on_state_init(msg);
+		MODULE_DISPATCH(state_init_handlers, msg);
 		break;
 	case STATE_RUNNING:
 		switch (sub_state) {
 			case SUB_STATE_SEARCHING:
-				on_sub_state_searching(msg);
+				MODULE_DISPATCH(sub_state_searching_handlers, msg);
 				break;
 
 			case SUB_STATE_IDLE:
-				on_sub_state_idle(msg);
+				MODULE_DISPATCH(sub_state_idle_handlers, msg);
 				break;
 		}
-		on_state_running(msg);
 		break;
 
 	case STATE_SHUTDOWN:
 		// Do nothing
 		break;
     }
-	on_all_states(msg);
+	MODULE_DISPATCH(all_states_handlers, msg);
+	event_pool_unref(msg->module.header);
+}
+
+#if defined(CONFIG_MODULE_WORK_QUEUE)
+static void module_work_fn(struct k_work *work)
+{
+	struct location_msg_data msg = {0};
+
+	while (module_queue_get(&msgq_location, &msg.module.header, K_NO_WAIT) == 0) {
+		message_handler(&msg);
+	}
+}
+
+static int location_module_init(void)
+{
+	module_queue_run(&msgq_location, module_work_fn, K_NO_WAIT);
+
+	return 0;
+}
+
+SYS_INIT(location_module_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+#else
+static void module_thread_fn(void)
+{
+	int err;
+	struct location_msg_data msg = {0};
+
+	while (1) {
+		err = module_queue_get(&msgq_location, &msg.module.header, K_FOREVER);
+		if (err) {
+			LOG_ERR("Failed to get event from message queue: %d", err);
+		} else {
+			message_handler(&msg);
+		}
+	}
 }
 
+K_THREAD_DEFINE(location_module_thread, CONFIG_LOCATION_MODULE_THREAD_STACK_SIZE,
+		module_thread_fn, NULL, NULL, NULL,
+		K_LOWEST_APPLICATION_THREAD_PRIO, 0, 0);
+#endif /* CONFIG_MODULE_WORK_QUEUE */
 
 APP_EVENT_LISTENER(MODULE, app_event_handler);
-APP_EVENT_SUBSCRIBE(MODULE, app_module_event);
-APP_EVENT_SUBSCRIBE(MODULE, modem_module_event);
-APP_EVENT_SUBSCRIBE(MODULE, cloud_module_event);
-APP_EVENT_SUBSCRIBE(MODULE, location_module_event);
\ No newline at end of file
+MODULE_SOURCES(MODULE_EVENT_SUBSCRIBE)
@@ -2,6 +2,7 @@
 #include <time.h>
 
 #include <zephyr/kernel.h>
+#include <zephyr/init.h>
 #include <zephyr/net/socket.h>
 #include <zephyr/random/rand32.h>
 
@@ -20,6 +21,9 @@
 #include "events/cloud_module_event.h"
 #include "events/modem_module_event.h"
 #include "events/location_module_event.h"
+#include "events/event_latency.h"
+#include "events/event_pool.h"
+#include "events/module_queue.h"
 
 /* Application module super states. */
 static enum state_type {
@@ -30,18 +34,42 @@ static enum state_type {
 
 struct modem_msg_data {
 	union {
-		struct app_module_event app;
-		struct cloud_module_event cloud;
-		struct modem_module_event modem;
-		struct location_module_event location;
+		const struct app_event_header *header;
+		const struct app_module_event *app;
+		const struct cloud_module_event *cloud;
+		const struct modem_module_event *modem;
+		const struct location_module_event *location;
 	} module;
 };
 
+/* Events handled by this module, by state, see modules_common.h. */
+#define MODULE_SOURCES(X) X(app) X(modem)
+
+#define STATE_DISCONNECTED_HANDLERS(X)							\
+	X(app, APP_EVENT_START, on_disconnected_start)					\
+	X(modem, MODEM_EVENT_LTE_CONNECTED, on_disconnected_lte_connected)
+
+#define STATE_CONNECTED_HANDLERS(X)							\
+	X(modem, MODEM_EVENT_LTE_DISCONNECTED, on_connected_lte_disconnected)
+
+#define MODULE_HANDLERS(X) STATE_DISCONNECTED_HANDLERS(X) STATE_CONNECTED_HANDLERS(X)
+
+MODULE_DISPATCH_DEFINE(struct modem_msg_data, MODULE_SOURCES)
+MODULE_EVENT_FILTER_DEFINE(MODULE_HANDLERS)
+
+/* The modem module only handles the start and the connection changes,
+ * none of which may be lost.
+ */
+static enum module_queue_policy queue_policy(const struct app_event_header *aeh)
+{
+	return MODULE_QUEUE_SPILL;
+}
+
 #define MSG_Q_SIZE 20
 
-K_MSGQ_DEFINE(msgq_modem, sizeof(struct modem_msg_data), MSG_Q_SIZE, 4);
+MODULE_QUEUE_DEFINE(msgq_modem, MSG_Q_SIZE, queue_policy);
 
-static K_SEM_DEFINE(lte_connected, 0, 1);
+static atomic_t lte_connected_reported;
 
 #define MODULE modem_module
 
@@ -74,44 +102,11 @@ static void set_state(enum state_type new_state)
 }
 
 static bool app_event_handler(const struct app_event_header *aeh){
-	bool consume = false, enqueue_msg = false;
-	struct modem_msg_data msg = {0};
-	if (is_app_module_event(aeh)){
-		struct app_module_event *event = cast_app_module_event(aeh);
-		msg.module.app = *event;
-		enqueue_msg = true;
-	}
-	
-	if (is_cloud_module_event(aeh)){
-		struct cloud_module_event *event = cast_cloud_module_event(aeh);
-		msg.module.cloud = *event;
-		enqueue_msg = true;
-	}
-
-	
-	if (is_modem_module_event(aeh)){
-		struct modem_module_event *event = cast_modem_module_event(aeh);
-		msg.module.modem = *event;
-		enqueue_msg = true;
-	}
-
-	
-	if (is_location_module_event(aeh)){
-		struct location_module_event *event = cast_location_module_event(aeh);
-		msg.module.location = *event;
-		enqueue_msg = true;
+	if (module_event_accept(aeh) && module_queue_put(&msgq_modem, aeh)) {
+		LOG_ERR("Event queue full, event dropped");
 	}
 
-	if (enqueue_msg){
-		 /* Add the event to the message queue */
-        int err = k_msgq_put(&msgq_modem, &msg, K_NO_WAIT);
-        if (err) {
-            LOG_ERR("Failed to add event to message queue: %d", err);
-            /* Handle the error */
-        }
-	}
-
-	return consume;
+	return false;
 }
 
 static void lte_handler(const struct lte_lc_evt *const evt)
@@ -125,7 +120,16 @@ static void lte_handler(const struct lte_lc_evt *const evt)
 		LOG_INF("Network registration status: %s",
 				evt->nw_reg_status == LTE_LC_NW_REG_REGISTERED_HOME ?
 				"Connected - home network" : "Connected - roaming");
-		k_sem_give(&lte_connected);
+		/* Reported once, the later registrations are reconnections of the
+		 * modem itself.
+		 */
+		if (atomic_cas(&lte_connected_reported, 0, 1)) {
+			LOG_INF("Connected to LTE network");
+			struct modem_module_event *modem_module_event = new_modem_module_event();
+
+			modem_module_event->type = MODEM_EVENT_LTE_CONNECTED;
+			APP_EVENT_SUBMIT(modem_module_event);
+		}
 		break;
 	case LTE_LC_EVT_RRC_UPDATE:
 		LOG_INF("RRC mode: %s",
@@ -181,41 +185,78 @@ static int modem_configure(void)
 		return err;
 	}
 
-	k_sem_take(&lte_connected, K_FOREVER);
-	LOG_INF("Connected to LTE network");
+	/* Not waiting for the connection here, so that the modules sharing
+	 * the module work queue are not blocked.
+	 */
+	return 0;
+}
 
-	struct modem_module_event *modem_module_event = new_modem_module_event();
+static void on_disconnected_start(struct modem_msg_data *msg)
+{
+	int err;
 
-	modem_module_event->type = MODEM_EVENT_LTE_CONNECTED;
+	err = modem_configure();
+	if (err) {
+		LOG_ERR("Failed to configure the modem");
+	}
+}
 
-	APP_EVENT_SUBMIT(modem_module_event);
+static void on_disconnected_lte_connected(struct modem_msg_data *msg)
+{
+	set_state(STATE_CONNECTED);
+}
 
-	return 0;
+static void on_connected_lte_disconnected(struct modem_msg_data *msg)
+{
+	set_state(STATE_DISCONNECTED);
 }
 
-static void on_state_disconnected(struct modem_msg_data *msg)
+MODULE_HANDLERS_DEFINE(state_disconnected_handlers, STATE_DISCONNECTED_HANDLERS);
+MODULE_HANDLERS_DEFINE(state_connected_handlers, STATE_CONNECTED_HANDLERS);
+
+static void message_handler(struct modem_msg_data *msg)
 {
-	int err;
+	event_latency_record(EVENT_LATENCY_MODEM, msg->module.header);
 
-	if (IS_EVENT(msg, app, APP_EVENT_START)){
-		err = modem_configure();
-		if (err) {
-			LOG_ERR("Failed to configure the modem");
-		}
-	}
+	switch (state)
+	{
+	case STATE_DISCONNECTED:
+		MODULE_DISPATCH(state_disconnected_handlers, msg);
+		break;
+	case STATE_CONNECTED:
+		MODULE_DISPATCH(state_connected_handlers, msg);
+		break;
+	case STATE_SHUTDOWN:
+		break;
 
-	if (IS_EVENT(msg, modem, MODEM_EVENT_LTE_CONNECTED)){
-		set_state(STATE_CONNECTED);
+	default:
+		LOG_ERR("Unknown state");
+		break;
 	}
+	event_pool_unref(msg->module.header);
 }
 
-static void on_state_connected(struct modem_msg_data *msg)
+#if defined(CONFIG_MODULE_WORK_QUEUE)
+static void module_work_fn(struct k_work *work)
 {
-	if (IS_EVENT(msg, modem, MODEM_EVENT_LTE_DISCONNECTED)){
-		set_state(STATE_DISCONNECTED);
+	struct modem_msg_data msg = {0};
+
+	while (module_queue_get(&msgq_modem, &msg.module.header, K_NO_WAIT) == 0) {
+		message_handler(&msg);
 	}
 }
 
+static int modem_module_init(void)
+{
+	LOG_INF("started!");
+
+	module_queue_run(&msgq_modem, module_work_fn, K_SECONDS(3));
+
+	return 0;
+}
+
+SYS_INIT(modem_module_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+#else
 int module_thread_fn(void)
 {
 	int err;
@@ -226,38 +267,22 @@ int module_thread_fn(void)
 	k_sleep(K_SECONDS(3));
 
 	while (1) {
-        err = k_msgq_get(&msgq_modem, &msg, K_FOREVER);
+        err = module_queue_get(&msgq_modem, &msg.module.header, K_FOREVER);
 		if (err) {
             LOG_ERR("Failed to get event from message queue: %d", err);
             /* Handle the error */
         } else {
-			switch (state)
-			{
-			case STATE_DISCONNECTED:
-				on_state_disconnected(&msg);
-				break;
-			case STATE_CONNECTED:
-				on_state_connected(&msg);
-				break;
-			case STATE_SHUTDOWN:
-				break;
-			
-			default:
-				LOG_ERR("Unknown state");
-				break;
-			}
+			message_handler(&msg);
 		}
 	}
 
 	return 0;
 }
 
-K_THREAD_DEFINE(modem_module_thread, 2048,
+K_THREAD_DEFINE(modem_module_thread, CONFIG_MODEM_THREAD_STACK_SIZE,
 		module_thread_fn, NULL, NULL, NULL,
 		K_LOWEST_APPLICATION_THREAD_PRIO, 0, 0);
+#endif /* CONFIG_MODULE_WORK_QUEUE */
 
 APP_EVENT_LISTENER(MODULE, app_event_handler);
-APP_EVENT_SUBSCRIBE(MODULE, app_module_event);
-APP_EVENT_SUBSCRIBE(MODULE, modem_module_event);
-APP_EVENT_SUBSCRIBE(MODULE, cloud_module_event);
-APP_EVENT_SUBSCRIBE(MODULE, location_module_event);
\ No newline at end of file
+MODULE_SOURCES(MODULE_EVENT_SUBSCRIBE)
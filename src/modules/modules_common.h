@@ -6,21 +6,122 @@
 #ifndef _MODULES_COMMON_H_
 #define _MODULES_COMMON_H_
 
+#include <zephyr/sys/util.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 /** @brief Macro that checks if an event is of a certain type.
  *
- * @param _ptr Name of module message struct variable.
+ * @param _ptr Name of module message struct variable. The message holds a
+ *	       pointer to the event, not a copy of it.
  * @param _mod Name of module that the event corresponds to.
  * @param _evt Name of the event.
  *
  * @return true if the event matches the event checked for, otherwise false.
  */
 #define IS_EVENT(_ptr, _mod, _evt) \
-		is_ ## _mod ## _module_event(&_ptr->module._mod.header) &&		\
-		_ptr->module._mod.type == _evt
+		is_ ## _mod ## _module_event(_ptr->module.header) &&			\
+		_ptr->module._mod->type == _evt
+
+/** @brief The events a module handles are described by X-macros, one per
+ *	   state, with one entry per (source module, event type) pair handled
+ *	   in that state and its handler, and by an X-macro of the source
+ *	   modules:
+ *
+ *	   #define MODULE_SOURCES(X) X(app) X(modem)
+ *
+ *	   #define STATE_INIT_HANDLERS(X)				\
+ *		X(app, APP_EVENT_START, on_init_start)
+ *	   #define STATE_RUNNING_HANDLERS(X)				\
+ *		X(modem, MODEM_EVENT_LTE_CONNECTED, on_running_connected)
+ *
+ *	   #define MODULE_HANDLERS(X)					\
+ *		STATE_INIT_HANDLERS(X) STATE_RUNNING_HANDLERS(X)
+ *
+ *	   MODULE_DISPATCH_DEFINE(struct module_msg_data, MODULE_SOURCES)
+ *	   defines the dispatch of the module, MODULE_HANDLERS_DEFINE()
+ *	   the dispatch table of a state, MODULE_EVENT_FILTER_DEFINE() the
+ *	   filter of the event listener from all the tables, and
+ *	   MODULE_SOURCES(MODULE_EVENT_SUBSCRIBE) subscribes to the source
+ *	   modules. Other events are never delivered to, or queued by, the
+ *	   module. A handler of a source module missing from MODULE_SOURCES
+ *	   does not build.
+ */
+#define MODULE_SOURCE_ENUM(_mod) MODULE_SOURCE_ ## _mod,
+
+#define MODULE_SOURCE_MATCH(_mod)							\
+	if (is_ ## _mod ## _module_event(aeh)) {					\
+		*type = cast_ ## _mod ## _module_event(aeh)->type;			\
+		return MODULE_SOURCE_ ## _mod;						\
+	}
+
+/** @brief Define the handler table entry of the module, with the handlers
+ *	   taking a _msg_type message, and the dispatch of a message through
+ *	   a table. Every handler of the table matching the event is called,
+ *	   in the order of the table.
+ */
+#define MODULE_DISPATCH_DEFINE(_msg_type, _sources)					\
+	enum module_source {								\
+		_sources(MODULE_SOURCE_ENUM)						\
+	};										\
+											\
+	struct module_handler {								\
+		int source;								\
+		int type;								\
+		void (*handler)(_msg_type *msg);					\
+	};										\
+											\
+	static int module_source_get(const struct app_event_header *aeh, int *type)	\
+	{										\
+		_sources(MODULE_SOURCE_MATCH)						\
+		return -1;								\
+	}										\
+											\
+	static void module_dispatch(const struct module_handler *table, size_t len,	\
+				    _msg_type *msg)					\
+	{										\
+		int type;								\
+		int source = module_source_get(msg->module.header, &type);		\
+											\
+		for (size_t i = 0; i < len; i++) {					\
+			if (table[i].source == source && table[i].type == type) {	\
+				table[i].handler(msg);					\
+			}								\
+		}									\
+	}
+
+#define MODULE_HANDLER_ENTRY(_mod, _evt, _handler)					\
+	{ .source = MODULE_SOURCE_ ## _mod, .type = _evt, .handler = _handler },
+
+/** @brief Define the dispatch table _name from the X-macro _list. */
+#define MODULE_HANDLERS_DEFINE(_name, _list)						\
+	static const struct module_handler _name[] = { _list(MODULE_HANDLER_ENTRY) }
+
+/** @brief Dispatch a message through the table of a state. */
+#define MODULE_DISPATCH(_table, _msg) module_dispatch(_table, ARRAY_SIZE(_table), _msg)
+
+#define MODULE_EVENT_ACCEPT(_mod, _evt, _handler)					\
+	if (source == MODULE_SOURCE_ ## _mod && type == _evt) {				\
+		return true;								\
+	}
+
+/** @brief Define module_event_accept(), that returns true for the events in
+ *	   the handler X-macro _list.
+ */
+#define MODULE_EVENT_FILTER_DEFINE(_list)						\
+	static bool module_event_accept(const struct app_event_header *aeh)		\
+	{										\
+		int type;								\
+		int source = module_source_get(aeh, &type);				\
+											\
+		_list(MODULE_EVENT_ACCEPT)						\
+		return false;								\
+	}
+
+/** @brief Subscribe to a source module of the X-macro. */
+#define MODULE_EVENT_SUBSCRIBE(_mod) APP_EVENT_SUBSCRIBE(MODULE, _mod ## _module_event);
 
 /** @brief Macro used to submit an event.
  *
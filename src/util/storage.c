@@ -0,0 +1,85 @@
+#include <zephyr/kernel.h>
+#include <zephyr/init.h>
+#include <zephyr/fs/nvs.h>
+#include <zephyr/drivers/flash.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/logging/log.h>
+
+#include "util/storage.h"
+
+LOG_MODULE_REGISTER(storage, LOG_LEVEL_DBG);
+
+/* NVS rotates the records over the partition sectors, which levels the wear
+ * of the flash.
+ */
+static struct nvs_fs fs;
+
+static bool mounted;
+
+static int storage_init(void)
+{
+	int err;
+	struct flash_pages_info info;
+
+	fs.flash_device = FIXED_PARTITION_DEVICE(storage_partition);
+	if (!device_is_ready(fs.flash_device)) {
+		LOG_ERR("Flash device %s is not ready", fs.flash_device->name);
+		return -ENODEV;
+	}
+
+	fs.offset = FIXED_PARTITION_OFFSET(storage_partition);
+	err = flash_get_page_info_by_offs(fs.flash_device, fs.offset, &info);
+	if (err) {
+		LOG_ERR("Unable to get page info, error: %d", err);
+		return err;
+	}
+
+	fs.sector_size = info.size;
+	fs.sector_count = CONFIG_STORAGE_SECTOR_COUNT;
+
+	err = nvs_mount(&fs);
+	if (err) {
+		LOG_ERR("Flash init failed, error: %d", err);
+		return err;
+	}
+
+	mounted = true;
+
+	return 0;
+}
+
+ssize_t storage_read(uint16_t id, void *data, size_t len)
+{
+	if (!mounted) {
+		return -ENODEV;
+	}
+
+	return nvs_read(&fs, id, data, len);
+}
+
+int storage_write(uint16_t id, const void *data, size_t len)
+{
+	ssize_t written;
+
+	if (!mounted) {
+		return -ENODEV;
+	}
+
+	written = nvs_write(&fs, id, data, len);
+	if (written < 0) {
+		return written;
+	}
+
+	return 0;
+}
+
+int storage_delete(uint16_t id)
+{
+	if (!mounted) {
+		return -ENODEV;
+	}
+
+	return nvs_delete(&fs, id);
+}
+
+SYS_INIT(storage_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -0,0 +1,66 @@
+#ifndef _STORAGE_H_
+#define _STORAGE_H_
+
+/**
+ * @brief Persistent storage
+ * @defgroup storage Persistent storage
+ * @{
+ */
+
+#include <zephyr/types.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Ids of the records kept in the storage partition. */
+enum storage_id {
+	/** Sequence number of the next record written to the fix queue. */
+	STORAGE_ID_FIX_QUEUE_HEAD = 1,
+	/** Sequence number of the oldest unacknowledged fix queue record. */
+	STORAGE_ID_FIX_QUEUE_TAIL,
+	/** OSCORE sender sequence numbers below this value may have been used. */
+	STORAGE_ID_OSCORE_SSN,
+	/** Header of the A-GNSS cache, written after its chunks. */
+	STORAGE_ID_AGNSS_CACHE,
+	/** Time to first fix after a boot, with and without the A-GNSS cache. */
+	STORAGE_ID_AGNSS_TTFF,
+	/** Last known position, given to GNSS before a search. */
+	STORAGE_ID_LAST_FIX,
+	/** Newest fix held back by the track simplification. */
+	STORAGE_ID_TRACK_PENDING,
+	/** Chunks of the A-GNSS cache. */
+	STORAGE_ID_AGNSS_CACHE_FIRST = 0x80,
+	STORAGE_ID_AGNSS_CACHE_LAST = 0x8f,
+	/** First fix queue slot. One id is used per slot. */
+	STORAGE_ID_FIX_QUEUE_FIRST = 0x100,
+};
+
+/** @brief Read a record from the storage.
+ *
+ * @return Number of bytes read, or a negative error code.
+ */
+ssize_t storage_read(uint16_t id, void *data, size_t len);
+
+/** @brief Write a record to the storage. Each write is atomic.
+ *
+ * @return 0 on success, or a negative error code.
+ */
+int storage_write(uint16_t id, const void *data, size_t len);
+
+/** @brief Delete a record from the storage.
+ *
+ * @return 0 on success, or a negative error code.
+ */
+int storage_delete(uint16_t id);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* _STORAGE_H_ */
@@ -0,0 +1,431 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <ztest.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <modem/location.h>
+#include <date_time.h>
+
+#include "location/agnss_cache.h"
+#include "util/storage.h"
+#include "host_storage.h"
+
+/* Element types and item lengths of the nRF Cloud A-GNSS binary format. */
+#define TYPE_UTC 1
+#define TYPE_EPHEMERIDES 2
+#define TYPE_ALMANAC 3
+#define TYPE_KLOBUCHAR 4
+#define TYPE_NEQUICK 5
+#define TYPE_TOWS 6
+
+#define UTC_LEN 14
+#define EPHEMERIS_LEN 62
+#define ALMANAC_LEN 31
+#define KLOBUCHAR_LEN 8
+#define NEQUICK_LEN 8
+#define TOWS_LEN 3
+
+/* 2021-10-01 00:00:00 UTC */
+#define START_TIME_MS 1633046400000LL
+
+/* Writes of a save, the chunks of the items and the header. */
+#define SAVE_WRITES 6
+
+static uint8_t data[4096];
+static size_t data_len;
+
+static uint8_t injected[4096];
+static size_t injected_len;
+static int injections;
+
+int location_agnss_data_process(const char *buf, const size_t buf_len)
+{
+	zassert_true(buf_len <= sizeof(injected));
+	memcpy(injected, buf, buf_len);
+	injected_len = buf_len;
+	injections++;
+
+	return 0;
+}
+
+static void data_start(void)
+{
+	data[0] = 1;
+	data_len = 1;
+}
+
+/**@brief Append an element with the given items, the first byte of each
+ *	  item is its satellite id and the rest is filled with the tag.
+ */
+static void element_add(uint8_t type, size_t item_len, const uint8_t *svs, uint16_t count,
+			uint8_t tag)
+{
+	data[data_len] = type;
+	sys_put_le16(count, &data[data_len + 1]);
+	data_len += 3;
+
+	for (uint16_t i = 0; i < count; i++) {
+		memset(&data[data_len], tag, item_len);
+		data[data_len] = svs[i];
+		data_len += item_len;
+	}
+}
+
+/**@brief Find an element of the injected data.
+ *
+ * @return Offset of the first item, or 0 if the element is not there.
+ */
+static size_t injected_element(uint8_t type, uint16_t *count)
+{
+	static const size_t lens[] = {
+		[TYPE_UTC] = UTC_LEN,
+		[TYPE_EPHEMERIDES] = EPHEMERIS_LEN,
+		[TYPE_ALMANAC] = ALMANAC_LEN,
+		[TYPE_KLOBUCHAR] = KLOBUCHAR_LEN,
+		[TYPE_NEQUICK] = NEQUICK_LEN,
+	};
+	size_t pos = 1;
+
+	while (pos < injected_len) {
+		uint8_t element = injected[pos];
+		uint16_t items = sys_get_le16(&injected[pos + 1]);
+
+		pos += 3;
+		if (element == type) {
+			*count = items;
+			return pos;
+		}
+
+		pos += items * lens[element];
+	}
+
+	*count = 0;
+
+	return 0;
+}
+
+/**@brief Tag of the item of a satellite in the injected element, 0 if the
+ *	  satellite is not there.
+ */
+static uint8_t injected_tag(uint8_t type, size_t item_len, uint8_t sv)
+{
+	uint16_t count;
+	size_t pos = injected_element(type, &count);
+
+	for (uint16_t i = 0; i < count; i++, pos += item_len) {
+		if (injected[pos] == sv) {
+			return injected[pos + 1];
+		}
+	}
+
+	return 0;
+}
+
+/**@brief Full set of the cached types: UTC, ionospheric corrections and
+ *	  the ephemerides and almanacs of satellites 1 to 8.
+ */
+static void full_set_store(uint8_t tag)
+{
+	static const uint8_t none[] = { 0 };
+	static const uint8_t svs[] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+
+	data_start();
+	element_add(TYPE_EPHEMERIDES, EPHEMERIS_LEN, svs, ARRAY_SIZE(svs), tag);
+	element_add(TYPE_ALMANAC, ALMANAC_LEN, svs, ARRAY_SIZE(svs), tag);
+	element_add(TYPE_UTC, UTC_LEN, none, 1, tag);
+	element_add(TYPE_KLOBUCHAR, KLOBUCHAR_LEN, none, 1, tag);
+	element_add(TYPE_NEQUICK, NEQUICK_LEN, none, 1, tag);
+
+	zassert_equal(agnss_cache_store(data, data_len), 19);
+}
+
+static void before(void *fixture)
+{
+	host_storage_erase();
+	host_uptime_set(0);
+	host_date_time_clear();
+	injected_len = 0;
+	injections = 0;
+
+	zassert_ok(agnss_cache_init());
+
+	host_date_time_set(START_TIME_MS);
+}
+
+ZTEST(agnss_cache, test_merge)
+{
+	static const uint8_t svs[] = { 1, 2, 0, 33 };
+	static const uint8_t newer_svs[] = { 2, 3 };
+	static const uint8_t tows_svs[] = { 1 };
+	uint16_t count;
+
+	/* The ephemerides of satellites 1 and 2 are cached, satellite ids out
+	 * of the GPS range and the time of week are not.
+	 */
+	data_start();
+	element_add(TYPE_EPHEMERIDES, EPHEMERIS_LEN, svs, ARRAY_SIZE(svs), 0xa1);
+	element_add(TYPE_TOWS, TOWS_LEN, tows_svs, 1, 0xa1);
+	element_add(TYPE_ALMANAC, ALMANAC_LEN, svs, 2, 0xa1);
+	zassert_equal(agnss_cache_store(data, data_len), 4);
+
+	/* A later download replaces satellite 2 and adds satellite 3. */
+	data_start();
+	element_add(TYPE_EPHEMERIDES, EPHEMERIS_LEN, newer_svs, ARRAY_SIZE(newer_svs), 0xb2);
+	zassert_equal(agnss_cache_store(data, data_len), 2);
+
+	zassert_equal(agnss_cache_inject(), 5);
+	zassert_equal(injections, 1);
+	zassert_equal(injected[0], 1, "schema version");
+
+	injected_element(TYPE_EPHEMERIDES, &count);
+	zassert_equal(count, 3);
+	zassert_equal(injected_tag(TYPE_EPHEMERIDES, EPHEMERIS_LEN, 1), 0xa1);
+	zassert_equal(injected_tag(TYPE_EPHEMERIDES, EPHEMERIS_LEN, 2), 0xb2);
+	zassert_equal(injected_tag(TYPE_EPHEMERIDES, EPHEMERIS_LEN, 3), 0xb2);
+
+	injected_element(TYPE_ALMANAC, &count);
+	zassert_equal(count, 2);
+
+	injected_element(TYPE_TOWS, &count);
+	zassert_equal(count, 0);
+}
+
+ZTEST(agnss_cache, test_inject_encoding)
+{
+	static const uint8_t order[] = {
+		TYPE_UTC, TYPE_KLOBUCHAR, TYPE_NEQUICK, TYPE_ALMANAC, TYPE_EPHEMERIDES
+	};
+	static const uint16_t counts[] = { 1, 1, 1, 8, 8 };
+	static const size_t lens[] = {
+		UTC_LEN, KLOBUCHAR_LEN, NEQUICK_LEN, ALMANAC_LEN, EPHEMERIS_LEN
+	};
+	size_t pos = 1;
+
+	full_set_store(0xc3);
+	zassert_equal(agnss_cache_inject(), 19);
+
+	/* The UTC parameters and the ionospheric corrections go before the
+	 * almanacs and the ephemerides, the items as they were downloaded.
+	 */
+	for (size_t i = 0; i < ARRAY_SIZE(order); i++) {
+		zassert_equal(injected[pos], order[i], "element %zu", i);
+		zassert_equal(sys_get_le16(&injected[pos + 1]), counts[i], "element %zu", i);
+		pos += 3;
+
+		for (uint16_t item = 0; item < counts[i]; item++, pos += lens[i]) {
+			zassert_equal(injected[pos + lens[i] - 1], 0xc3);
+		}
+	}
+
+	zassert_equal(pos, injected_len);
+}
+
+ZTEST(agnss_cache, test_expiry)
+{
+	uint16_t count;
+
+	full_set_store(0xd4);
+
+	/* The ephemerides expire after two hours, the rest is still given. */
+	host_uptime_advance(CONFIG_AGNSS_CACHE_EPHEMERIS_VALIDITY * MSEC_PER_SEC);
+	zassert_equal(agnss_cache_inject(), 11);
+	injected_element(TYPE_EPHEMERIDES, &count);
+	zassert_equal(count, 0);
+
+	/* And the almanacs after three days. */
+	host_uptime_advance((int64_t)CONFIG_AGNSS_CACHE_ALMANAC_VALIDITY * MSEC_PER_SEC);
+	zassert_equal(agnss_cache_inject(), -ENODATA);
+	zassert_equal(injections, 1);
+
+	/* A clock that went backwards expires the items too. */
+	host_date_time_set(START_TIME_MS);
+	full_set_store(0xd4);
+	host_date_time_set(START_TIME_MS - MSEC_PER_SEC);
+	zassert_equal(agnss_cache_inject(), -ENODATA);
+}
+
+ZTEST(agnss_cache, test_errors)
+{
+	static const uint8_t svs[] = { 1 };
+	uint8_t bad_type[] = { 1, 12, 1, 0, 0 };
+
+	zassert_equal(agnss_cache_inject(), -ENODATA, "empty cache");
+
+	/* Unknown schema, unknown element type and truncated item. */
+	data_start();
+	element_add(TYPE_EPHEMERIDES, EPHEMERIS_LEN, svs, 1, 0xe5);
+	data[0] = 2;
+	zassert_equal(agnss_cache_store(data, data_len), -EBADMSG);
+	data[0] = 1;
+	zassert_equal(agnss_cache_store(data, data_len - 1), -EBADMSG);
+	zassert_equal(agnss_cache_store(data, 2), -EBADMSG);
+	zassert_equal(agnss_cache_store(bad_type, sizeof(bad_type)), -EBADMSG);
+	zassert_equal(agnss_cache_store(data, 0), -EBADMSG);
+
+	/* Without the time nothing is stored or injected. */
+	host_date_time_clear();
+	zassert_equal(agnss_cache_store(data, data_len), -EAGAIN);
+	zassert_equal(agnss_cache_inject(), -EAGAIN);
+
+	host_date_time_set(START_TIME_MS);
+	zassert_equal(agnss_cache_inject(), -ENODATA);
+	zassert_equal(injections, 0);
+}
+
+ZTEST(agnss_cache, test_trim)
+{
+	static const uint8_t newer_svs[] = { 1, 2 };
+	struct nrf_modem_gnss_agnss_data_frame request = {
+		.data_flags = NRF_MODEM_GNSS_AGNSS_GPS_UTC_REQUEST |
+			      NRF_MODEM_GNSS_AGNSS_KLOBUCHAR_REQUEST |
+			      NRF_MODEM_GNSS_AGNSS_NEQUICK_REQUEST |
+			      NRF_MODEM_GNSS_AGNSS_GPS_SYS_TIME_AND_SV_TOW_REQUEST |
+			      NRF_MODEM_GNSS_AGNSS_POSITION_REQUEST,
+		.system_count = 2,
+		.system = {
+			{ .system_id = NRF_MODEM_GNSS_SYSTEM_GPS, .sv_mask_ephe = 0xffff,
+			  .sv_mask_alm = 0xffff },
+			{ .system_id = NRF_MODEM_GNSS_SYSTEM_QZSS, .sv_mask_ephe = 0x3ff,
+			  .sv_mask_alm = 0x3ff },
+		},
+	};
+	struct nrf_modem_gnss_agnss_data_frame later = request;
+	struct nrf_modem_gnss_agnss_data_frame no_time = request;
+
+	zassert_false(agnss_cache_trim(&request), "empty cache");
+	zassert_equal(request.system[0].sv_mask_ephe, 0xffff);
+
+	full_set_store(0xf6);
+
+	/* Time and position are only valid at download, the other systems
+	 * are not cached.
+	 */
+	zassert_true(agnss_cache_trim(&request));
+	zassert_equal(request.data_flags, NRF_MODEM_GNSS_AGNSS_GPS_SYS_TIME_AND_SV_TOW_REQUEST |
+					  NRF_MODEM_GNSS_AGNSS_POSITION_REQUEST);
+	zassert_equal(request.system[0].sv_mask_ephe, 0xff00);
+	zassert_equal(request.system[0].sv_mask_alm, 0xff00);
+	zassert_equal(request.system[1].sv_mask_ephe, 0x3ff);
+	zassert_equal(request.system[1].sv_mask_alm, 0x3ff);
+
+	/* Within the refresh margin of their expiry the ephemerides are
+	 * downloaded again, except the ones of a later download.
+	 */
+	host_uptime_advance((CONFIG_AGNSS_CACHE_EPHEMERIS_VALIDITY -
+			     CONFIG_AGNSS_CACHE_REFRESH_MARGIN) * MSEC_PER_SEC);
+	data_start();
+	element_add(TYPE_EPHEMERIDES, EPHEMERIS_LEN, newer_svs, ARRAY_SIZE(newer_svs), 0xf7);
+	zassert_equal(agnss_cache_store(data, data_len), 2);
+
+	zassert_true(agnss_cache_trim(&later));
+	zassert_equal(later.system[0].sv_mask_ephe, 0xfffc);
+	zassert_equal(later.system[0].sv_mask_alm, 0xff00);
+
+	/* Without the time the whole request is downloaded. */
+	host_date_time_clear();
+	zassert_false(agnss_cache_trim(&no_time));
+	zassert_equal(no_time.data_flags, request.data_flags |
+					  NRF_MODEM_GNSS_AGNSS_GPS_UTC_REQUEST |
+					  NRF_MODEM_GNSS_AGNSS_KLOBUCHAR_REQUEST |
+					  NRF_MODEM_GNSS_AGNSS_NEQUICK_REQUEST);
+	zassert_equal(no_time.system[0].sv_mask_ephe, 0xffff);
+}
+
+ZTEST(agnss_cache, test_reboot)
+{
+	static uint8_t before_reboot[4096];
+	size_t before_reboot_len;
+	struct host_storage_stats stats;
+
+	full_set_store(0x17);
+	host_storage_stats_get(&stats);
+	zassert_equal(stats.writes, SAVE_WRITES);
+
+	zassert_equal(agnss_cache_inject(), 19);
+	memcpy(before_reboot, injected, injected_len);
+	before_reboot_len = injected_len;
+
+	/* The cache is restored after a reboot, before the time is known. */
+	host_uptime_set(0);
+	host_date_time_clear();
+	zassert_ok(agnss_cache_init());
+	zassert_equal(agnss_cache_inject(), -EAGAIN);
+
+	host_date_time_set(START_TIME_MS + 60 * MSEC_PER_SEC);
+	zassert_equal(agnss_cache_inject(), 19);
+	zassert_equal(injected_len, before_reboot_len);
+	zassert_mem_equal(injected, before_reboot, injected_len);
+}
+
+ZTEST(agnss_cache, test_interrupted_save)
+{
+	static const uint8_t svs[] = { 1 };
+	uint8_t chunk[1024];
+	ssize_t len;
+
+	full_set_store(0x39);
+
+	/* A save that fails at its first write keeps the previous cache in
+	 * the flash.
+	 */
+	data_start();
+	element_add(TYPE_EPHEMERIDES, EPHEMERIS_LEN, svs, 1, 0x4a);
+	host_storage_fail_writes(1);
+	zassert_equal(agnss_cache_store(data, data_len), -EIO);
+
+	zassert_ok(agnss_cache_init());
+	zassert_equal(agnss_cache_inject(), 19);
+	zassert_equal(injected_tag(TYPE_EPHEMERIDES, EPHEMERIS_LEN, 1), 0x39);
+
+	/* A reboot after a chunk but before the header does not match the CRC
+	 * and the cache is dropped.
+	 */
+	len = storage_read(STORAGE_ID_AGNSS_CACHE_FIRST, chunk, sizeof(chunk));
+	zassert_equal(len, sizeof(chunk));
+	chunk[100] ^= 0x01;
+	zassert_ok(storage_write(STORAGE_ID_AGNSS_CACHE_FIRST, chunk, len));
+
+	zassert_ok(agnss_cache_init());
+	zassert_equal(agnss_cache_inject(), -ENODATA);
+
+	/* A missing chunk too. */
+	full_set_store(0x39);
+	zassert_ok(storage_delete(STORAGE_ID_AGNSS_CACHE_FIRST + 4));
+	zassert_ok(agnss_cache_init());
+	zassert_equal(agnss_cache_inject(), -ENODATA);
+}
+
+ZTEST(agnss_cache, test_ttff)
+{
+	struct agnss_cache_ttff ttff;
+
+	agnss_cache_ttff_record(true, 5000);
+	agnss_cache_ttff_record(false, 30000);
+	agnss_cache_ttff_record(true, 3000);
+
+	zassert_ok(agnss_cache_init());
+
+	agnss_cache_ttff_get(true, &ttff);
+	zassert_equal(ttff.count, 2);
+	zassert_equal(ttff.total, 8000);
+	zassert_equal(ttff.last, 3000);
+
+	agnss_cache_ttff_get(false, &ttff);
+	zassert_equal(ttff.count, 1);
+	zassert_equal(ttff.total, 30000);
+	zassert_equal(ttff.last, 30000);
+
+	/* The statistics start over with an erased flash. */
+	host_storage_erase();
+	zassert_ok(agnss_cache_init());
+	agnss_cache_ttff_get(true, &ttff);
+	zassert_equal(ttff.count, 0);
+}
+
+ZTEST_SUITE(agnss_cache, NULL, NULL, before, NULL, NULL);
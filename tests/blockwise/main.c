@@ -0,0 +1,351 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <string.h>
+#include <ztest.h>
+#include <zephyr/kernel.h>
+#include <zephyr/net/coap.h>
+
+#include "cloud/blockwise.h"
+
+#define MSG_LEN 1200
+#define DOCUMENT_MAX_LEN 4096
+
+/* CONFIG_CLOUD_COAP_BLOCK_SIZE of 64 bytes. */
+#define SZX_64 2
+
+static uint8_t document[DOCUMENT_MAX_LEN];
+
+static uint8_t reply_buf[MSG_LEN];
+static struct coap_packet reply;
+
+/* Stand-in of the server. It reassembles the uploads in blocks of at most
+ * 2^(szx + 4) bytes, and serves the document in blocks of that size.
+ */
+static struct {
+	uint8_t szx;
+	uint8_t received[DOCUMENT_MAX_LEN];
+	size_t received_len;
+	uint32_t blocks;
+	uint32_t size1;
+} server;
+
+static void document_fill(size_t len)
+{
+	for (size_t i = 0; i < len; i++) {
+		document[i] = (uint8_t)(i * 7 + i / 251);
+	}
+}
+
+static void reply_init(uint8_t code)
+{
+	uint8_t token = 0x42;
+
+	zassert_ok(coap_packet_init(&reply, reply_buf, sizeof(reply_buf), 1, COAP_TYPE_ACK,
+				    sizeof(token), &token, code, 1));
+}
+
+/* Answer a block of an upload as the server of tools/blockwise_server.py
+ * does: 2.31 Continue with the Block1 option while more blocks follow,
+ * 2.04 Changed after the last one.
+ */
+static const struct coap_packet *server_upload(const struct blockwise_block *block)
+{
+	uint32_t num = block->block1 >> 4;
+	bool more = block->block1 & 0x08;
+	uint8_t szx = block->block1 & 0x07;
+	size_t offset = (size_t)num << (szx + 4);
+
+	zassert_equal(offset, server.received_len, "block %u at offset %zu", num, offset);
+	zassert_true(offset + block->len <= sizeof(server.received));
+	if (more) {
+		zassert_equal(block->len, BLOCKWISE_BYTES(szx));
+	}
+
+	if (block->size1 != 0) {
+		zassert_equal(offset, 0, "Size1 in block %u", num);
+		server.size1 = block->size1;
+	}
+
+	memcpy(&server.received[offset], block->data, block->len);
+	server.received_len = offset + block->len;
+	server.blocks++;
+
+	if (!more) {
+		reply_init(COAP_RESPONSE_CODE_CHANGED);
+		return &reply;
+	}
+
+	/* A block larger than the server accepts is acknowledged with the
+	 * server's block size (RFC 7959 2.5).
+	 */
+	szx = MIN(szx, server.szx);
+	reply_init(COAP_RESPONSE_CODE_CONTINUE);
+	zassert_ok(coap_append_option_int(&reply, COAP_OPTION_BLOCK1,
+					  blockwise_option(offset >> (szx + 4), true, szx)));
+
+	return &reply;
+}
+
+/* Upload the document, returns the final response code. */
+static uint8_t upload(size_t len)
+{
+	struct blockwise_upload state;
+	struct blockwise_block block;
+	const struct coap_packet *response;
+
+	blockwise_upload_start(&state, document, len);
+	do {
+		blockwise_upload_next(&state, &block);
+		response = server_upload(&block);
+	} while (blockwise_upload_response(&state, response));
+
+	zassert_is_null(state.payload);
+
+	return coap_header_get_code(response);
+}
+
+/* Serve the block of the document asked for by a Block2 option. */
+static const struct coap_packet *server_download(uint32_t block2, size_t len)
+{
+	uint8_t szx = MIN(block2 & 0x07, server.szx);
+	size_t offset = (size_t)(block2 >> 4) << ((block2 & 0x07) + 4);
+	size_t block_len = MIN(BLOCKWISE_BYTES(szx), len - offset);
+	bool more = offset + block_len < len;
+
+	zassert_true(offset < len);
+	server.blocks++;
+
+	reply_init(COAP_RESPONSE_CODE_CONTENT);
+	zassert_ok(coap_append_option_int(&reply, COAP_OPTION_BLOCK2,
+					  blockwise_option(offset >> (szx + 4), more, szx)));
+	zassert_ok(coap_packet_append_payload_marker(&reply));
+	zassert_ok(coap_packet_append_payload(&reply, &document[offset], block_len));
+
+	return &reply;
+}
+
+/* Download the document, as the device config and the A-GNSS data are. */
+static int download(size_t len, uint8_t *buf, size_t size, size_t *received)
+{
+	uint32_t block2 = blockwise_option(0, false, BLOCKWISE_SZX_PREFERRED);
+	int err;
+
+	do {
+		err = blockwise_download_append(server_download(block2, len), buf, size,
+						received, &block2);
+	} while (err == 1);
+
+	return err;
+}
+
+static void before(void *fixture)
+{
+	memset(&server, 0, sizeof(server));
+	server.szx = 6;
+	document_fill(sizeof(document));
+}
+
+ZTEST(blockwise, test_option)
+{
+	zassert_equal(blockwise_option(0, false, 0), 0x00);
+	zassert_equal(blockwise_option(1, true, 2), 0x1a);
+	zassert_equal(blockwise_option(0x1234, false, 6), 0x12346);
+	zassert_equal(BLOCKWISE_SZX_PREFERRED, SZX_64);
+	zassert_equal(BLOCKWISE_BYTES(SZX_64), 64);
+}
+
+ZTEST(blockwise, test_upload)
+{
+	zassert_equal(upload(1000), COAP_RESPONSE_CODE_CHANGED);
+
+	/* 15 blocks of 64 bytes and one of 40, the total size in the first. */
+	zassert_equal(server.blocks, 16);
+	zassert_equal(server.size1, 1000);
+	zassert_equal(server.received_len, 1000);
+	zassert_mem_equal(server.received, document, 1000);
+}
+
+ZTEST(blockwise, test_upload_whole_blocks)
+{
+	zassert_equal(upload(256), COAP_RESPONSE_CODE_CHANGED);
+	zassert_equal(server.blocks, 4);
+	zassert_mem_equal(server.received, document, 256);
+}
+
+ZTEST(blockwise, test_upload_renegotiated)
+{
+	/* The server takes 16 byte blocks, the rest of the upload goes in
+	 * blocks of that size from the end of the first one.
+	 */
+	server.szx = 0;
+	zassert_equal(upload(1000), COAP_RESPONSE_CODE_CHANGED);
+	zassert_equal(server.blocks, 1 + DIV_ROUND_UP(1000 - 64, 16));
+	zassert_equal(server.received_len, 1000);
+	zassert_mem_equal(server.received, document, 1000);
+}
+
+ZTEST(blockwise, test_upload_larger_block_ignored)
+{
+	struct blockwise_upload state;
+	struct blockwise_block block;
+
+	/* A server allowing larger blocks does not make them larger. */
+	blockwise_upload_start(&state, document, 1000);
+	blockwise_upload_next(&state, &block);
+	reply_init(COAP_RESPONSE_CODE_CONTINUE);
+	zassert_ok(coap_append_option_int(&reply, COAP_OPTION_BLOCK1,
+					  blockwise_option(0, true, 6)));
+	zassert_true(blockwise_upload_response(&state, &reply));
+
+	blockwise_upload_next(&state, &block);
+	zassert_equal(block.block1, blockwise_option(1, true, SZX_64));
+	zassert_equal(block.len, 64);
+	zassert_equal(block.size1, 0);
+}
+
+ZTEST(blockwise, test_upload_ended)
+{
+	struct blockwise_upload state;
+	struct blockwise_block block;
+
+	/* The server rejects the upload after the first block. */
+	blockwise_upload_start(&state, document, 1000);
+	blockwise_upload_next(&state, &block);
+	reply_init(COAP_RESPONSE_CODE_REQUEST_TOO_LARGE);
+	zassert_false(blockwise_upload_response(&state, &reply));
+	zassert_is_null(state.payload);
+
+	/* The block got no response. */
+	blockwise_upload_start(&state, document, 1000);
+	blockwise_upload_next(&state, &block);
+	zassert_false(blockwise_upload_response(&state, NULL));
+	zassert_is_null(state.payload);
+
+	/* Continue after the last block. */
+	blockwise_upload_start(&state, document, 100);
+	blockwise_upload_next(&state, &block);
+	reply_init(COAP_RESPONSE_CODE_CONTINUE);
+	zassert_true(blockwise_upload_response(&state, &reply));
+	blockwise_upload_next(&state, &block);
+	zassert_equal(block.len, 36);
+	zassert_equal(block.block1 & 0x08, 0);
+	zassert_false(blockwise_upload_response(&state, &reply));
+}
+
+ZTEST(blockwise, test_download)
+{
+	static uint8_t buf[DOCUMENT_MAX_LEN];
+	size_t len = 0;
+
+	zassert_equal(download(1000, buf, sizeof(buf), &len), 0);
+	zassert_equal(len, 1000);
+	zassert_equal(server.blocks, 16);
+	zassert_mem_equal(buf, document, 1000);
+}
+
+ZTEST(blockwise, test_download_smaller_blocks)
+{
+	static uint8_t buf[DOCUMENT_MAX_LEN];
+	size_t len = 0;
+
+	/* The server answers the request for 64 byte blocks with 32 byte
+	 * ones, the next blocks are asked for at that size.
+	 */
+	server.szx = 1;
+	zassert_equal(download(1000, buf, sizeof(buf), &len), 0);
+	zassert_equal(len, 1000);
+	zassert_equal(server.blocks, DIV_ROUND_UP(1000, 32));
+	zassert_mem_equal(buf, document, 1000);
+}
+
+ZTEST(blockwise, test_download_larger_first_block)
+{
+	static uint8_t buf[DOCUMENT_MAX_LEN];
+	uint32_t next_block2;
+	size_t len = 0;
+
+	/* A first block of 1024 bytes, sent without being asked for, is kept
+	 * and the rest is asked for in 64 byte blocks.
+	 */
+	reply_init(COAP_RESPONSE_CODE_CONTENT);
+	zassert_ok(coap_append_option_int(&reply, COAP_OPTION_BLOCK2,
+					  blockwise_option(0, true, 6)));
+	zassert_ok(coap_packet_append_payload_marker(&reply));
+	zassert_ok(coap_packet_append_payload(&reply, document, 1024));
+
+	zassert_equal(blockwise_download_append(&reply, buf, sizeof(buf), &len, &next_block2), 1);
+	zassert_equal(len, 1024);
+	zassert_equal(next_block2, blockwise_option(16, false, SZX_64));
+}
+
+ZTEST(blockwise, test_download_single_response)
+{
+	static uint8_t buf[DOCUMENT_MAX_LEN];
+	uint32_t next_block2 = 0;
+	size_t len = 123;
+
+	/* A response without Block2 is the whole document. */
+	reply_init(COAP_RESPONSE_CODE_CONTENT);
+	zassert_ok(coap_packet_append_payload_marker(&reply));
+	zassert_ok(coap_packet_append_payload(&reply, document, 40));
+
+	zassert_equal(blockwise_download_append(&reply, buf, sizeof(buf), &len, &next_block2), 0);
+	zassert_equal(len, 40);
+	zassert_mem_equal(buf, document, 40);
+}
+
+ZTEST(blockwise, test_download_restart)
+{
+	static uint8_t buf[DOCUMENT_MAX_LEN];
+	uint32_t next_block2;
+	size_t len = 0;
+
+	zassert_equal(blockwise_download_append(server_download(blockwise_option(0, false, SZX_64),
+								 1000),
+						buf, sizeof(buf), &len, &next_block2), 1);
+	zassert_equal(blockwise_download_append(server_download(next_block2, 1000),
+						buf, sizeof(buf), &len, &next_block2), 1);
+	zassert_equal(len, 128);
+
+	/* The first block, of a notification for example, starts over. */
+	zassert_equal(blockwise_download_append(server_download(blockwise_option(0, false, SZX_64),
+								 1000),
+						buf, sizeof(buf), &len, &next_block2), 1);
+	zassert_equal(len, 64);
+	zassert_equal(next_block2, blockwise_option(1, false, SZX_64));
+}
+
+ZTEST(blockwise, test_download_unexpected_block)
+{
+	static uint8_t buf[DOCUMENT_MAX_LEN];
+	uint32_t next_block2;
+	size_t len = 0;
+
+	zassert_equal(blockwise_download_append(server_download(blockwise_option(0, false, SZX_64),
+								 1000),
+						buf, sizeof(buf), &len, &next_block2), 1);
+
+	/* Block 2 instead of block 1. */
+	zassert_equal(blockwise_download_append(server_download(blockwise_option(2, false, SZX_64),
+								 1000),
+						buf, sizeof(buf), &len, &next_block2), -EBADMSG);
+	zassert_equal(len, 64);
+}
+
+ZTEST(blockwise, test_download_overflow)
+{
+	static uint8_t buf[200];
+	size_t len = 0;
+
+	/* The fourth block does not fit. */
+	zassert_equal(download(1000, buf, sizeof(buf), &len), -EMSGSIZE);
+	zassert_equal(len, 192);
+	zassert_equal(server.blocks, 4);
+	zassert_mem_equal(buf, document, 192);
+}
+
+ZTEST_SUITE(blockwise, NULL, NULL, before, NULL, NULL);
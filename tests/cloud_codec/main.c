@@ -0,0 +1,314 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <malloc.h>
+#include <ztest.h>
+#include <zephyr/kernel.h>
+
+#include "cloud/cloud_codec.h"
+#include "host_track.h"
+
+#define BATCH_MAX 16
+
+static uint8_t buf[2048];
+
+/* Minimal CBOR reader of the fix maps, for checking the encoder. */
+struct cbor_reader {
+	const uint8_t *pos;
+	const uint8_t *end;
+};
+
+static bool cbor_int(struct cbor_reader *r, int64_t *value)
+{
+	uint8_t major;
+	uint8_t info;
+	uint64_t arg = 0;
+	int bytes;
+
+	if (r->pos >= r->end) {
+		return false;
+	}
+
+	major = *r->pos >> 5;
+	info = *r->pos++ & 0x1f;
+
+	if (major > 1) {
+		return false;
+	}
+
+	if (info < 24) {
+		arg = info;
+	} else if (info <= 27) {
+		bytes = 1 << (info - 24);
+		if (r->end - r->pos < bytes) {
+			return false;
+		}
+		for (int i = 0; i < bytes; i++) {
+			arg = (arg << 8) | *r->pos++;
+		}
+	} else {
+		return false;
+	}
+
+	*value = major == 0 ? (int64_t)arg : -1 - (int64_t)arg;
+
+	return true;
+}
+
+static bool cbor_byte(struct cbor_reader *r, uint8_t byte)
+{
+	return r->pos < r->end && *r->pos++ == byte;
+}
+
+static bool cbor_fix(struct cbor_reader *r, struct codec_fix_record *record)
+{
+	int64_t key;
+	int64_t value;
+
+	if (!cbor_byte(r, 0xbf)) {
+		return false;
+	}
+
+	for (int i = 0; i < 5; i++) {
+		if (!cbor_int(r, &key) || key != i || !cbor_int(r, &value)) {
+			return false;
+		}
+
+		switch (key) {
+		case CLOUD_CODEC_KEY_TIME:
+			record->time = value;
+			break;
+		case CLOUD_CODEC_KEY_LATITUDE:
+			record->latitude = value;
+			break;
+		case CLOUD_CODEC_KEY_LONGITUDE:
+			record->longitude = value;
+			break;
+		case CLOUD_CODEC_KEY_ALTITUDE:
+			record->altitude = value;
+			break;
+		case CLOUD_CODEC_KEY_ACCURACY:
+			record->accuracy = value;
+			break;
+		}
+	}
+
+	return cbor_byte(r, 0xff);
+}
+
+/* Decode an array of fix maps and compare it to the fixes. */
+static void expect_cbor_fixes(const uint8_t *data, size_t len,
+			      const struct cloud_location_data *fixes, int count)
+{
+	struct cbor_reader r = { .pos = data, .end = data + len };
+	struct codec_fix_record expected;
+	struct codec_fix_record record;
+
+	zassert_true(cbor_byte(&r, 0x9f));
+
+	for (int i = 0; i < count; i++) {
+		zassert_true(cbor_fix(&r, &record), "fix %d", i);
+		codec_record_from_fix(&expected, &fixes[i]);
+		zassert_equal(record.time, expected.time, "fix %d", i);
+		zassert_equal(record.latitude, expected.latitude, "fix %d", i);
+		zassert_equal(record.longitude, expected.longitude, "fix %d", i);
+		zassert_equal(record.altitude, expected.altitude, "fix %d", i);
+		zassert_equal(record.accuracy, expected.accuracy, "fix %d", i);
+	}
+
+	zassert_true(cbor_byte(&r, 0xff));
+	zassert_equal(r.pos, r.end, "%zu bytes left", (size_t)(r.end - r.pos));
+}
+
+ZTEST(cloud_codec, test_cbor_values)
+{
+	const struct cloud_location_data *track = host_track_get();
+	struct cloud_location_data southwest = track[0];
+	size_t len;
+
+	zassert_equal(cloud_codec_encode_cbor(track, BATCH_MAX, true, buf, sizeof(buf), &len, NULL),
+		      BATCH_MAX);
+	expect_cbor_fixes(buf, len, track, BATCH_MAX);
+
+	/* Negative coordinates and altitude. */
+	southwest.pvt.latitude = -33.8688;
+	southwest.pvt.longitude = -151.2093;
+	southwest.pvt.altitude = -12.5f;
+	zassert_equal(cloud_codec_encode_cbor(&southwest, 1, true, buf, sizeof(buf), &len, NULL), 1);
+	expect_cbor_fixes(buf, len, &southwest, 1);
+}
+
+ZTEST(cloud_codec, test_cbor_single_fix)
+{
+	const struct cloud_location_data *track = host_track_get();
+	struct cbor_reader r;
+	struct codec_fix_record record;
+	size_t len;
+
+	/* Without the array only the first fix is encoded. */
+	zassert_equal(cloud_codec_encode_cbor(track, 4, false, buf, sizeof(buf), &len, NULL), 1);
+
+	r.pos = buf;
+	r.end = buf + len;
+	zassert_true(cbor_fix(&r, &record));
+	zassert_equal(r.pos, r.end);
+}
+
+ZTEST(cloud_codec, test_cbor_fixes_left_out)
+{
+	const struct cloud_location_data *track = host_track_get();
+	size_t full_len;
+	size_t len;
+	int count;
+
+	zassert_equal(cloud_codec_encode_cbor(track, BATCH_MAX, true, buf, sizeof(buf),
+					      &full_len, NULL), BATCH_MAX);
+
+	/* The predicted sizes are exact, a buffer of the payload size fits all. */
+	zassert_equal(cloud_codec_encode_cbor(track, BATCH_MAX, true, buf, full_len, &len, NULL),
+		      BATCH_MAX);
+	zassert_equal(len, full_len);
+
+	/* Every smaller buffer leaves out the newest fixes, and never overflows. */
+	for (size_t size = full_len - 1; size > 0; size--) {
+		memset(buf, 0xa5, sizeof(buf));
+		count = cloud_codec_encode_cbor(track, BATCH_MAX, true, buf, size, &len, NULL);
+		if (count < 0) {
+			zassert_equal(count, -ENOMEM);
+			zassert_true(size < 40, "one fix fits in %zu bytes", size);
+			continue;
+		}
+
+		zassert_true(count < BATCH_MAX);
+		zassert_true(len <= size, "%zu bytes in %zu", len, size);
+		zassert_equal(buf[size], 0xa5, "overflow at %zu", size);
+		expect_cbor_fixes(buf, len, track, count);
+	}
+}
+
+ZTEST(cloud_codec, test_json_fixes_left_out)
+{
+	const struct cloud_location_data *track = host_track_get();
+	size_t full_len;
+	size_t len;
+	int count;
+
+	zassert_equal(cloud_codec_encode_json(track, BATCH_MAX, true, buf, sizeof(buf),
+					      &full_len, NULL), BATCH_MAX);
+	zassert_equal(buf[0], '[');
+	zassert_equal(buf[full_len - 1], ']');
+
+	count = cloud_codec_encode_json(track, BATCH_MAX, true, buf, full_len / 2, &len, NULL);
+	zassert_true(count > 0 && count < BATCH_MAX);
+	zassert_true(len <= full_len / 2);
+	zassert_equal(buf[len - 1], ']');
+}
+
+/* Bytes per fix of the formats over the reference track, batched and as
+ * single fix payloads. Printed for the comparison in the README.
+ */
+ZTEST(cloud_codec, test_size_comparison)
+{
+	const struct cloud_location_data *track = host_track_get();
+	static const int batches[] = { 1, 8, 16 };
+	size_t json_bytes[ARRAY_SIZE(batches)] = { 0 };
+	size_t cbor_bytes[ARRAY_SIZE(batches)] = { 0 };
+	size_t record_bytes[ARRAY_SIZE(batches)] = { 0 };
+
+	for (int b = 0; b < ARRAY_SIZE(batches); b++) {
+		int batch = batches[b];
+
+		for (int i = 0; i + batch <= HOST_TRACK_LEN; i += batch) {
+			size_t len;
+
+			zassert_equal(cloud_codec_encode_json(&track[i], batch, batch > 1, buf,
+							      sizeof(buf), &len, NULL), batch);
+			json_bytes[b] += len;
+			zassert_equal(cloud_codec_encode_cbor(&track[i], batch, batch > 1, buf,
+							      sizeof(buf), &len, NULL), batch);
+			cbor_bytes[b] += len;
+			zassert_equal(codec_records_encode(&track[i], batch, buf, sizeof(buf),
+							   &len), batch);
+			record_bytes[b] += len;
+		}
+
+		TC_PRINT("Batch %2d: JSON %5.1f, CBOR %5.1f, records %5.1f bytes per fix\n",
+			 batch, (double)json_bytes[b] / HOST_TRACK_LEN,
+			 (double)cbor_bytes[b] / HOST_TRACK_LEN,
+			 (double)record_bytes[b] / HOST_TRACK_LEN);
+
+		zassert_true(cbor_bytes[b] * 2 < json_bytes[b], "CBOR at least halves JSON");
+		zassert_true(record_bytes[b] <= cbor_bytes[b]);
+	}
+}
+
+/* The size of the fixes sent on their own, for the bytes per fix metric,
+ * is the same as when each fix is encoded on its own.
+ */
+ZTEST(cloud_codec, test_single_len)
+{
+	const struct cloud_location_data *track = host_track_get();
+	size_t json_single = 0;
+	size_t cbor_single = 0;
+	size_t record_single = 0;
+	size_t single_len;
+	size_t len;
+
+	for (int i = 0; i < BATCH_MAX; i++) {
+		zassert_equal(cloud_codec_encode_json(&track[i], 1, false, buf, sizeof(buf),
+						      &len, NULL), 1);
+		json_single += len;
+		zassert_equal(cloud_codec_encode_cbor(&track[i], 1, false, buf, sizeof(buf),
+						      &len, NULL), 1);
+		cbor_single += len;
+		zassert_equal(codec_records_encode(&track[i], 1, buf, sizeof(buf), &len), 1);
+		zassert_equal(codec_record_single_len(&track[i]), len);
+		record_single += len;
+	}
+
+	zassert_equal(cloud_codec_encode_json(track, BATCH_MAX, true, buf, sizeof(buf), &len,
+					      &single_len), BATCH_MAX);
+	zassert_equal(single_len, json_single, "%zu != %zu", single_len, json_single);
+	zassert_equal(cloud_codec_encode_cbor(track, BATCH_MAX, true, buf, sizeof(buf), &len,
+					      &single_len), BATCH_MAX);
+	zassert_equal(single_len, cbor_single, "%zu != %zu", single_len, cbor_single);
+	zassert_true(record_single > 0);
+
+	/* Only the fixes that fit are counted. */
+	zassert_equal(cloud_codec_encode_json(track, BATCH_MAX, true, buf, 200, &len,
+					      &single_len), 1);
+	zassert_equal(single_len, len - 2);
+	zassert_equal(cloud_codec_encode_cbor(track, BATCH_MAX, true, buf, 60, &len,
+					      &single_len), 2);
+	zassert_equal(single_len, len - 2);
+}
+
+/* The encoders write to the caller's buffer and never allocate. */
+ZTEST(cloud_codec, test_no_heap_allocation)
+{
+	const struct cloud_location_data *track = host_track_get();
+	size_t heap_used;
+	size_t single_len;
+	size_t len;
+
+	/* The C library of the host may allocate on the first conversion of a time. */
+	(void)cloud_codec_encode_json(track, 1, false, buf, sizeof(buf), &len, NULL);
+
+	heap_used = mallinfo2().uordblks;
+
+	for (int i = 0; i + BATCH_MAX <= HOST_TRACK_LEN; i += BATCH_MAX) {
+		zassert_equal(cloud_codec_encode_json(&track[i], BATCH_MAX, true, buf, sizeof(buf),
+						      &len, &single_len), BATCH_MAX);
+		zassert_equal(cloud_codec_encode_cbor(&track[i], BATCH_MAX, true, buf, sizeof(buf),
+						      &len, &single_len), BATCH_MAX);
+		zassert_equal(codec_records_encode(&track[i], BATCH_MAX, buf, sizeof(buf), &len),
+			      BATCH_MAX);
+	}
+
+	zassert_equal(mallinfo2().uordblks, heap_used, "encoders allocated from the heap");
+}
+
+ZTEST_SUITE(cloud_codec, NULL, NULL, NULL, NULL, NULL);
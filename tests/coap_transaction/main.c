@@ -0,0 +1,464 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <ztest.h>
+#include <zephyr/kernel.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/net/coap.h>
+#include <zephyr/random/rand32.h>
+
+#include "cloud/coap_transaction.h"
+
+/* Stand-in of the server behind a lossy link. Every datagram the device
+ * sends is lost with the uplink loss, or answered after the round trip
+ * time, and the answer is lost with the downlink loss.
+ */
+enum server_mode {
+	/* Piggybacked 2.04 Changed in the ACK. */
+	SERVER_PIGGYBACKED,
+	/* Empty ACK, then a confirmable 2.04 Changed after the delay. */
+	SERVER_SEPARATE,
+	/* Reset. */
+	SERVER_RESET,
+	/* No answer. */
+	SERVER_SILENT,
+};
+
+static struct {
+	enum server_mode mode;
+	uint32_t rtt_ms;
+	uint32_t jitter_ms;
+	uint32_t separate_delay_ms;
+	/* Loss in percent. */
+	uint32_t uplink_loss;
+	uint32_t downlink_loss;
+	/* Reverse the order of the answers that arrive at the same time. */
+	bool reorder;
+} link;
+
+#define IN_FLIGHT_MAX 64
+#define SENDS_MAX 64
+
+static struct {
+	int64_t at;
+	uint8_t buf[16];
+	size_t len;
+} in_flight[IN_FLIGHT_MAX];
+
+static size_t in_flight_count;
+
+/* Times the device sent datagrams at. */
+static int64_t sends[SENDS_MAX];
+static size_t send_count;
+
+static uint32_t loss_seed = 12345;
+
+static uint32_t link_rand(uint32_t range)
+{
+	loss_seed ^= loss_seed << 13;
+	loss_seed ^= loss_seed >> 17;
+	loss_seed ^= loss_seed << 5;
+
+	return range ? loss_seed % range : 0;
+}
+
+static void deliver_later(int64_t at, uint8_t type, uint8_t code, uint16_t id,
+			  const uint8_t *token, uint8_t token_len)
+{
+	zassert_true(in_flight_count < IN_FLIGHT_MAX);
+
+	if (link_rand(100) < link.downlink_loss) {
+		return;
+	}
+
+	in_flight[in_flight_count].at = at;
+	in_flight[in_flight_count].len = host_coap_build(in_flight[in_flight_count].buf,
+							 type, code, id, token, token_len);
+	in_flight_count++;
+}
+
+ssize_t host_socket_send(int sock, const void *buf, size_t len, int flags)
+{
+	struct coap_packet request;
+	uint8_t token[COAP_TOKEN_MAX_LEN];
+	uint8_t token_len;
+	uint16_t id;
+	int64_t at = k_uptime_get() + link.rtt_ms + link_rand(link.jitter_ms + 1);
+
+	zassert_ok(coap_packet_parse(&request, (uint8_t *)buf, len, NULL, 0));
+
+	if (send_count < SENDS_MAX) {
+		sends[send_count] = k_uptime_get();
+	}
+	send_count++;
+
+	/* The device's own ACKs to separate responses. */
+	if (coap_header_get_type(&request) != COAP_TYPE_CON) {
+		return len;
+	}
+
+	if (link_rand(100) < link.uplink_loss) {
+		return len;
+	}
+
+	id = coap_header_get_id(&request);
+	token_len = coap_header_get_token(&request, token);
+
+	switch (link.mode) {
+	case SERVER_PIGGYBACKED:
+		deliver_later(at, COAP_TYPE_ACK, COAP_RESPONSE_CODE_CHANGED, id, token, token_len);
+		break;
+	case SERVER_SEPARATE:
+		deliver_later(at, COAP_TYPE_ACK, COAP_CODE_EMPTY, id, NULL, 0);
+		deliver_later(at + link.separate_delay_ms, COAP_TYPE_CON,
+			      COAP_RESPONSE_CODE_CHANGED, 0x7000 + id, token, token_len);
+		break;
+	case SERVER_RESET:
+		deliver_later(at, COAP_TYPE_RESET, COAP_CODE_EMPTY, id, NULL, 0);
+		break;
+	case SERVER_SILENT:
+		break;
+	}
+
+	return len;
+}
+
+/* Completed transactions. */
+static struct {
+	int calls;
+	int responses;
+	uint8_t last_code;
+	void *last_user_data;
+} completions;
+
+static void response_cb(const struct coap_packet *response, void *user_data)
+{
+	completions.calls++;
+	completions.last_user_data = user_data;
+	if (response != NULL) {
+		completions.responses++;
+		completions.last_code = coap_header_get_code(response);
+	}
+}
+
+static struct coap_transaction *request_send(void *user_data)
+{
+	struct coap_transaction *transaction = coap_transaction_new(true, response_cb, user_data);
+
+	if (transaction == NULL) {
+		return NULL;
+	}
+
+	transaction->len = host_coap_build(transaction->buf, COAP_TYPE_CON, COAP_METHOD_POST,
+					   transaction->id, &transaction->token,
+					   sizeof(transaction->token));
+	zassert_ok(coap_transaction_send(transaction));
+
+	return transaction;
+}
+
+/* Deliver the answers and run the retransmissions until no request is
+ * outstanding.
+ */
+static void run(void)
+{
+	while (coap_transaction_count() > 0) {
+		int64_t next = coap_transaction_deadline();
+
+		for (size_t i = 0; i < in_flight_count; i++) {
+			next = MIN(next, in_flight[i].at);
+		}
+
+		host_uptime_set(MAX(next, k_uptime_get()));
+
+		for (size_t i = 0; i < in_flight_count;) {
+			size_t n = link.reorder ? in_flight_count - 1 - i : i;
+			struct coap_packet packet;
+
+			if (in_flight[n].at > k_uptime_get()) {
+				i++;
+				continue;
+			}
+
+			zassert_ok(coap_packet_parse(&packet, in_flight[n].buf, in_flight[n].len,
+						     NULL, 0));
+			(void)coap_transaction_handle(&packet);
+
+			in_flight[n] = in_flight[--in_flight_count];
+			i = 0;
+		}
+
+		coap_transaction_process();
+	}
+
+	/* Answers to retransmissions of completed requests are ignored. */
+	for (size_t i = 0; i < in_flight_count; i++) {
+		struct coap_packet packet;
+
+		zassert_ok(coap_packet_parse(&packet, in_flight[i].buf, in_flight[i].len, NULL, 0));
+		zassert_false(coap_transaction_handle(&packet));
+	}
+	in_flight_count = 0;
+}
+
+/* Send requests one after the other. */
+static void exchange(int count)
+{
+	for (int i = 0; i < count; i++) {
+		zassert_not_null(request_send(NULL));
+		run();
+	}
+}
+
+static void before(void *fixture)
+{
+	memset(&link, 0, sizeof(link));
+	memset(&completions, 0, sizeof(completions));
+	in_flight_count = 0;
+	send_count = 0;
+	host_rand_seed(1);
+	coap_transaction_init(1);
+}
+
+ZTEST(coap_transaction, test_rto_converges_to_rtt)
+{
+	struct coap_transaction_stats stats;
+
+	link.rtt_ms = 300;
+	exchange(50);
+
+	coap_transaction_stats_get(&stats);
+	zassert_within(stats.srtt_ms, 300, 10, "SRTT %u", stats.srtt_ms);
+	zassert_true(stats.rto_ms > 300 && stats.rto_ms < 700, "RTO %u", stats.rto_ms);
+	zassert_equal(completions.responses, 50);
+}
+
+ZTEST(coap_transaction, test_rto_grows_with_long_rtt)
+{
+	struct coap_transaction_stats before;
+	struct coap_transaction_stats after;
+
+	/* Start from a short RTO, the first requests are retransmitted. */
+	link.rtt_ms = 200;
+	exchange(30);
+
+	link.rtt_ms = 4000;
+	exchange(40);
+
+	/* Once the RTO has grown, requests are no longer retransmitted. */
+	coap_transaction_stats_get(&before);
+	exchange(20);
+	coap_transaction_stats_get(&after);
+
+	zassert_equal(after.retransmissions, before.retransmissions,
+		      "%u spurious retransmissions", after.retransmissions - before.retransmissions);
+	zassert_true(after.rto_ms > 4000, "RTO %u", after.rto_ms);
+	zassert_equal(completions.responses, 90);
+}
+
+/* Backoff factor of CoCoA's variable backoff for the current RTO. */
+static uint32_t vbf(uint32_t rto)
+{
+	return rto < 1000 ? 30 : rto > 3000 ? 15 : 20;
+}
+
+static void check_backoff(uint32_t rtt)
+{
+	struct coap_transaction_stats stats;
+	uint32_t timeout;
+	int64_t total;
+
+	/* Train the RTO, then stop answering. */
+	link.rtt_ms = rtt;
+	exchange(40);
+	coap_transaction_stats_get(&stats);
+
+	link.mode = SERVER_SILENT;
+	send_count = 0;
+	zassert_not_null(request_send(NULL));
+	run();
+
+	/* The first transmission and the retransmissions. */
+	zassert_equal(send_count, 1 + CONFIG_CLOUD_COAP_MAX_RETRANSMIT);
+	zassert_equal(completions.calls - completions.responses, 1, "timed out");
+
+	/* The first timeout is randomized between RTO and 1.5 RTO. */
+	timeout = sends[1] - sends[0];
+	zassert_true(timeout >= stats.rto_ms && timeout <= stats.rto_ms * 3 / 2,
+		     "first timeout %u, RTO %u", timeout, stats.rto_ms);
+
+	for (int i = 2; i < send_count; i++) {
+		uint32_t next = sends[i] - sends[i - 1];
+
+		/* The factor is applied to the integer timeout. */
+		zassert_within(next * 10, timeout * vbf(stats.rto_ms), 10,
+			       "RTO %u: timeout %u after %u", stats.rto_ms, next, timeout);
+		timeout = next;
+	}
+
+	total = k_uptime_get() - sends[0];
+	TC_PRINT("RTO %5u ms: %d retransmissions, gave up after %lld ms\n",
+		 stats.rto_ms, CONFIG_CLOUD_COAP_MAX_RETRANSMIT, total);
+}
+
+ZTEST(coap_transaction, test_backoff_short_rto)
+{
+	check_backoff(200);
+}
+
+ZTEST(coap_transaction, test_backoff_medium_rto)
+{
+	check_backoff(1500);
+}
+
+ZTEST(coap_transaction, test_backoff_long_rto)
+{
+	check_backoff(5000);
+}
+
+ZTEST(coap_transaction, test_lossy_link)
+{
+	struct coap_transaction_stats before;
+	struct coap_transaction_stats after;
+	const int requests = 300;
+	uint32_t timeouts;
+
+	link.rtt_ms = 400;
+	link.jitter_ms = 400;
+	link.uplink_loss = 25;
+	link.downlink_loss = 25;
+
+	coap_transaction_stats_get(&before);
+	exchange(requests);
+	coap_transaction_stats_get(&after);
+
+	timeouts = after.timeouts - before.timeouts;
+
+	TC_PRINT("%d requests over 25%%/25%% loss: %u retransmissions, %u timed out, "
+		 "RTO %u ms\n", requests, after.retransmissions - before.retransmissions,
+		 timeouts, after.rto_ms);
+
+	/* With 4 retransmissions, about 2% of the requests should be lost. */
+	zassert_equal(completions.calls, requests);
+	zassert_equal(completions.responses + timeouts, requests);
+	zassert_true(timeouts < requests / 20, "%u timed out", timeouts);
+	zassert_true(after.retransmissions > before.retransmissions);
+	zassert_true(after.rto_ms >= 400 && after.rto_ms < 60000, "RTO %u", after.rto_ms);
+}
+
+ZTEST(coap_transaction, test_separate_response)
+{
+	link.mode = SERVER_SEPARATE;
+	link.rtt_ms = 300;
+	link.separate_delay_ms = 3000;
+
+	zassert_not_null(request_send(NULL));
+	run();
+
+	/* Not retransmitted after the empty ACK. */
+	zassert_equal(send_count, 1);
+	zassert_equal(completions.responses, 1);
+	zassert_equal(completions.last_code, COAP_RESPONSE_CODE_CHANGED);
+}
+
+ZTEST(coap_transaction, test_separate_response_timeout)
+{
+	struct coap_transaction_stats before;
+	struct coap_transaction_stats after;
+	int64_t start = k_uptime_get();
+
+	link.mode = SERVER_SEPARATE;
+	link.rtt_ms = 300;
+	link.separate_delay_ms = CONFIG_CLOUD_RESPONSE_TIMEOUT_MS + 1000;
+
+	coap_transaction_stats_get(&before);
+	zassert_not_null(request_send(NULL));
+	run();
+	coap_transaction_stats_get(&after);
+
+	zassert_equal(completions.responses, 0);
+	zassert_equal(after.timeouts - before.timeouts, 1);
+	zassert_equal(k_uptime_get() - start, 300 + CONFIG_CLOUD_RESPONSE_TIMEOUT_MS);
+}
+
+ZTEST(coap_transaction, test_reset)
+{
+	link.mode = SERVER_RESET;
+	link.rtt_ms = 300;
+
+	zassert_not_null(request_send(NULL));
+	run();
+
+	zassert_equal(completions.calls, 1);
+	zassert_equal(completions.responses, 0);
+	zassert_equal(send_count, 1);
+}
+
+ZTEST(coap_transaction, test_outstanding_requests)
+{
+	int tags[CONFIG_CLOUD_COAP_MAX_TRANSACTIONS];
+
+	link.rtt_ms = 300;
+	link.reorder = true;
+
+	for (int i = 0; i < ARRAY_SIZE(tags); i++) {
+		zassert_not_null(request_send(&tags[i]));
+	}
+
+	/* The table is full. */
+	zassert_is_null(coap_transaction_new(true, response_cb, NULL));
+	zassert_equal(coap_transaction_count(), ARRAY_SIZE(tags));
+
+	/* The answers arrive together in reverse order, each completes its
+	 * own request.
+	 */
+	run();
+	zassert_equal(completions.responses, ARRAY_SIZE(tags));
+	zassert_equal(completions.last_user_data, &tags[0]);
+	zassert_equal(send_count, ARRAY_SIZE(tags));
+}
+
+ZTEST(coap_transaction, test_cancel_all)
+{
+	link.mode = SERVER_SILENT;
+
+	zassert_not_null(request_send(NULL));
+	zassert_not_null(request_send(NULL));
+
+	coap_transaction_cancel_all();
+	zassert_equal(coap_transaction_count(), 0);
+	zassert_equal(completions.calls, 2);
+	zassert_equal(completions.responses, 0);
+	zassert_equal(coap_transaction_deadline(), 0);
+}
+
+ZTEST(coap_transaction, test_timeouts_in_row)
+{
+	struct coap_transaction_stats stats;
+
+	link.mode = SERVER_SILENT;
+	exchange(CONFIG_CLOUD_RECONNECT_TIMEOUTS);
+	coap_transaction_stats_get(&stats);
+	zassert_equal(stats.timeouts_in_row, CONFIG_CLOUD_RECONNECT_TIMEOUTS);
+
+	/* A response ends the run of timeouts. */
+	link.mode = SERVER_PIGGYBACKED;
+	link.rtt_ms = 300;
+	exchange(1);
+	coap_transaction_stats_get(&stats);
+	zassert_equal(stats.timeouts_in_row, 0);
+
+	/* So does a new socket. */
+	link.mode = SERVER_SILENT;
+	exchange(2);
+	coap_transaction_stats_get(&stats);
+	zassert_equal(stats.timeouts_in_row, 2);
+	coap_transaction_init(1);
+	coap_transaction_stats_get(&stats);
+	zassert_equal(stats.timeouts_in_row, 0);
+}
+
+ZTEST_SUITE(coap_transaction, NULL, NULL, before, NULL, NULL);
@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+
+#include <ztest.h>
+#include <zephyr/kernel.h>
+
+#include "codec.h"
+#include "host_track.h"
+
+#define BATCH_MAX 16
+
+static uint8_t buf[1 + HOST_TRACK_LEN * CODEC_RECORD_MAX_LEN];
+static struct cloud_location_data decoded[HOST_TRACK_LEN];
+
+static void record_equal(const struct codec_fix_record *a, const struct codec_fix_record *b)
+{
+	zassert_equal(a->time, b->time);
+	zassert_equal(a->latitude, b->latitude);
+	zassert_equal(a->longitude, b->longitude);
+	zassert_equal(a->altitude, b->altitude);
+	zassert_equal(a->accuracy, b->accuracy);
+	zassert_equal(a->speed, b->speed);
+	zassert_equal(a->heading, b->heading);
+}
+
+/**@brief Encode and decode the fixes, the decoded fixes must give the same
+ *	  records as the original ones.
+ */
+static size_t round_trip(const struct cloud_location_data *fixes, size_t count)
+{
+	struct codec_fix_record expected;
+	struct codec_fix_record actual;
+	size_t len;
+
+	zassert_equal(codec_records_encode(fixes, count, buf, sizeof(buf), &len), count);
+	zassert_equal(codec_records_decode(buf, len, decoded, ARRAY_SIZE(decoded)), count);
+
+	for (size_t i = 0; i < count; i++) {
+		codec_record_from_fix(&expected, &fixes[i]);
+		codec_record_from_fix(&actual, &decoded[i]);
+		record_equal(&actual, &expected);
+	}
+
+	return len;
+}
+
+/* Largest values of the fields of float fixes that survive the conversion. */
+#define METERS_MAX (214748352 * CODEC_SCALE_METERS)
+#define SPEED_MAX (21474836 * CODEC_SCALE_SPEED)
+#define HEADING_MAX (214748352 * CODEC_SCALE_HEADING)
+
+/* Records with the fields at the extremes of their range, and back. */
+static const struct codec_fix_record extremes[] = {
+	{ 0, INT32_MAX, INT32_MIN, METERS_MAX, -METERS_MAX, SPEED_MAX, -HEADING_MAX },
+	{ INT64_MAX / 1000, INT32_MIN, INT32_MAX, -METERS_MAX, METERS_MAX, -SPEED_MAX,
+	  HEADING_MAX },
+	{ 0, 0, 0, 0, 0, 0, 0 },
+	{ INT64_MIN / 1000, -1, 1, -10, 10, -1, 1 },
+};
+
+ZTEST(codec, test_round_trip_track)
+{
+	round_trip(host_track_get(), HOST_TRACK_LEN);
+}
+
+ZTEST(codec, test_round_trip_extremes)
+{
+	struct cloud_location_data fixes[ARRAY_SIZE(extremes)];
+	struct codec_fix_record record;
+
+	for (int i = 0; i < ARRAY_SIZE(extremes); i++) {
+		codec_record_to_fix(&fixes[i], &extremes[i]);
+		codec_record_from_fix(&record, &fixes[i]);
+		record_equal(&record, &extremes[i]);
+	}
+
+	/* The differences between the records take the most bytes. */
+	zassert_true(round_trip(fixes, ARRAY_SIZE(fixes)) <=
+		     1 + ARRAY_SIZE(fixes) * CODEC_RECORD_MAX_LEN);
+}
+
+ZTEST(codec, test_out_of_range_clamped)
+{
+	struct cloud_location_data fix = {
+		.pvt = { .latitude = 1e10, .longitude = -1e10, .altitude = 1e30f,
+			 .accuracy = -1e30f, .speed = NAN, .heading = 0 },
+	};
+	struct codec_fix_record record;
+
+	codec_record_from_fix(&record, &fix);
+	zassert_equal(record.latitude, INT32_MAX);
+	zassert_equal(record.longitude, INT32_MIN);
+	zassert_equal(record.altitude, INT32_MAX);
+	zassert_equal(record.accuracy, INT32_MIN);
+	zassert_equal(record.speed, INT32_MIN);
+}
+
+ZTEST(codec, test_first_record_max_len)
+{
+	struct cloud_location_data fix;
+	size_t single_len;
+	size_t len;
+
+	/* The longest first record, every field takes its longest varint. */
+	codec_record_to_fix(&fix, &extremes[1]);
+	single_len = codec_record_single_len(&fix);
+	zassert_true(single_len <= 1 + CODEC_RECORD_MAX_LEN, "%zu bytes", single_len);
+
+	/* A buffer of the version byte and CODEC_RECORD_MAX_LEN always fits it. */
+	zassert_equal(codec_records_encode(&fix, 1, buf, 1 + CODEC_RECORD_MAX_LEN, &len), 1);
+	zassert_equal(len, single_len);
+
+	/* Exactly fits, and one byte short. */
+	zassert_equal(codec_records_encode(&fix, 1, buf, single_len, &len), 1);
+	zassert_equal(codec_records_encode(&fix, 1, buf, single_len - 1, &len), -ENOMEM);
+
+	zassert_equal(codec_records_decode(buf, len, decoded, 1), 1);
+}
+
+ZTEST(codec, test_single_len)
+{
+	const struct cloud_location_data *track = host_track_get();
+	size_t len;
+
+	for (int i = 0; i < HOST_TRACK_LEN; i++) {
+		zassert_equal(codec_records_encode(&track[i], 1, buf, sizeof(buf), &len), 1);
+		zassert_equal(codec_record_single_len(&track[i]), len);
+	}
+}
+
+ZTEST(codec, test_fixes_left_out)
+{
+	const struct cloud_location_data *track = host_track_get();
+	size_t full;
+	size_t len;
+	int count;
+
+	zassert_equal(codec_records_encode(track, BATCH_MAX, buf, sizeof(buf), &full), BATCH_MAX);
+
+	/* The fixes that fit are the same as in the full payload. */
+	count = codec_records_encode(track, BATCH_MAX, buf, full - 1, &len);
+	zassert_equal(count, BATCH_MAX - 1);
+	zassert_equal(codec_records_decode(buf, len, decoded, BATCH_MAX), count);
+}
+
+ZTEST(codec, test_malformed)
+{
+	const struct cloud_location_data *track = host_track_get();
+	size_t len;
+
+	zassert_equal(codec_records_encode(track, 2, buf, sizeof(buf), &len), 2);
+
+	/* Only as many fixes as fit in the array are decoded. */
+	zassert_equal(codec_records_decode(buf, len, decoded, 1), 1);
+
+	/* Truncated record, and an unknown version. */
+	zassert_equal(codec_records_decode(buf, len - 1, decoded, 2), -EBADMSG);
+	buf[0] = CODEC_RECORD_VERSION + 1;
+	zassert_equal(codec_records_decode(buf, len, decoded, 2), -EBADMSG);
+	zassert_equal(codec_records_decode(buf, 0, decoded, 2), -EBADMSG);
+
+	/* A varint that does not end. */
+	memset(buf, 0xff, 12);
+	buf[0] = CODEC_RECORD_VERSION;
+	zassert_equal(codec_records_decode(buf, 12, decoded, 2), -EBADMSG);
+}
+
+ZTEST(codec, test_benchmark)
+{
+	const struct cloud_location_data *track = host_track_get();
+	const int rounds = 200;
+	uint32_t start;
+	uint32_t encode_us;
+	uint32_t decode_us;
+	size_t len;
+
+	TC_PRINT("Batch  bytes per fix\n");
+	for (int batch = 1; batch <= BATCH_MAX; batch *= 2) {
+		size_t total = 0;
+
+		for (int i = 0; i + batch <= HOST_TRACK_LEN; i += batch) {
+			zassert_equal(codec_records_encode(&track[i], batch, buf, sizeof(buf), &len),
+				      batch);
+			total += len;
+		}
+		TC_PRINT("%5d  %.1f\n", batch, (double)total / (HOST_TRACK_LEN / batch * batch));
+	}
+
+	start = k_cycle_get_32();
+	for (int i = 0; i < rounds; i++) {
+		codec_records_encode(track, HOST_TRACK_LEN, buf, sizeof(buf), &len);
+	}
+	encode_us = k_cyc_to_us_floor64(k_cycle_get_32() - start);
+
+	start = k_cycle_get_32();
+	for (int i = 0; i < rounds; i++) {
+		codec_records_decode(buf, len, decoded, HOST_TRACK_LEN);
+	}
+	decode_us = k_cyc_to_us_floor64(k_cycle_get_32() - start);
+
+	TC_PRINT("Encode %.0f ns per fix, decode %.0f ns per fix on the host\n",
+		 1000.0 * encode_us / (rounds * HOST_TRACK_LEN),
+		 1000.0 * decode_us / (rounds * HOST_TRACK_LEN));
+}
+
+ZTEST_SUITE(codec, NULL, NULL, NULL, NULL, NULL);
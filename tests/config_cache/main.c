@@ -0,0 +1,301 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <string.h>
+#include <ztest.h>
+#include <zephyr/kernel.h>
+#include <zephyr/net/coap.h>
+
+#include "cloud/config_cache.h"
+
+#define MSG_LEN 256
+
+/* Stand-in of the device config resource of the server. It tags each
+ * version of the document with an ETag, and answers a GET with the ETag of
+ * the current version with 2.03 Valid and no payload.
+ */
+static struct {
+	char document[128];
+	uint8_t etag[CONFIG_CACHE_ETAG_MAX_LEN + 1];
+	uint8_t etag_len;
+	/* Max-Age option of the responses, -1 to leave it out. */
+	int max_age;
+	/* Response code instead of the document, 0 for none. */
+	uint8_t error;
+	/* ETag of the last request, empty if it had none. */
+	uint8_t request_etag[CONFIG_CACHE_ETAG_MAX_LEN];
+	uint8_t request_etag_len;
+	uint32_t requests;
+	uint32_t payloads;
+} server;
+
+/* Document the client has, as the cloud module forwards it to main. */
+static char client_document[128];
+
+static void server_set(const char *document, const char *etag, int max_age)
+{
+	strcpy(server.document, document);
+	server.etag_len = strlen(etag);
+	memcpy(server.etag, etag, server.etag_len);
+	server.max_age = max_age;
+}
+
+static void server_handle(uint8_t *buf, size_t len, uint8_t *reply_buf,
+			  struct coap_packet *reply)
+{
+	struct coap_packet request;
+	struct coap_option etag;
+	uint8_t token[COAP_TOKEN_MAX_LEN];
+	uint8_t token_len;
+	bool valid;
+
+	zassert_ok(coap_packet_parse(&request, buf, len, NULL, 0));
+	zassert_equal(coap_header_get_code(&request), COAP_METHOD_GET);
+	server.requests++;
+
+	server.request_etag_len = 0;
+	if (coap_find_options(&request, COAP_OPTION_ETAG, &etag, 1) == 1) {
+		zassert_true(etag.len <= CONFIG_CACHE_ETAG_MAX_LEN);
+		memcpy(server.request_etag, etag.value, etag.len);
+		server.request_etag_len = etag.len;
+	}
+
+	valid = server.etag_len > 0 && server.request_etag_len == server.etag_len &&
+		memcmp(server.request_etag, server.etag, server.etag_len) == 0;
+
+	token_len = coap_header_get_token(&request, token);
+	zassert_ok(coap_packet_init(reply, reply_buf, MSG_LEN, 1, COAP_TYPE_ACK, token_len,
+				    token, server.error ? server.error :
+				    valid ? COAP_RESPONSE_CODE_VALID : COAP_RESPONSE_CODE_CONTENT,
+				    coap_header_get_id(&request)));
+
+	if (server.error) {
+		return;
+	}
+
+	if (server.etag_len > 0) {
+		zassert_ok(coap_packet_append_option(reply, COAP_OPTION_ETAG, server.etag,
+						     server.etag_len));
+	}
+
+	if (server.max_age >= 0) {
+		zassert_ok(coap_append_option_int(reply, COAP_OPTION_MAX_AGE, server.max_age));
+	}
+
+	if (!valid) {
+		zassert_ok(coap_packet_append_payload_marker(reply));
+		zassert_ok(coap_packet_append_payload(reply, (uint8_t *)server.document,
+						      strlen(server.document)));
+		server.payloads++;
+	}
+}
+
+enum fetch_result {
+	FETCH_SKIPPED,
+	FETCH_VALID,
+	FETCH_NEW,
+	FETCH_ERROR,
+};
+
+/**@brief Fetch the device config as client_get_device_config() and
+ *	  device_config_handle() of the cloud module do.
+ */
+static enum fetch_result fetch(void)
+{
+	static uint16_t id;
+	uint8_t buf[MSG_LEN];
+	uint8_t reply_buf[MSG_LEN];
+	uint32_t token = 0x1234;
+	struct coap_packet request;
+	struct coap_packet reply;
+	const uint8_t *etag;
+	uint8_t etag_len;
+	const uint8_t *payload;
+	uint16_t payload_len;
+
+	if (config_cache_fresh()) {
+		return FETCH_SKIPPED;
+	}
+
+	etag_len = config_cache_etag_get(&etag);
+
+	zassert_ok(coap_packet_init(&request, buf, sizeof(buf), 1, COAP_TYPE_CON,
+				    sizeof(token), (uint8_t *)&token, COAP_METHOD_GET, ++id));
+	if (etag_len > 0) {
+		zassert_ok(coap_packet_append_option(&request, COAP_OPTION_ETAG, etag, etag_len));
+	}
+	zassert_ok(coap_packet_append_option(&request, COAP_OPTION_URI_PATH,
+					     (uint8_t *)"device_config", 13));
+
+	server_handle(buf, request.offset, reply_buf, &reply);
+
+	if (config_cache_update(&reply)) {
+		return FETCH_VALID;
+	}
+
+	if ((coap_header_get_code(&reply) >> 5) != 2) {
+		return FETCH_ERROR;
+	}
+
+	payload = coap_packet_get_payload(&reply, &payload_len);
+	zassert_not_null(payload);
+	memcpy(client_document, payload, payload_len);
+	client_document[payload_len] = '\0';
+
+	return FETCH_NEW;
+}
+
+static void before(void *fixture)
+{
+	const uint8_t *etag;
+
+	/* Start each test with an expired config without an ETag. */
+	host_uptime_advance(24 * 3600 * MSEC_PER_SEC);
+	memset(&server, 0, sizeof(server));
+	server_set("{}", "", 0);
+	zassert_equal(fetch(), FETCH_NEW);
+	zassert_equal(config_cache_etag_get(&etag), 0);
+
+	memset(&server, 0, sizeof(server));
+	memset(client_document, 0, sizeof(client_document));
+}
+
+ZTEST(config_cache, test_content_with_etag)
+{
+	const uint8_t *etag;
+
+	server_set("{\"batch_size\":4}", "v1", 30);
+
+	zassert_equal(fetch(), FETCH_NEW);
+	zassert_equal(server.request_etag_len, 0, "no ETag before the first config");
+	zassert_str_equal(client_document, "{\"batch_size\":4}");
+
+	zassert_equal(config_cache_etag_get(&etag), 2);
+	zassert_mem_equal(etag, "v1", 2);
+}
+
+ZTEST(config_cache, test_valid)
+{
+	struct config_cache_stats before;
+	struct config_cache_stats after;
+
+	server_set("{\"batch_size\":4}", "v1", 30);
+	zassert_equal(fetch(), FETCH_NEW);
+	memset(client_document, 0, sizeof(client_document));
+
+	/* After Max-Age the ETag is sent back, and the unchanged config is
+	 * answered without a payload.
+	 */
+	config_cache_stats_get(&before);
+	host_uptime_advance(30 * MSEC_PER_SEC);
+	zassert_equal(fetch(), FETCH_VALID);
+	zassert_equal(server.request_etag_len, 2);
+	zassert_mem_equal(server.request_etag, "v1", 2);
+	zassert_equal(server.payloads, 1);
+	zassert_str_equal(client_document, "", "a valid config is not parsed again");
+
+	config_cache_stats_get(&after);
+	zassert_equal(after.validated, before.validated + 1);
+
+	/* The 2.03 refreshes the Max-Age. */
+	host_uptime_advance(29 * MSEC_PER_SEC);
+	zassert_equal(fetch(), FETCH_SKIPPED);
+	zassert_equal(server.requests, 2);
+
+	/* A changed config comes with its new ETag, sent with the next GET. */
+	host_uptime_advance(MSEC_PER_SEC);
+	server_set("{\"batch_size\":8}", "v2", 30);
+	zassert_equal(fetch(), FETCH_NEW);
+	zassert_mem_equal(server.request_etag, "v1", 2);
+	zassert_str_equal(client_document, "{\"batch_size\":8}");
+
+	host_uptime_advance(30 * MSEC_PER_SEC);
+	zassert_equal(fetch(), FETCH_VALID);
+	zassert_mem_equal(server.request_etag, "v2", 2);
+}
+
+ZTEST(config_cache, test_expiry)
+{
+	struct config_cache_stats before;
+	struct config_cache_stats after;
+
+	/* Without Max-Age the config is fresh for 60 seconds. */
+	server_set("{}", "v1", -1);
+	config_cache_stats_get(&before);
+	zassert_equal(fetch(), FETCH_NEW);
+
+	for (int s = 0; s < CONFIG_CACHE_DEFAULT_MAX_AGE; s += 10) {
+		zassert_equal(fetch(), FETCH_SKIPPED, "%d s", s);
+		host_uptime_advance(10 * MSEC_PER_SEC);
+	}
+
+	zassert_equal(server.requests, 1);
+	config_cache_stats_get(&after);
+	zassert_equal(after.fetches_avoided, before.fetches_avoided + 6);
+
+	/* Refetched once it has expired. */
+	zassert_equal(fetch(), FETCH_VALID);
+	zassert_equal(server.requests, 2);
+
+	/* The 2.03 without Max-Age is fresh for 60 seconds too. Then Max-Age 0
+	 * makes every fetch a GET.
+	 */
+	zassert_equal(fetch(), FETCH_SKIPPED);
+	host_uptime_advance(CONFIG_CACHE_DEFAULT_MAX_AGE * MSEC_PER_SEC);
+	server.max_age = 0;
+	zassert_equal(fetch(), FETCH_VALID);
+	zassert_equal(fetch(), FETCH_VALID);
+	zassert_equal(server.requests, 4);
+
+	/* A longer Max-Age keeps the config fresh longer. */
+	server.max_age = 600;
+	zassert_equal(fetch(), FETCH_VALID);
+	host_uptime_advance(599 * MSEC_PER_SEC);
+	zassert_equal(fetch(), FETCH_SKIPPED);
+	host_uptime_advance(MSEC_PER_SEC);
+	zassert_equal(fetch(), FETCH_VALID);
+}
+
+ZTEST(config_cache, test_no_etag)
+{
+	const uint8_t *etag;
+
+	server_set("{}", "v1", 0);
+	zassert_equal(fetch(), FETCH_NEW);
+	zassert_equal(config_cache_etag_get(&etag), 2);
+
+	/* A config without an ETag drops the old one. */
+	server_set("{\"batch_size\":2}", "", 0);
+	zassert_equal(fetch(), FETCH_NEW);
+	zassert_equal(config_cache_etag_get(&etag), 0);
+	zassert_equal(fetch(), FETCH_NEW);
+	zassert_equal(server.request_etag_len, 0);
+
+	/* An ETag longer than the client keeps is not sent back. */
+	server_set("{}", "123456789", 0);
+	zassert_equal(fetch(), FETCH_NEW);
+	zassert_equal(config_cache_etag_get(&etag), 0);
+	zassert_equal(fetch(), FETCH_NEW);
+	zassert_equal(server.request_etag_len, 0);
+}
+
+ZTEST(config_cache, test_error)
+{
+	server_set("{}", "v1", 30);
+	zassert_equal(fetch(), FETCH_NEW);
+	host_uptime_advance(30 * MSEC_PER_SEC);
+
+	/* An error is not cached, the config is fetched again next time with
+	 * the ETag of the last config.
+	 */
+	server.error = COAP_RESPONSE_CODE_NOT_FOUND;
+	zassert_equal(fetch(), FETCH_ERROR);
+	server.error = 0;
+	zassert_equal(fetch(), FETCH_VALID);
+	zassert_mem_equal(server.request_etag, "v1", 2);
+}
+
+ZTEST_SUITE(config_cache, NULL, NULL, before, NULL, NULL);
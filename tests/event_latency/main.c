@@ -0,0 +1,256 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <ztest.h>
+#include <zephyr/kernel.h>
+
+#include "events/event_latency.h"
+#include "events/event_pool.h"
+#include "events/app_module_event.h"
+#include "events/cloud_module_event.h"
+#include "events/modem_module_event.h"
+#include "events/location_module_event.h"
+
+APP_EVENT_TYPE_DEFINE(app_module_event);
+APP_EVENT_TYPE_DEFINE(cloud_module_event);
+APP_EVENT_TYPE_DEFINE(modem_module_event);
+APP_EVENT_TYPE_DEFINE(location_module_event);
+
+/* Model of the dispatch of the events by the Application Event Manager. The
+ * time is simulated in microseconds, the handlers take the times below, and
+ * event_latency.c records the time from the submission of an event to the
+ * start of its handling.
+ *
+ * The listeners are called one after the other in the order of their names.
+ * A module with a thread queues the event in its listener and handles it
+ * when its thread runs. The location module's own handling of a location
+ * request mostly waits for the modem, so the other threads run meanwhile.
+ */
+
+/* Queueing a reference to the event in a module queue. */
+#define QUEUE_US 20
+/* led_module reading the event in its listener. */
+#define LED_US 10
+/* A module handling a config update. */
+#define CONFIG_UPDATE_US 100
+/* location_request() and the AT commands it sends to the modem. */
+#define LOCATION_REQUEST_US 20000
+
+#define EVENTS_MAX 8
+
+struct test_event {
+	/* First, so that the header is the one of the test event. */
+	struct app_module_event event;
+	uint32_t submitted_at;
+};
+
+struct subscriber {
+	enum event_latency_subscriber id;
+	const char *name;
+	/* Handled by the module thread, not in the listener. */
+	bool thread;
+	struct {
+		struct test_event *event;
+		uint32_t queued_at;
+	} queue[EVENTS_MAX];
+	size_t queue_len;
+};
+
+/* In the order of the listener names. */
+enum {
+	CLOUD,
+	LED,
+	LOCATION,
+	MAIN,
+
+	SUBSCRIBER_COUNT
+};
+
+static struct subscriber subscribers[SUBSCRIBER_COUNT] = {
+	[CLOUD] = { EVENT_LATENCY_CLOUD, "cloud_module", true },
+	[LED] = { EVENT_LATENCY_LED, "led_module", false },
+	[LOCATION] = { EVENT_LATENCY_LOCATION, "location_module", false },
+	[MAIN] = { EVENT_LATENCY_MAIN, "main", true },
+};
+
+static uint32_t now;
+
+uint32_t event_pool_age_cycles(const struct app_event_header *aeh)
+{
+	/* Cycles of the host stand-in are microseconds. */
+	return now - ((const struct test_event *)aeh)->submitted_at;
+}
+
+static bool handles(int subscriber, const struct test_event *event)
+{
+	switch (event->event.type) {
+	case APP_EVENT_LOCATION_GET:
+		return subscriber == LOCATION;
+	case APP_EVENT_CONFIG_UPDATE:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static uint32_t handling_us(int subscriber, const struct test_event *event)
+{
+	if (subscriber == LED) {
+		return LED_US;
+	}
+
+	return event->event.type == APP_EVENT_LOCATION_GET ? LOCATION_REQUEST_US :
+							      CONFIG_UPDATE_US;
+}
+
+/* Dispatch the events in the order they were submitted, then run the module
+ * threads until their queues are empty.
+ */
+static void dispatch(struct test_event *events, size_t count)
+{
+	uint32_t dispatcher = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		struct test_event *event = &events[i];
+
+		dispatcher = MAX(dispatcher, event->submitted_at);
+
+		for (int s = 0; s < SUBSCRIBER_COUNT; s++) {
+			struct subscriber *subscriber = &subscribers[s];
+
+			if (!handles(s, event)) {
+				continue;
+			}
+
+			if (subscriber->thread) {
+				dispatcher += QUEUE_US;
+				zassert_true(subscriber->queue_len < EVENTS_MAX);
+				subscriber->queue[subscriber->queue_len].event = event;
+				subscriber->queue[subscriber->queue_len].queued_at = dispatcher;
+				subscriber->queue_len++;
+				continue;
+			}
+
+			now = dispatcher;
+			event_latency_record(subscriber->id, &event->event.header);
+			dispatcher += handling_us(s, event);
+		}
+	}
+
+	/* Each thread waits for its own events only. */
+	for (int s = 0; s < SUBSCRIBER_COUNT; s++) {
+		struct subscriber *subscriber = &subscribers[s];
+		uint32_t thread = 0;
+
+		for (size_t i = 0; i < subscriber->queue_len; i++) {
+			struct test_event *event = subscriber->queue[i].event;
+
+			thread = MAX(thread, subscriber->queue[i].queued_at);
+			now = thread;
+			event_latency_record(subscriber->id, &event->event.header);
+			thread += handling_us(s, event);
+		}
+		subscriber->queue_len = 0;
+	}
+}
+
+/* A location request of the sample timer and a config update received from
+ * the cloud at the same time.
+ */
+static void burst(struct event_latency_stats stats[SUBSCRIBER_COUNT])
+{
+	struct test_event events[] = {
+		{ .event = { .type = APP_EVENT_LOCATION_GET } },
+		{ .event = { .type = APP_EVENT_CONFIG_UPDATE } },
+	};
+
+	for (size_t i = 0; i < ARRAY_SIZE(events); i++) {
+		events[i].event.header.type_id = &_event_type_app_module_event;
+	}
+
+	event_latency_reset();
+	dispatch(events, ARRAY_SIZE(events));
+
+	for (int s = 0; s < SUBSCRIBER_COUNT; s++) {
+		event_latency_get(subscribers[s].id, &stats[s]);
+	}
+}
+
+ZTEST(event_latency, test_location_module_thread)
+{
+	struct event_latency_stats listener[SUBSCRIBER_COUNT];
+	struct event_latency_stats thread[SUBSCRIBER_COUNT];
+
+	subscribers[LOCATION].thread = false;
+	burst(listener);
+	subscribers[LOCATION].thread = true;
+	burst(thread);
+
+	TC_PRINT("Location module in the listener / in its thread\n");
+	TC_PRINT("%-16s %5s %11s %11s\n", "Subscriber", "n", "mean us", "max us");
+	for (int s = 0; s < SUBSCRIBER_COUNT; s++) {
+		TC_PRINT("%-16s %5u %5u/%5u %5u/%5u\n", subscribers[s].name, thread[s].count,
+			 listener[s].mean_us, thread[s].mean_us,
+			 listener[s].max_us, thread[s].max_us);
+		zassert_equal(listener[s].count, thread[s].count);
+	}
+
+	/* The other subscribers of the config update no longer wait for the
+	 * location request.
+	 */
+	for (int s = 0; s < SUBSCRIBER_COUNT; s++) {
+		if (s == LOCATION) {
+			continue;
+		}
+		zassert_true(listener[s].max_us >= LOCATION_REQUEST_US, "%s",
+			     subscribers[s].name);
+		zassert_true(thread[s].max_us < 1000, "%s", subscribers[s].name);
+	}
+
+	/* The location module waits for its own request instead, in its queue. */
+	zassert_true(thread[LOCATION].max_us >= LOCATION_REQUEST_US);
+	zassert_within(thread[LOCATION].max_us, listener[LOCATION].max_us, 100);
+}
+
+ZTEST(event_latency, test_buckets)
+{
+	struct event_latency_stats stats;
+	struct test_event event = {
+		.event = {
+			.header = { .type_id = &_event_type_app_module_event },
+		},
+	};
+	/* Bucket i holds 4^i to 4^(i+1) microseconds. */
+	const uint32_t ages[] = { 0, 3, 4, 15, 16, 1000, 5000000 };
+	const size_t buckets[] = { 0, 0, 1, 1, 2, 4, EVENT_LATENCY_BUCKETS - 1 };
+
+	event_latency_reset();
+	now = 5000000;
+
+	for (size_t i = 0; i < ARRAY_SIZE(ages); i++) {
+		event.submitted_at = now - ages[i];
+		event_latency_record(EVENT_LATENCY_MAIN, &event.event.header);
+	}
+
+	event_latency_get(EVENT_LATENCY_MAIN, &stats);
+	zassert_equal(stats.count, ARRAY_SIZE(ages));
+	zassert_equal(stats.max_us, 5000000);
+	for (size_t i = 0; i < ARRAY_SIZE(buckets); i++) {
+		uint32_t expected = 0;
+
+		for (size_t j = 0; j < ARRAY_SIZE(buckets); j++) {
+			expected += buckets[j] == buckets[i];
+		}
+		zassert_equal(stats.buckets[buckets[i]], expected, "bucket %zu", buckets[i]);
+	}
+
+	/* Subscribers are kept apart. */
+	event_latency_get(EVENT_LATENCY_LED, &stats);
+	zassert_equal(stats.count, 0);
+	zassert_equal(stats.mean_us, 0);
+}
+
+ZTEST_SUITE(event_latency, NULL, NULL, NULL, NULL, NULL);
@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <ztest.h>
+#include <zephyr/kernel.h>
+
+#include "cloud/fix_queue.h"
+#include "host_storage.h"
+
+#define CAPACITY CONFIG_FIX_QUEUE_CAPACITY
+
+/* Fix number n of the track, told apart by its time. */
+static struct cloud_location_data fix(int n)
+{
+	struct cloud_location_data fix = {
+		.pvt.latitude = 65.0 + n * 1e-4,
+		.pvt.longitude = 25.4,
+		.pvt.accuracy = 5.0f,
+		.gnss_ts = 1700000000000LL + n * 1000LL,
+	};
+
+	return fix;
+}
+
+static void push(int first, int count)
+{
+	for (int n = first; n < first + count; n++) {
+		struct cloud_location_data data = fix(n);
+
+		zassert_ok(fix_queue_push(&data), "fix %d", n);
+	}
+}
+
+/* Peek the whole queue and check it holds the fixes first.. in order. */
+static void expect_fixes(int first, int count, uint32_t first_seq)
+{
+	struct cloud_location_data fixes[CAPACITY];
+	uint32_t seq;
+
+	zassert_equal(fix_queue_count(), count, "count %zu", fix_queue_count());
+	zassert_equal(fix_queue_peek(fixes, ARRAY_SIZE(fixes), &seq), count);
+	zassert_equal(seq, first_seq, "first seq %u", seq);
+
+	for (int i = 0; i < count; i++) {
+		zassert_equal(fixes[i].gnss_ts, fix(first + i).gnss_ts, "fix %d", i);
+	}
+}
+
+/* A simulated reboot restores the queue from the storage. */
+static void reboot(void)
+{
+	zassert_ok(fix_queue_init());
+}
+
+static void before(void *fixture)
+{
+	host_storage_erase();
+	zassert_ok(fix_queue_init());
+}
+
+ZTEST(fix_queue, test_empty)
+{
+	struct cloud_location_data fixes[1];
+	uint32_t seq;
+
+	zassert_equal(fix_queue_count(), 0);
+	zassert_equal(fix_queue_peek(fixes, ARRAY_SIZE(fixes), &seq), 0);
+}
+
+ZTEST(fix_queue, test_peek_does_not_remove)
+{
+	push(0, 3);
+	expect_fixes(0, 3, 0);
+	expect_fixes(0, 3, 0);
+}
+
+ZTEST(fix_queue, test_ring_wraps)
+{
+	/* The sequence numbers run several times around the slots. */
+	for (int round = 0; round < 4; round++) {
+		int first = round * (CAPACITY - 3);
+
+		push(first, CAPACITY - 3);
+		expect_fixes(first, CAPACITY - 3, first);
+		zassert_ok(fix_queue_trim(first + CAPACITY - 3));
+		zassert_equal(fix_queue_count(), 0);
+	}
+
+	/* A batch that straddles the end of the slots. */
+	push(100, CAPACITY);
+	expect_fixes(100, CAPACITY, 4 * (CAPACITY - 3));
+}
+
+ZTEST(fix_queue, test_partial_trim)
+{
+	struct fix_queue_stats before;
+	struct fix_queue_stats after;
+
+	fix_queue_stats_get(&before);
+
+	push(0, 6);
+	zassert_ok(fix_queue_trim(4));
+	expect_fixes(4, 2, 4);
+
+	/* A late acknowledgement of fixes already removed is ignored. */
+	zassert_ok(fix_queue_trim(2));
+	expect_fixes(4, 2, 4);
+
+	/* So is one beyond the head. */
+	zassert_ok(fix_queue_trim(100));
+	expect_fixes(4, 2, 4);
+
+	fix_queue_stats_get(&after);
+	zassert_equal(after.queued - before.queued, 6);
+	zassert_equal(after.sent - before.sent, 4);
+}
+
+ZTEST(fix_queue, test_restore_after_reboot)
+{
+	push(0, 5);
+	zassert_ok(fix_queue_trim(2));
+
+	reboot();
+	expect_fixes(2, 3, 2);
+
+	/* The queue continues from the restored head. */
+	push(5, 2);
+	reboot();
+	expect_fixes(2, 5, 2);
+}
+
+ZTEST(fix_queue, test_restore_before_first_trim)
+{
+	/* The tail has not been written yet. */
+	push(0, 3);
+
+	reboot();
+	expect_fixes(0, 3, 0);
+}
+
+ZTEST(fix_queue, test_restore_wrapped_after_reboot)
+{
+	push(0, CAPACITY * 2 + 3);
+
+	reboot();
+	expect_fixes(CAPACITY + 3, CAPACITY, CAPACITY + 3);
+}
+
+ZTEST(fix_queue, test_full_queue_drops_oldest)
+{
+	struct fix_queue_stats before;
+	struct fix_queue_stats after;
+
+	fix_queue_stats_get(&before);
+
+	push(0, CAPACITY + 2);
+	expect_fixes(2, CAPACITY, 2);
+
+	fix_queue_stats_get(&after);
+	zassert_equal(after.dropped - before.dropped, 2);
+	zassert_equal(after.queued - before.queued, CAPACITY + 2);
+
+	/* The drops are persistent too. */
+	reboot();
+	expect_fixes(2, CAPACITY, 2);
+}
+
+ZTEST(fix_queue, test_failed_write_keeps_queue)
+{
+	struct cloud_location_data data = fix(1);
+
+	push(0, 1);
+
+	/* A fix that could not be written is not queued. */
+	host_storage_fail_writes(1);
+	zassert_not_equal(fix_queue_push(&data), 0);
+	expect_fixes(0, 1, 0);
+
+	reboot();
+	expect_fixes(0, 1, 0);
+
+	/* The next fix takes the slot. */
+	push(1, 1);
+	expect_fixes(0, 2, 0);
+}
+
+ZTEST_SUITE(fix_queue, NULL, NULL, before, NULL, NULL);
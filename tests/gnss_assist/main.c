@@ -0,0 +1,365 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <ztest.h>
+#include <zephyr/kernel.h>
+#include <date_time.h>
+
+#include "location/gnss_assist.h"
+#include "host_storage.h"
+
+/* 2024-01-01 00:00:00 UTC, GPS day 16066 with the 18 leap seconds. */
+#define NEW_YEAR_MS 1704067200000LL
+
+#define MINUTE_MS (60 * MSEC_PER_SEC)
+
+/* Age at which a fix of the given accuracy is no longer given to GNSS. */
+#define CUT_OFF_S(accuracy)									\
+	((CONFIG_GNSS_ASSIST_MAX_UNCERTAINTY - (accuracy)) / CONFIG_GNSS_ASSIST_SPEED)
+
+static struct {
+	int count;
+	int err;
+	bool location_written;
+	bool time_written;
+	struct nrf_modem_gnss_agnss_data_location location;
+	struct nrf_modem_gnss_agnss_gps_data_system_time_and_sv_tow time;
+} writes;
+
+int32_t nrf_modem_gnss_agnss_write(void *buf, int32_t buf_len, uint16_t type)
+{
+	writes.count++;
+
+	if (writes.err) {
+		return writes.err;
+	}
+
+	if (type == NRF_MODEM_GNSS_AGNSS_LOCATION) {
+		zassert_equal(buf_len, sizeof(writes.location));
+		memcpy(&writes.location, buf, buf_len);
+		writes.location_written = true;
+	} else {
+		zassert_equal(type, NRF_MODEM_GNSS_AGNSS_GPS_SYSTEM_CLOCK_AND_TOWS);
+		zassert_equal(buf_len, sizeof(writes.time));
+		memcpy(&writes.time, buf, buf_len);
+		writes.time_written = true;
+	}
+
+	return 0;
+}
+
+static const struct gnss_assist_fix gnss_fix = {
+	.latitude = 61.4978,
+	.longitude = 23.7610,
+	.accuracy = 10.0f,
+	.altitude = 120.6f,
+	.altitude_accuracy = 10.0f,
+};
+
+static const struct gnss_assist_fix cell_fix = {
+	.latitude = 61.5000,
+	.longitude = 23.7700,
+	.accuracy = 800.0f,
+};
+
+/**@brief Radius of an uncertainty code, r = C((1 + x)^K - 1). */
+static float uncertainty_decode(uint8_t k, float c, float x)
+{
+	return c * (powf(1.0f + x, k) - 1.0f);
+}
+
+/**@brief Check that the code is the smallest one that covers the radius. */
+static void uncertainty_check(uint8_t k, float meters, float c, float x)
+{
+	zassert_true(uncertainty_decode(k, c, x) >= meters * 0.9999f, "K %u for %f m", k,
+		     meters);
+	zassert_true(k == 0 || uncertainty_decode(k - 1, c, x) < meters, "K %u for %f m", k,
+		     meters);
+}
+
+/**@brief A fix taken now. */
+static struct gnss_assist_fix fix_now(const struct gnss_assist_fix *fix)
+{
+	struct gnss_assist_fix now_fix = *fix;
+
+	zassert_ok(date_time_now(&now_fix.time));
+
+	return now_fix;
+}
+
+/**@brief Reboot with the time known the given time after the boot. */
+static void reboot(int64_t unix_time_ms)
+{
+	host_uptime_set(0);
+	host_date_time_clear();
+	zassert_ok(gnss_assist_init());
+	host_date_time_set(unix_time_ms);
+	memset(&writes, 0, sizeof(writes));
+}
+
+static void before(void *fixture)
+{
+	host_storage_erase();
+	reboot(NEW_YEAR_MS);
+}
+
+ZTEST(gnss_assist, test_time_encode)
+{
+	struct nrf_modem_gnss_agnss_gps_data_system_time_and_sv_tow time;
+
+	gnss_assist_time_encode(NEW_YEAR_MS, &time);
+	zassert_equal(time.date_day, 16066);
+	zassert_equal(time.time_full_s, 18);
+	zassert_equal(time.time_frac_ms, 0);
+	zassert_equal(time.sv_mask, 0, "no time of week of the satellites");
+
+	/* The last second of the GPS day before. */
+	gnss_assist_time_encode(NEW_YEAR_MS - 19 * MSEC_PER_SEC + 250, &time);
+	zassert_equal(time.date_day, 16065);
+	zassert_equal(time.time_full_s, 86399);
+	zassert_equal(time.time_frac_ms, 250);
+
+	/* The GPS epoch, 1980-01-06, less the leap seconds. */
+	gnss_assist_time_encode((315964800LL - 18) * MSEC_PER_SEC, &time);
+	zassert_equal(time.date_day, 0);
+	zassert_equal(time.time_full_s, 0);
+}
+
+ZTEST(gnss_assist, test_location_encode)
+{
+	static const float accuracies[] = { 1.0f, 10.0f, 49.0f, 800.0f, 20000.0f };
+	struct nrf_modem_gnss_agnss_data_location location;
+	struct gnss_assist_fix fix = gnss_fix;
+
+	fix.time = NEW_YEAR_MS;
+
+	zassert_true(gnss_assist_location_encode(&fix, NEW_YEAR_MS, &location));
+	zassert_within(location.latitude, lround(61.4978 * (1 << 23) / 90.0), 1);
+	zassert_within(location.longitude, lround(23.7610 * (1 << 24) / 360.0), 1);
+	zassert_equal(location.altitude, 121);
+	zassert_equal(location.unc_semimajor, location.unc_semiminor);
+	zassert_equal(location.confidence, 68);
+	uncertainty_check(location.unc_altitude, 10.0f, 45.0f, 0.025f);
+
+	for (size_t i = 0; i < ARRAY_SIZE(accuracies); i++) {
+		fix.accuracy = accuracies[i];
+		gnss_assist_location_encode(&fix, NEW_YEAR_MS, &location);
+		uncertainty_check(location.unc_semimajor, accuracies[i], 10.0f, 0.1f);
+	}
+
+	/* The uncertainty grows with the age. */
+	fix.accuracy = 10.0f;
+	gnss_assist_location_encode(&fix, NEW_YEAR_MS + 600 * MSEC_PER_SEC, &location);
+	uncertainty_check(location.unc_semimajor, 10.0f + 600 * CONFIG_GNSS_ASSIST_SPEED, 10.0f,
+			  0.1f);
+
+	/* A fix from the future does not shrink it. */
+	gnss_assist_location_encode(&fix, NEW_YEAR_MS - 600 * MSEC_PER_SEC, &location);
+	uncertainty_check(location.unc_semimajor, 10.0f, 10.0f, 0.1f);
+}
+
+ZTEST(gnss_assist, test_clamping)
+{
+	struct nrf_modem_gnss_agnss_data_location location;
+	struct gnss_assist_fix fix = {
+		.latitude = 90.0,
+		.longitude = 180.0,
+		.accuracy = 1e7f,
+		.altitude = 50000.0f,
+		.altitude_accuracy = 1e6f,
+		.time = NEW_YEAR_MS,
+	};
+
+	/* Beyond the largest code, and beyond the largest uncertainty given
+	 * to GNSS.
+	 */
+	zassert_false(gnss_assist_location_encode(&fix, NEW_YEAR_MS, &location));
+	zassert_equal(location.unc_semimajor, 127);
+	zassert_equal(location.unc_altitude, 127);
+	zassert_equal(location.latitude, (1 << 23) - 1);
+	zassert_equal(location.longitude, (1 << 23) - 1);
+	zassert_equal(location.altitude, INT16_MAX);
+
+	fix.latitude = -90.0;
+	fix.longitude = -180.0;
+	fix.altitude = -50000.0f;
+	fix.altitude_accuracy = 0.0f;
+	fix.accuracy = 0.0f;
+	zassert_true(gnss_assist_location_encode(&fix, NEW_YEAR_MS, &location));
+	zassert_equal(location.unc_semimajor, 0);
+	zassert_equal(location.latitude, -(1 << 23));
+	zassert_equal(location.longitude, -(1 << 23));
+
+	/* Without an altitude only the horizontal position is given. */
+	zassert_equal(location.altitude, 0);
+	zassert_equal(location.unc_altitude, 255);
+}
+
+ZTEST(gnss_assist, test_age_cut_off)
+{
+	struct nrf_modem_gnss_agnss_data_location location;
+	struct gnss_assist_fix fix = gnss_fix;
+
+	fix.time = NEW_YEAR_MS;
+
+	zassert_true(gnss_assist_location_encode(
+		&fix, NEW_YEAR_MS + CUT_OFF_S(10) * MSEC_PER_SEC, &location));
+	zassert_false(gnss_assist_location_encode(
+		&fix, NEW_YEAR_MS + (CUT_OFF_S(10) + 1) * MSEC_PER_SEC, &location));
+
+	/* A restored position older than that is not given, the time is. */
+	gnss_assist_fix_update(&fix, true);
+	reboot(NEW_YEAR_MS + (CUT_OFF_S(10) + 1) * MSEC_PER_SEC);
+
+	zassert_equal(gnss_assist_inject(), GNSS_ASSIST_TIME);
+	zassert_false(writes.location_written);
+}
+
+ZTEST(gnss_assist, test_no_time)
+{
+	struct gnss_assist_fix fix = fix_now(&gnss_fix);
+
+	gnss_assist_fix_update(&fix, false);
+
+	host_date_time_clear();
+	zassert_equal(gnss_assist_inject(), -EAGAIN);
+	zassert_equal(writes.count, 0);
+
+	/* Without a position only the time is given. */
+	host_storage_erase();
+	reboot(NEW_YEAR_MS);
+	zassert_equal(gnss_assist_inject(), GNSS_ASSIST_TIME);
+	zassert_equal(writes.count, 1);
+	zassert_equal(writes.time.date_day, 16066);
+	zassert_equal(writes.time.time_full_s, 18);
+}
+
+ZTEST(gnss_assist, test_after_boot)
+{
+	struct gnss_assist_fix fix = fix_now(&gnss_fix);
+	struct nrf_modem_gnss_agnss_data_location expected;
+
+	/* The fix of the last boot is restored from the flash and given with
+	 * the time, ten minutes later.
+	 */
+	gnss_assist_fix_update(&fix, true);
+	reboot(NEW_YEAR_MS + 10 * MINUTE_MS);
+
+	zassert_equal(gnss_assist_inject(), GNSS_ASSIST_POSITION | GNSS_ASSIST_TIME);
+	zassert_true(gnss_assist_location_encode(&fix, NEW_YEAR_MS + 10 * MINUTE_MS, &expected));
+	zassert_mem_equal(&writes.location, &expected, sizeof(expected));
+	uncertainty_check(writes.location.unc_semimajor, 10.0f + 600 * CONFIG_GNSS_ASSIST_SPEED,
+			  10.0f, 0.1f);
+	zassert_equal(writes.time.date_day, 16066);
+	zassert_equal(writes.time.time_full_s, 10 * 60 + 18);
+}
+
+ZTEST(gnss_assist, test_after_cell_fix)
+{
+	struct gnss_assist_fix old = fix_now(&gnss_fix);
+	struct gnss_assist_fix cell;
+
+	/* A cell fix after the boot is more accurate than the position of
+	 * yesterday, and replaces it.
+	 */
+	gnss_assist_fix_update(&old, true);
+	reboot(NEW_YEAR_MS + 24 * 60 * MINUTE_MS);
+
+	host_uptime_advance(5 * MSEC_PER_SEC);
+	cell = fix_now(&cell_fix);
+	gnss_assist_fix_update(&cell, false);
+
+	zassert_equal(gnss_assist_inject(), GNSS_ASSIST_POSITION | GNSS_ASSIST_TIME);
+	zassert_within(writes.location.latitude, lround(61.5 * (1 << 23) / 90.0), 1);
+	uncertainty_check(writes.location.unc_semimajor, 800.0f, 10.0f, 0.1f);
+	zassert_equal(writes.location.unc_altitude, 255);
+}
+
+ZTEST(gnss_assist, test_after_gnss_fix)
+{
+	struct gnss_assist_fix fix;
+	struct gnss_assist_fix cell;
+
+	host_uptime_advance(30 * MSEC_PER_SEC);
+	fix = fix_now(&gnss_fix);
+	gnss_assist_fix_update(&fix, true);
+
+	/* GNSS keeps its own position and time after a fix. */
+	zassert_equal(gnss_assist_inject(), 0);
+	zassert_equal(writes.count, 0);
+
+	/* A cell fix right after it is less accurate, and not kept. */
+	host_uptime_advance(10 * MSEC_PER_SEC);
+	cell = fix_now(&cell_fix);
+	gnss_assist_fix_update(&cell, false);
+	zassert_equal(gnss_assist_inject(), 0);
+
+	/* An hour later the cell fix is the better position, and newer than
+	 * what GNSS knows.
+	 */
+	host_uptime_advance(60 * MINUTE_MS);
+	cell = fix_now(&cell_fix);
+	gnss_assist_fix_update(&cell, false);
+	zassert_equal(gnss_assist_inject(), GNSS_ASSIST_POSITION);
+	zassert_false(writes.time_written);
+	uncertainty_check(writes.location.unc_semimajor, 800.0f, 10.0f, 0.1f);
+
+	/* Until the next GNSS fix. */
+	host_uptime_advance(MINUTE_MS);
+	fix = fix_now(&gnss_fix);
+	gnss_assist_fix_update(&fix, true);
+	writes.count = 0;
+	zassert_equal(gnss_assist_inject(), 0);
+	zassert_equal(writes.count, 0);
+}
+
+ZTEST(gnss_assist, test_write_failure)
+{
+	struct gnss_assist_fix fix = fix_now(&gnss_fix);
+
+	gnss_assist_fix_update(&fix, false);
+
+	/* What GNSS did not take is not reported as given. */
+	writes.err = -EINVAL;
+	zassert_equal(gnss_assist_inject(), 0);
+	zassert_equal(writes.count, 2);
+}
+
+ZTEST(gnss_assist, test_save)
+{
+	struct gnss_assist_fix fix = fix_now(&gnss_fix);
+	struct host_storage_stats stats;
+
+	/* The first position is saved, a slightly better one only after the
+	 * save interval, a much better one at once.
+	 */
+	fix.accuracy = 100.0f;
+	gnss_assist_fix_update(&fix, true);
+
+	host_uptime_advance(MINUTE_MS);
+	fix = fix_now(&gnss_fix);
+	fix.accuracy = 80.0f;
+	gnss_assist_fix_update(&fix, true);
+	host_storage_stats_get(&stats);
+	zassert_equal(stats.writes, 1);
+
+	fix.accuracy = 30.0f;
+	gnss_assist_fix_update(&fix, true);
+	host_storage_stats_get(&stats);
+	zassert_equal(stats.writes, 2);
+
+	host_uptime_advance(CONFIG_GNSS_ASSIST_SAVE_INTERVAL * MSEC_PER_SEC);
+	fix = fix_now(&gnss_fix);
+	fix.accuracy = 30.0f;
+	gnss_assist_fix_update(&fix, true);
+	host_storage_stats_get(&stats);
+	zassert_equal(stats.writes, 3);
+}
+
+ZTEST_SUITE(gnss_assist, NULL, NULL, before, NULL, NULL);
@@ -0,0 +1,312 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/net/coap.h>
+
+static uint16_t message_id;
+
+int coap_packet_parse(struct coap_packet *cpkt, uint8_t *data, uint16_t len,
+		      void *options, uint8_t opt_num)
+{
+	if (len < 4 || (data[0] >> 6) != 1 || (data[0] & 0x0f) > COAP_TOKEN_MAX_LEN ||
+	    len < 4 + (data[0] & 0x0f)) {
+		return -EINVAL;
+	}
+
+	cpkt->data = data;
+	cpkt->offset = len;
+	cpkt->max_len = len;
+	cpkt->delta = 0;
+
+	return 0;
+}
+
+uint8_t coap_header_get_type(const struct coap_packet *cpkt)
+{
+	return (cpkt->data[0] >> 4) & 0x03;
+}
+
+uint8_t coap_header_get_code(const struct coap_packet *cpkt)
+{
+	return cpkt->data[1];
+}
+
+uint16_t coap_header_get_id(const struct coap_packet *cpkt)
+{
+	return (cpkt->data[2] << 8) | cpkt->data[3];
+}
+
+uint8_t coap_header_get_token(const struct coap_packet *cpkt, uint8_t *token)
+{
+	uint8_t len = cpkt->data[0] & 0x0f;
+
+	memcpy(token, &cpkt->data[4], len);
+
+	return len;
+}
+
+uint16_t coap_next_id(void)
+{
+	return ++message_id;
+}
+
+size_t host_coap_build(uint8_t *buf, uint8_t type, uint8_t code, uint16_t id,
+		       const void *token, uint8_t token_len)
+{
+	buf[0] = (1 << 6) | (type << 4) | token_len;
+	buf[1] = code;
+	buf[2] = id >> 8;
+	buf[3] = id;
+	memcpy(&buf[4], token, token_len);
+
+	return 4 + token_len;
+}
+
+int coap_packet_init(struct coap_packet *cpkt, uint8_t *data, uint16_t max_len,
+		     uint8_t ver, uint8_t type, uint8_t token_len,
+		     const uint8_t *token, uint8_t code, uint16_t id)
+{
+	if (token_len > COAP_TOKEN_MAX_LEN || max_len < 4 + token_len) {
+		return -EINVAL;
+	}
+
+	cpkt->data = data;
+	cpkt->max_len = max_len;
+	cpkt->delta = 0;
+	/* Only version 1 exists. */
+	cpkt->offset = host_coap_build(data, type, code, id, token, token_len);
+
+	return 0;
+}
+
+/* Option delta or length nibble, and the extended bytes it needs. */
+static uint8_t option_nibble(uint16_t value, uint8_t *ext, size_t *ext_len)
+{
+	if (value < 13) {
+		*ext_len = 0;
+		return value;
+	} else if (value < 269) {
+		ext[0] = value - 13;
+		*ext_len = 1;
+		return 13;
+	}
+
+	ext[0] = (value - 269) >> 8;
+	ext[1] = value - 269;
+	*ext_len = 2;
+
+	return 14;
+}
+
+int coap_packet_append_option(struct coap_packet *cpkt, uint16_t code,
+			      const uint8_t *value, uint16_t len)
+{
+	uint8_t delta_ext[2];
+	uint8_t len_ext[2];
+	size_t delta_ext_len;
+	size_t len_ext_len;
+	uint8_t delta_nibble;
+	uint8_t len_nibble;
+
+	/* Options are encoded in ascending order. */
+	if (code < cpkt->delta) {
+		return -EINVAL;
+	}
+
+	delta_nibble = option_nibble(code - cpkt->delta, delta_ext, &delta_ext_len);
+	len_nibble = option_nibble(len, len_ext, &len_ext_len);
+
+	if (cpkt->offset + 1 + delta_ext_len + len_ext_len + len > cpkt->max_len) {
+		return -ENOMEM;
+	}
+
+	cpkt->data[cpkt->offset++] = (delta_nibble << 4) | len_nibble;
+	memcpy(&cpkt->data[cpkt->offset], delta_ext, delta_ext_len);
+	cpkt->offset += delta_ext_len;
+	memcpy(&cpkt->data[cpkt->offset], len_ext, len_ext_len);
+	cpkt->offset += len_ext_len;
+	memcpy(&cpkt->data[cpkt->offset], value, len);
+	cpkt->offset += len;
+	cpkt->delta = code;
+
+	return 0;
+}
+
+int coap_append_option_int(struct coap_packet *cpkt, uint16_t code, unsigned int val)
+{
+	uint8_t value[4];
+	uint16_t len = 0;
+
+	/* Shortest big-endian encoding, no bytes for 0. */
+	for (int shift = 24; shift >= 0; shift -= 8) {
+		if (len > 0 || (val >> shift) & 0xff) {
+			value[len++] = val >> shift;
+		}
+	}
+
+	return coap_packet_append_option(cpkt, code, value, len);
+}
+
+int coap_packet_append_payload_marker(struct coap_packet *cpkt)
+{
+	if (cpkt->offset >= cpkt->max_len) {
+		return -ENOMEM;
+	}
+
+	cpkt->data[cpkt->offset++] = 0xff;
+
+	return 0;
+}
+
+int coap_packet_append_payload(struct coap_packet *cpkt, const uint8_t *payload,
+			       uint16_t payload_len)
+{
+	if (cpkt->offset + payload_len > cpkt->max_len) {
+		return -ENOMEM;
+	}
+
+	memcpy(&cpkt->data[cpkt->offset], payload, payload_len);
+	cpkt->offset += payload_len;
+
+	return 0;
+}
+
+/* Value of an extended option delta or length, or -1 if it is malformed. */
+static int option_field(const struct coap_packet *cpkt, size_t *pos, uint8_t nibble)
+{
+	int value;
+
+	if (nibble < 13) {
+		return nibble;
+	} else if (nibble == 13 && *pos + 1 <= cpkt->offset) {
+		value = cpkt->data[*pos] + 13;
+		*pos += 1;
+		return value;
+	} else if (nibble == 14 && *pos + 2 <= cpkt->offset) {
+		value = ((cpkt->data[*pos] << 8) | cpkt->data[*pos + 1]) + 269;
+		*pos += 2;
+		return value;
+	}
+
+	return -1;
+}
+
+/**@brief Walk the options. Calls the visitor with each option, and gives
+ *	  the offset of the payload, or the end of the message.
+ */
+static int options_walk(const struct coap_packet *cpkt, size_t *payload_pos,
+			bool (*visit)(uint16_t code, const uint8_t *value, uint16_t len,
+				      void *user_data),
+			void *user_data)
+{
+	size_t pos = 4 + (cpkt->data[0] & 0x0f);
+	uint16_t code = 0;
+
+	while (pos < cpkt->offset && cpkt->data[pos] != 0xff) {
+		uint8_t byte = cpkt->data[pos++];
+		int delta = option_field(cpkt, &pos, byte >> 4);
+		int len = option_field(cpkt, &pos, byte & 0x0f);
+
+		if (delta < 0 || len < 0 || pos + len > cpkt->offset) {
+			return -EINVAL;
+		}
+
+		code += delta;
+		if (visit != NULL && !visit(code, &cpkt->data[pos], len, user_data)) {
+			break;
+		}
+
+		pos += len;
+	}
+
+	if (payload_pos != NULL) {
+		*payload_pos = pos < cpkt->offset ? pos + 1 : cpkt->offset;
+	}
+
+	return 0;
+}
+
+struct option_search {
+	uint16_t code;
+	struct coap_option *options;
+	uint16_t veclen;
+	uint16_t count;
+};
+
+static bool option_collect(uint16_t code, const uint8_t *value, uint16_t len, void *user_data)
+{
+	struct option_search *search = user_data;
+	struct coap_option *option;
+
+	if (code != search->code) {
+		return true;
+	}
+
+	option = &search->options[search->count++];
+	option->delta = code;
+	option->len = len;
+	memcpy(option->value, value, MIN(len, sizeof(option->value)));
+
+	return search->count < search->veclen;
+}
+
+int coap_find_options(const struct coap_packet *cpkt, uint16_t code,
+		      struct coap_option *options, uint16_t veclen)
+{
+	struct option_search search = {
+		.code = code,
+		.options = options,
+		.veclen = veclen,
+	};
+	int err;
+
+	if (veclen == 0) {
+		return 0;
+	}
+
+	err = options_walk(cpkt, NULL, option_collect, &search);
+
+	return err ? err : search.count;
+}
+
+unsigned int coap_option_value_to_int(const struct coap_option *option)
+{
+	unsigned int value = 0;
+
+	for (uint16_t i = 0; i < MIN(option->len, 4); i++) {
+		value = (value << 8) | option->value[i];
+	}
+
+	return value;
+}
+
+int coap_get_option_int(const struct coap_packet *cpkt, uint16_t code)
+{
+	struct coap_option option;
+
+	if (coap_find_options(cpkt, code, &option, 1) != 1) {
+		return -ENOENT;
+	}
+
+	return coap_option_value_to_int(&option);
+}
+
+const uint8_t *coap_packet_get_payload(const struct coap_packet *cpkt, uint16_t *len)
+{
+	size_t pos;
+
+	if (options_walk(cpkt, &pos, NULL, NULL) || pos >= cpkt->offset) {
+		*len = 0;
+		return NULL;
+	}
+
+	*len = cpkt->offset - pos;
+
+	return &cpkt->data[pos];
+}
@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <zephyr/kernel.h>
+#include <date_time.h>
+
+static bool time_known;
+static int64_t time_at_uptime;
+static int64_t uptime_at_set;
+
+int date_time_now(int64_t *unix_time_ms)
+{
+	if (!time_known) {
+		return -ENODATA;
+	}
+
+	*unix_time_ms = time_at_uptime + k_uptime_get() - uptime_at_set;
+
+	return 0;
+}
+
+void host_date_time_set(int64_t unix_time_ms)
+{
+	time_known = true;
+	time_at_uptime = unix_time_ms;
+	uptime_at_set = k_uptime_get();
+}
+
+void host_date_time_clear(void)
+{
+	time_known = false;
+}
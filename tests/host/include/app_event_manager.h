@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/* Host stand-in for the event types of the Application Event Manager. There
+ * is no dispatch, the tests call the handlers themselves.
+ */
+
+#ifndef _APP_EVENT_MANAGER_H_
+#define _APP_EVENT_MANAGER_H_
+
+#include <stdbool.h>
+
+struct event_type {
+	const char *name;
+};
+
+struct app_event_header {
+	const struct event_type *type_id;
+};
+
+#define APP_EVENT_TYPE_DECLARE(ename)							\
+	extern const struct event_type _event_type_##ename;				\
+	static inline bool is_##ename(const struct app_event_header *aeh)		\
+	{										\
+		return aeh->type_id == &_event_type_##ename;				\
+	}										\
+	static inline struct ename *cast_##ename(const struct app_event_header *aeh)	\
+	{										\
+		return (struct ename *)aeh;						\
+	}
+
+#define APP_EVENT_TYPE_DEFINE(ename, ...)						\
+	const struct event_type _event_type_##ename = { .name = #ename }
+
+#endif /* _APP_EVENT_MANAGER_H_ */
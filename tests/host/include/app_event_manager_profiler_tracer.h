@@ -0,0 +1,12 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/* Host stand-in, the events are not traced on the host. */
+
+#ifndef _APP_EVENT_MANAGER_PROFILER_TRACER_H_
+#define _APP_EVENT_MANAGER_PROFILER_TRACER_H_
+
+#endif /* _APP_EVENT_MANAGER_PROFILER_TRACER_H_ */
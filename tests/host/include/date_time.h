@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/* Host stand-in for the Date-Time library. The time runs with the uptime
+ * once it is set.
+ */
+
+#ifndef DATE_TIME_H_
+#define DATE_TIME_H_
+
+#include <stdint.h>
+
+/** @brief Current UNIX time in milliseconds.
+ *
+ * @return 0, or -ENODATA if the time is not known.
+ */
+int date_time_now(int64_t *unix_time_ms);
+
+/** @brief Set the UNIX time in milliseconds at the current uptime. */
+void host_date_time_set(int64_t unix_time_ms);
+
+/** @brief Forget the time, as after a boot. */
+void host_date_time_clear(void);
+
+#endif /* DATE_TIME_H_ */
@@ -0,0 +1,29 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef HOST_STORAGE_H_
+#define HOST_STORAGE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** @brief Write counters of the RAM storage. */
+struct host_storage_stats {
+	uint32_t reads;
+	uint32_t writes;
+	size_t bytes_written;
+};
+
+/** @brief Delete all records and clear the counters. */
+void host_storage_erase(void);
+
+/** @brief Fail the next writes with -EIO. */
+void host_storage_fail_writes(int count);
+
+/** @brief Get the counters. */
+void host_storage_stats_get(struct host_storage_stats *stats);
+
+#endif /* HOST_STORAGE_H_ */
@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef HOST_TRACK_H_
+#define HOST_TRACK_H_
+
+#include <stddef.h>
+
+#include "codec.h"
+
+/** Number of fixes of the reference track. */
+#define HOST_TRACK_LEN 240
+
+/** Interval of the fixes of the reference track, in seconds. */
+#define HOST_TRACK_INTERVAL 30
+
+/** @brief Reference track of a tracker in Oulu, one fix every
+ *	   HOST_TRACK_INTERVAL seconds: standing still, walking, driving
+ *	   along a curved road, parked, and driving back on a straight road.
+ *	   The positions have GNSS noise of a few meters. The track is
+ *	   generated with a fixed seed, so it is the same on every run.
+ *
+ * @return HOST_TRACK_LEN fixes, with UNIX millisecond times.
+ */
+const struct cloud_location_data *host_track_get(void);
+
+/** @brief Distance between two points in meters, on a local flat earth. */
+double host_track_distance(double lat1, double lon1, double lat2, double lon2);
+
+#endif /* HOST_TRACK_H_ */
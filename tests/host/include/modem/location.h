@@ -0,0 +1,24 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef LOCATION_H_
+#define LOCATION_H_
+
+#include <stddef.h>
+
+/** @brief Location methods, with the values of the Location library. */
+enum location_method {
+	LOCATION_METHOD_CELLULAR = 1,
+	LOCATION_METHOD_GNSS,
+	LOCATION_METHOD_WIFI,
+};
+
+/** @brief Give A-GNSS data in the nRF Cloud binary format to GNSS. Provided
+ *	   by the test.
+ */
+int location_agnss_data_process(const char *buf, const size_t buf_len);
+
+#endif /* LOCATION_H_ */
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/* Host stand-in for the A-GNSS parts of <nrf_modem_gnss.h> used by the
+ * application, with the layouts of the modem library.
+ */
+
+#ifndef NRF_MODEM_GNSS_H_
+#define NRF_MODEM_GNSS_H_
+
+#include <stdint.h>
+
+#define NRF_MODEM_GNSS_SYSTEM_GPS 1
+#define NRF_MODEM_GNSS_SYSTEM_QZSS 4
+
+/* Assistance data flags of a request. */
+#define NRF_MODEM_GNSS_AGNSS_GPS_UTC_REQUEST 0x01
+#define NRF_MODEM_GNSS_AGNSS_KLOBUCHAR_REQUEST 0x02
+#define NRF_MODEM_GNSS_AGNSS_NEQUICK_REQUEST 0x04
+#define NRF_MODEM_GNSS_AGNSS_GPS_SYS_TIME_AND_SV_TOW_REQUEST 0x08
+#define NRF_MODEM_GNSS_AGNSS_POSITION_REQUEST 0x10
+#define NRF_MODEM_GNSS_AGNSS_INTEGRITY_REQUEST 0x20
+
+/* Types of the assistance data written to GNSS. */
+#define NRF_MODEM_GNSS_AGNSS_GPS_UTC_PARAMETERS 1
+#define NRF_MODEM_GNSS_AGNSS_GPS_EPHEMERIDES 2
+#define NRF_MODEM_GNSS_AGNSS_GPS_ALMANAC 3
+#define NRF_MODEM_GNSS_AGNSS_KLOBUCHAR_IONOSPHERIC_CORRECTION 4
+#define NRF_MODEM_GNSS_AGNSS_NEQUICK_IONOSPHERIC_CORRECTION 5
+#define NRF_MODEM_GNSS_AGNSS_GPS_SYSTEM_CLOCK_AND_TOWS 6
+#define NRF_MODEM_GNSS_AGNSS_LOCATION 7
+#define NRF_MODEM_GNSS_AGNSS_INTEGRITY 8
+
+#define NRF_MODEM_GNSS_AGNSS_MAX_SYSTEMS 2
+#define NRF_MODEM_GNSS_NUM_GPS_SATELLITES 32
+
+struct nrf_modem_gnss_agnss_system_data_need {
+	uint8_t system_id;
+	uint64_t sv_mask_ephe;
+	uint64_t sv_mask_alm;
+};
+
+struct nrf_modem_gnss_agnss_data_frame {
+	uint32_t data_flags;
+	uint8_t system_count;
+	struct nrf_modem_gnss_agnss_system_data_need system[NRF_MODEM_GNSS_AGNSS_MAX_SYSTEMS];
+};
+
+struct nrf_modem_gnss_agnss_data_location {
+	int32_t latitude;
+	int32_t longitude;
+	int16_t altitude;
+	uint8_t unc_semimajor;
+	uint8_t unc_semiminor;
+	uint8_t orientation_major;
+	uint8_t unc_altitude;
+	uint8_t confidence;
+};
+
+struct nrf_modem_gnss_agnss_gps_data_tow_element {
+	uint16_t tlm;
+	uint8_t flags;
+};
+
+struct nrf_modem_gnss_agnss_gps_data_system_time_and_sv_tow {
+	uint16_t date_day;
+	uint32_t time_full_s;
+	uint16_t time_frac_ms;
+	uint32_t sv_mask;
+	struct nrf_modem_gnss_agnss_gps_data_tow_element sv_tow[NRF_MODEM_GNSS_NUM_GPS_SATELLITES];
+};
+
+/** @brief Write assistance data to GNSS. Provided by the test. */
+int32_t nrf_modem_gnss_agnss_write(void *buf, int32_t buf_len, uint16_t type);
+
+#endif /* NRF_MODEM_GNSS_H_ */
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/* Host stand-in for the parts of the PSA Crypto API used by the application,
+ * on top of OpenSSL's libcrypto: AES-CCM with a shortened tag and HKDF
+ * SHA-256.
+ */
+
+#ifndef PSA_CRYPTO_H
+#define PSA_CRYPTO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef int32_t psa_status_t;
+typedef uint32_t psa_key_id_t;
+typedef uint32_t psa_algorithm_t;
+typedef uint16_t psa_key_type_t;
+typedef uint32_t psa_key_usage_t;
+
+#define PSA_SUCCESS ((psa_status_t)0)
+#define PSA_ERROR_GENERIC_ERROR ((psa_status_t)-132)
+#define PSA_ERROR_NOT_SUPPORTED ((psa_status_t)-134)
+#define PSA_ERROR_INVALID_ARGUMENT ((psa_status_t)-135)
+#define PSA_ERROR_INSUFFICIENT_MEMORY ((psa_status_t)-141)
+#define PSA_ERROR_BUFFER_TOO_SMALL ((psa_status_t)-138)
+#define PSA_ERROR_INVALID_SIGNATURE ((psa_status_t)-149)
+
+#define PSA_KEY_TYPE_AES ((psa_key_type_t)0x2400)
+#define PSA_KEY_USAGE_ENCRYPT ((psa_key_usage_t)0x00000100)
+#define PSA_KEY_USAGE_DECRYPT ((psa_key_usage_t)0x00000200)
+
+#define PSA_ALG_SHA_256 ((psa_algorithm_t)0x02000009)
+#define PSA_ALG_HKDF(hash_alg) ((psa_algorithm_t)(0x08000100 | ((hash_alg) & 0xff)))
+#define PSA_ALG_CCM ((psa_algorithm_t)0x05500100)
+#define PSA_ALG_AEAD_WITH_SHORTENED_TAG(aead_alg, tag_length) \
+	((psa_algorithm_t)(((aead_alg) & ~0x003f0000) | (((tag_length) & 0x3f) << 16)))
+
+typedef enum {
+	PSA_KEY_DERIVATION_INPUT_SECRET = 0x0101,
+	PSA_KEY_DERIVATION_INPUT_SALT = 0x0202,
+	PSA_KEY_DERIVATION_INPUT_INFO = 0x0203,
+} psa_key_derivation_step_t;
+
+typedef struct {
+	psa_key_type_t type;
+	size_t bits;
+	psa_key_usage_t usage;
+	psa_algorithm_t alg;
+} psa_key_attributes_t;
+
+#define PSA_KEY_ATTRIBUTES_INIT {0}
+
+typedef struct {
+	psa_algorithm_t alg;
+	uint8_t secret[64];
+	size_t secret_len;
+	uint8_t salt[64];
+	size_t salt_len;
+	uint8_t info[64];
+	size_t info_len;
+} psa_key_derivation_operation_t;
+
+#define PSA_KEY_DERIVATION_OPERATION_INIT {0}
+
+static inline void psa_set_key_usage_flags(psa_key_attributes_t *attributes,
+					   psa_key_usage_t usage)
+{
+	attributes->usage = usage;
+}
+
+static inline void psa_set_key_algorithm(psa_key_attributes_t *attributes, psa_algorithm_t alg)
+{
+	attributes->alg = alg;
+}
+
+static inline void psa_set_key_type(psa_key_attributes_t *attributes, psa_key_type_t type)
+{
+	attributes->type = type;
+}
+
+static inline void psa_set_key_bits(psa_key_attributes_t *attributes, size_t bits)
+{
+	attributes->bits = bits;
+}
+
+psa_status_t psa_crypto_init(void);
+
+psa_status_t psa_import_key(const psa_key_attributes_t *attributes, const uint8_t *data,
+			    size_t data_length, psa_key_id_t *key);
+
+psa_status_t psa_destroy_key(psa_key_id_t key);
+
+psa_status_t psa_aead_encrypt(psa_key_id_t key, psa_algorithm_t alg, const uint8_t *nonce,
+			      size_t nonce_length, const uint8_t *additional_data,
+			      size_t additional_data_length, const uint8_t *plaintext,
+			      size_t plaintext_length, uint8_t *ciphertext, size_t ciphertext_size,
+			      size_t *ciphertext_length);
+
+psa_status_t psa_aead_decrypt(psa_key_id_t key, psa_algorithm_t alg, const uint8_t *nonce,
+			      size_t nonce_length, const uint8_t *additional_data,
+			      size_t additional_data_length, const uint8_t *ciphertext,
+			      size_t ciphertext_length, uint8_t *plaintext, size_t plaintext_size,
+			      size_t *plaintext_length);
+
+psa_status_t psa_key_derivation_setup(psa_key_derivation_operation_t *operation,
+				      psa_algorithm_t alg);
+
+psa_status_t psa_key_derivation_input_bytes(psa_key_derivation_operation_t *operation,
+					    psa_key_derivation_step_t step, const uint8_t *data,
+					    size_t data_length);
+
+psa_status_t psa_key_derivation_output_bytes(psa_key_derivation_operation_t *operation,
+					     uint8_t *output, size_t output_length);
+
+psa_status_t psa_key_derivation_abort(psa_key_derivation_operation_t *operation);
+
+#endif /* PSA_CRYPTO_H */
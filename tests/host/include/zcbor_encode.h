@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/* Host stand-in for the zcbor encoder functions used by the application. It
+ * encodes like zcbor without ZCBOR_CANONICAL: integers in their shortest
+ * form, and arrays and maps with indefinite length.
+ */
+
+#ifndef ZCBOR_ENCODE_H__
+#define ZCBOR_ENCODE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+	uint8_t *payload;
+	const uint8_t *payload_end;
+} zcbor_state_t;
+
+#define ZCBOR_STATE_E(name, num_backups, payload_buf, payload_size, elem_count)	\
+	zcbor_state_t name[1] = { {							\
+		.payload = (payload_buf),						\
+		.payload_end = (payload_buf) + (payload_size),				\
+	} }
+
+static inline bool zcbor_host_put_byte(zcbor_state_t *state, uint8_t byte)
+{
+	if (state->payload >= state->payload_end) {
+		return false;
+	}
+
+	*state->payload++ = byte;
+	return true;
+}
+
+static inline bool zcbor_host_put_head(zcbor_state_t *state, uint8_t major, uint64_t arg)
+{
+	int bytes;
+
+	if (arg < 24) {
+		return zcbor_host_put_byte(state, (major << 5) | arg);
+	}
+
+	bytes = arg <= UINT8_MAX ? 1 : arg <= UINT16_MAX ? 2 : arg <= UINT32_MAX ? 4 : 8;
+	if (!zcbor_host_put_byte(state, (major << 5) | (24 + __builtin_ctz(bytes)))) {
+		return false;
+	}
+
+	for (int i = bytes - 1; i >= 0; i--) {
+		if (!zcbor_host_put_byte(state, arg >> (8 * i))) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static inline bool zcbor_uint64_put(zcbor_state_t *state, uint64_t value)
+{
+	return zcbor_host_put_head(state, 0, value);
+}
+
+static inline bool zcbor_uint32_put(zcbor_state_t *state, uint32_t value)
+{
+	return zcbor_host_put_head(state, 0, value);
+}
+
+static inline bool zcbor_int32_put(zcbor_state_t *state, int32_t value)
+{
+	if (value < 0) {
+		return zcbor_host_put_head(state, 1, (uint64_t)(-1 - (int64_t)value));
+	}
+
+	return zcbor_host_put_head(state, 0, value);
+}
+
+static inline bool zcbor_list_start_encode(zcbor_state_t *state, size_t max_num)
+{
+	return zcbor_host_put_byte(state, 0x9f);
+}
+
+static inline bool zcbor_map_start_encode(zcbor_state_t *state, size_t max_num)
+{
+	return zcbor_host_put_byte(state, 0xbf);
+}
+
+static inline bool zcbor_list_end_encode(zcbor_state_t *state, size_t max_num)
+{
+	return zcbor_host_put_byte(state, 0xff);
+}
+
+static inline bool zcbor_map_end_encode(zcbor_state_t *state, size_t max_num)
+{
+	return zcbor_host_put_byte(state, 0xff);
+}
+
+#endif /* ZCBOR_ENCODE_H__ */
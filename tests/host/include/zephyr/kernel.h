@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/* Host stand-in for the parts of <zephyr/kernel.h> used by the application.
+ * The tests are single threaded, so the locks do nothing. The uptime is
+ * controlled by the test with host_uptime_set().
+ */
+
+#ifndef ZEPHYR_INCLUDE_KERNEL_H_
+#define ZEPHYR_INCLUDE_KERNEL_H_
+
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include <zephyr/types.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/sys/byteorder.h>
+
+#define MSEC_PER_SEC 1000
+#define USEC_PER_MSEC 1000
+
+#define BUILD_ASSERT(cond, ...) _Static_assert(cond, "" __VA_ARGS__)
+#define __ASSERT(cond, ...) assert(cond)
+#define __ASSERT_NO_MSG(cond) assert(cond)
+
+/* Cycles of the host stand-in are microseconds. */
+#define HOST_CYC_PER_SEC 1000000
+
+typedef struct {
+	int64_t ticks;
+} k_timeout_t;
+
+#define K_FOREVER ((k_timeout_t){ .ticks = -1 })
+#define K_NO_WAIT ((k_timeout_t){ .ticks = 0 })
+#define K_MSEC(ms) ((k_timeout_t){ .ticks = (ms) })
+#define K_SECONDS(s) K_MSEC((s) * MSEC_PER_SEC)
+
+struct k_mutex {
+	int locked;
+};
+
+#define K_MUTEX_DEFINE(name) struct k_mutex name
+
+static inline int k_mutex_lock(struct k_mutex *mutex, k_timeout_t timeout)
+{
+	mutex->locked++;
+	return 0;
+}
+
+static inline int k_mutex_unlock(struct k_mutex *mutex)
+{
+	mutex->locked--;
+	return 0;
+}
+
+struct k_spinlock {
+	int locked;
+};
+
+typedef int k_spinlock_key_t;
+
+static inline k_spinlock_key_t k_spin_lock(struct k_spinlock *lock)
+{
+	return lock->locked++;
+}
+
+static inline void k_spin_unlock(struct k_spinlock *lock, k_spinlock_key_t key)
+{
+	lock->locked = key;
+}
+
+typedef long atomic_t;
+typedef atomic_t atomic_val_t;
+
+static inline atomic_val_t atomic_get(const atomic_t *target)
+{
+	return *target;
+}
+
+static inline atomic_val_t atomic_set(atomic_t *target, atomic_val_t value)
+{
+	atomic_val_t old = *target;
+
+	*target = value;
+	return old;
+}
+
+static inline atomic_val_t atomic_inc(atomic_t *target)
+{
+	return (*target)++;
+}
+
+static inline atomic_val_t atomic_dec(atomic_t *target)
+{
+	return (*target)--;
+}
+
+static inline bool atomic_cas(atomic_t *target, atomic_val_t old, atomic_val_t value)
+{
+	if (*target != old) {
+		return false;
+	}
+
+	*target = value;
+	return true;
+}
+
+/** @brief Set the uptime returned by k_uptime_get(). */
+void host_uptime_set(int64_t uptime_ms);
+
+/** @brief Move the uptime forward. */
+void host_uptime_advance(int64_t ms);
+
+int64_t k_uptime_get(void);
+
+static inline uint32_t k_uptime_get_32(void)
+{
+	return (uint32_t)k_uptime_get();
+}
+
+/** @brief Cycle counter, counting microseconds of the host clock. */
+uint32_t k_cycle_get_32(void);
+
+static inline uint64_t k_cyc_to_us_floor64(uint64_t cycles)
+{
+	return cycles;
+}
+
+static inline uint32_t k_cyc_to_us_floor32(uint32_t cycles)
+{
+	return cycles;
+}
+
+static inline uint64_t k_cyc_to_ns_floor64(uint64_t cycles)
+{
+	return cycles * 1000;
+}
+
+static inline uint64_t k_cyc_to_ms_floor64(uint64_t cycles)
+{
+	return cycles / 1000;
+}
+
+#endif /* ZEPHYR_INCLUDE_KERNEL_H_ */
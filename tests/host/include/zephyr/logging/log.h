@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/* Host stand-in for <zephyr/logging/log.h>. Errors and warnings are printed,
+ * the other levels only with HOST_TEST_VERBOSE defined.
+ */
+
+#ifndef ZEPHYR_INCLUDE_LOGGING_LOG_H_
+#define ZEPHYR_INCLUDE_LOGGING_LOG_H_
+
+#include <stdio.h>
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERR 1
+#define LOG_LEVEL_WRN 2
+#define LOG_LEVEL_INF 3
+#define LOG_LEVEL_DBG 4
+
+#define LOG_MODULE_REGISTER(...)
+#define LOG_MODULE_DECLARE(...)
+
+#define HOST_LOG(_level, _fmt, ...) \
+	printf("<%s> %s: " _fmt "\n", _level, __func__, ##__VA_ARGS__)
+
+#define LOG_ERR(_fmt, ...) HOST_LOG("err", _fmt, ##__VA_ARGS__)
+#define LOG_WRN(_fmt, ...) HOST_LOG("wrn", _fmt, ##__VA_ARGS__)
+
+#if defined(HOST_TEST_VERBOSE)
+#define LOG_INF(_fmt, ...) HOST_LOG("inf", _fmt, ##__VA_ARGS__)
+#define LOG_DBG(_fmt, ...) HOST_LOG("dbg", _fmt, ##__VA_ARGS__)
+#else
+#define LOG_INF(_fmt, ...) do { if (0) printf(_fmt, ##__VA_ARGS__); } while (0)
+#define LOG_DBG(_fmt, ...) do { if (0) printf(_fmt, ##__VA_ARGS__); } while (0)
+#endif
+
+#define LOG_HEXDUMP_DBG(_data, _len, _str) do { (void)(_data); (void)(_len); } while (0)
+#define LOG_HEXDUMP_INF(_data, _len, _str) do { (void)(_data); (void)(_len); } while (0)
+
+#endif /* ZEPHYR_INCLUDE_LOGGING_LOG_H_ */
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/* Host stand-in for the parts of <zephyr/net/coap.h> used by the
+ * application: the message header, options and payload of RFC 7252.
+ */
+
+#ifndef ZEPHYR_INCLUDE_NET_COAP_H_
+#define ZEPHYR_INCLUDE_NET_COAP_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define COAP_TOKEN_MAX_LEN 8
+
+enum coap_msgtype {
+	COAP_TYPE_CON = 0,
+	COAP_TYPE_NON_CON = 1,
+	COAP_TYPE_ACK = 2,
+	COAP_TYPE_RESET = 3,
+};
+
+#define COAP_TYPE_NON COAP_TYPE_NON_CON
+
+#define COAP_MAKE_RESPONSE_CODE(class, det) (((class) << 5) | (det))
+
+enum coap_method {
+	COAP_METHOD_GET = 1,
+	COAP_METHOD_POST = 2,
+	COAP_METHOD_PUT = 3,
+	COAP_METHOD_DELETE = 4,
+	COAP_METHOD_FETCH = 5,
+};
+
+enum coap_response_code {
+	COAP_RESPONSE_CODE_OK = COAP_MAKE_RESPONSE_CODE(2, 0),
+	COAP_RESPONSE_CODE_CREATED = COAP_MAKE_RESPONSE_CODE(2, 1),
+	COAP_RESPONSE_CODE_VALID = COAP_MAKE_RESPONSE_CODE(2, 3),
+	COAP_RESPONSE_CODE_CHANGED = COAP_MAKE_RESPONSE_CODE(2, 4),
+	COAP_RESPONSE_CODE_CONTENT = COAP_MAKE_RESPONSE_CODE(2, 5),
+	COAP_RESPONSE_CODE_CONTINUE = COAP_MAKE_RESPONSE_CODE(2, 31),
+	COAP_RESPONSE_CODE_BAD_REQUEST = COAP_MAKE_RESPONSE_CODE(4, 0),
+	COAP_RESPONSE_CODE_NOT_FOUND = COAP_MAKE_RESPONSE_CODE(4, 4),
+	COAP_RESPONSE_CODE_INCOMPLETE = COAP_MAKE_RESPONSE_CODE(4, 8),
+	COAP_RESPONSE_CODE_REQUEST_TOO_LARGE = COAP_MAKE_RESPONSE_CODE(4, 13),
+};
+
+#define COAP_CODE_EMPTY 0
+
+enum coap_option_num {
+	COAP_OPTION_ETAG = 4,
+	COAP_OPTION_OBSERVE = 6,
+	COAP_OPTION_URI_PATH = 11,
+	COAP_OPTION_CONTENT_FORMAT = 12,
+	COAP_OPTION_MAX_AGE = 14,
+	COAP_OPTION_BLOCK2 = 23,
+	COAP_OPTION_BLOCK1 = 27,
+	COAP_OPTION_SIZE2 = 28,
+	COAP_OPTION_SIZE1 = 60,
+};
+
+enum coap_content_format {
+	COAP_CONTENT_FORMAT_TEXT_PLAIN = 0,
+	COAP_CONTENT_FORMAT_APP_OCTET_STREAM = 42,
+	COAP_CONTENT_FORMAT_APP_JSON = 50,
+};
+
+struct coap_packet {
+	uint8_t *data;
+	uint16_t offset;
+	uint16_t max_len;
+	/* Number of the last option appended. */
+	uint16_t delta;
+};
+
+struct coap_option {
+	uint16_t delta;
+	uint16_t len;
+	uint8_t value[12];
+};
+
+int coap_packet_parse(struct coap_packet *cpkt, uint8_t *data, uint16_t len,
+		      void *options, uint8_t opt_num);
+
+uint8_t coap_header_get_type(const struct coap_packet *cpkt);
+uint8_t coap_header_get_code(const struct coap_packet *cpkt);
+uint16_t coap_header_get_id(const struct coap_packet *cpkt);
+uint8_t coap_header_get_token(const struct coap_packet *cpkt, uint8_t *token);
+
+uint16_t coap_next_id(void);
+
+int coap_packet_init(struct coap_packet *cpkt, uint8_t *data, uint16_t max_len,
+		     uint8_t ver, uint8_t type, uint8_t token_len,
+		     const uint8_t *token, uint8_t code, uint16_t id);
+int coap_packet_append_option(struct coap_packet *cpkt, uint16_t code,
+			      const uint8_t *value, uint16_t len);
+int coap_append_option_int(struct coap_packet *cpkt, uint16_t code, unsigned int val);
+int coap_packet_append_payload_marker(struct coap_packet *cpkt);
+int coap_packet_append_payload(struct coap_packet *cpkt, const uint8_t *payload,
+			       uint16_t payload_len);
+
+int coap_find_options(const struct coap_packet *cpkt, uint16_t code,
+		      struct coap_option *options, uint16_t veclen);
+unsigned int coap_option_value_to_int(const struct coap_option *option);
+int coap_get_option_int(const struct coap_packet *cpkt, uint16_t code);
+const uint8_t *coap_packet_get_payload(const struct coap_packet *cpkt, uint16_t *len);
+
+/** @brief Build a message without options, for the tests. */
+size_t host_coap_build(uint8_t *buf, uint8_t type, uint8_t code, uint16_t id,
+		       const void *token, uint8_t token_len);
+
+#endif /* ZEPHYR_INCLUDE_NET_COAP_H_ */
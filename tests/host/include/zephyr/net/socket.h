@@ -0,0 +1,21 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/* Host stand-in for <zephyr/net/socket.h>. Datagrams are sent to the test,
+ * which implements host_socket_send().
+ */
+
+#ifndef ZEPHYR_INCLUDE_NET_SOCKET_H_
+#define ZEPHYR_INCLUDE_NET_SOCKET_H_
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#define send host_socket_send
+
+ssize_t host_socket_send(int sock, const void *buf, size_t len, int flags);
+
+#endif /* ZEPHYR_INCLUDE_NET_SOCKET_H_ */
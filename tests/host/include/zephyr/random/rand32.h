@@ -0,0 +1,18 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef ZEPHYR_INCLUDE_RANDOM_RAND32_H_
+#define ZEPHYR_INCLUDE_RANDOM_RAND32_H_
+
+#include <stdint.h>
+
+/** @brief Pseudo-random numbers, the same sequence on every run. */
+uint32_t sys_rand32_get(void);
+
+/** @brief Restart the sequence of sys_rand32_get(). */
+void host_rand_seed(uint32_t seed);
+
+#endif /* ZEPHYR_INCLUDE_RANDOM_RAND32_H_ */
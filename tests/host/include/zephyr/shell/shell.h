@@ -0,0 +1,12 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/* Host stand-in, the tests are built without CONFIG_SHELL. */
+
+#ifndef SHELL_H__
+#define SHELL_H__
+
+#endif /* SHELL_H__ */
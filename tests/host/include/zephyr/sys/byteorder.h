@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/* Host stand-in for the parts of <zephyr/sys/byteorder.h> used by the
+ * application.
+ */
+
+#ifndef ZEPHYR_INCLUDE_SYS_BYTEORDER_H_
+#define ZEPHYR_INCLUDE_SYS_BYTEORDER_H_
+
+#include <stdint.h>
+
+static inline uint16_t sys_get_be16(const uint8_t src[2])
+{
+	return ((uint16_t)src[0] << 8) | src[1];
+}
+
+static inline void sys_put_be16(uint16_t val, uint8_t dst[2])
+{
+	dst[0] = val >> 8;
+	dst[1] = val;
+}
+
+static inline uint32_t sys_get_be32(const uint8_t src[4])
+{
+	return ((uint32_t)sys_get_be16(&src[0]) << 16) | sys_get_be16(&src[2]);
+}
+
+static inline void sys_put_be32(uint32_t val, uint8_t dst[4])
+{
+	sys_put_be16(val >> 16, &dst[0]);
+	sys_put_be16(val, &dst[2]);
+}
+
+static inline uint16_t sys_get_le16(const uint8_t src[2])
+{
+	return ((uint16_t)src[1] << 8) | src[0];
+}
+
+static inline void sys_put_le16(uint16_t val, uint8_t dst[2])
+{
+	dst[0] = val;
+	dst[1] = val >> 8;
+}
+
+#endif /* ZEPHYR_INCLUDE_SYS_BYTEORDER_H_ */
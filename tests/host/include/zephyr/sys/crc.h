@@ -0,0 +1,20 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/* Host stand-in for the parts of <zephyr/sys/crc.h> used by the
+ * application.
+ */
+
+#ifndef ZEPHYR_INCLUDE_SYS_CRC_H_
+#define ZEPHYR_INCLUDE_SYS_CRC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** @brief CRC-32 of IEEE 802.3. */
+uint32_t crc32_ieee(const uint8_t *data, size_t len);
+
+#endif /* ZEPHYR_INCLUDE_SYS_CRC_H_ */
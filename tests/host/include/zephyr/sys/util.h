@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/* Host stand-in for the parts of <zephyr/sys/util.h> used by the application. */
+
+#ifndef ZEPHYR_INCLUDE_SYS_UTIL_H_
+#define ZEPHYR_INCLUDE_SYS_UTIL_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ARRAY_SIZE(array) (sizeof(array) / sizeof((array)[0]))
+
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+#define MAX(a, b) (((a) > (b)) ? (a) : (b))
+#define CLAMP(val, low, high) (((val) <= (low)) ? (low) : MIN(val, high))
+
+#define BIT(n) (1UL << (n))
+#define BIT64(n) (1ULL << (n))
+#define DIV_ROUND_UP(n, d) (((n) + (d) - 1) / (d))
+#define ROUND_UP(x, align) (DIV_ROUND_UP(x, align) * (align))
+#define IS_POWER_OF_TWO(x) (((x) != 0U) && (((x) & ((x) - 1U)) == 0U))
+
+#define __packed __attribute__((__packed__))
+
+#define CONTAINER_OF(ptr, type, field) ((type *)(((char *)(ptr)) - offsetof(type, field)))
+
+/* IS_ENABLED() of Zephyr: 1 if the macro is defined to 1, else 0. */
+#define IS_ENABLED(config_macro) Z_IS_ENABLED1(config_macro)
+#define Z_IS_ENABLED1(config_macro) Z_IS_ENABLED2(_XXXX##config_macro)
+#define _XXXX1 _YYYY,
+#define Z_IS_ENABLED2(one_or_two_args) Z_IS_ENABLED3(one_or_two_args 1, 0)
+#define Z_IS_ENABLED3(ignore_this, val, ...) val
+
+static inline unsigned int find_lsb_set(uint32_t op)
+{
+	return __builtin_ffs(op);
+}
+
+static inline unsigned int find_msb_set(uint32_t op)
+{
+	return op == 0 ? 0 : 32 - __builtin_clz(op);
+}
+
+static inline int host_hex_digit(char c)
+{
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	} else if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	} else if (c >= 'A' && c <= 'F') {
+		return c - 'A' + 10;
+	}
+
+	return -1;
+}
+
+/* hex2bin() of Zephyr, without the odd length case. */
+static inline size_t hex2bin(const char *hex, size_t hexlen, uint8_t *buf, size_t buflen)
+{
+	if (hexlen % 2 != 0 || hexlen / 2 > buflen) {
+		return 0;
+	}
+
+	for (size_t i = 0; i < hexlen / 2; i++) {
+		int high = host_hex_digit(hex[2 * i]);
+		int low = host_hex_digit(hex[2 * i + 1]);
+
+		if (high < 0 || low < 0) {
+			return 0;
+		}
+		buf[i] = (high << 4) | low;
+	}
+
+	return hexlen / 2;
+}
+
+#endif /* ZEPHYR_INCLUDE_SYS_UTIL_H_ */
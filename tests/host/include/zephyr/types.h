@@ -0,0 +1,13 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef ZEPHYR_INCLUDE_TYPES_H_
+#define ZEPHYR_INCLUDE_TYPES_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#endif /* ZEPHYR_INCLUDE_TYPES_H_ */
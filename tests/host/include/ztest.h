@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/* Host stand-in for the subset of the ztest API used by the tests, so that
+ * the tests read like Zephyr tests. A test suite is defined with
+ * ZTEST_SUITE(), and its tests with ZTEST(). The before function of the
+ * suite runs before each test. A failed assertion ends the test run.
+ */
+
+#ifndef HOST_ZTEST_H_
+#define HOST_ZTEST_H_
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef void *(*ztest_setup_t)(void);
+typedef void (*ztest_before_t)(void *fixture);
+
+void host_ztest_register_suite(const char *suite, ztest_before_t before);
+void host_ztest_register(const char *suite, const char *name, void (*fn)(void));
+void host_ztest_fail(const char *file, int line, const char *cond, const char *fmt, ...);
+
+#define ZTEST_SUITE(_suite, _predicate, _setup, _before, _after, _teardown)		\
+	__attribute__((constructor(101))) static void register_suite_##_suite(void)	\
+	{										\
+		host_ztest_register_suite(#_suite, _before);				\
+	}
+
+#define ZTEST(_suite, _name)								\
+	static void _suite##_##_name(void);						\
+	__attribute__((constructor(102))) static void register_##_suite##_##_name(void)	\
+	{										\
+		host_ztest_register(#_suite, #_name, _suite##_##_name);			\
+	}										\
+	static void _suite##_##_name(void)
+
+#define zassert_true(cond, ...)								\
+	do {										\
+		if (!(cond)) {								\
+			host_ztest_fail(__FILE__, __LINE__, #cond, "" __VA_ARGS__);	\
+		}									\
+	} while (0)
+
+#define zassert_false(cond, ...) zassert_true(!(cond), ##__VA_ARGS__)
+#define zassert_equal(a, b, ...) zassert_true((a) == (b), ##__VA_ARGS__)
+#define zassert_not_equal(a, b, ...) zassert_true((a) != (b), ##__VA_ARGS__)
+#define zassert_ok(cond, ...) zassert_true((cond) == 0, ##__VA_ARGS__)
+#define zassert_is_null(ptr, ...) zassert_true((ptr) == NULL, ##__VA_ARGS__)
+#define zassert_not_null(ptr, ...) zassert_true((ptr) != NULL, ##__VA_ARGS__)
+#define zassert_mem_equal(a, b, len, ...) zassert_true(memcmp(a, b, len) == 0, ##__VA_ARGS__)
+#define zassert_str_equal(a, b, ...) zassert_true(strcmp(a, b) == 0, ##__VA_ARGS__)
+#define zassert_within(a, b, delta, ...)						\
+	zassert_true(((a) >= (b) - (delta)) && ((a) <= (b) + (delta)), ##__VA_ARGS__)
+
+#define TC_PRINT(fmt, ...) printf(fmt, ##__VA_ARGS__)
+
+#endif /* HOST_ZTEST_H_ */
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <time.h>
+#include <zephyr/kernel.h>
+#include <zephyr/random/rand32.h>
+
+static int64_t uptime;
+
+void host_uptime_set(int64_t uptime_ms)
+{
+	uptime = uptime_ms;
+}
+
+void host_uptime_advance(int64_t ms)
+{
+	uptime += ms;
+}
+
+int64_t k_uptime_get(void)
+{
+	return uptime;
+}
+
+uint32_t k_cycle_get_32(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint32_t)(ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+}
+
+static uint32_t rand_state = 1;
+
+void host_rand_seed(uint32_t seed)
+{
+	rand_state = seed ? seed : 1;
+}
+
+uint32_t sys_rand32_get(void)
+{
+	/* xorshift32 */
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 17;
+	rand_state ^= rand_state << 5;
+
+	return rand_state;
+}
@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include <openssl/evp.h>
+#include <openssl/kdf.h>
+#include <psa/crypto.h>
+
+#define KEYS_MAX 4
+#define CCM_L 2
+
+/* The key ID is the index of the slot plus one. */
+static struct {
+	uint8_t data[32];
+	size_t len;
+} keys[KEYS_MAX];
+
+static size_t tag_len(psa_algorithm_t alg)
+{
+	return (alg >> 16) & 0x3f;
+}
+
+psa_status_t psa_crypto_init(void)
+{
+	return PSA_SUCCESS;
+}
+
+psa_status_t psa_import_key(const psa_key_attributes_t *attributes, const uint8_t *data,
+			    size_t data_length, psa_key_id_t *key)
+{
+	if (attributes->type != PSA_KEY_TYPE_AES || data_length != 16 ||
+	    attributes->bits != 8 * data_length) {
+		return PSA_ERROR_NOT_SUPPORTED;
+	}
+
+	for (size_t i = 0; i < KEYS_MAX; i++) {
+		if (keys[i].len == 0) {
+			memcpy(keys[i].data, data, data_length);
+			keys[i].len = data_length;
+			*key = i + 1;
+			return PSA_SUCCESS;
+		}
+	}
+
+	return PSA_ERROR_INSUFFICIENT_MEMORY;
+}
+
+psa_status_t psa_destroy_key(psa_key_id_t key)
+{
+	if (key == 0 || key > KEYS_MAX || keys[key - 1].len == 0) {
+		return PSA_ERROR_INVALID_ARGUMENT;
+	}
+
+	memset(&keys[key - 1], 0, sizeof(keys[key - 1]));
+
+	return PSA_SUCCESS;
+}
+
+/* AES-128-CCM of OpenSSL, the tag follows the ciphertext as in PSA. */
+static psa_status_t ccm(bool encrypt, psa_key_id_t key, psa_algorithm_t alg,
+			const uint8_t *nonce, size_t nonce_length, const uint8_t *aad,
+			size_t aad_length, const uint8_t *in, size_t in_length, uint8_t *out,
+			size_t out_size, size_t *out_length)
+{
+	size_t tag = tag_len(alg);
+	size_t data_len = encrypt ? in_length : in_length - tag;
+	EVP_CIPHER_CTX *ctx;
+	psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+	int len;
+
+	if (key == 0 || key > KEYS_MAX || keys[key - 1].len == 0 || nonce_length != 15 - CCM_L ||
+	    (!encrypt && in_length < tag)) {
+		return PSA_ERROR_INVALID_ARGUMENT;
+	}
+
+	if (out_size < (encrypt ? in_length + tag : data_len)) {
+		return PSA_ERROR_BUFFER_TOO_SMALL;
+	}
+
+	ctx = EVP_CIPHER_CTX_new();
+	if (ctx == NULL) {
+		return PSA_ERROR_INSUFFICIENT_MEMORY;
+	}
+
+	if (EVP_CipherInit_ex(ctx, EVP_aes_128_ccm(), NULL, NULL, NULL, encrypt) != 1 ||
+	    EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_IVLEN, nonce_length, NULL) != 1 ||
+	    EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, tag,
+				encrypt ? NULL : (void *)&in[data_len]) != 1 ||
+	    EVP_CipherInit_ex(ctx, NULL, NULL, keys[key - 1].data, nonce, encrypt) != 1 ||
+	    EVP_CipherUpdate(ctx, NULL, &len, NULL, data_len) != 1 ||
+	    (aad_length > 0 && EVP_CipherUpdate(ctx, NULL, &len, aad, aad_length) != 1)) {
+		goto out;
+	}
+
+	/* The tag of CCM is verified by the update with the ciphertext. */
+	if (EVP_CipherUpdate(ctx, out, &len, in, data_len) != 1) {
+		status = encrypt ? PSA_ERROR_GENERIC_ERROR : PSA_ERROR_INVALID_SIGNATURE;
+		goto out;
+	}
+
+	if (encrypt) {
+		if (EVP_CipherFinal_ex(ctx, out + len, &len) != 1 ||
+		    EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, tag, &out[data_len]) != 1) {
+			goto out;
+		}
+		*out_length = data_len + tag;
+	} else {
+		*out_length = data_len;
+	}
+
+	status = PSA_SUCCESS;
+
+out:
+	EVP_CIPHER_CTX_free(ctx);
+	return status;
+}
+
+psa_status_t psa_aead_encrypt(psa_key_id_t key, psa_algorithm_t alg, const uint8_t *nonce,
+			      size_t nonce_length, const uint8_t *additional_data,
+			      size_t additional_data_length, const uint8_t *plaintext,
+			      size_t plaintext_length, uint8_t *ciphertext, size_t ciphertext_size,
+			      size_t *ciphertext_length)
+{
+	return ccm(true, key, alg, nonce, nonce_length, additional_data, additional_data_length,
+		   plaintext, plaintext_length, ciphertext, ciphertext_size, ciphertext_length);
+}
+
+psa_status_t psa_aead_decrypt(psa_key_id_t key, psa_algorithm_t alg, const uint8_t *nonce,
+			      size_t nonce_length, const uint8_t *additional_data,
+			      size_t additional_data_length, const uint8_t *ciphertext,
+			      size_t ciphertext_length, uint8_t *plaintext, size_t plaintext_size,
+			      size_t *plaintext_length)
+{
+	return ccm(false, key, alg, nonce, nonce_length, additional_data, additional_data_length,
+		   ciphertext, ciphertext_length, plaintext, plaintext_size, plaintext_length);
+}
+
+psa_status_t psa_key_derivation_setup(psa_key_derivation_operation_t *operation,
+				      psa_algorithm_t alg)
+{
+	if (alg != PSA_ALG_HKDF(PSA_ALG_SHA_256)) {
+		return PSA_ERROR_NOT_SUPPORTED;
+	}
+
+	memset(operation, 0, sizeof(*operation));
+	operation->alg = alg;
+
+	return PSA_SUCCESS;
+}
+
+psa_status_t psa_key_derivation_input_bytes(psa_key_derivation_operation_t *operation,
+					    psa_key_derivation_step_t step, const uint8_t *data,
+					    size_t data_length)
+{
+	uint8_t *buf;
+	size_t *len;
+
+	switch (step) {
+	case PSA_KEY_DERIVATION_INPUT_SECRET:
+		buf = operation->secret;
+		len = &operation->secret_len;
+		break;
+	case PSA_KEY_DERIVATION_INPUT_SALT:
+		buf = operation->salt;
+		len = &operation->salt_len;
+		break;
+	case PSA_KEY_DERIVATION_INPUT_INFO:
+		buf = operation->info;
+		len = &operation->info_len;
+		break;
+	default:
+		return PSA_ERROR_INVALID_ARGUMENT;
+	}
+
+	if (data_length > sizeof(operation->secret)) {
+		return PSA_ERROR_INSUFFICIENT_MEMORY;
+	}
+
+	memcpy(buf, data, data_length);
+	*len = data_length;
+
+	return PSA_SUCCESS;
+}
+
+psa_status_t psa_key_derivation_output_bytes(psa_key_derivation_operation_t *operation,
+					     uint8_t *output, size_t output_length)
+{
+	EVP_PKEY_CTX *ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, NULL);
+	psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+	size_t len = output_length;
+
+	if (ctx == NULL) {
+		return PSA_ERROR_INSUFFICIENT_MEMORY;
+	}
+
+	if (EVP_PKEY_derive_init(ctx) == 1 &&
+	    EVP_PKEY_CTX_set_hkdf_md(ctx, EVP_sha256()) == 1 &&
+	    EVP_PKEY_CTX_set1_hkdf_salt(ctx, operation->salt, operation->salt_len) == 1 &&
+	    EVP_PKEY_CTX_set1_hkdf_key(ctx, operation->secret, operation->secret_len) == 1 &&
+	    EVP_PKEY_CTX_add1_hkdf_info(ctx, operation->info, operation->info_len) == 1 &&
+	    EVP_PKEY_derive(ctx, output, &len) == 1 && len == output_length) {
+		status = PSA_SUCCESS;
+	}
+
+	EVP_PKEY_CTX_free(ctx);
+
+	return status;
+}
+
+psa_status_t psa_key_derivation_abort(psa_key_derivation_operation_t *operation)
+{
+	memset(operation, 0, sizeof(*operation));
+
+	return PSA_SUCCESS;
+}
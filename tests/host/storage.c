@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/* Storage kept in RAM. It survives the simulated reboots of a test, which
+ * only initialize the modules again.
+ */
+
+#include <zephyr/kernel.h>
+
+#include "util/storage.h"
+#include "host_storage.h"
+
+#define RECORDS_MAX 512
+#define RECORD_MAX_LEN 1024
+
+static struct {
+	uint16_t id;
+	size_t len;
+	uint8_t data[RECORD_MAX_LEN];
+} records[RECORDS_MAX];
+
+static size_t record_count;
+
+static struct host_storage_stats stats;
+
+static int write_failures;
+
+static int record_find(uint16_t id)
+{
+	for (size_t i = 0; i < record_count; i++) {
+		if (records[i].id == id) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+void host_storage_erase(void)
+{
+	record_count = 0;
+	write_failures = 0;
+	memset(&stats, 0, sizeof(stats));
+}
+
+void host_storage_fail_writes(int count)
+{
+	write_failures = count;
+}
+
+void host_storage_stats_get(struct host_storage_stats *out)
+{
+	*out = stats;
+}
+
+ssize_t storage_read(uint16_t id, void *data, size_t len)
+{
+	int i = record_find(id);
+
+	stats.reads++;
+
+	if (i < 0) {
+		return -ENOENT;
+	}
+
+	memcpy(data, records[i].data, MIN(len, records[i].len));
+
+	/* Like NVS, the length of the record is returned. */
+	return records[i].len;
+}
+
+int storage_write(uint16_t id, const void *data, size_t len)
+{
+	int i = record_find(id);
+
+	if (write_failures > 0) {
+		write_failures--;
+		return -EIO;
+	}
+
+	if (len > RECORD_MAX_LEN) {
+		return -EINVAL;
+	}
+
+	if (i < 0) {
+		if (record_count == RECORDS_MAX) {
+			return -ENOSPC;
+		}
+		i = record_count++;
+		records[i].id = id;
+	}
+
+	memcpy(records[i].data, data, len);
+	records[i].len = len;
+	stats.writes++;
+	stats.bytes_written += len;
+
+	return 0;
+}
+
+int storage_delete(uint16_t id)
+{
+	int i = record_find(id);
+
+	if (i >= 0) {
+		records[i] = records[--record_count];
+	}
+
+	return 0;
+}
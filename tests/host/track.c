@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "host_track.h"
+
+#define EARTH_RADIUS 6371000.0
+#define DEG_TO_RAD (M_PI / 180.0)
+
+/* Segments of the track: number of fixes, speed in m/s and turn rate in
+ * degrees per fix.
+ */
+static const struct {
+	int fixes;
+	double speed;
+	double turn;
+} segments[] = {
+	{ 20, 0.0, 0.0 },	/* Standing at home */
+	{ 40, 1.4, 0.0 },	/* Walking to the car */
+	{ 80, 14.0, 2.5 },	/* Driving along a curved road */
+	{ 30, 0.0, 0.0 },	/* Parked */
+	{ 70, 20.0, 0.0 },	/* Driving back on a straight road */
+};
+
+static struct cloud_location_data track[HOST_TRACK_LEN];
+
+static uint64_t seed = 0x2545f4914f6cdd1dULL;
+
+static double uniform(void)
+{
+	/* xorshift64* */
+	seed ^= seed >> 12;
+	seed ^= seed << 25;
+	seed ^= seed >> 27;
+
+	return ((seed * 0x2545f4914f6cdd1dULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double gaussian(double sigma)
+{
+	double u1 = uniform();
+	double u2 = uniform();
+
+	return sigma * sqrt(-2.0 * log(u1 + 1e-12)) * cos(2.0 * M_PI * u2);
+}
+
+static void generate(void)
+{
+	double lat = 65.0121;
+	double lon = 25.4651;
+	double alt = 15.0;
+	double heading = 60.0;
+	int64_t ts = 1700000000000LL;
+	int n = 0;
+
+	for (size_t s = 0; s < sizeof(segments) / sizeof(segments[0]); s++) {
+		for (int i = 0; i < segments[s].fixes && n < HOST_TRACK_LEN; i++, n++) {
+			double distance = segments[s].speed * HOST_TRACK_INTERVAL;
+			double accuracy = 3.0 + 4.0 * uniform();
+
+			heading = fmod(heading + segments[s].turn + 360.0, 360.0);
+			lat += distance * cos(heading * DEG_TO_RAD) / EARTH_RADIUS / DEG_TO_RAD;
+			lon += distance * sin(heading * DEG_TO_RAD) /
+			       (EARTH_RADIUS * cos(lat * DEG_TO_RAD)) / DEG_TO_RAD;
+			alt += segments[s].speed > 0 ? gaussian(0.5) : 0.0;
+
+			track[n].pvt.latitude = lat + gaussian(accuracy / 2) /
+						EARTH_RADIUS / DEG_TO_RAD;
+			track[n].pvt.longitude = lon + gaussian(accuracy / 2) /
+						 (EARTH_RADIUS * cos(lat * DEG_TO_RAD)) / DEG_TO_RAD;
+			track[n].pvt.altitude = alt + gaussian(2.0);
+			track[n].pvt.accuracy = accuracy;
+			track[n].pvt.speed = fmax(0.0, segments[s].speed + gaussian(0.2));
+			track[n].pvt.heading = heading;
+			track[n].gnss_ts = ts;
+
+			ts += HOST_TRACK_INTERVAL * 1000;
+		}
+	}
+}
+
+const struct cloud_location_data *host_track_get(void)
+{
+	static bool generated;
+
+	if (!generated) {
+		generate();
+		generated = true;
+	}
+
+	return track;
+}
+
+double host_track_distance(double lat1, double lon1, double lat2, double lon2)
+{
+	double x = (lon2 - lon1) * DEG_TO_RAD * cos((lat1 + lat2) / 2 * DEG_TO_RAD);
+	double y = (lat2 - lat1) * DEG_TO_RAD;
+
+	return sqrt(x * x + y * y) * EARTH_RADIUS;
+}
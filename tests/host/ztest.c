@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <stdarg.h>
+#include <string.h>
+
+#include "ztest.h"
+
+#define SUITES_MAX 8
+#define TESTS_MAX 64
+
+static struct {
+	const char *name;
+	ztest_before_t before;
+} suites[SUITES_MAX];
+
+static struct {
+	const char *suite;
+	const char *name;
+	void (*fn)(void);
+} tests[TESTS_MAX];
+
+static int suite_count;
+static int test_count;
+
+void host_ztest_register_suite(const char *suite, ztest_before_t before)
+{
+	if (suite_count == SUITES_MAX) {
+		fprintf(stderr, "Too many test suites\n");
+		exit(2);
+	}
+
+	suites[suite_count].name = suite;
+	suites[suite_count].before = before;
+	suite_count++;
+}
+
+void host_ztest_register(const char *suite, const char *name, void (*fn)(void))
+{
+	if (test_count == TESTS_MAX) {
+		fprintf(stderr, "Too many tests\n");
+		exit(2);
+	}
+
+	tests[test_count].suite = suite;
+	tests[test_count].name = name;
+	tests[test_count].fn = fn;
+	test_count++;
+}
+
+void host_ztest_fail(const char *file, int line, const char *cond, const char *fmt, ...)
+{
+	va_list args;
+
+	printf("    Assertion failed at %s:%d: %s", file, line, cond);
+	if (fmt[0] != '\0') {
+		printf(": ");
+		va_start(args, fmt);
+		vprintf(fmt, args);
+		va_end(args);
+	}
+	printf("\n FAIL\n");
+
+	exit(1);
+}
+
+int main(void)
+{
+	for (int i = 0; i < suite_count; i++) {
+		for (int j = 0; j < test_count; j++) {
+			if (strcmp(tests[j].suite, suites[i].name) != 0) {
+				continue;
+			}
+
+			printf("START - %s.%s\n", suites[i].name, tests[j].name);
+			if (suites[i].before != NULL) {
+				suites[i].before(NULL);
+			}
+			tests[j].fn();
+			printf(" PASS - %s.%s\n", suites[i].name, tests[j].name);
+		}
+	}
+
+	printf("%d tests passed\n", test_count);
+
+	return 0;
+}
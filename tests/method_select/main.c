@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <ztest.h>
+#include <zephyr/kernel.h>
+#include <zephyr/random/rand32.h>
+
+#include "location/method_select.h"
+
+#define GNSS_BUDGET_MS 120000
+#define REQUESTS 100
+
+/* Synthetic conditions of one method: the chance of a fix, the time to fix
+ * and the accuracy, uniform around their means, and the time a failed
+ * cellular request takes. A GNSS search without a fix takes its timeout.
+ */
+struct method_env {
+	uint32_t success;
+	uint32_t fix_time_ms;
+	uint32_t fix_time_jitter_ms;
+	uint32_t fail_time_ms;
+	uint32_t accuracy;
+	uint32_t accuracy_jitter;
+};
+
+struct env {
+	struct method_env gnss;
+	struct method_env cellular;
+};
+
+/* Clear sky with valid ephemeris, GNSS fixes quickly and accurately. */
+static const struct env open_sky = {
+	.gnss = { .success = 95, .fix_time_ms = 6000, .fix_time_jitter_ms = 2000,
+		  .accuracy = 10, .accuracy_jitter = 5 },
+	.cellular = { .success = 98, .fix_time_ms = 4000, .fix_time_jitter_ms = 1000,
+		      .fail_time_ms = 10000, .accuracy = 800, .accuracy_jitter = 400 },
+};
+
+/* Between tall buildings GNSS rarely gets a fix and takes long, dense cells
+ * give a cellular fix mostly within the accuracy target.
+ */
+static const struct env urban_canyon = {
+	.gnss = { .success = 20, .fix_time_ms = 60000, .fix_time_jitter_ms = 20000,
+		  .accuracy = 40, .accuracy_jitter = 20 },
+	.cellular = { .success = 95, .fix_time_ms = 4000, .fix_time_jitter_ms = 1000,
+		      .fail_time_ms = 10000, .accuracy = 80, .accuracy_jitter = 40 },
+};
+
+static const struct method_select_context open_sky_ctx = { .rsrp = -85, .gnss_age = 600 };
+static const struct method_select_context urban_canyon_ctx = { .rsrp = -100,
+								.gnss_age = 8 * 3600 };
+static const struct method_select_context no_history_ctx = { .rsrp = INT16_MIN,
+							      .gnss_age = -1 };
+static const struct method_select_context changing_ctx = { .rsrp = -115, .gnss_age = 600 };
+
+static uint32_t uniform(uint32_t mean, uint32_t jitter)
+{
+	return mean - jitter + sys_rand32_get() % (2 * jitter + 1);
+}
+
+/**@brief Try a method and record the outcome, as the location module does.
+ *
+ * @return true if the method gave a fix.
+ */
+static bool attempt(const struct method_select_context *ctx, const struct env *env,
+		    enum location_method method, int gnss_timeout)
+{
+	const struct method_env *m = method == LOCATION_METHOD_GNSS ? &env->gnss :
+								       &env->cellular;
+	bool fix = sys_rand32_get() % 100 < m->success;
+	int64_t time = uniform(m->fix_time_ms, m->fix_time_jitter_ms);
+
+	if (method == LOCATION_METHOD_GNSS && time > gnss_timeout) {
+		fix = false;
+	}
+
+	if (!fix) {
+		time = method == LOCATION_METHOD_GNSS ? gnss_timeout : m->fail_time_ms;
+	}
+
+	method_select_record(ctx, method, fix, time, uniform(m->accuracy, m->accuracy_jitter));
+
+	return fix;
+}
+
+/**@brief Run a request through the chosen order, up to the first fix. */
+static void request(const struct method_select_context *ctx, const struct env *env,
+		    struct method_select_decision *decision)
+{
+	method_select_choose(ctx, GNSS_BUDGET_MS, decision);
+
+	for (int i = 0; i < METHOD_SELECT_METHODS; i++) {
+		if (attempt(ctx, env, decision->order[i], decision->gnss_timeout)) {
+			break;
+		}
+	}
+}
+
+/**@brief Run requests and count the ones that tried GNSS first, leaving
+ *	  out the explorations of the other order.
+ */
+static int run(const struct method_select_context *ctx, const struct env *env, int count,
+	       struct method_select_decision *last)
+{
+	int gnss_first = 0;
+	int explored = 0;
+
+	for (int i = 0; i < count; i++) {
+		request(ctx, env, last);
+
+		if (last->explore) {
+			explored++;
+		} else if (last->order[0] == LOCATION_METHOD_GNSS) {
+			gnss_first++;
+		}
+	}
+
+	zassert_true(explored <= count / CONFIG_LOCATION_METHOD_SELECT_EXPLORE + 1,
+		     "%d of %d explored", explored, count);
+
+	return gnss_first;
+}
+
+static void print_stats(const char *name, const struct method_select_context *ctx)
+{
+	static const enum location_method methods[] = {
+		LOCATION_METHOD_GNSS,
+		LOCATION_METHOD_CELLULAR,
+	};
+
+	for (int i = 0; i < ARRAY_SIZE(methods); i++) {
+		struct method_select_stats s;
+
+		method_select_stats_get(ctx, methods[i], &s);
+		TC_PRINT("%s %s: %u attempts, %u fixes, success %.0f%%, accurate %.0f%%, "
+			 "fix time %.1f s (%.1f), fail time %.1f s, accuracy %.0f m\n", name,
+			 methods[i] == LOCATION_METHOD_GNSS ? "GNSS" : "cellular",
+			 s.attempts, s.fixes, s.success * 100.0, s.accurate * 100.0,
+			 s.fix_time, s.fix_time_dev, s.fail_time, s.accuracy);
+	}
+}
+
+static void before(void *fixture)
+{
+	host_rand_seed(1);
+}
+
+ZTEST(method_select, test_no_history)
+{
+	struct method_select_decision decision;
+	struct method_select_stats stats;
+
+	method_select_choose(&no_history_ctx, GNSS_BUDGET_MS, &decision);
+
+	zassert_equal(decision.order[0], LOCATION_METHOD_GNSS);
+	zassert_equal(decision.order[1], LOCATION_METHOD_CELLULAR);
+	zassert_equal(decision.gnss_timeout, GNSS_BUDGET_MS);
+	zassert_equal(decision.charge, 0.0f);
+	zassert_false(decision.explore);
+
+	/* GNSS first until both methods have been tried often enough. With
+	 * open sky cellular is never reached.
+	 */
+	for (int i = 0; i < 2 * CONFIG_LOCATION_METHOD_SELECT_MIN_ATTEMPTS; i++) {
+		request(&no_history_ctx, &open_sky, &decision);
+		zassert_equal(decision.order[0], LOCATION_METHOD_GNSS);
+		zassert_equal(decision.gnss_timeout, GNSS_BUDGET_MS);
+	}
+
+	method_select_stats_get(&no_history_ctx, LOCATION_METHOD_CELLULAR, &stats);
+	zassert_true(stats.attempts < CONFIG_LOCATION_METHOD_SELECT_MIN_ATTEMPTS);
+
+	/* The other contexts have no history from these requests. */
+	method_select_stats_get(&open_sky_ctx, LOCATION_METHOD_GNSS, &stats);
+	zassert_equal(stats.attempts, 0);
+}
+
+ZTEST(method_select, test_open_sky)
+{
+	struct method_select_decision decision;
+	struct method_select_stats gnss;
+	int gnss_first;
+
+	gnss_first = run(&open_sky_ctx, &open_sky, REQUESTS, &decision);
+	print_stats("open sky", &open_sky_ctx);
+
+	method_select_stats_get(&open_sky_ctx, LOCATION_METHOD_GNSS, &gnss);
+	zassert_true(gnss.attempts > REQUESTS / 2);
+	zassert_within(gnss.success, 0.95f, 0.15f, "GNSS success %f", gnss.success);
+	zassert_within(gnss.fix_time, 6.0f, 2.0f, "time to fix %f s", gnss.fix_time);
+	zassert_within(gnss.accuracy, 10.0f, 5.0f, "accuracy %f m", gnss.accuracy);
+	zassert_true(gnss.accurate > 0.99f);
+
+	/* Nearly all the requests try GNSS first, and the GNSS timeout is cut
+	 * down from the budget to the shortest one allowed.
+	 */
+	TC_PRINT("open sky: GNSS first in %d of %d requests, GNSS timeout %d ms, "
+		 "%.0f mAs per request\n", gnss_first, REQUESTS, decision.gnss_timeout,
+		 decision.charge);
+	zassert_true(gnss_first >= REQUESTS * 8 / 10, "GNSS first in %d", gnss_first);
+
+	request(&open_sky_ctx, &open_sky, &decision);
+	if (decision.explore) {
+		request(&open_sky_ctx, &open_sky, &decision);
+	}
+	zassert_equal(decision.order[0], LOCATION_METHOD_GNSS);
+	zassert_equal(decision.gnss_timeout,
+		      CONFIG_LOCATION_METHOD_SELECT_GNSS_TIMEOUT_MIN * MSEC_PER_SEC);
+	zassert_true(decision.charge > 0.0f);
+}
+
+ZTEST(method_select, test_urban_canyon)
+{
+	struct method_select_decision decision;
+	struct method_select_stats cellular;
+	int gnss_first;
+
+	gnss_first = run(&urban_canyon_ctx, &urban_canyon, REQUESTS, &decision);
+	print_stats("urban canyon", &urban_canyon_ctx);
+
+	TC_PRINT("urban canyon: GNSS first in %d of %d requests, GNSS timeout %d ms, "
+		 "%.0f mAs per request\n", gnss_first, REQUESTS, decision.gnss_timeout,
+		 decision.charge);
+
+	/* Cellular first once both methods have enough attempts. */
+	zassert_true(gnss_first <= 2 * CONFIG_LOCATION_METHOD_SELECT_MIN_ATTEMPTS,
+		     "GNSS first in %d", gnss_first);
+
+	method_select_stats_get(&urban_canyon_ctx, LOCATION_METHOD_CELLULAR, &cellular);
+	zassert_within(cellular.accuracy, 80.0f, 40.0f, "accuracy %f m", cellular.accuracy);
+	zassert_true(cellular.accurate > 0.5f && cellular.accurate < 1.0f);
+
+	request(&urban_canyon_ctx, &urban_canyon, &decision);
+	if (decision.explore) {
+		request(&urban_canyon_ctx, &urban_canyon, &decision);
+	}
+	zassert_equal(decision.order[0], LOCATION_METHOD_CELLULAR);
+	zassert_equal(decision.order[1], LOCATION_METHOD_GNSS);
+	zassert_true(decision.gnss_timeout <= GNSS_BUDGET_MS);
+}
+
+ZTEST(method_select, test_conditions_change)
+{
+	struct method_select_decision decision;
+	int gnss_first;
+
+	/* Open sky first, then the device is carried between buildings. The
+	 * averages follow within a few windows.
+	 */
+	run(&changing_ctx, &open_sky, REQUESTS, &decision);
+	run(&changing_ctx, &urban_canyon, 4 * CONFIG_LOCATION_METHOD_SELECT_WINDOW, &decision);
+	gnss_first = run(&changing_ctx, &urban_canyon, REQUESTS, &decision);
+
+	zassert_true(gnss_first <= REQUESTS / 10, "GNSS first in %d", gnss_first);
+
+	/* And back under the open sky, where the explorations find GNSS again. */
+	run(&changing_ctx, &open_sky, REQUESTS, &decision);
+	gnss_first = run(&changing_ctx, &open_sky, REQUESTS, &decision);
+
+	zassert_true(gnss_first >= REQUESTS * 8 / 10, "GNSS first in %d", gnss_first);
+}
+
+ZTEST(method_select, test_exploration)
+{
+	struct method_select_decision decision;
+	int explored = 0;
+	int explored_gnss_first = 0;
+
+	run(&open_sky_ctx, &open_sky, REQUESTS, &decision);
+
+	for (int i = 0; i < 10 * CONFIG_LOCATION_METHOD_SELECT_EXPLORE; i++) {
+		request(&open_sky_ctx, &open_sky, &decision);
+		if (decision.explore) {
+			explored++;
+			explored_gnss_first += decision.order[0] == LOCATION_METHOD_GNSS;
+		}
+	}
+
+	/* One request in CONFIG_LOCATION_METHOD_SELECT_EXPLORE, with the
+	 * worse order.
+	 */
+	zassert_equal(explored, 10);
+	zassert_equal(explored_gnss_first, 0);
+}
+
+ZTEST_SUITE(method_select, NULL, NULL, before, NULL, NULL);
@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <ztest.h>
+#include <host_storage.h>
+#include <openssl/evp.h>
+
+#include "cloud/oscore.h"
+#include "util/storage.h"
+
+/* Test vectors of RFC 8613 appendix C, on the client side. */
+
+/* C.4, GET coap://localhost/tv1 with sequence number 20. */
+static const uint8_t tv4_request[] = {
+	0x44, 0x01, 0x5d, 0x1f, 0x00, 0x00, 0x39, 0x74, 0x39, 0x6c, 0x6f, 0x63, 0x61, 0x6c,
+	0x68, 0x6f, 0x73, 0x74, 0x83, 0x74, 0x76, 0x31,
+};
+
+static const uint8_t tv4_protected[] = {
+	0x44, 0x02, 0x5d, 0x1f, 0x00, 0x00, 0x39, 0x74, 0x39, 0x6c, 0x6f, 0x63, 0x61, 0x6c,
+	0x68, 0x6f, 0x73, 0x74, 0x62, 0x09, 0x14, 0xff, 0x61, 0x2f, 0x10, 0x92, 0xf1, 0x77,
+	0x6f, 0x1c, 0x16, 0x68, 0xb3, 0x82, 0x5e,
+};
+
+/* C.7, 2.05 Content "Hello World!" without a Partial IV. */
+static const uint8_t tv7_response[] = {
+	0x64, 0x45, 0x5d, 0x1f, 0x00, 0x00, 0x39, 0x74, 0xff, 0x48, 0x65, 0x6c, 0x6c, 0x6f,
+	0x20, 0x57, 0x6f, 0x72, 0x6c, 0x64, 0x21,
+};
+
+static const uint8_t tv7_protected[] = {
+	0x64, 0x44, 0x5d, 0x1f, 0x00, 0x00, 0x39, 0x74, 0x90, 0xff, 0xdb, 0xaa, 0xd1, 0xe9,
+	0xa7, 0xe7, 0xb2, 0xa8, 0x13, 0xd3, 0xc3, 0x15, 0x24, 0x37, 0x83, 0x03, 0xcd, 0xaf,
+	0xae, 0x11, 0x91, 0x06,
+};
+
+/* C.8, the same response with the Partial IV 0 of the server. */
+static const uint8_t tv8_protected[] = {
+	0x64, 0x44, 0x5d, 0x1f, 0x00, 0x00, 0x39, 0x74, 0x92, 0x01, 0x00, 0xff, 0x4d, 0x4c,
+	0x13, 0x66, 0x93, 0x84, 0xb6, 0x73, 0x54, 0xb2, 0xb6, 0x17, 0x5f, 0xf4, 0xb8, 0x65,
+	0x8c, 0x66, 0x6a, 0x6c, 0xf8, 0x8e,
+};
+
+/* C.1.1, the keys of the server, to build notifications. */
+static const uint8_t server_sender_key[] = {
+	0xff, 0xb1, 0x4e, 0x09, 0x3c, 0x94, 0xc9, 0xca, 0xc9, 0x47, 0x16, 0x48, 0xb4, 0xf9,
+	0x87, 0x10,
+};
+
+static const uint8_t common_iv[] = {
+	0x46, 0x22, 0xd4, 0xdd, 0x6d, 0x94, 0x41, 0x68, 0xee, 0xfb, 0x54, 0x98, 0x7c,
+};
+
+#define SERVER_SENDER_ID 0x01
+
+/* GET /tv1 with Observe: 0, token 0x4a. */
+static const uint8_t observe_request[] = {
+	0x41, 0x01, 0x12, 0x34, 0x4a, 0x60, 0x53, 0x74, 0x76, 0x31,
+};
+
+static uint8_t out[CONFIG_CLOUD_COAP_MAX_MSG_LEN];
+static size_t out_len;
+
+/**@brief Build a notification of the server, with its own Partial IV, for a
+ *	  request protected with the one byte Partial IV request_piv.
+ */
+static size_t notification_build(uint8_t *buf, uint8_t request_piv, uint8_t piv,
+				 const char *payload)
+{
+	/* Enc_structure ["Encrypt0", h'', [1, [10], h'', h'<request_piv>', h'']] */
+	const uint8_t aad[] = {
+		0x83, 0x68, 'E', 'n', 'c', 'r', 'y', 'p', 't', '0', 0x40, 0x48,
+		0x85, 0x01, 0x81, 0x0a, 0x40, 0x41, request_piv, 0x40,
+	};
+	uint8_t plaintext[64] = { 0x45, 0xff };
+	size_t plaintext_len = 2 + strlen(payload);
+	uint8_t nonce[sizeof(common_iv)] = { 0 };
+	EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+	size_t len = 0;
+	int n;
+
+	memcpy(&plaintext[2], payload, strlen(payload));
+
+	/* Nonce of the server's sender ID and the Partial IV. */
+	nonce[0] = 1;
+	nonce[7] = SERVER_SENDER_ID;
+	nonce[12] = piv;
+	for (int i = 0; i < sizeof(nonce); i++) {
+		nonce[i] ^= common_iv[i];
+	}
+
+	/* NON 2.04, token 0x4a, Observe: piv, OSCORE: piv without kid. */
+	buf[len++] = 0x51;
+	buf[len++] = 0x44;
+	buf[len++] = 0x56;
+	buf[len++] = piv;
+	buf[len++] = 0x4a;
+	buf[len++] = 0x61;
+	buf[len++] = piv;
+	buf[len++] = 0x32;
+	buf[len++] = 0x01;
+	buf[len++] = piv;
+	buf[len++] = 0xff;
+
+	zassert_equal(EVP_EncryptInit_ex(ctx, EVP_aes_128_ccm(), NULL, NULL, NULL), 1);
+	zassert_equal(EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_IVLEN, sizeof(nonce), NULL), 1);
+	zassert_equal(EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, 8, NULL), 1);
+	zassert_equal(EVP_EncryptInit_ex(ctx, NULL, NULL, server_sender_key, nonce), 1);
+	zassert_equal(EVP_EncryptUpdate(ctx, NULL, &n, NULL, plaintext_len), 1);
+	zassert_equal(EVP_EncryptUpdate(ctx, NULL, &n, aad, sizeof(aad)), 1);
+	zassert_equal(EVP_EncryptUpdate(ctx, &buf[len], &n, plaintext, plaintext_len), 1);
+	len += n;
+	zassert_equal(EVP_EncryptFinal_ex(ctx, &buf[len], &n), 1);
+	zassert_equal(EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, 8, &buf[len]), 1);
+	len += 8;
+	EVP_CIPHER_CTX_free(ctx);
+
+	return len;
+}
+
+static void before(void *fixture)
+{
+	/* The sequence number of test vector 4. */
+	uint64_t ssn = 20;
+
+	host_storage_erase();
+	zassert_ok(storage_write(STORAGE_ID_OSCORE_SSN, &ssn, sizeof(ssn)));
+	zassert_ok(oscore_init());
+}
+
+ZTEST(oscore, test_protect_request)
+{
+	zassert_ok(oscore_protect(tv4_request, sizeof(tv4_request), out, sizeof(out), &out_len));
+	zassert_equal(out_len, sizeof(tv4_protected));
+	zassert_mem_equal(out, tv4_protected, sizeof(tv4_protected));
+}
+
+ZTEST(oscore, test_unprotect_response)
+{
+	zassert_ok(oscore_protect(tv4_request, sizeof(tv4_request), out, sizeof(out), &out_len));
+	zassert_ok(oscore_unprotect(tv7_protected, sizeof(tv7_protected), out, sizeof(out),
+				    &out_len));
+	zassert_equal(out_len, sizeof(tv7_response));
+	zassert_mem_equal(out, tv7_response, sizeof(tv7_response));
+}
+
+ZTEST(oscore, test_unprotect_response_with_partial_iv)
+{
+	zassert_ok(oscore_protect(tv4_request, sizeof(tv4_request), out, sizeof(out), &out_len));
+	zassert_ok(oscore_unprotect(tv8_protected, sizeof(tv8_protected), out, sizeof(out),
+				    &out_len));
+	zassert_equal(out_len, sizeof(tv7_response));
+	zassert_mem_equal(out, tv7_response, sizeof(tv7_response));
+
+	/* Only one response is accepted. */
+	zassert_equal(oscore_unprotect(tv8_protected, sizeof(tv8_protected), out, sizeof(out),
+				       &out_len), -EBADMSG);
+}
+
+ZTEST(oscore, test_replayed_response)
+{
+	zassert_ok(oscore_protect(tv4_request, sizeof(tv4_request), out, sizeof(out), &out_len));
+	zassert_ok(oscore_unprotect(tv7_protected, sizeof(tv7_protected), out, sizeof(out),
+				    &out_len));
+	zassert_equal(oscore_unprotect(tv7_protected, sizeof(tv7_protected), out, sizeof(out),
+				       &out_len), -EBADMSG);
+}
+
+ZTEST(oscore, test_tampered_response)
+{
+	uint8_t tampered[sizeof(tv7_protected)];
+	struct oscore_stats before;
+	struct oscore_stats after;
+
+	memcpy(tampered, tv7_protected, sizeof(tampered));
+	tampered[sizeof(tampered) - 1] ^= 0x01;
+
+	oscore_stats_get(&before);
+	zassert_ok(oscore_protect(tv4_request, sizeof(tv4_request), out, sizeof(out), &out_len));
+	zassert_equal(oscore_unprotect(tampered, sizeof(tampered), out, sizeof(out), &out_len),
+		      -EBADMSG);
+	oscore_stats_get(&after);
+	zassert_equal(after.rejected - before.rejected, 1);
+
+	/* The request is still waiting for the real response. */
+	zassert_ok(oscore_unprotect(tv7_protected, sizeof(tv7_protected), out, sizeof(out),
+				    &out_len));
+}
+
+ZTEST(oscore, test_unprotected_message)
+{
+	zassert_equal(oscore_unprotect(tv7_response, sizeof(tv7_response), out, sizeof(out),
+				       &out_len), -ENOENT);
+}
+
+ZTEST(oscore, test_sequence_number_after_reboot)
+{
+	zassert_ok(oscore_protect(tv4_request, sizeof(tv4_request), out, sizeof(out), &out_len));
+
+	/* The numbers reserved before the reboot are skipped, 20 + 64. */
+	zassert_ok(oscore_init());
+	zassert_ok(oscore_protect(tv4_request, sizeof(tv4_request), out, sizeof(out), &out_len));
+	zassert_equal(out[18], 0x62, "OSCORE option with a 2 byte value");
+	zassert_equal(out[19], 0x09);
+	zassert_equal(out[20], 84);
+}
+
+ZTEST(oscore, test_notifications)
+{
+	uint8_t notification[64];
+	size_t len;
+
+	zassert_ok(oscore_protect(observe_request, sizeof(observe_request), out, sizeof(out),
+				  &out_len));
+	/* The outer code is FETCH, with Observe and OSCORE options. */
+	zassert_equal(out[1], 0x05);
+	zassert_equal(out[5], 0x60);
+	zassert_equal(out[6], 0x32);
+	zassert_equal(out[7], 0x09);
+	zassert_equal(out[8], 20);
+
+	len = notification_build(notification, 20, 5, "first");
+	zassert_ok(oscore_unprotect(notification, len, out, sizeof(out), &out_len));
+	/* The inner code, the outer Observe and the payload. */
+	zassert_equal(out[1], 0x45);
+	zassert_equal(out[5], 0x61);
+	zassert_equal(out[6], 5);
+	zassert_mem_equal(&out[8], "first", 5);
+
+	/* A replayed and an older notification are rejected. */
+	zassert_equal(oscore_unprotect(notification, len, out, sizeof(out), &out_len), -EBADMSG);
+	len = notification_build(notification, 20, 4, "older");
+	zassert_equal(oscore_unprotect(notification, len, out, sizeof(out), &out_len), -EBADMSG);
+
+	len = notification_build(notification, 20, 6, "second");
+	zassert_ok(oscore_unprotect(notification, len, out, sizeof(out), &out_len));
+	zassert_mem_equal(&out[8], "second", 6);
+
+	/* Notifications bound to another registration fail verification. */
+	len = notification_build(notification, 19, 7, "other");
+	zassert_equal(oscore_unprotect(notification, len, out, sizeof(out), &out_len), -EBADMSG);
+}
+
+ZTEST_SUITE(oscore, NULL, NULL, before, NULL, NULL);
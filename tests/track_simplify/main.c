@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <math.h>
+
+#include <ztest.h>
+#include <host_storage.h>
+#include <zephyr/kernel.h>
+
+#include "cloud/track_simplify.h"
+#include "host_track.h"
+
+#define EARTH_RADIUS_M 6371000.0
+#define DEG_TO_RAD (M_PI / 180.0)
+
+static struct cloud_location_data kept[HOST_TRACK_LEN];
+static size_t kept_len;
+
+static void push(const struct cloud_location_data *fix)
+{
+	kept_len += track_simplify_push(fix, &kept[kept_len]);
+}
+
+static void flush(void)
+{
+	kept_len += track_simplify_flush(&kept[kept_len]);
+}
+
+static bool stopped(const struct cloud_location_data *fix)
+{
+	return fix->pvt.speed * 100.0f < CONFIG_TRACK_SIMPLIFY_STOP_SPEED;
+}
+
+/**@brief Distance of a fix from the line between two kept fixes, as the
+ *	  simplification measures it.
+ */
+static double line_distance(const struct cloud_location_data *a,
+			    const struct cloud_location_data *b,
+			    const struct cloud_location_data *p)
+{
+	double scale = DEG_TO_RAD * EARTH_RADIUS_M;
+	double cos_lat = cos(a->pvt.latitude * DEG_TO_RAD);
+	double ex = (b->pvt.longitude - a->pvt.longitude) * scale * cos_lat;
+	double ey = (b->pvt.latitude - a->pvt.latitude) * scale;
+	double px = (p->pvt.longitude - a->pvt.longitude) * scale * cos_lat;
+	double py = (p->pvt.latitude - a->pvt.latitude) * scale;
+	double length = sqrt(ex * ex + ey * ey);
+
+	return length < 1.0 ? sqrt(px * px + py * py) : fabs(ex * py - ey * px) / length;
+}
+
+/**@brief Largest and mean distance of the fixes from the simplified track. */
+static void track_error(const struct cloud_location_data *fixes, size_t count,
+			double *max, double *mean)
+{
+	size_t k = 0;
+	double sum = 0.0;
+
+	*max = 0.0;
+
+	for (size_t i = 0; i < count; i++) {
+		double error;
+
+		while (k + 1 < kept_len && kept[k + 1].gnss_ts <= fixes[i].gnss_ts) {
+			k++;
+		}
+
+		if (kept[k].gnss_ts == fixes[i].gnss_ts || k + 1 == kept_len) {
+			continue;
+		}
+
+		error = line_distance(&kept[k], &kept[k + 1], &fixes[i]);
+		*max = MAX(*max, error);
+		sum += error;
+	}
+
+	*mean = sum / count;
+}
+
+static void before(void *fixture)
+{
+	struct cloud_location_data unused;
+
+	host_storage_erase();
+	zassert_equal(track_simplify_restore(&unused), 0);
+	kept_len = 0;
+}
+
+ZTEST(track_simplify, test_reference_track)
+{
+	const struct cloud_location_data *track = host_track_get();
+	struct track_simplify_stats stats;
+	double max;
+	double mean;
+
+	for (int i = 0; i < HOST_TRACK_LEN; i++) {
+		push(&track[i]);
+	}
+	flush();
+
+	track_error(track, HOST_TRACK_LEN, &max, &mean);
+	track_simplify_stats_get(&stats);
+
+	TC_PRINT("%d fixes in, %zu kept (%.0f%%), error %.1f m max, %.1f m mean, "
+		 "tolerance %d m, %.2f us per fix\n", HOST_TRACK_LEN, kept_len,
+		 100.0 * kept_len / HOST_TRACK_LEN, max, mean, CONFIG_TRACK_SIMPLIFY_TOLERANCE,
+		 (double)k_cyc_to_us_floor64(stats.cycles) / stats.points);
+
+	zassert_true(kept_len < HOST_TRACK_LEN / 2, "%zu fixes kept", kept_len);
+	zassert_true(max <= CONFIG_TRACK_SIMPLIFY_TOLERANCE, "error %.1f m", max);
+	zassert_equal(kept[0].gnss_ts, track[0].gnss_ts, "first fix kept");
+	zassert_equal(kept[kept_len - 1].gnss_ts, track[HOST_TRACK_LEN - 1].gnss_ts,
+		      "last fix kept by the flush");
+}
+
+ZTEST(track_simplify, test_stops_and_departures_kept)
+{
+	const struct cloud_location_data *track = host_track_get();
+	size_t k = 0;
+
+	for (int i = 0; i < HOST_TRACK_LEN; i++) {
+		push(&track[i]);
+	}
+
+	for (int i = 1; i < HOST_TRACK_LEN; i++) {
+		if (stopped(&track[i]) == stopped(&track[i - 1])) {
+			continue;
+		}
+
+		while (k < kept_len && kept[k].gnss_ts < track[i].gnss_ts) {
+			k++;
+		}
+		zassert_true(k > 0 && k < kept_len);
+		zassert_equal(kept[k].gnss_ts, track[i].gnss_ts, "fix %d kept", i);
+		zassert_equal(kept[k - 1].gnss_ts, track[i - 1].gnss_ts, "fix %d kept", i - 1);
+	}
+}
+
+ZTEST(track_simplify, test_window_bounded)
+{
+	struct cloud_location_data fix = { .pvt = { .latitude = 65.0, .longitude = 25.0,
+						    .speed = 10.0f } };
+
+	/* On a straight line no fix is needed, the window still has an end. */
+	for (int i = 0; i < 4 * CONFIG_TRACK_SIMPLIFY_WINDOW; i++) {
+		fix.pvt.latitude += 0.001;
+		fix.gnss_ts += 30000;
+		push(&fix);
+		zassert_true(track_simplify_pending() <= CONFIG_TRACK_SIMPLIFY_WINDOW);
+	}
+
+	zassert_equal(kept_len, 1 + 3);
+}
+
+ZTEST(track_simplify, test_end_of_track_after_reboot)
+{
+	const struct cloud_location_data *track = host_track_get();
+	static struct cloud_location_data expected[HOST_TRACK_LEN];
+	size_t expected_len;
+	struct cloud_location_data restored;
+	int reboot = 100;
+
+	/* Without the reboot, a flush keeps the end of the track. */
+	for (int i = 0; i < HOST_TRACK_LEN; i++) {
+		if (i == reboot) {
+			zassert_true(track_simplify_pending() > 0, "fixes held back");
+			flush();
+		}
+		push(&track[i]);
+	}
+	flush();
+	memcpy(expected, kept, sizeof(kept));
+	expected_len = kept_len;
+
+	/* The same track, with a reboot. The restored fix is the anchor of the
+	 * rest of the track.
+	 */
+	before(NULL);
+	for (int i = 0; i < HOST_TRACK_LEN; i++) {
+		if (i == reboot) {
+			zassert_equal(track_simplify_restore(&restored), 1);
+			zassert_equal(track_simplify_pending(), 0);
+			kept[kept_len++] = restored;
+		}
+		push(&track[i]);
+	}
+	flush();
+
+	zassert_equal(kept_len, expected_len);
+	zassert_mem_equal(kept, expected, kept_len * sizeof(kept[0]));
+
+	/* Nothing is restored after a flush. */
+	zassert_equal(track_simplify_restore(&restored), 0);
+}
+
+ZTEST(track_simplify, test_one_write_per_fix)
+{
+	const struct cloud_location_data *track = host_track_get();
+	struct host_storage_stats before_stats;
+	struct host_storage_stats after_stats;
+
+	host_storage_stats_get(&before_stats);
+	for (int i = 0; i < HOST_TRACK_LEN; i++) {
+		push(&track[i]);
+	}
+	host_storage_stats_get(&after_stats);
+
+	zassert_true(after_stats.writes - before_stats.writes <= HOST_TRACK_LEN);
+}
+
+ZTEST_SUITE(track_simplify, NULL, NULL, before, NULL, NULL);
@@ -0,0 +1,274 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2021 Nordic Semiconductor
+#
+# SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+#
+
+"""Local stand-in for the A-GNSS and cellular positioning resources of the
+CoAP server, for testing CONFIG_CLOUD_AGNSS without the real server.
+
+The server speaks plain CoAP over UDP, without DTLS or OSCORE. It answers
+FETCH requests to the "agnss" resource with canned A-GNSS data in the nRF
+Cloud A-GNSS binary format, block-wise (RFC 7959), and FETCH requests to the
+"cellpos" resource with a fixed location. The request formats are described
+in src/cloud/assistance.h.
+
+By default the A-GNSS data is synthetic: a coarse location and ephemerides of
+all GPS satellites marked unhealthy, so that the transfer has a realistic
+size but GNSS does not use the satellite data. Serve real data captured from
+nRF Cloud with --agnss-file.
+
+    python3 tools/assistance_server.py --port 5683 --lat 65.0121 --lon 25.4651
+"""
+
+import argparse
+import socket
+import struct
+
+COAP_VERSION = 1
+TYPE_CON, TYPE_NON, TYPE_ACK, TYPE_RST = range(4)
+
+METHOD_FETCH = 5
+CODE_CONTENT = (2 << 5) | 5
+CODE_BAD_REQUEST = (4 << 5) | 0
+CODE_NOT_FOUND = (4 << 5) | 4
+CODE_METHOD_NOT_ALLOWED = (4 << 5) | 5
+
+OPTION_URI_PATH = 11
+OPTION_CONTENT_FORMAT = 12
+OPTION_BLOCK2 = 23
+OPTION_SIZE2 = 28
+
+CONTENT_FORMAT_OCTET_STREAM = 42
+
+ASSISTANCE_VERSION = 1
+
+# nRF Cloud A-GNSS binary format, schema version 1.
+AGNSS_SCHEMA_VERSION = 1
+AGNSS_TYPE_EPHEMERIDES = 2
+AGNSS_TYPE_LOCATION = 8
+
+# sv_id, health, iodc, toc, af2, af1, af0, tgd, ura, fit_int, toe, w,
+# delta_n, m0, omega_dot, e, idot, sqrt_a, i0, omega0, crs, cis, cus, crc,
+# cic, cuc
+EPHEMERIS = struct.Struct("<BBHHbhibBBHihiiIhIiihhhhhh")
+# latitude, longitude, altitude, unc_semimajor, unc_semiminor,
+# orientation_major, unc_altitude, confidence
+LOCATION = struct.Struct("<iihBBBBB")
+
+
+def agnss_element(element_type, items):
+    return struct.pack("<BH", element_type, len(items)) + b"".join(items)
+
+
+def synthetic_agnss(lat, lon):
+    """Canned A-GNSS data, see the module documentation."""
+    # The coordinates are scaled as in the GNSS API of the modem.
+    location = LOCATION.pack(int(lat / 90.0 * (1 << 23)), int(lon / 360.0 * (1 << 24)),
+                             0, 127, 127, 0, 255, 68)
+    ephemerides = [EPHEMERIS.pack(sv_id, 0x3f, 0, 0, 0, 0, 0, 0, 15, 0, 0, 0, 0, 0, 0,
+                                  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0)
+                   for sv_id in range(1, 33)]
+
+    return (bytes([AGNSS_SCHEMA_VERSION]) +
+            agnss_element(AGNSS_TYPE_LOCATION, [location]) +
+            agnss_element(AGNSS_TYPE_EPHEMERIDES, ephemerides))
+
+
+def parse(datagram):
+    """Parse a CoAP message into its header fields, options and payload."""
+    if len(datagram) < 4:
+        raise ValueError("short message")
+
+    first, code, mid = struct.unpack_from("!BBH", datagram)
+    if first >> 6 != COAP_VERSION:
+        raise ValueError("unknown version")
+
+    msg_type = (first >> 4) & 0x03
+    tkl = first & 0x0f
+    token = datagram[4:4 + tkl]
+    pos = 4 + tkl
+    options = []
+    number = 0
+
+    while pos < len(datagram):
+        if datagram[pos] == 0xff:
+            pos += 1
+            break
+
+        delta = datagram[pos] >> 4
+        length = datagram[pos] & 0x0f
+        pos += 1
+
+        values = []
+        for nibble in (delta, length):
+            if nibble == 13:
+                values.append(datagram[pos] + 13)
+                pos += 1
+            elif nibble == 14:
+                values.append(struct.unpack_from("!H", datagram, pos)[0] + 269)
+                pos += 2
+            elif nibble == 15:
+                raise ValueError("reserved option nibble")
+            else:
+                values.append(nibble)
+
+        number += values[0]
+        options.append((number, datagram[pos:pos + values[1]]))
+        pos += values[1]
+
+    return msg_type, code, mid, token, options, datagram[pos:]
+
+
+def option_uint(value):
+    return int.from_bytes(value, "big") if value else 0
+
+
+def encode_uint(value):
+    return value.to_bytes((value.bit_length() + 7) // 8, "big") if value else b""
+
+
+def option_nibble(value):
+    if value < 13:
+        return value, b""
+    if value < 269:
+        return 13, bytes([value - 13])
+    return 14, struct.pack("!H", value - 269)
+
+
+def build(msg_type, code, mid, token, options, payload=b""):
+    """Build a CoAP message, the options must be sorted by number."""
+    out = bytearray([(COAP_VERSION << 6) | (msg_type << 4) | len(token), code])
+    out += struct.pack("!H", mid) + token
+    number = 0
+
+    for option, value in options:
+        delta, delta_ext = option_nibble(option - number)
+        length, length_ext = option_nibble(len(value))
+        out.append((delta << 4) | length)
+        out += delta_ext + length_ext + value
+        number = option
+
+    if payload:
+        out += b"\xff" + payload
+
+    return bytes(out)
+
+
+class Server:
+    def __init__(self, args):
+        self.args = args
+        if args.agnss_file:
+            with open(args.agnss_file, "rb") as f:
+                self.agnss = f.read()
+        else:
+            self.agnss = synthetic_agnss(args.lat, args.lon)
+        self.mid = 0
+
+    def agnss_request(self, payload):
+        if len(payload) < 6 or payload[0] != ASSISTANCE_VERSION:
+            return None
+
+        flags, count = struct.unpack_from("<IB", payload, 1)
+        systems = []
+        for i in range(count):
+            system_id, ephe, alm = struct.unpack_from("<BQQ", payload, 6 + i * 17)
+            systems.append(f"system {system_id} ephe 0x{ephe:x} alm 0x{alm:x}")
+
+        print(f"A-GNSS request: flags 0x{flags:x}, " + ", ".join(systems))
+
+        return self.agnss
+
+    def cellpos_request(self, payload):
+        if len(payload) < 26 or payload[0] != ASSISTANCE_VERSION:
+            return None
+
+        mcc, mnc, tac, cell_id, earfcn, pci, rsrp, rsrq, ta, count = \
+            struct.unpack_from("<HHIIIHhhHB", payload, 1)
+        print(f"Cell request: {mcc}-{mnc} tac {tac} cell {cell_id} earfcn {earfcn} "
+              f"pci {pci} rsrp {rsrp} rsrq {rsrq} ta {ta}, {count} neighbor cells")
+
+        return struct.pack("<BiiI", ASSISTANCE_VERSION, round(self.args.lat * 1e7),
+                           round(self.args.lon * 1e7), self.args.accuracy)
+
+    def handle(self, datagram):
+        msg_type, code, mid, token, options, payload = parse(datagram)
+
+        if msg_type not in (TYPE_CON, TYPE_NON) or code == 0:
+            return None
+
+        path = "/".join(v.decode() for n, v in options if n == OPTION_URI_PATH)
+        block2 = next((option_uint(v) for n, v in options if n == OPTION_BLOCK2), None)
+        reply_type = TYPE_ACK if msg_type == TYPE_CON else TYPE_NON
+        if reply_type == TYPE_NON:
+            self.mid = (self.mid + 1) & 0xffff
+            mid = self.mid
+
+        handlers = {
+            "agnss": self.agnss_request,
+            "cellpos": self.cellpos_request,
+        }
+
+        if path not in handlers:
+            return build(reply_type, CODE_NOT_FOUND, mid, token, [])
+        if code != METHOD_FETCH:
+            return build(reply_type, CODE_METHOD_NOT_ALLOWED, mid, token, [])
+
+        body = handlers[path](payload)
+        if body is None:
+            return build(reply_type, CODE_BAD_REQUEST, mid, token, [])
+
+        reply_options = [(OPTION_CONTENT_FORMAT, encode_uint(CONTENT_FORMAT_OCTET_STREAM))]
+
+        szx = min(block2 & 0x07 if block2 is not None else 6, self.args.szx)
+        size = 1 << (szx + 4)
+        if block2 is not None or len(body) > size:
+            num = (block2 >> 4) if block2 is not None else 0
+            # A smaller block size than requested keeps the same offset.
+            if block2 is not None and (block2 & 0x07) > szx:
+                num <<= (block2 & 0x07) - szx
+            chunk = body[num * size:(num + 1) * size]
+            more = (num + 1) * size < len(body)
+            reply_options.append((OPTION_BLOCK2, encode_uint((num << 4) | (more << 3) | szx)))
+            if num == 0:
+                reply_options.append((OPTION_SIZE2, encode_uint(len(body))))
+            print(f"  block {num}, {len(chunk)} of {len(body)} bytes")
+            body = chunk
+
+        return build(reply_type, CODE_CONTENT, mid, token, reply_options, body)
+
+    def serve(self):
+        sock = socket.socket(socket.AF_INET6, socket.SOCK_DGRAM)
+        sock.setsockopt(socket.IPPROTO_IPV6, socket.IPV6_V6ONLY, 0)
+        sock.bind(("::", self.args.port))
+        print(f"Listening on UDP port {self.args.port}, {len(self.agnss)} bytes of A-GNSS data")
+
+        while True:
+            datagram, peer = sock.recvfrom(2048)
+            try:
+                reply = self.handle(datagram)
+            except (ValueError, struct.error) as e:
+                print(f"Malformed message from {peer[0]}: {e}")
+                continue
+            if reply:
+                sock.sendto(reply, peer)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--port", type=int, default=5683)
+    parser.add_argument("--agnss-file", help="A-GNSS data in the nRF Cloud binary format")
+    parser.add_argument("--lat", type=float, default=65.0121,
+                        help="latitude of the cell location and the A-GNSS location")
+    parser.add_argument("--lon", type=float, default=25.4651,
+                        help="longitude of the cell location and the A-GNSS location")
+    parser.add_argument("--accuracy", type=int, default=1000,
+                        help="accuracy of the cell location in meters")
+    parser.add_argument("--szx", type=int, default=5, choices=range(7),
+                        help="largest block size exponent, blocks of 2^(szx + 4) bytes")
+    Server(parser.parse_args()).serve()
+
+
+if __name__ == "__main__":
+    main()
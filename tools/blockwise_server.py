@@ -0,0 +1,202 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2021 Nordic Semiconductor
+#
+# SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+#
+
+"""Local stand-in of a CoAP server for block-wise transfers (RFC 7959).
+
+The server speaks plain CoAP over UDP, without DTLS or OSCORE. POST and PUT
+requests to any resource are reassembled from their Block1 blocks and
+answered with 2.31 Continue until the last block, then with 2.04 Changed. GET
+requests are answered with a generated document of --download-size bytes,
+block-wise if it does not fit in a block. Blocks larger than --szx are
+negotiated down, and uploads larger than --max-size are rejected with 4.13
+Request Entity Too Large, from the Size1 option of the first block.
+
+Point the device to it with CONFIG_COAP_SERVER_IP, and the uploads of
+the fixes and the diagnostics, and the device config, go through it:
+
+    python3 tools/blockwise_server.py --port 5683 --szx 2 --download-size 4096
+"""
+
+import argparse
+import socket
+import struct
+
+from assistance_server import (TYPE_CON, TYPE_NON, TYPE_ACK, build, encode_uint, option_uint,
+                               parse)
+
+METHOD_GET = 1
+METHOD_POST = 2
+METHOD_PUT = 3
+CODE_CHANGED = (2 << 5) | 4
+CODE_CONTENT = (2 << 5) | 5
+CODE_CONTINUE = (2 << 5) | 31
+CODE_BAD_REQUEST = (4 << 5) | 0
+CODE_METHOD_NOT_ALLOWED = (4 << 5) | 5
+CODE_REQUEST_ENTITY_INCOMPLETE = (4 << 5) | 8
+CODE_REQUEST_ENTITY_TOO_LARGE = (4 << 5) | 13
+
+OPTION_URI_PATH = 11
+OPTION_CONTENT_FORMAT = 12
+OPTION_BLOCK2 = 23
+OPTION_BLOCK1 = 27
+OPTION_SIZE2 = 28
+OPTION_SIZE1 = 60
+
+CONTENT_FORMAT_TEXT_PLAIN = 0
+
+
+def block_value(num, more, szx):
+    return (num << 4) | (more << 3) | szx
+
+
+def block_fields(value):
+    """Block number, more flag and size exponent of a Block1 or Block2 option."""
+    return value >> 4, bool(value & 0x08), value & 0x07
+
+
+def document(size):
+    """Generated download, a text that shows where a block went missing."""
+    text = b"".join(b"%07d\n" % i for i in range(0, size, 8))
+    return text[:size]
+
+
+class Server:
+    def __init__(self, szx=6, max_size=1 << 20, download_size=4096, log=print):
+        self.szx = szx
+        self.max_size = max_size
+        self.download = document(download_size)
+        self.log = log
+        self.mid = 0
+        # Uploads being reassembled, by peer and resource.
+        self.uploads = {}
+        # Completed uploads, by peer and resource.
+        self.received = {}
+        # Last reply to each peer, sent again for a retransmitted request.
+        self.replies = {}
+
+    def upload_block(self, key, code, options, payload):
+        block1 = next((option_uint(v) for n, v in options if n == OPTION_BLOCK1), None)
+        size1 = next((option_uint(v) for n, v in options if n == OPTION_SIZE1), None)
+
+        if block1 is None:
+            self.received[key] = payload
+            self.log(f"Upload to {key[1]}, {len(payload)} bytes")
+            return CODE_CHANGED, []
+
+        num, more, szx = block_fields(block1)
+        offset = num << (szx + 4)
+
+        if offset == 0:
+            if size1 is not None and size1 > self.max_size:
+                self.log(f"Upload to {key[1]} of {size1} bytes too large")
+                return CODE_REQUEST_ENTITY_TOO_LARGE, [(OPTION_SIZE1, encode_uint(self.max_size))]
+            self.uploads[key] = bytearray()
+
+        upload = self.uploads.get(key)
+        if upload is None or offset != len(upload) or (more and len(payload) != 1 << (szx + 4)):
+            self.log(f"Upload to {key[1]}: unexpected block {num} at offset {offset}")
+            self.uploads.pop(key, None)
+            return CODE_REQUEST_ENTITY_INCOMPLETE, []
+
+        upload += payload
+        if len(upload) > self.max_size:
+            self.uploads.pop(key)
+            return CODE_REQUEST_ENTITY_TOO_LARGE, [(OPTION_SIZE1, encode_uint(self.max_size))]
+
+        if more:
+            # A smaller block size applies from the next block on.
+            reply_szx = min(szx, self.szx)
+            return CODE_CONTINUE, [(OPTION_BLOCK1, encode_uint(block_value(num, True, reply_szx)))]
+
+        self.received[key] = bytes(self.uploads.pop(key))
+        self.log(f"Upload to {key[1]}, {len(upload)} bytes in {num + 1} blocks of {1 << (szx + 4)} bytes")
+        return CODE_CHANGED, [(OPTION_BLOCK1, encode_uint(block_value(num, False, szx)))]
+
+    def download_block(self, options):
+        block2 = next((option_uint(v) for n, v in options if n == OPTION_BLOCK2), None)
+        body = self.download
+        reply_options = [(OPTION_CONTENT_FORMAT, encode_uint(CONTENT_FORMAT_TEXT_PLAIN))]
+
+        szx = min(block2 & 0x07 if block2 is not None else 6, self.szx)
+        size = 1 << (szx + 4)
+        if block2 is None and len(body) <= size:
+            return CODE_CONTENT, reply_options, body
+
+        num = (block2 >> 4) if block2 is not None else 0
+        # A smaller block size than requested keeps the same offset.
+        if block2 is not None and (block2 & 0x07) > szx:
+            num <<= (block2 & 0x07) - szx
+        more = (num + 1) * size < len(body)
+        reply_options.append((OPTION_BLOCK2, encode_uint(block_value(num, more, szx))))
+        if num == 0:
+            reply_options.append((OPTION_SIZE2, encode_uint(len(body))))
+
+        return CODE_CONTENT, reply_options, body[num * size:(num + 1) * size]
+
+    def handle(self, datagram, peer):
+        msg_type, code, mid, token, options, payload = parse(datagram)
+
+        if msg_type not in (TYPE_CON, TYPE_NON) or code == 0:
+            return None
+
+        if msg_type == TYPE_CON and self.replies.get(peer, (None,))[0] == mid:
+            return self.replies[peer][1]
+
+        path = "/".join(v.decode() for n, v in options if n == OPTION_URI_PATH)
+        reply_type = TYPE_ACK if msg_type == TYPE_CON else TYPE_NON
+        reply_mid = mid
+        if reply_type == TYPE_NON:
+            self.mid = (self.mid + 1) & 0xffff
+            reply_mid = self.mid
+
+        body = b""
+        if code in (METHOD_POST, METHOD_PUT):
+            reply_code, reply_options = self.upload_block((peer, path), code, options, payload)
+        elif code == METHOD_GET:
+            reply_code, reply_options, body = self.download_block(options)
+        else:
+            reply_code, reply_options = CODE_METHOD_NOT_ALLOWED, []
+
+        reply = build(reply_type, reply_code, reply_mid, token, sorted(reply_options), body)
+        if msg_type == TYPE_CON:
+            self.replies[peer] = (mid, reply)
+
+        return reply
+
+    def serve(self, sock):
+        while True:
+            datagram, peer = sock.recvfrom(2048)
+            try:
+                reply = self.handle(datagram, peer)
+            except (ValueError, struct.error) as e:
+                self.log(f"Malformed message from {peer[0]}: {e}")
+                continue
+            if reply:
+                sock.sendto(reply, peer)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--port", type=int, default=5683)
+    parser.add_argument("--szx", type=int, default=6, choices=range(7),
+                        help="largest block size exponent, blocks of 2^(szx + 4) bytes")
+    parser.add_argument("--max-size", type=int, default=1 << 20,
+                        help="largest upload in bytes")
+    parser.add_argument("--download-size", type=int, default=4096,
+                        help="size of the document served to GET requests")
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET6, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.IPPROTO_IPV6, socket.IPV6_V6ONLY, 0)
+    sock.bind(("::", args.port))
+    print(f"Listening on UDP port {args.port}, blocks of up to {1 << (args.szx + 4)} bytes")
+
+    Server(args.szx, args.max_size, args.download_size).serve(sock)
+
+
+if __name__ == "__main__":
+    main()
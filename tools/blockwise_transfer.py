@@ -0,0 +1,210 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2021 Nordic Semiconductor
+#
+# SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+#
+
+"""Smoke test of the stand-in of tools/blockwise_server.py.
+
+Uploads and downloads payloads of 4, 16 and 64 KB in blocks of 16, 64 and
+512 bytes with a Python client: Block1 uploads with Size1 in the first
+block and the block size lowered when the server asks for smaller blocks,
+and Block2 downloads continuing at the offset of the received bytes. Each
+transfer is checked byte for byte, and the blocks and bytes on the air are
+printed per block size. The link can be made lossy with --loss, lost
+datagrams are retransmitted.
+
+Only the server is tested here, the client is a Python model and not the
+device code. The Block1 and Block2 handling of the device, in
+src/cloud/blockwise.c, is tested by the blockwise host test.
+
+The server is started in the same process. Exits with 1 if a transfer
+failed.
+
+    python3 tools/blockwise_transfer.py --loss 10
+"""
+
+import argparse
+import random
+import socket
+import sys
+import threading
+
+from assistance_server import TYPE_CON, build, encode_uint, option_uint, parse
+from blockwise_server import (CODE_CHANGED, CODE_CONTENT, CODE_CONTINUE,
+                              CODE_REQUEST_ENTITY_TOO_LARGE, METHOD_GET, METHOD_POST,
+                              OPTION_BLOCK1, OPTION_BLOCK2, OPTION_SIZE1, OPTION_URI_PATH,
+                              Server, block_fields, block_value, document)
+
+SIZES = (4096, 16384, 65536)
+BLOCK_SIZES = (16, 64, 512)
+
+
+class Client:
+    def __init__(self, address, loss, retransmit_timeout=0.005, max_retransmit=8):
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.connect(address)
+        self.loss = loss
+        self.rand = random.Random(1)
+        self.timeout = retransmit_timeout
+        self.max_retransmit = max_retransmit
+        self.mid = 0
+        self.token = 0
+        self.reset_stats()
+
+    def reset_stats(self):
+        self.requests = 0
+        self.datagrams = 0
+        self.bytes = 0
+
+    def lost(self):
+        return self.rand.randrange(100) < self.loss
+
+    def request(self, code, path, options, payload=b""):
+        """Confirmable request, retransmitted until the piggybacked response."""
+        self.mid = (self.mid + 1) & 0xffff
+        self.token += 1
+        token = self.token.to_bytes(4, "big")
+        options = sorted([(OPTION_URI_PATH, path.encode())] + options)
+        datagram = build(TYPE_CON, code, self.mid, token, options, payload)
+        self.requests += 1
+
+        for _ in range(self.max_retransmit + 1):
+            self.datagrams += 1
+            self.bytes += len(datagram)
+            if not self.lost():
+                self.sock.send(datagram)
+
+            self.sock.settimeout(self.timeout)
+            try:
+                while True:
+                    reply = self.sock.recv(2048)
+                    if self.lost():
+                        continue
+                    _, reply_code, mid, reply_token, reply_options, reply_payload = parse(reply)
+                    if mid == self.mid and reply_token == token:
+                        self.datagrams += 1
+                        self.bytes += len(reply)
+                        return reply_code, reply_options, reply_payload
+            except socket.timeout:
+                continue
+
+        raise TimeoutError(f"no response to message 0x{self.mid:04x}")
+
+    def upload(self, path, payload, block_size):
+        """Block1 upload as client_send_blockwise() of the cloud module."""
+        szx = block_size.bit_length() - 5
+        offset = 0
+
+        while True:
+            block_len = min(1 << (szx + 4), len(payload) - offset)
+            more = offset + block_len < len(payload)
+            options = [(OPTION_BLOCK1, encode_uint(block_value(offset >> (szx + 4), more, szx)))]
+            if offset == 0:
+                options.append((OPTION_SIZE1, encode_uint(len(payload))))
+
+            code, reply_options, _ = self.request(METHOD_POST, path, options,
+                                                  payload[offset:offset + block_len])
+            if code != CODE_CONTINUE:
+                return code
+
+            offset += block_len
+            block1 = next((option_uint(v) for n, v in reply_options if n == OPTION_BLOCK1), None)
+            if block1 is not None and block1 & 0x07 < szx:
+                szx = block1 & 0x07
+
+    def download(self, path, block_size):
+        """Block2 download as block2_append() of the cloud module."""
+        szx = block_size.bit_length() - 5
+        body = bytearray()
+        num = 0
+
+        while True:
+            options = [(OPTION_BLOCK2, encode_uint(block_value(num, False, szx)))]
+            code, reply_options, payload = self.request(METHOD_GET, path, options)
+            if code != CODE_CONTENT:
+                raise ValueError(f"download failed, code {code >> 5}.{code & 0x1f:02d}")
+
+            block2 = next((option_uint(v) for n, v in reply_options if n == OPTION_BLOCK2), None)
+            if block2 is None:
+                return bytes(payload)
+
+            reply_num, more, reply_szx = block_fields(block2)
+            if reply_num << (reply_szx + 4) != len(body):
+                raise ValueError(f"unexpected block at offset {reply_num << (reply_szx + 4)}")
+
+            body += payload
+            if not more:
+                return bytes(body)
+
+            # Continue with the smaller of the two block sizes.
+            szx = min(szx, reply_szx)
+            num = len(body) >> (szx + 4)
+
+
+def run(client, server, sizes, block_sizes):
+    failures = 0
+
+    print(f"{'transfer':>10} {'size':>6} {'block':>6} {'requests':>9} {'datagrams':>10} "
+          f"{'bytes':>8} {'overhead':>9}")
+
+    for direction in ("upload", "download"):
+        for size in sizes:
+            for block_size in block_sizes:
+                client.reset_stats()
+                payload = random.Random(size).randbytes(size)
+
+                try:
+                    if direction == "upload":
+                        code = client.upload("data", payload, block_size)
+                        ok = code == CODE_CHANGED and server.received.get(
+                            (client.sock.getsockname(), "data")) == payload
+                    else:
+                        server.download = document(size)
+                        ok = client.download("config", block_size) == server.download
+                except (TimeoutError, ValueError) as e:
+                    print(f"{direction} of {size} bytes in {block_size} byte blocks: {e}")
+                    ok = False
+
+                failures += not ok
+                overhead = (client.bytes - size) / size
+                print(f"{direction:>10} {size:>6} {block_size:>6} {client.requests:>9} "
+                      f"{client.datagrams:>10} {client.bytes:>8} {overhead:>8.0%}"
+                      f"{'' if ok else '  FAILED'}")
+
+    return failures
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--loss", type=int, default=0,
+                        help="datagrams lost each way, in percent")
+    parser.add_argument("--server-szx", type=int, default=6, choices=range(7),
+                        help="largest block size exponent of the started server")
+    args = parser.parse_args()
+
+    server = Server(szx=args.server_szx, log=lambda message: None)
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(("127.0.0.1", 0))
+    threading.Thread(target=server.serve, args=(sock,), daemon=True).start()
+
+    client = Client(sock.getsockname(), args.loss)
+    failures = run(client, server, SIZES, BLOCK_SIZES)
+
+    # The size of the upload is checked from the first block.
+    server.max_size = 8192
+    client.reset_stats()
+    code = client.upload("data", bytes(16384), 512)
+    too_large = code == CODE_REQUEST_ENTITY_TOO_LARGE and client.requests == 1
+    print(f"16384 byte upload to a server taking 8192 bytes: "
+          f"{'rejected with the first block' if too_large else 'not rejected, FAILED'}")
+    failures += not too_large
+
+    if failures:
+        print(f"{failures} transfer(s) failed")
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == "__main__":
+    main()
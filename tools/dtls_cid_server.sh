@@ -0,0 +1,48 @@
+#!/bin/sh
+#
+# Copyright (c) 2021 Nordic Semiconductor
+#
+# SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+#
+
+# DTLS 1.2 server with the Connection ID (RFC 9146) and a session cache, for
+# checking CONFIG_CLOUD_DTLS_CID and CONFIG_CLOUD_DTLS_SESSION_CACHE. OpenSSL
+# has no Connection ID support, so this runs ssl_server2 of Mbed TLS, built
+# from the sources in the nRF Connect SDK (modules/crypto/mbedtls/programs/ssl)
+# with MBEDTLS_SSL_DTLS_CONNECTION_ID enabled.
+#
+# The server answers every record with a short text instead of CoAP, so the
+# check is done from the handshakes in its log, see "DTLS" in README.md.
+#
+#     PSK=000102030405060708090a0b0c0d0e0f PSK_IDENTITY=device \
+#         tools/dtls_cid_server.sh 5685
+#
+# Certificates are used instead of a PSK with CRT_FILE, KEY_FILE and CA_FILE.
+# CID=0 runs the server without the Connection ID.
+
+PORT=${1:-5684}
+SSL_SERVER2=${SSL_SERVER2:-ssl_server2}
+CID=${CID:-1}
+CID_VAL=${CID_VAL:-c1d0}
+
+if ! command -v "$SSL_SERVER2" > /dev/null; then
+	echo "ssl_server2 of Mbed TLS not found, set SSL_SERVER2 to its path" >&2
+	exit 1
+fi
+
+if [ -n "$PSK" ]; then
+	set -- psk="$PSK" psk_identity="${PSK_IDENTITY:-device}"
+elif [ -n "$CRT_FILE" ]; then
+	set -- crt_file="$CRT_FILE" key_file="$KEY_FILE" ca_file="$CA_FILE" auth_mode=required
+else
+	echo "Set PSK, or CRT_FILE, KEY_FILE and CA_FILE" >&2
+	exit 1
+fi
+
+# Sessions are resumed from the session ID cache of the server, not from
+# tickets, and stay in the cache for a day of PSM. The server serves one
+# peer after another, and keeps serving after a peer has gone quiet.
+exec "$SSL_SERVER2" server_port="$PORT" dtls=1 force_version=dtls12 \
+	cid="$CID" cid_val="$CID_VAL" \
+	tickets=0 cache_max=16 cache_timeout=86400 \
+	exchanges=1000000 read_timeout=0 debug_level=1 "$@"
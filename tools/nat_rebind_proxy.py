@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2021 Nordic Semiconductor
+#
+# SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+#
+
+"""UDP relay that changes its source port, as a NAT that has dropped the
+mapping of a sleeping device.
+
+Datagrams from the device are relayed to the server, and the replies back to
+the device. Every --rebind seconds of silence, and on SIGUSR1, the relay
+sends to the server from a new port, so the server sees the device at a new
+address. With the DTLS Connection ID the session goes on, without it the
+server drops the records and the device has to handshake again.
+
+    python3 tools/nat_rebind_proxy.py --port 5684 --server 127.0.0.1:5685 --rebind 60
+"""
+
+import argparse
+import selectors
+import signal
+import socket
+import time
+
+
+class Relay:
+    def __init__(self, port, server, rebind, log=print):
+        self.server = server
+        self.rebind_after = rebind
+        self.log = log
+        self.device = None
+        self.last_seen = time.monotonic()
+        self.rebinds = 0
+        self.selector = selectors.DefaultSelector()
+        self.downstream = socket.socket(socket.AF_INET6, socket.SOCK_DGRAM)
+        self.downstream.setsockopt(socket.IPPROTO_IPV6, socket.IPV6_V6ONLY, 0)
+        self.downstream.bind(("::", port))
+        self.selector.register(self.downstream, selectors.EVENT_READ, self.from_device)
+        self.upstream = None
+        self.rebind_pending = False
+        self.rebind()
+
+    def rebind(self):
+        if self.upstream is not None:
+            self.selector.unregister(self.upstream)
+            self.upstream.close()
+            self.rebinds += 1
+
+        self.upstream = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.upstream.connect(self.server)
+        self.selector.register(self.upstream, selectors.EVENT_READ, self.from_server)
+        self.log(f"Relaying to {self.server[0]}:{self.server[1]} "
+                 f"from port {self.upstream.getsockname()[1]}")
+
+    def from_device(self, sock):
+        datagram, self.device = sock.recvfrom(2048)
+
+        quiet = time.monotonic() - self.last_seen
+        if self.rebind_pending or (self.rebind_after and quiet > self.rebind_after):
+            self.log(f"Device quiet for {quiet:.0f} s, rebinding")
+            self.rebind()
+            self.rebind_pending = False
+
+        self.last_seen = time.monotonic()
+        self.upstream.send(datagram)
+
+    def from_server(self, sock):
+        datagram = sock.recv(2048)
+        if self.device is not None:
+            self.downstream.sendto(datagram, self.device)
+
+    def poll(self, timeout=None):
+        for key, _ in self.selector.select(timeout):
+            key.data(key.fileobj)
+
+    def serve(self):
+        while True:
+            self.poll()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--port", type=int, default=5684, help="port the device sends to")
+    parser.add_argument("--server", required=True, help="host:port of the server")
+    parser.add_argument("--rebind", type=float, default=60,
+                        help="seconds of silence after which the source port changes, "
+                        "0 to change it only on SIGUSR1")
+    args = parser.parse_args()
+
+    host, port = args.server.rsplit(":", 1)
+    relay = Relay(args.port, (host, int(port)), args.rebind)
+
+    def rebind_on_next(signum, frame):
+        relay.rebind_pending = True
+
+    signal.signal(signal.SIGUSR1, rebind_on_next)
+    relay.serve()
+
+
+if __name__ == "__main__":
+    main()